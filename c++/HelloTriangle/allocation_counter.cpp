@@ -0,0 +1,33 @@
+#include <allocation_counter.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+/**
+ * The global operator new, replaced to count the allocations made by
+ * the app (the driver allocates through malloc and is not counted).
+ * A relaxed increment is all it adds; the array, nothrow and sized
+ * forms end up here as well.
+ */
+static std::atomic<uint64_t> allocations{0};
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+uint64_t host_allocation_count() {
+    return allocations.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <cstdint>
+
+// calls to the global operator new since the process started
+uint64_t host_allocation_count();
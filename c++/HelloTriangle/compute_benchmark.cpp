@@ -0,0 +1,246 @@
+#include <compute_jobs.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <random>
+
+/**
+ * Two kernels at opposite ends: a reduction, which reads a lot and
+ * writes almost nothing back, and a 7x7 convolution, which downloads
+ * as much as it uploads. Each runs its jobs twice:
+ *  - batched: jobs are recorded in groups, upload, dispatch and
+ *    download phase by phase so that one barrier covers the group,
+ *    and submitted only when a slot's host memory is full,
+ *  - one submit per job, waited for before the next one is recorded,
+ *    which is how such work usually starts out.
+ * The jobs cycle through a few inputs, whose results are computed on
+ * the CPU once and compared with every job's.
+ */
+
+namespace {
+
+// see shaders/reduce.comp and shaders/convolve.comp
+const uint32_t reduce_group_values = 1024;
+const uint32_t convolve_group_size = 16;
+
+const uint32_t reduce_count = 1u << 20;
+const uint32_t image_width = 1024;
+const uint32_t image_height = 1024;
+const uint32_t convolve_radius = 3;
+const uint32_t input_sets = 4;
+// device buffers per kernel, twice the group so that a group does
+// not overwrite the inputs of the group still running before it
+const uint32_t batch_group = 4;
+const uint32_t buffer_sets = 2 * batch_group;
+
+struct reduce_constants {
+    uint32_t count;
+};
+
+struct convolve_constants {
+    uint32_t width;
+    uint32_t height;
+    uint32_t radius;
+};
+
+uint32_t group_count(uint32_t count, uint32_t group_size) {
+    return (count + group_size - 1) / group_size;
+}
+
+template <typename function>
+double time_ms(function&& body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+double reduce_on_cpu(const std::vector<float>& values) {
+    double sum = 0.0;
+    for (float value : values) {
+        sum += value;
+    }
+    return sum;
+}
+
+void convolve_on_cpu(const std::vector<float>& pixels, const std::vector<float>& weights, std::vector<float>& result) {
+    int radius = static_cast<int>(convolve_radius);
+    int side = 2 * radius + 1;
+    int width = static_cast<int>(image_width);
+    int height = static_cast<int>(image_height);
+    result.resize(pixels.size());
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            float sum = 0.0f;
+            for (int dy = -radius; dy <= radius; dy++) {
+                int row = std::clamp(y + dy, 0, height - 1) * width;
+                for (int dx = -radius; dx <= radius; dx++) {
+                    sum += weights[(dy + radius) * side + dx + radius] * pixels[row + std::clamp(x + dx, 0, width - 1)];
+                }
+            }
+            result[y * width + x] = sum;
+        }
+    }
+}
+
+// records `job_count` jobs, `group` at a time, and reports the difference in the stats
+void run_jobs(compute_jobs& jobs, const char* name, uint32_t job_count, uint32_t group, bool submit_each_group,
+              double work, const char* work_unit, const std::function<void(uint32_t, uint32_t)>& record_group,
+              const std::function<double()>& check) {
+    compute_job_stats before = jobs.get_stats();
+    double ms = time_ms([&] {
+        for (uint32_t first = 0; first < job_count; first += group) {
+            record_group(first, std::min(first + group, job_count));
+            if (submit_each_group) {
+                jobs.finish();
+            }
+        }
+        jobs.finish();
+    });
+    const compute_job_stats& after = jobs.get_stats();
+    std::cout << "\t" << name << ": " << ms << " ms, " << work / (ms * 1e-3) << " " << work_unit << ", "
+              << after.submits - before.submits << " submits, " << after.barriers - before.barriers << " barriers, "
+              << after.wait_ms - before.wait_ms << " ms waiting, max error " << check() << "\n";
+}
+
+}
+
+void benchmark_compute_jobs(compute_jobs& jobs, uint32_t job_count) {
+    // a fixed seed, so that runs see the same inputs
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    // the reduction: the input, then one partial sum per workgroup, reduced again until one is left
+    compute_jobs::kernel_id reduce = jobs.load_kernel("shaders/reduce.comp.spv");
+    std::vector<std::vector<float>> reduce_inputs(input_sets, std::vector<float>(reduce_count));
+    std::vector<double> reduce_references(input_sets);
+    for (uint32_t i = 0; i < input_sets; i++) {
+        std::generate(reduce_inputs[i].begin(), reduce_inputs[i].end(), [&] { return unit(random); });
+    }
+    double cpu_reduce_ms = time_ms([&] {
+        for (uint32_t i = 0; i < input_sets; i++) {
+            reduce_references[i] = reduce_on_cpu(reduce_inputs[i]);
+        }
+    }) / input_sets;
+    VkDeviceSize reduce_bytes = sizeof(float) * reduce_count;
+    VkDeviceSize partial_bytes = sizeof(float) * group_count(reduce_count, reduce_group_values);
+    std::vector<compute_jobs::buffer_id> reduce_buffers;
+    for (uint32_t i = 0; i < buffer_sets; i++) {
+        reduce_buffers.push_back(jobs.create_buffer(reduce_bytes));
+        reduce_buffers.push_back(jobs.create_buffer(partial_bytes));
+        reduce_buffers.push_back(jobs.create_buffer(partial_bytes));
+    }
+    std::vector<float> sums(job_count);
+
+    auto record_reductions = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t j = begin; j < end; j++) {
+            jobs.upload(reduce_buffers[3 * (j % buffer_sets)], reduce_inputs[j % input_sets].data(), reduce_bytes);
+        }
+        // pass by pass across the group, the count shrinks the same way for every job
+        uint32_t source[buffer_sets] = {};
+        uint32_t count = reduce_count;
+        for (uint32_t pass = 0; count > 1; pass++) {
+            for (uint32_t j = begin; j < end; j++) {
+                uint32_t set = j % buffer_sets;
+                uint32_t destination = 1 + pass % 2;
+                reduce_constants constants{count};
+                jobs.dispatch(reduce, {reduce_buffers[3 * set + source[set]], reduce_buffers[3 * set + destination]},
+                              &constants, group_count(count, reduce_group_values));
+                source[set] = destination;
+            }
+            count = group_count(count, reduce_group_values);
+        }
+        for (uint32_t j = begin; j < end; j++) {
+            uint32_t set = j % buffer_sets;
+            jobs.download(reduce_buffers[3 * set + source[set]], &sums[j], sizeof(float));
+        }
+    };
+    auto check_reductions = [&] {
+        double error = 0.0;
+        for (uint32_t j = 0; j < job_count; j++) {
+            double reference = reduce_references[j % input_sets];
+            error = std::max(error, std::abs(sums[j] - reference) / reference);
+        }
+        return error;
+    };
+
+    double reduce_gb = double(job_count) * reduce_bytes * 1e-9;
+    std::cout << "reduction: " << job_count << " jobs of " << reduce_count << " floats; CPU, one thread: "
+              << reduce_bytes * 1e-9 / (cpu_reduce_ms * 1e-3) << " GB/s\n";
+    run_jobs(jobs, "batched", job_count, batch_group, false, reduce_gb, "GB/s", record_reductions, check_reductions);
+    run_jobs(jobs, "one submit per job", job_count, 1, true, reduce_gb, "GB/s", record_reductions, check_reductions);
+
+    // the convolution: a normalized gaussian, so the result stays in the range of the input
+    compute_jobs::kernel_id convolve = jobs.load_kernel("shaders/convolve.comp.spv");
+    uint32_t side = 2 * convolve_radius + 1;
+    std::vector<float> weights(side * side);
+    float weight_sum = 0.0f;
+    for (uint32_t y = 0; y < side; y++) {
+        for (uint32_t x = 0; x < side; x++) {
+            float dx = float(x) - float(convolve_radius);
+            float dy = float(y) - float(convolve_radius);
+            weights[y * side + x] = std::exp(-(dx * dx + dy * dy) / 4.0f);
+            weight_sum += weights[y * side + x];
+        }
+    }
+    for (float& weight : weights) {
+        weight /= weight_sum;
+    }
+    size_t pixel_count = size_t(image_width) * image_height;
+    std::vector<std::vector<float>> images(input_sets, std::vector<float>(pixel_count));
+    std::vector<std::vector<float>> convolve_references(input_sets);
+    for (auto& image : images) {
+        std::generate(image.begin(), image.end(), [&] { return unit(random); });
+    }
+    double cpu_convolve_ms = time_ms([&] {
+        for (uint32_t i = 0; i < input_sets; i++) {
+            convolve_on_cpu(images[i], weights, convolve_references[i]);
+        }
+    }) / input_sets;
+    VkDeviceSize image_bytes = sizeof(float) * pixel_count;
+    compute_jobs::buffer_id weight_buffer = jobs.create_buffer(sizeof(float) * weights.size());
+    jobs.upload(weight_buffer, weights.data(), sizeof(float) * weights.size());
+    std::vector<compute_jobs::buffer_id> image_buffers;
+    for (uint32_t i = 0; i < buffer_sets; i++) {
+        image_buffers.push_back(jobs.create_buffer(image_bytes));
+        image_buffers.push_back(jobs.create_buffer(image_bytes));
+    }
+    std::vector<std::vector<float>> results(job_count, std::vector<float>(pixel_count));
+
+    auto record_convolutions = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t j = begin; j < end; j++) {
+            jobs.upload(image_buffers[2 * (j % buffer_sets)], images[j % input_sets].data(), image_bytes);
+        }
+        convolve_constants constants{image_width, image_height, convolve_radius};
+        for (uint32_t j = begin; j < end; j++) {
+            uint32_t set = j % buffer_sets;
+            jobs.dispatch(convolve, {image_buffers[2 * set], image_buffers[2 * set + 1], weight_buffer}, &constants,
+                          group_count(image_width, convolve_group_size), group_count(image_height, convolve_group_size));
+        }
+        for (uint32_t j = begin; j < end; j++) {
+            jobs.download(image_buffers[2 * (j % buffer_sets) + 1], results[j].data(), image_bytes);
+        }
+    };
+    auto check_convolutions = [&] {
+        double error = 0.0;
+        for (uint32_t j = 0; j < job_count; j++) {
+            const auto& reference = convolve_references[j % input_sets];
+            for (size_t p = 0; p < pixel_count; p++) {
+                error = std::max(error, double(std::abs(results[j][p] - reference[p])));
+            }
+        }
+        return error;
+    };
+
+    double megapixels = double(job_count) * pixel_count * 1e-6;
+    std::cout << "convolution: " << job_count << " jobs of " << image_width << "x" << image_height << ", "
+              << side << "x" << side << " kernel; CPU, one thread: "
+              << pixel_count * 1e-6 / (cpu_convolve_ms * 1e-3) << " Mpixel/s\n";
+    run_jobs(jobs, "batched", job_count, batch_group, false, megapixels, "Mpixel/s", record_convolutions,
+             check_convolutions);
+    run_jobs(jobs, "one submit per job", job_count, 1, true, megapixels, "Mpixel/s", record_convolutions,
+             check_convolutions);
+    std::cout << std::flush;
+}
@@ -0,0 +1,429 @@
+#include <compute_jobs.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// staging and readback offsets, keeps the copies to whole cache lines
+const VkDeviceSize copy_alignment = 64;
+
+VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+}
+
+void compute_jobs::init(VkDevice device, const VkAllocationCallbacks* callbacks, gpu_allocator* allocator,
+                        shader_library* shaders, VkPipelineCache pipeline_cache,
+                        uint32_t queue_family, VkQueue queue, bool timeline_semaphores,
+                        uint32_t slot_count, VkDeviceSize slot_size) {
+    this->device = device;
+    this->callbacks = callbacks;
+    this->allocator = allocator;
+    this->shaders = shaders;
+    this->pipeline_cache = pipeline_cache;
+    this->queue = queue;
+    this->slot_size = slot_size;
+    timeline = timeline_semaphores;
+
+    VkCommandPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    // each slot re-records its command buffer for every batch
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex = queue_family;
+    if (vkCreateCommandPool(device, &pool_info, callbacks, &command_pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create the compute command pool!");
+    }
+
+    if (timeline) {
+        VkSemaphoreTypeCreateInfo type_info{};
+        type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        type_info.initialValue = 0;
+        VkSemaphoreCreateInfo semaphore_info{};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphore_info.pNext = &type_info;
+        if (vkCreateSemaphore(device, &semaphore_info, callbacks, &timeline_semaphore) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create the compute timeline semaphore!");
+        }
+    }
+
+    // a pool set per slot, reset when the slot starts its next batch
+    descriptors.init(device, callbacks, slot_count, false);
+
+    slots.resize(slot_count);
+    for (auto& s : slots) {
+        VkCommandBufferAllocateInfo allocate_info{};
+        allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocate_info.commandPool = command_pool;
+        allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocate_info.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(device, &allocate_info, &s.command_buffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate a compute command buffer!");
+        }
+        if (!timeline) {
+            VkFenceCreateInfo fence_info{};
+            fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            if (vkCreateFence(device, &fence_info, callbacks, &s.fence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create a compute fence!");
+            }
+        }
+        // written once by the CPU and read once by the copy, like the upload ring
+        s.staging = allocator->create_buffer(slot_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                             0, s.staging_memory);
+        // cached memory, every byte of it is read back by the CPU
+        s.readback = allocator->create_buffer(slot_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                              VK_MEMORY_PROPERTY_HOST_CACHED_BIT, s.readback_memory);
+    }
+}
+
+void compute_jobs::destroy() {
+    if (device == VK_NULL_HANDLE) {
+        return;
+    }
+    // a batch that was never submitted is simply dropped with its pool
+    for (const auto& s : slots) {
+        if (s.in_flight) {
+            wait_for_slot(s);
+        }
+        if (s.fence != VK_NULL_HANDLE) {
+            vkDestroyFence(device, s.fence, callbacks);
+        }
+        allocator->destroy_buffer(s.staging, s.staging_memory);
+        allocator->destroy_buffer(s.readback, s.readback_memory);
+    }
+    slots.clear();
+    for (const auto& b : buffers) {
+        allocator->destroy_buffer(b.buffer, b.allocation);
+    }
+    buffers.clear();
+    for (const auto& k : kernels) {
+        vkDestroyPipeline(device, k.pipeline, callbacks);
+    }
+    kernels.clear();
+    descriptors.destroy();
+    // destroying the pool frees all of its command buffers
+    vkDestroyCommandPool(device, command_pool, callbacks);
+    if (timeline_semaphore != VK_NULL_HANDLE) {
+        vkDestroySemaphore(device, timeline_semaphore, callbacks);
+    }
+    device = VK_NULL_HANDLE;
+}
+
+compute_jobs::kernel_id compute_jobs::load_kernel(const std::string& path) {
+    const shader& module = shaders->load(path);
+    if (module.reflection.stage != VK_SHADER_STAGE_COMPUTE_BIT) {
+        throw std::runtime_error(path + " is not a compute shader!");
+    }
+    for (const auto& binding : module.reflection.bindings) {
+        if (binding.set != 0 || binding.type != VK_DESCRIPTOR_TYPE_STORAGE_BUFFER || binding.count != 1) {
+            throw std::runtime_error(path + ": kernels may only bind single storage buffers in set 0!");
+        }
+    }
+
+    kernel k;
+    reflected_layout layout = shaders->create_pipeline_layout({&module});
+    k.layout = layout.layout;
+    k.set_layout = layout.set_layouts.empty() ? VK_NULL_HANDLE : layout.set_layouts[0];
+    k.bindings = module.reflection.bindings;
+    k.push_constant_size = module.reflection.push_constant_size;
+
+    VkComputePipelineCreateInfo pipeline_info{};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = module.module;
+    pipeline_info.stage.pName = "main";
+    pipeline_info.layout = k.layout;
+    if (vkCreateComputePipelines(device, pipeline_cache, 1, &pipeline_info, callbacks, &k.pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create the pipeline of " + path + "!");
+    }
+    kernels.push_back(std::move(k));
+    return static_cast<kernel_id>(kernels.size() - 1);
+}
+
+compute_jobs::buffer_id compute_jobs::create_buffer(VkDeviceSize size) {
+    buffer b;
+    b.buffer = allocator->create_buffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                                  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, b.allocation);
+    b.size = size;
+    buffers.push_back(b);
+    return static_cast<buffer_id>(buffers.size() - 1);
+}
+
+void compute_jobs::wait_for_slot(const slot& s) {
+    auto start = std::chrono::steady_clock::now();
+    if (timeline) {
+        VkSemaphoreWaitInfo wait_info{};
+        wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        wait_info.semaphoreCount = 1;
+        wait_info.pSemaphores = &timeline_semaphore;
+        wait_info.pValues = &s.value;
+        vkWaitSemaphores(device, &wait_info, UINT64_MAX);
+    } else {
+        vkWaitForFences(device, 1, &s.fence, VK_TRUE, UINT64_MAX);
+    }
+    stats.wait_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void compute_jobs::retire(slot& s) {
+    wait_for_slot(s);
+    auto readback = static_cast<const char*>(s.readback_memory.mapped);
+    for (const auto& d : s.downloads) {
+        std::memcpy(d.destination, readback + d.readback_offset, d.size);
+    }
+    s.downloads.clear();
+    s.in_flight = false;
+}
+
+/**
+ * Starting a batch is where double buffering happens: the slot's last
+ * batch was submitted two batches ago (with two slots) and has most
+ * likely completed while the other slot was being filled, so the wait
+ * here is usually free and the downloads are ready to be copied out.
+ */
+compute_jobs::slot& compute_jobs::recording_slot() {
+    slot& s = slots[current_slot];
+    if (recording) {
+        return s;
+    }
+    if (s.in_flight) {
+        retire(s);
+    }
+    vkResetCommandBuffer(s.command_buffer, 0);
+    if (!timeline) {
+        vkResetFences(device, 1, &s.fence);
+    }
+    descriptors.begin_frame(current_slot, next_value);
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(s.command_buffer, &begin_info) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording a compute command buffer!");
+    }
+    s.value = next_value;
+    s.staging_used = 0;
+    s.readback_used = 0;
+    recording = true;
+    return s;
+}
+
+// read after write, or write after read or write, since the last barrier
+bool compute_jobs::conflicts(const buffer& b, bool write) const {
+    return b.written > last_barrier || (write && b.read > last_barrier);
+}
+
+/**
+ * One global barrier covers every buffer, which is what drivers do
+ * with per-buffer barriers anyway. Commands of earlier batches are
+ * covered as well, they come earlier in submission order on the same
+ * queue.
+ */
+void compute_jobs::record_barrier(VkCommandBuffer command_buffer) {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT |
+                            VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+    vkCmdPipelineBarrier(command_buffer, stages, stages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    // everything recorded so far, the command about to be recorded is not
+    last_barrier = commands;
+    stats.barriers++;
+}
+
+void compute_jobs::upload(buffer_id id, const void* data, VkDeviceSize size, VkDeviceSize offset) {
+    buffer& b = buffers[id];
+    if (offset + size > b.size) {
+        throw std::runtime_error("compute upload out of the buffer's bounds!");
+    }
+    auto bytes = static_cast<const char*>(data);
+    VkDeviceSize done = 0;
+    while (done < size) {
+        slot& s = recording_slot();
+        VkDeviceSize staging_offset = align_up(s.staging_used, copy_alignment);
+        if (staging_offset >= slot_size) {
+            // the rest goes into the next batch, which takes the other slot
+            submit();
+            continue;
+        }
+        VkDeviceSize chunk = std::min(size - done, slot_size - staging_offset);
+        std::memcpy(static_cast<char*>(s.staging_memory.mapped) + staging_offset, bytes + done, chunk);
+        s.staging_used = staging_offset + chunk;
+
+        // the chunks of one upload never overlap each other
+        if (done == 0 && conflicts(b, true)) {
+            record_barrier(s.command_buffer);
+        }
+        b.written = ++commands;
+        VkBufferCopy region{};
+        region.srcOffset = staging_offset;
+        region.dstOffset = offset + done;
+        region.size = chunk;
+        vkCmdCopyBuffer(s.command_buffer, s.staging, b.buffer, 1, &region);
+        done += chunk;
+        stats.bytes_uploaded += chunk;
+    }
+}
+
+void compute_jobs::dispatch(kernel_id id, const std::vector<buffer_id>& bindings, const void* push_constants,
+                            uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z) {
+    const kernel& k = kernels[id];
+    for (const auto& binding : k.bindings) {
+        if (binding.binding >= bindings.size()) {
+            throw std::runtime_error("compute dispatch without a buffer for binding " +
+                                     std::to_string(binding.binding) + "!");
+        }
+    }
+    if (k.push_constant_size > 0 && push_constants == nullptr) {
+        throw std::runtime_error("compute dispatch without its push constants!");
+    }
+    slot& s = recording_slot();
+
+    std::vector<VkDescriptorBufferInfo> buffer_infos(k.bindings.size());
+    std::vector<VkWriteDescriptorSet> writes(k.bindings.size());
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    if (k.set_layout != VK_NULL_HANDLE) {
+        set = descriptors.allocate(current_slot, k.set_layout);
+    }
+    bool hazard = false;
+    for (size_t i = 0; i < k.bindings.size(); i++) {
+        const buffer& b = buffers[bindings[k.bindings[i].binding]];
+        hazard = hazard || conflicts(b, !k.bindings[i].read_only);
+        buffer_infos[i].buffer = b.buffer;
+        buffer_infos[i].offset = 0;
+        buffer_infos[i].range = VK_WHOLE_SIZE;
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = set;
+        writes[i].dstBinding = k.bindings[i].binding;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &buffer_infos[i];
+    }
+    if (!writes.empty()) {
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+    if (hazard) {
+        record_barrier(s.command_buffer);
+    }
+    ++commands;
+    for (const auto& binding : k.bindings) {
+        buffer& b = buffers[bindings[binding.binding]];
+        (binding.read_only ? b.read : b.written) = commands;
+    }
+
+    vkCmdBindPipeline(s.command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, k.pipeline);
+    if (set != VK_NULL_HANDLE) {
+        vkCmdBindDescriptorSets(s.command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, k.layout, 0, 1, &set, 0, nullptr);
+    }
+    if (k.push_constant_size > 0) {
+        vkCmdPushConstants(s.command_buffer, k.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, k.push_constant_size,
+                           push_constants);
+    }
+    vkCmdDispatch(s.command_buffer, group_count_x, group_count_y, group_count_z);
+    stats.dispatches++;
+}
+
+void compute_jobs::download(buffer_id id, void* destination, VkDeviceSize size, VkDeviceSize offset) {
+    buffer& b = buffers[id];
+    if (offset + size > b.size) {
+        throw std::runtime_error("compute download out of the buffer's bounds!");
+    }
+    auto bytes = static_cast<char*>(destination);
+    VkDeviceSize done = 0;
+    while (done < size) {
+        slot& s = recording_slot();
+        VkDeviceSize readback_offset = align_up(s.readback_used, copy_alignment);
+        if (readback_offset >= slot_size) {
+            submit();
+            continue;
+        }
+        VkDeviceSize chunk = std::min(size - done, slot_size - readback_offset);
+        s.readback_used = readback_offset + chunk;
+
+        if (conflicts(b, false)) {
+            record_barrier(s.command_buffer);
+        }
+        b.read = ++commands;
+        VkBufferCopy region{};
+        region.srcOffset = offset + done;
+        region.dstOffset = readback_offset;
+        region.size = chunk;
+        vkCmdCopyBuffer(s.command_buffer, b.buffer, s.readback, 1, &region);
+        s.downloads.push_back({bytes + done, readback_offset, chunk});
+        done += chunk;
+        stats.bytes_downloaded += chunk;
+    }
+}
+
+compute_jobs::ticket compute_jobs::submit() {
+    if (!recording) {
+        return next_value - 1;
+    }
+    slot& s = slots[current_slot];
+    if (!s.downloads.empty()) {
+        // the copies have to be visible to the host once the batch has completed
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(s.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+    if (vkEndCommandBuffer(s.command_buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record a compute command buffer!");
+    }
+
+    VkSubmitInfo submit_info{};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &s.command_buffer;
+    VkTimelineSemaphoreSubmitInfo timeline_info{};
+    if (timeline) {
+        timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timeline_info.signalSemaphoreValueCount = 1;
+        timeline_info.pSignalSemaphoreValues = &s.value;
+        submit_info.pNext = &timeline_info;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &timeline_semaphore;
+    }
+    if (vkQueueSubmit(queue, 1, &submit_info, s.fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit a compute batch!");
+    }
+    s.in_flight = true;
+    recording = false;
+    next_value++;
+    current_slot = (current_slot + 1) % static_cast<uint32_t>(slots.size());
+    stats.submits++;
+    return s.value;
+}
+
+void compute_jobs::wait(ticket value) {
+    if (value >= next_value) {
+        submit();
+    }
+    // oldest first, so that downloads into the same memory land in order
+    for (size_t i = 0; i < slots.size(); i++) {
+        slot& s = slots[(current_slot + i) % slots.size()];
+        if (s.in_flight && s.value <= value) {
+            retire(s);
+        }
+    }
+}
+
+void compute_jobs::print_stats(std::ostream& out) const {
+    if (slots.empty()) {
+        return;
+    }
+    out << "compute: " << stats.submits << " submits, " << stats.dispatches << " dispatches, "
+        << stats.barriers << " barriers, " << stats.bytes_uploaded / (1024.0 * 1024.0) << " MiB up, "
+        << stats.bytes_downloaded / (1024.0 * 1024.0) << " MiB down, " << stats.wait_ms << " ms waiting on "
+        << slots.size() << " slots of " << slot_size / (1024 * 1024) << " MiB" << std::endl;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <gpu_allocator.hpp>
+#include <shader_library.hpp>
+#include <descriptor_manager.hpp>
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <cstdint>
+
+struct compute_job_stats {
+    uint64_t submits = 0;
+    uint64_t dispatches = 0;
+    uint64_t barriers = 0;
+    uint64_t bytes_uploaded = 0;
+    uint64_t bytes_downloaded = 0;
+    double wait_ms = 0.0; // the host blocked on a slot or a ticket
+};
+
+/**
+ * Compute work without any rendering: SPIR-V kernels whose storage
+ * buffers are bound by binding number, and device-local buffers that
+ * data is uploaded to and downloaded from. Like upload_manager the
+ * work is batched, upload(), dispatch() and download() only record,
+ * and a batch goes to the queue in a single submit when submit() is
+ * called or its host memory runs out.
+ *
+ * Host I/O goes through slots (two by default), each with its own
+ * command buffer, staging and readback memory and descriptor pools.
+ * Batches take the slots in turn, so the host copies the inputs of
+ * the next batch and the results of the previous one while the
+ * device runs the current one. A slot is reused once its last batch
+ * has completed, which is also when that batch's downloads are
+ * copied to their destinations; wait() does the same for a ticket.
+ *
+ * Barriers are recorded only where a command touches a buffer that an
+ * earlier command wrote, or writes one an earlier command read (read-
+ * only bindings come from reflection), so independent dispatches of a
+ * batch may overlap. Not thread-safe.
+ */
+class compute_jobs
+{
+public:
+    using ticket = uint64_t;
+    using kernel_id = uint32_t;
+    using buffer_id = uint32_t;
+
+    void init(VkDevice device, const VkAllocationCallbacks* callbacks, gpu_allocator* allocator,
+              shader_library* shaders, VkPipelineCache pipeline_cache,
+              uint32_t queue_family, VkQueue queue, bool timeline_semaphores,
+              uint32_t slot_count = 2, VkDeviceSize slot_size = 32ull * 1024 * 1024);
+    // waits for everything still in flight
+    void destroy();
+
+    // a compute shader with its descriptor bindings in set 0
+    kernel_id load_kernel(const std::string& path);
+    buffer_id create_buffer(VkDeviceSize size);
+    VkDeviceSize buffer_size(buffer_id buffer) const { return buffers[buffer].size; }
+
+    // `data` is copied right away and may be reused on return
+    void upload(buffer_id buffer, const void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+    // bindings[b] is bound to binding b; `push_constants` must have the
+    // size the kernel declares
+    void dispatch(kernel_id kernel, const std::vector<buffer_id>& bindings, const void* push_constants,
+                  uint32_t group_count_x, uint32_t group_count_y = 1, uint32_t group_count_z = 1);
+    // `destination` is written once the batch has completed, see wait()
+    void download(buffer_id buffer, void* destination, VkDeviceSize size, VkDeviceSize offset = 0);
+
+    // send the current batch off, returns its ticket
+    ticket submit();
+    // the ticket of the batch the next command goes into
+    ticket current() const { return next_value; }
+    // blocks until the batch has completed and its downloads arrived
+    void wait(ticket value);
+    void finish() { wait(submit()); }
+
+    const compute_job_stats& get_stats() const { return stats; }
+    void print_stats(std::ostream& out) const;
+
+private:
+    struct kernel {
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VkPipelineLayout layout = VK_NULL_HANDLE; // owned by shaders
+        VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+        std::vector<reflected_binding> bindings;
+        uint32_t push_constant_size = 0;
+    };
+
+    struct buffer {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        gpu_allocation allocation;
+        VkDeviceSize size = 0;
+        // the command that last wrote or read it, see conflicts()
+        uint64_t written = 0;
+        uint64_t read = 0;
+    };
+
+    struct pending_download {
+        void* destination;
+        VkDeviceSize readback_offset;
+        VkDeviceSize size;
+    };
+
+    struct slot {
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE; // only without timeline semaphores
+        ticket value = 0;               // of its last batch, 0 if it never had one
+        bool in_flight = false;
+        VkBuffer staging = VK_NULL_HANDLE;
+        gpu_allocation staging_memory;
+        VkDeviceSize staging_used = 0;
+        VkBuffer readback = VK_NULL_HANDLE;
+        gpu_allocation readback_memory;
+        VkDeviceSize readback_used = 0;
+        std::vector<pending_download> downloads;
+    };
+
+    slot& recording_slot();
+    void wait_for_slot(const slot& s);
+    void retire(slot& s);
+    bool conflicts(const buffer& b, bool write) const;
+    void record_barrier(VkCommandBuffer command_buffer);
+
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks* callbacks = nullptr;
+    gpu_allocator* allocator = nullptr;
+    shader_library* shaders = nullptr;
+    VkPipelineCache pipeline_cache = VK_NULL_HANDLE;
+    VkQueue queue = VK_NULL_HANDLE;
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+    descriptor_manager descriptors;
+
+    bool timeline = false;
+    VkSemaphore timeline_semaphore = VK_NULL_HANDLE;
+    ticket next_value = 1;
+
+    std::vector<slot> slots;
+    uint32_t current_slot = 0;
+    bool recording = false;
+    VkDeviceSize slot_size = 0;
+
+    std::vector<kernel> kernels;
+    std::vector<buffer> buffers;
+    // commands are numbered as they are recorded, across batches
+    uint64_t commands = 0;
+    uint64_t last_barrier = 0;
+    compute_job_stats stats;
+};
+
+// a reduction and a 2D convolution, batched and with one submit per job,
+// checked against the CPU; see compute_benchmark.cpp
+void benchmark_compute_jobs(compute_jobs& jobs, uint32_t job_count);
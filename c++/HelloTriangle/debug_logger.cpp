@@ -0,0 +1,265 @@
+#include <debug_logger.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+bool parse_debug_severity(const std::string& name, VkDebugUtilsMessageSeverityFlagsEXT& severities) {
+    const VkDebugUtilsMessageSeverityFlagsEXT all = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT |
+                                                    VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT |
+                                                    VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
+                                                    VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    VkDebugUtilsMessageSeverityFlagBitsEXT minimum;
+    if (name == "verbose") {
+        minimum = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+    } else if (name == "info") {
+        minimum = VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT;
+    } else if (name == "warning") {
+        minimum = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT;
+    } else if (name == "error") {
+        minimum = VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    } else {
+        return false;
+    }
+    // the severity bits are ordered, everything from `minimum` up
+    severities = all & ~(VkDebugUtilsMessageSeverityFlagsEXT(minimum) - 1);
+    return true;
+}
+
+bool parse_debug_types(const std::string& names, VkDebugUtilsMessageTypeFlagsEXT& types) {
+    types = 0;
+    size_t start = 0;
+    while (start <= names.size()) {
+        size_t comma = std::min(names.find(',', start), names.size());
+        std::string name = names.substr(start, comma - start);
+        if (name == "general") {
+            types |= VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT;
+        } else if (name == "validation") {
+            types |= VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT;
+        } else if (name == "performance") {
+            types |= VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+        } else {
+            return false;
+        }
+        start = comma + 1;
+    }
+    return types != 0;
+}
+
+void debug_logger::start(uint32_t rate_limit) {
+    this->rate_limit = rate_limit;
+    queue = std::make_unique<queued_message[]>(queue_size);
+    for (size_t i = 0; i < queue_size; i++) {
+        queue[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    ids = std::make_unique<id_counters[]>(id_table_size);
+    stopping = false;
+    logger = std::thread(&debug_logger::logger_loop, this);
+    running = true;
+}
+
+void debug_logger::stop() {
+    if (!running) {
+        return;
+    }
+    stopping.store(true, std::memory_order_release);
+    logger.join();
+    running = false;
+}
+
+VKAPI_ATTR VkBool32 VKAPI_CALL debug_logger::callback(VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+                                                      VkDebugUtilsMessageTypeFlagsEXT type,
+                                                      const VkDebugUtilsMessengerCallbackDataEXT* callback_data,
+                                                      void* user_data) {
+    auto start = std::chrono::steady_clock::now();
+    auto self = static_cast<debug_logger*>(user_data);
+    self->handle(severity, type, callback_data);
+    auto end = std::chrono::steady_clock::now();
+    self->callback_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(),
+                                std::memory_order_relaxed);
+    // never abort the call that triggered the message
+    return VK_FALSE;
+}
+
+void debug_logger::handle(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT type,
+                          const VkDebugUtilsMessengerCallbackDataEXT* callback_data) {
+    messages.fetch_add(1, std::memory_order_relaxed);
+    if (severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+        errors.fetch_add(1, std::memory_order_relaxed);
+    } else if (severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+        warnings.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint32_t slot = find_id(callback_data);
+    id_counters& id = ids[slot];
+    id.total.fetch_add(1, std::memory_order_relaxed);
+    if (rate_limit > 0) {
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        auto second = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(now).count());
+        uint64_t window = id.window.load(std::memory_order_relaxed);
+        // whoever moves the window on resets the count; a message racing
+        // with that may be counted in either window, which is fine here
+        if (window != second && id.window.compare_exchange_strong(window, second, std::memory_order_relaxed)) {
+            id.window_count.store(0, std::memory_order_relaxed);
+        }
+        if (id.window_count.fetch_add(1, std::memory_order_relaxed) >= rate_limit) {
+            id.suppressed.fetch_add(1, std::memory_order_relaxed);
+            suppressed.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    if (!push(severity, type, slot, callback_data->pMessage ? callback_data->pMessage : "")) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// open addressing on the message ID; when the table is full, the
+// remaining IDs share the last slot probed
+uint32_t debug_logger::find_id(const VkDebugUtilsMessengerCallbackDataEXT* callback_data) {
+    // the layers derive messageIdNumber from the VUID, other messages may leave it 0
+    auto key = static_cast<uint32_t>(callback_data->messageIdNumber);
+    const char* name = callback_data->pMessageIdName ? callback_data->pMessageIdName : "";
+    if (key == 0) {
+        key = 2166136261u;
+        for (const char* c = name; *c; c++) {
+            key = (key ^ static_cast<uint8_t>(*c)) * 16777619u;
+        }
+    }
+    key = std::max(key, 1u); // 0 marks a free slot
+
+    uint32_t slot = (key * 2654435761u) & (id_table_size - 1);
+    for (size_t probe = 0; probe < id_table_size; probe++, slot = (slot + 1) & (id_table_size - 1)) {
+        id_counters& id = ids[slot];
+        uint32_t current = id.key.load(std::memory_order_acquire);
+        if (current == key) {
+            return slot;
+        }
+        if (current == 0 && id.key.compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+            std::strncpy(id.name, name, id_name_size - 1);
+            id.name[id_name_size - 1] = '\0';
+            id.named.store(true, std::memory_order_release);
+            id_count.fetch_add(1, std::memory_order_relaxed);
+            return slot;
+        }
+        if (current == key) {
+            return slot;
+        }
+    }
+    return slot;
+}
+
+// a bounded multi-producer queue (Vyukov): every slot carries a
+// sequence number that says whether it is free for the producer of
+// a given position or holds the message for the consumer
+bool debug_logger::push(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT type,
+                        uint32_t id_slot, const char* text) {
+    size_t position = enqueue_position.load(std::memory_order_relaxed);
+    queued_message* message;
+    while (true) {
+        message = &queue[position & (queue_size - 1)];
+        size_t sequence = message->sequence.load(std::memory_order_acquire);
+        auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (difference == 0) {
+            if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            return false;
+        } else {
+            position = enqueue_position.load(std::memory_order_relaxed);
+        }
+    }
+    message->severity = severity;
+    message->type = type;
+    message->id_slot = id_slot;
+    std::strncpy(message->text, text, message_size - 1);
+    message->text[message_size - 1] = '\0';
+    message->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+size_t debug_logger::drain(std::ostream& out) {
+    size_t count = 0;
+    while (true) {
+        queued_message& message = queue[dequeue_position & (queue_size - 1)];
+        if (message.sequence.load(std::memory_order_acquire) != dequeue_position + 1) {
+            break;
+        }
+        const char* severity = "verbose";
+        if (message.severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+            severity = "error";
+        } else if (message.severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+            severity = "warning";
+        } else if (message.severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) {
+            severity = "info";
+        }
+        out << "validation layer (" << severity << "): " << message.text;
+        id_counters& id = ids[message.id_slot];
+        uint64_t suppressed_so_far = id.suppressed.load(std::memory_order_relaxed);
+        if (suppressed_so_far > id.reported_suppressed) {
+            out << " [" << suppressed_so_far - id.reported_suppressed << " repeats suppressed]";
+            id.reported_suppressed = suppressed_so_far;
+        }
+        out << '\n';
+        // hand the slot back to the producers, one lap later
+        message.sequence.store(dequeue_position + queue_size, std::memory_order_release);
+        dequeue_position++;
+        count++;
+    }
+    if (count > 0) {
+        logged.fetch_add(count, std::memory_order_relaxed);
+        out.flush();
+    }
+    return count;
+}
+
+void debug_logger::logger_loop() {
+    while (!stopping.load(std::memory_order_acquire)) {
+        if (drain(std::cerr) == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+    drain(std::cerr);
+}
+
+debug_logger_stats debug_logger::get_stats() const {
+    debug_logger_stats stats;
+    stats.messages = messages.load(std::memory_order_relaxed);
+    stats.errors = errors.load(std::memory_order_relaxed);
+    stats.warnings = warnings.load(std::memory_order_relaxed);
+    stats.logged = logged.load(std::memory_order_relaxed);
+    stats.suppressed = suppressed.load(std::memory_order_relaxed);
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    stats.message_ids = id_count.load(std::memory_order_relaxed);
+    stats.callback_ms = callback_ns.load(std::memory_order_relaxed) / 1e6;
+    return stats;
+}
+
+void debug_logger::print_stats(std::ostream& out) const {
+    if (!ids) {
+        return;
+    }
+    auto stats = get_stats();
+    out << "validation messages: " << stats.messages << " (" << stats.errors << " errors, "
+        << stats.warnings << " warnings) with " << stats.message_ids << " IDs, " << stats.logged
+        << " logged, " << stats.suppressed << " suppressed, " << stats.dropped << " dropped; "
+        << stats.callback_ms << " ms in the callback\n";
+
+    std::vector<const id_counters*> noisy;
+    for (size_t i = 0; i < id_table_size; i++) {
+        if (ids[i].named.load(std::memory_order_acquire) && ids[i].suppressed.load(std::memory_order_relaxed) > 0) {
+            noisy.push_back(&ids[i]);
+        }
+    }
+    std::sort(noisy.begin(), noisy.end(), [](const id_counters* a, const id_counters* b) {
+        return a->suppressed.load(std::memory_order_relaxed) > b->suppressed.load(std::memory_order_relaxed);
+    });
+    noisy.resize(std::min<size_t>(noisy.size(), 5));
+    for (const id_counters* id : noisy) {
+        out << '\t' << (id->name[0] ? id->name : "(unnamed)") << ": " << id->total.load(std::memory_order_relaxed)
+            << " messages, " << id->suppressed.load(std::memory_order_relaxed) << " suppressed\n";
+    }
+    out << std::flush;
+}
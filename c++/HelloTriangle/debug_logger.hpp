@@ -0,0 +1,111 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <string>
+#include <ostream>
+#include <cstdint>
+
+// "verbose", "info", "warning" or "error": that severity and all above it
+bool parse_debug_severity(const std::string& name, VkDebugUtilsMessageSeverityFlagsEXT& severities);
+// a comma-separated list of "general", "validation" and "performance"
+bool parse_debug_types(const std::string& names, VkDebugUtilsMessageTypeFlagsEXT& types);
+
+struct debug_logger_stats {
+    uint64_t messages = 0;   // passed to the callback
+    uint64_t errors = 0;
+    uint64_t warnings = 0;
+    uint64_t logged = 0;     // written out by the logger thread
+    uint64_t suppressed = 0; // over the rate limit of their message ID
+    uint64_t dropped = 0;    // the queue was full
+    uint32_t message_ids = 0;
+    double callback_ms = 0.0; // spent in the callback, on whichever thread the layer called it
+};
+
+/**
+ * The debug messenger's callback. The layers call it synchronously,
+ * from whichever thread made the Vulkan call, so all it does is copy
+ * the message into a lock-free queue (truncated to a fixed size) and
+ * return; a background thread drains the queue every few
+ * milliseconds and writes the messages to stderr, flushing once per
+ * batch rather than once per message.
+ *
+ * Messages are rate-limited per message ID: once an ID has been seen
+ * `rate_limit` times within a second, further repeats are only
+ * counted, and the next message of that ID that gets through says
+ * how many were suppressed in between.
+ */
+class debug_logger
+{
+public:
+    ~debug_logger() { stop(); }
+
+    // rate_limit is per message ID and second, 0 for unlimited
+    void start(uint32_t rate_limit);
+    // writes out what is still queued; call after the last Vulkan object is gone
+    void stop();
+
+    static VKAPI_ATTR VkBool32 VKAPI_CALL callback(VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+                                                   VkDebugUtilsMessageTypeFlagsEXT type,
+                                                   const VkDebugUtilsMessengerCallbackDataEXT* callback_data,
+                                                   void* user_data);
+
+    debug_logger_stats get_stats() const;
+    // ids suppressed most often, on top of the stats
+    void print_stats(std::ostream& out) const;
+
+private:
+    static constexpr size_t queue_size = 256;      // power of two
+    static constexpr size_t message_size = 1024;
+    static constexpr size_t id_table_size = 1024;  // power of two
+    static constexpr size_t id_name_size = 96;
+
+    struct queued_message {
+        std::atomic<size_t> sequence{0};
+        VkDebugUtilsMessageSeverityFlagBitsEXT severity;
+        VkDebugUtilsMessageTypeFlagsEXT type;
+        uint32_t id_slot;
+        char text[message_size];
+    };
+
+    // one per message ID, claimed by the first message with that ID
+    struct id_counters {
+        std::atomic<uint32_t> key{0};
+        std::atomic<bool> named{false};
+        char name[id_name_size];
+        std::atomic<uint64_t> window{0};       // the second the count below belongs to
+        std::atomic<uint32_t> window_count{0};
+        std::atomic<uint64_t> total{0};
+        std::atomic<uint64_t> suppressed{0};
+        uint64_t reported_suppressed = 0;      // logger thread only
+    };
+
+    void handle(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT type,
+                const VkDebugUtilsMessengerCallbackDataEXT* callback_data);
+    uint32_t find_id(const VkDebugUtilsMessengerCallbackDataEXT* callback_data);
+    bool push(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT type,
+              uint32_t id_slot, const char* text);
+    size_t drain(std::ostream& out);
+    void logger_loop();
+
+    uint32_t rate_limit = 0;
+    std::unique_ptr<queued_message[]> queue;
+    std::atomic<size_t> enqueue_position{0};
+    size_t dequeue_position = 0; // logger thread only
+    std::unique_ptr<id_counters[]> ids;
+    std::thread logger;
+    std::atomic<bool> stopping{false};
+    bool running = false;
+
+    std::atomic<uint64_t> messages{0};
+    std::atomic<uint64_t> errors{0};
+    std::atomic<uint64_t> warnings{0};
+    std::atomic<uint64_t> logged{0};
+    std::atomic<uint64_t> suppressed{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint32_t> id_count{0};
+    std::atomic<uint64_t> callback_ns{0};
+};
@@ -0,0 +1,227 @@
+#include <descriptor_manager.hpp>
+
+#include <stdexcept>
+
+void descriptor_manager::init(VkDevice device, const VkAllocationCallbacks* callbacks,
+                              uint32_t frames_in_flight, bool bindless) {
+    this->device = device;
+    this->callbacks = callbacks;
+    this->frames_in_flight = frames_in_flight;
+    this->bindless = bindless;
+    frames.resize(frames_in_flight);
+    for (auto& frame : frames) {
+        frame.pools.push_back(create_frame_pool());
+    }
+    if (bindless) {
+        create_bindless_set();
+    }
+}
+
+void descriptor_manager::destroy() {
+    for (auto& frame : frames) {
+        for (auto pool : frame.pools) {
+            vkDestroyDescriptorPool(device, pool, callbacks);
+        }
+    }
+    frames.clear();
+    // destroying the pool frees the set as well
+    vkDestroyDescriptorPool(device, bindless_pool, callbacks);
+    vkDestroyDescriptorSetLayout(device, bindless_set_layout, callbacks);
+}
+
+/**
+ * Partially bound arrays may contain descriptors that were never
+ * written, as long as shaders do not access them. Update-after-bind
+ * lets new slots be written while command buffers that use the set
+ * are still pending, so the set never has to be re-allocated.
+ */
+void descriptor_manager::create_bindless_set() {
+    textures.capacity = max_bindless_textures;
+    storage_buffers.capacity = max_bindless_storage_buffers;
+
+    VkDescriptorSetLayoutBinding bindings[2]{};
+    bindings[0].binding = texture_binding;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = textures.capacity;
+    bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+    bindings[1].binding = storage_buffer_binding;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[1].descriptorCount = storage_buffers.capacity;
+    bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+
+    VkDescriptorBindingFlags binding_flags[2];
+    binding_flags[0] = binding_flags[1] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                                          VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                          VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flags_info{};
+    flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    flags_info.bindingCount = 2;
+    flags_info.pBindingFlags = binding_flags;
+
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.pNext = &flags_info;
+    layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layout_info.bindingCount = 2;
+    layout_info.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(device, &layout_info, callbacks, &bindless_set_layout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create the bindless descriptor set layout!");
+    }
+
+    VkDescriptorPoolSize pool_sizes[2]{};
+    pool_sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    pool_sizes[0].descriptorCount = textures.capacity;
+    pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pool_sizes[1].descriptorCount = storage_buffers.capacity;
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = 2;
+    pool_info.pPoolSizes = pool_sizes;
+    if (vkCreateDescriptorPool(device, &pool_info, callbacks, &bindless_pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create the bindless descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo allocate_info{};
+    allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocate_info.descriptorPool = bindless_pool;
+    allocate_info.descriptorSetCount = 1;
+    allocate_info.pSetLayouts = &bindless_set_layout;
+    if (vkAllocateDescriptorSets(device, &allocate_info, &bindless_set) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate the bindless descriptor set!");
+    }
+}
+
+VkDescriptorPool descriptor_manager::create_frame_pool() {
+    // a mix that covers the usual per-draw sets; a full pool is not
+    // an error, allocate() simply moves on to the next one
+    VkDescriptorPoolSize pool_sizes[] = {
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, sets_per_frame_pool},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sets_per_frame_pool},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sets_per_frame_pool},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, sets_per_frame_pool / 4},
+    };
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    // no FREE_DESCRIPTOR_SET_BIT: sets are never freed individually,
+    // which lets the driver use a plain linear allocator
+    pool_info.flags = 0;
+    pool_info.maxSets = sets_per_frame_pool;
+    pool_info.poolSizeCount = static_cast<uint32_t>(sizeof(pool_sizes) / sizeof(pool_sizes[0]));
+    pool_info.pPoolSizes = pool_sizes;
+    VkDescriptorPool pool;
+    if (vkCreateDescriptorPool(device, &pool_info, callbacks, &pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create a descriptor pool!");
+    }
+    return pool;
+}
+
+VkDescriptorSet descriptor_manager::allocate(uint32_t frame, VkDescriptorSetLayout layout) {
+    frame_pools& pools = frames[frame];
+    VkDescriptorSetAllocateInfo allocate_info{};
+    allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocate_info.descriptorSetCount = 1;
+    allocate_info.pSetLayouts = &layout;
+    for (;;) {
+        allocate_info.descriptorPool = pools.pools[pools.current];
+        VkDescriptorSet set;
+        VkResult result = vkAllocateDescriptorSets(device, &allocate_info, &set);
+        if (result == VK_SUCCESS) {
+            return set;
+        }
+        if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) {
+            throw std::runtime_error("failed to allocate a descriptor set!");
+        }
+        // pools are kept after a reset, so a busy frame grows only once
+        if (++pools.current == pools.pools.size()) {
+            pools.pools.push_back(create_frame_pool());
+        }
+    }
+}
+
+void descriptor_manager::begin_frame(uint32_t frame, uint64_t frame_number) {
+    this->frame_number = frame_number;
+    frame_pools& pools = frames[frame];
+    for (size_t i = 0; i <= pools.current; i++) {
+        vkResetDescriptorPool(device, pools.pools[i], 0);
+    }
+    pools.current = 0;
+    recycle_slots(textures);
+    recycle_slots(storage_buffers);
+}
+
+uint32_t descriptor_manager::take_slot(slot_array& slots) {
+    if (!slots.free.empty()) {
+        uint32_t index = slots.free.back();
+        slots.free.pop_back();
+        return index;
+    }
+    if (slots.next == slots.capacity) {
+        throw std::runtime_error("out of bindless descriptor slots!");
+    }
+    return slots.next++;
+}
+
+void descriptor_manager::recycle_slots(slot_array& slots) {
+    // frames up to frame_number - frames_in_flight have retired by now
+    auto& released = slots.released;
+    size_t kept = 0;
+    for (const auto& [index, released_at] : released) {
+        if (released_at + frames_in_flight <= frame_number) {
+            slots.free.push_back(index);
+        } else {
+            released[kept++] = {index, released_at};
+        }
+    }
+    released.resize(kept);
+}
+
+uint32_t descriptor_manager::add_texture(VkImageView view, VkSampler sampler) {
+    uint32_t index = take_slot(textures);
+    VkDescriptorImageInfo image_info{};
+    image_info.sampler = sampler;
+    image_info.imageView = view;
+    image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = bindless_set;
+    write.dstBinding = texture_binding;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &image_info;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    return index;
+}
+
+uint32_t descriptor_manager::add_storage_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    uint32_t index = take_slot(storage_buffers);
+    VkDescriptorBufferInfo buffer_info{};
+    buffer_info.buffer = buffer;
+    buffer_info.offset = offset;
+    buffer_info.range = range;
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = bindless_set;
+    write.dstBinding = storage_buffer_binding;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &buffer_info;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    return index;
+}
+
+void descriptor_manager::remove_texture(uint32_t index) {
+    textures.released.push_back({index, frame_number});
+}
+
+void descriptor_manager::remove_storage_buffer(uint32_t index) {
+    storage_buffers.released.push_back({index, frame_number});
+}
+
+void descriptor_manager::bind_bindless(VkCommandBuffer command_buffer, VkPipelineBindPoint bind_point,
+                                       VkPipelineLayout layout, uint32_t set) {
+    vkCmdBindDescriptorSets(command_buffer, bind_point, layout, set, 1, &bindless_set, 0, nullptr);
+}
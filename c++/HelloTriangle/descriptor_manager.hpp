@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <cstdint>
+
+/**
+ * Descriptor management without per-draw set allocation:
+ *  - bindless (Vulkan 1.2 descriptor indexing): a single set with large
+ *    arrays of textures and storage buffers, bound once per command
+ *    buffer; resources are referred to by their index into the arrays,
+ *    e.g. through push constants,
+ *  - otherwise, and for short-lived sets in either mode, descriptor sets
+ *    come from per-frame pools which are reset wholesale once the frame
+ *    has retired instead of freeing sets one at a time.
+ *
+ * Not thread-safe, sets are allocated and written on the main thread.
+ */
+class descriptor_manager
+{
+public:
+    static constexpr uint32_t texture_binding = 0;
+    static constexpr uint32_t storage_buffer_binding = 1;
+
+    void init(VkDevice device, const VkAllocationCallbacks* callbacks, uint32_t frames_in_flight, bool bindless);
+    void destroy();
+
+    bool is_bindless() const { return bindless; }
+    // VK_NULL_HANDLE without bindless support
+    VkDescriptorSetLayout bindless_layout() const { return bindless_set_layout; }
+
+    // bindless slots; released slots are reused once the frames that
+    // might still read them have retired
+    uint32_t add_texture(VkImageView view, VkSampler sampler);
+    uint32_t add_storage_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+    void remove_texture(uint32_t index);
+    void remove_storage_buffer(uint32_t index);
+    void bind_bindless(VkCommandBuffer command_buffer, VkPipelineBindPoint bind_point,
+                       VkPipelineLayout layout, uint32_t set = 0);
+
+    // a set that stays valid until begin_frame() is called for the same frame again
+    VkDescriptorSet allocate(uint32_t frame, VkDescriptorSetLayout layout);
+    // call once the frame's fence has been waited on
+    void begin_frame(uint32_t frame, uint64_t frame_number);
+
+private:
+    struct slot_array {
+        uint32_t capacity = 0;
+        uint32_t next = 0;           // slots below this have been handed out before
+        std::vector<uint32_t> free;  // ready for reuse
+        std::vector<std::pair<uint32_t, uint64_t>> released; // slot, frame it was released in
+    };
+
+    struct frame_pools {
+        std::vector<VkDescriptorPool> pools;
+        size_t current = 0;
+    };
+
+    void create_bindless_set();
+    VkDescriptorPool create_frame_pool();
+    static uint32_t take_slot(slot_array& slots);
+    void recycle_slots(slot_array& slots);
+
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks* callbacks = nullptr;
+    bool bindless = false;
+    uint32_t frames_in_flight = 0;
+    uint64_t frame_number = 0;
+
+    VkDescriptorSetLayout bindless_set_layout = VK_NULL_HANDLE;
+    VkDescriptorPool bindless_pool = VK_NULL_HANDLE;
+    VkDescriptorSet bindless_set = VK_NULL_HANDLE;
+    slot_array textures;
+    slot_array storage_buffers;
+
+    std::vector<frame_pools> frames;
+
+    // descriptor indexing guarantees far more than this, see
+    // maxDescriptorSetUpdateAfterBind* (at least 500000)
+    static constexpr uint32_t max_bindless_textures = 16384;
+    static constexpr uint32_t max_bindless_storage_buffers = 4096;
+    static constexpr uint32_t sets_per_frame_pool = 256;
+};
@@ -0,0 +1,353 @@
+#include <frame_capture.hpp>
+#include <stats.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+namespace {
+
+bool ends_with(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// the formats vulkan_app renders to, with the byte order of their pixels
+bool is_bgra(VkFormat format) {
+    return format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_B8G8R8A8_UNORM;
+}
+
+bool is_rgba(VkFormat format) {
+    return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_R8G8B8A8_UNORM;
+}
+
+}
+
+bool parse_capture_format(const std::string& path, capture_format& format) {
+    if (ends_with(path, ".raw")) {
+        format = capture_format::raw;
+    } else if (ends_with(path, ".ppm")) {
+        format = capture_format::ppm;
+    } else if (ends_with(path, ".y4m")) {
+        format = capture_format::y4m;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void frame_capture::init(VkDevice device, const VkAllocationCallbacks* callbacks, gpu_allocator* allocator,
+                         const std::string& path, uint32_t ring_size, bool wait_for_slots) {
+    this->device = device;
+    this->callbacks = callbacks;
+    this->allocator = allocator;
+    this->path = path;
+    this->wait_for_slots = wait_for_slots;
+    if (!parse_capture_format(path, format)) {
+        throw std::runtime_error("failed to capture to " + path + ", expected a .raw, .ppm or .y4m file!");
+    }
+    if (format != capture_format::ppm) {
+        stream.open(path, std::ios::binary | std::ios::trunc);
+        if (!stream) {
+            throw std::runtime_error("failed to open " + path + "!");
+        }
+    }
+
+    slots.resize(std::max(ring_size, 1u));
+    for (auto& slot : slots) {
+        VkFenceCreateInfo fence_info{};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(device, &fence_info, callbacks, &slot.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create a readback fence!");
+        }
+    }
+    writer = std::thread(&frame_capture::writer_loop, this);
+}
+
+void frame_capture::destroy() {
+    if (slots.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    slot_submitted.notify_all();
+    writer.join();
+    for (auto& slot : slots) {
+        if (slot.buffer != VK_NULL_HANDLE) {
+            allocator->destroy_buffer(slot.buffer, slot.allocation);
+        }
+        vkDestroyFence(device, slot.fence, callbacks);
+    }
+    slots.clear();
+    stream.close();
+}
+
+uint32_t frame_capture::acquire(VkFormat image_format, VkExtent2D extent, uint64_t frame_number) {
+    if (!is_bgra(image_format) && !is_rgba(image_format)) {
+        throw std::runtime_error("failed to capture a frame, only 8-bit RGBA and BGRA images are supported!");
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    if (writer_error) {
+        std::rethrow_exception(writer_error);
+    }
+    if (format != capture_format::ppm) {
+        if (stream_extent.width == 0) {
+            stream_extent = extent;
+        } else if (stream_extent.width != extent.width || stream_extent.height != extent.height) {
+            frames_skipped++;
+            return no_slot;
+        }
+    }
+    uint32_t index = next_slot;
+    readback_slot& slot = slots[index];
+    if (slot.state != slot_state::free) {
+        if (!wait_for_slots) {
+            frames_dropped++;
+            return no_slot;
+        }
+        auto wait_start = std::chrono::steady_clock::now();
+        slot_freed.wait(lock, [&] { return slot.state == slot_state::free; });
+        wait_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wait_start).count();
+    }
+    slot.state = slot_state::recording;
+    next_slot = (next_slot + 1) % slots.size();
+    lock.unlock();
+
+    VkDeviceSize size = VkDeviceSize(extent.width) * extent.height * 4;
+    if (slot.capacity < size) {
+        // the writer is done with it, it waited on the slot's fence before freeing it
+        if (slot.buffer != VK_NULL_HANDLE) {
+            allocator->destroy_buffer(slot.buffer, slot.allocation);
+        }
+        // cached memory, the writer thread reads every byte of it
+        slot.buffer = allocator->create_buffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                               VK_MEMORY_PROPERTY_HOST_CACHED_BIT, slot.allocation);
+        slot.capacity = size;
+    }
+    slot.frame_number = frame_number;
+    slot.format = image_format;
+    slot.extent = extent;
+    return index;
+}
+
+void frame_capture::record_copy(VkCommandBuffer command_buffer, uint32_t slot, VkImage image) {
+    const readback_slot& s = slots[slot];
+    VkBufferImageCopy region{};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0; // tightly packed
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = {s.extent.width, s.extent.height, 1};
+    vkCmdCopyImageToBuffer(command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, s.buffer, 1, &region);
+
+    // the fence only makes the copy available, the writer thread reads
+    // it after waiting on the fence
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = s.buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr,
+                         1, &barrier, 0, nullptr);
+}
+
+void frame_capture::submit(VkQueue queue, uint32_t slot) {
+    // signalled once everything submitted to the queue before it has completed
+    if (vkQueueSubmit(queue, 0, nullptr, slots[slot].fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit a readback fence!");
+    }
+    auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (frames_captured++ == 0) {
+            first_submit = now;
+        }
+        slots[slot].submit_time = now;
+        slots[slot].state = slot_state::submitted;
+    }
+    slot_submitted.notify_one();
+}
+
+/**
+ * Slots are handed out and submitted in ring order, so the writer
+ * simply follows the ring: it waits until the next slot has been
+ * submitted, then on its fence (without holding the lock), and only
+ * stops once every submitted slot has been written.
+ */
+void frame_capture::writer_loop() {
+    uint32_t index = 0;
+    while (true) {
+        readback_slot& slot = slots[index];
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            slot_submitted.wait(lock, [&] { return slot.state == slot_state::submitted || stopping; });
+            if (slot.state != slot_state::submitted) {
+                break;
+            }
+        }
+        vkWaitForFences(device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+        auto copied = std::chrono::steady_clock::now();
+        size_t size = 0;
+        std::exception_ptr failure;
+        if (!writer_error) {
+            try {
+                size = write_frame(slot);
+            } catch (...) {
+                failure = std::current_exception();
+            }
+        }
+        auto written = std::chrono::steady_clock::now();
+        vkResetFences(device, 1, &slot.fence);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (failure) {
+                // rethrown on the render loop by the next acquire()
+                writer_error = failure;
+            } else if (size > 0) {
+                latency_ms.push_back(std::chrono::duration<double, std::milli>(copied - slot.submit_time).count());
+                write_ms += std::chrono::duration<double, std::milli>(written - copied).count();
+                last_write = written;
+                bytes_written += size;
+                frames_written++;
+            }
+            slot.state = slot_state::free;
+        }
+        slot_freed.notify_all();
+        index = (index + 1) % slots.size();
+    }
+    stream.flush();
+}
+
+size_t frame_capture::write_frame(const readback_slot& slot) {
+    auto pixels = static_cast<const uint8_t*>(slot.allocation.mapped);
+    size_t size = size_t(slot.extent.width) * slot.extent.height * 4;
+    bool bgra = is_bgra(slot.format);
+    switch (format) {
+    case capture_format::raw:
+        stream.write(reinterpret_cast<const char*>(pixels), size);
+        break;
+    case capture_format::ppm:
+        size = write_ppm(slot, pixels, bgra);
+        break;
+    case capture_format::y4m:
+        size = write_y4m(slot, pixels, bgra);
+        break;
+    }
+    if (!stream.good() && format != capture_format::ppm) {
+        throw std::runtime_error("failed to write to " + path + "!");
+    }
+    return size;
+}
+
+size_t frame_capture::write_ppm(const readback_slot& slot, const uint8_t* pixels, bool bgra) {
+    // capture.ppm -> capture_000042.ppm
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), "_%06llu.ppm", static_cast<unsigned long long>(slot.frame_number));
+    std::string file_path = path.substr(0, path.size() - 4) + suffix;
+    std::ofstream file(file_path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("failed to open " + file_path + "!");
+    }
+    size_t pixel_count = size_t(slot.extent.width) * slot.extent.height;
+    conversion.resize(pixel_count * 3);
+    int r = bgra ? 2 : 0, b = bgra ? 0 : 2;
+    for (size_t i = 0; i < pixel_count; i++) {
+        conversion[i * 3 + 0] = pixels[i * 4 + r];
+        conversion[i * 3 + 1] = pixels[i * 4 + 1];
+        conversion[i * 3 + 2] = pixels[i * 4 + b];
+    }
+    file << "P6\n" << slot.extent.width << ' ' << slot.extent.height << "\n255\n";
+    file.write(reinterpret_cast<const char*>(conversion.data()), conversion.size());
+    if (!file) {
+        throw std::runtime_error("failed to write " + file_path + "!");
+    }
+    return conversion.size();
+}
+
+// 4:2:0 needs even dimensions, an odd last row or column is dropped
+size_t frame_capture::write_y4m(const readback_slot& slot, const uint8_t* pixels, bool bgra) {
+    uint32_t width = slot.extent.width & ~1u;
+    uint32_t height = slot.extent.height & ~1u;
+    if (!header_written) {
+        // the frame rate is nominal, frames are written as fast as they are rendered
+        stream << "YUV4MPEG2 W" << width << " H" << height << " F60:1 Ip A1:1 C420jpeg\n";
+        header_written = true;
+    }
+    size_t luma_size = size_t(width) * height;
+    conversion.resize(luma_size + luma_size / 2);
+    uint8_t* y_plane = conversion.data();
+    uint8_t* u_plane = y_plane + luma_size;
+    uint8_t* v_plane = u_plane + luma_size / 4;
+    int r_offset = bgra ? 2 : 0, b_offset = bgra ? 0 : 2;
+    size_t stride = size_t(slot.extent.width) * 4;
+
+    // full range BT.601 in 16.16 fixed point, chroma from the average of each 2x2 block
+    for (uint32_t y = 0; y < height; y += 2) {
+        for (uint32_t x = 0; x < width; x += 2) {
+            int r_sum = 0, g_sum = 0, b_sum = 0;
+            for (uint32_t dy = 0; dy < 2; dy++) {
+                for (uint32_t dx = 0; dx < 2; dx++) {
+                    const uint8_t* p = pixels + (y + dy) * stride + (x + dx) * 4;
+                    int r = p[r_offset], g = p[1], b = p[b_offset];
+                    y_plane[size_t(y + dy) * width + x + dx] =
+                        static_cast<uint8_t>((19595 * r + 38470 * g + 7471 * b + 32768) >> 16);
+                    r_sum += r;
+                    g_sum += g;
+                    b_sum += b;
+                }
+            }
+            size_t chroma = size_t(y / 2) * (width / 2) + x / 2;
+            // the sums are of four pixels, hence the shift by 18; the bias of 128 keeps it positive
+            int u = (-11059 * r_sum - 21709 * g_sum + 32768 * b_sum + (128 << 18) + (1 << 17)) >> 18;
+            int v = (32768 * r_sum - 27439 * g_sum - 5329 * b_sum + (128 << 18) + (1 << 17)) >> 18;
+            u_plane[chroma] = static_cast<uint8_t>(std::clamp(u, 0, 255));
+            v_plane[chroma] = static_cast<uint8_t>(std::clamp(v, 0, 255));
+        }
+    }
+    stream << "FRAME\n";
+    stream.write(reinterpret_cast<const char*>(conversion.data()), conversion.size());
+    return conversion.size();
+}
+
+void frame_capture::wait_idle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    slot_freed.wait(lock, [&] {
+        return std::all_of(slots.begin(), slots.end(), [](const readback_slot& slot) {
+            return slot.state != slot_state::submitted;
+        });
+    });
+}
+
+void frame_capture::print_stats(std::ostream& out) {
+    if (slots.empty()) {
+        return;
+    }
+    wait_idle();
+    std::lock_guard<std::mutex> lock(mutex);
+    out << "capture: " << frames_written << '/' << frames_captured << " frames written to " << path
+        << " (" << bytes_written / (1024.0 * 1024.0) << " MiB), " << frames_dropped
+        << " dropped with all " << slots.size() << " readback buffers busy, " << frames_skipped
+        << " skipped after a size change\n";
+    if (frames_written > 0) {
+        double seconds = std::chrono::duration<double>(last_write - first_submit).count();
+        double mean = 0.0;
+        for (double latency : latency_ms) {
+            mean += latency;
+        }
+        mean /= latency_ms.size();
+        out << "\t" << frames_written / std::max(seconds, 1e-9) << " frames/s sustained, readback latency "
+            << mean << " ms mean, " << percentile(latency_ms, 0.5) << " ms p50, " << percentile(latency_ms, 0.99)
+            << " ms p99; " << write_ms / frames_written << " ms per frame to write it out, "
+            << wait_ms << " ms waiting for a free buffer\n";
+    }
+    out << std::flush;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <gpu_allocator.hpp>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+
+/**
+ * Output formats, chosen by the extension of the capture path:
+ *  - raw: the pixels of every frame back to back, as the device wrote them,
+ *  - ppm: one binary PPM file per frame, the frame number appended to the name,
+ *  - y4m: a YUV4MPEG2 stream (4:2:0, full range BT.601) for video encoders.
+ * The streams need every frame to have the same size.
+ */
+enum class capture_format {
+    raw,
+    ppm,
+    y4m
+};
+
+bool parse_capture_format(const std::string& path, capture_format& format);
+
+/**
+ * Copies rendered frames into a ring of host-visible readback buffers
+ * and writes them out on a background thread, so that the render loop
+ * never waits for a copy to finish. Per captured frame:
+ *  - acquire() hands out the next slot of the ring, once the frame's
+ *    fence has been waited on,
+ *  - record_copy() records the image-to-buffer copy into the frame,
+ *  - submit() is called after the frame's submission and submits the
+ *    slot's fence behind it, without any command buffers; the writer
+ *    thread waits on that fence, writes the pixels out and hands the
+ *    slot back.
+ * When all slots are still busy the frame is either not captured
+ * (interactive use) or the render loop waits for a slot (offline
+ * rendering, where every frame counts); both are reported.
+ */
+class frame_capture
+{
+public:
+    static constexpr uint32_t no_slot = UINT32_MAX;
+
+    ~frame_capture() { destroy(); }
+
+    void init(VkDevice device, const VkAllocationCallbacks* callbacks, gpu_allocator* allocator,
+              const std::string& path, uint32_t ring_size, bool wait_for_slots);
+    // waits for the writer to finish the frames already submitted
+    void destroy();
+    bool is_enabled() const { return !slots.empty(); }
+
+    // the image has to be in TRANSFER_SRC_OPTIMAL when the copy runs; 8-bit
+    // RGBA and BGRA formats only
+    uint32_t acquire(VkFormat format, VkExtent2D extent, uint64_t frame_number);
+    void record_copy(VkCommandBuffer command_buffer, uint32_t slot, VkImage image);
+    void submit(VkQueue queue, uint32_t slot);
+    // until the writer has written out every frame submitted so far
+    void wait_idle();
+
+    // waits for the writer first
+    void print_stats(std::ostream& out);
+
+private:
+    enum class slot_state {
+        free,      // owned by the render loop
+        recording, // handed out by acquire(), not yet submitted
+        submitted  // owned by the writer thread until its fence has been waited on
+    };
+
+    struct readback_slot {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        gpu_allocation allocation;
+        VkDeviceSize capacity = 0;
+        VkFence fence = VK_NULL_HANDLE;
+        slot_state state = slot_state::free;
+        uint64_t frame_number = 0;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent{};
+        std::chrono::steady_clock::time_point submit_time;
+    };
+
+    void writer_loop();
+    // return the number of bytes written
+    size_t write_frame(const readback_slot& slot);
+    size_t write_ppm(const readback_slot& slot, const uint8_t* pixels, bool bgra);
+    size_t write_y4m(const readback_slot& slot, const uint8_t* pixels, bool bgra);
+
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks* callbacks = nullptr;
+    gpu_allocator* allocator = nullptr;
+    std::string path;
+    capture_format format = capture_format::raw;
+    bool wait_for_slots = false;
+
+    std::vector<readback_slot> slots;
+    // render loop only
+    uint32_t next_slot = 0;
+    VkExtent2D stream_extent{};  // of the first frame, raw and y4m only
+
+    std::mutex mutex;
+    std::condition_variable slot_submitted;
+    std::condition_variable slot_freed;
+    std::thread writer;
+    bool stopping = false;
+
+    // writer thread only
+    std::ofstream stream;        // raw and y4m
+    bool header_written = false;
+    std::vector<uint8_t> conversion;
+
+    // guarded by mutex
+    uint64_t frames_captured = 0;
+    uint64_t frames_written = 0;
+    uint64_t frames_dropped = 0; // no free slot
+    uint64_t frames_skipped = 0; // a size the stream cannot take
+    double wait_ms = 0.0;        // render loop blocked on a slot
+    double write_ms = 0.0;
+    std::vector<double> latency_ms; // from submit() until the writer saw the copy complete
+    std::chrono::steady_clock::time_point first_submit;
+    std::chrono::steady_clock::time_point last_write;
+    uint64_t bytes_written = 0;
+    // the writer stops writing after the first failure
+    std::exception_ptr writer_error;
+};
@@ -0,0 +1,283 @@
+#include <frame_profiler.hpp>
+#include <stats.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+
+frame_profiler::scope::scope(frame_profiler* profiler, const char* name)
+    : profiler(profiler), name(name), start(std::chrono::steady_clock::now()) {}
+
+frame_profiler::scope::~scope() {
+    profiler->add_cpu_scope(name, start, std::chrono::steady_clock::now());
+}
+
+void frame_profiler::add_cpu_scope(const char* name, std::chrono::steady_clock::time_point start,
+                                   std::chrono::steady_clock::time_point end) {
+    if (!active) {
+        return;
+    }
+    auto& frame = frames[current_slot];
+    double start_us = std::chrono::duration<double, std::micro>(start - epoch).count();
+    double duration_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    frame.cpu_scopes.push_back({name, start_us, duration_ms});
+    if (std::strcmp(name, "submit") == 0) {
+        frame.submit_us = start_us + duration_ms * 1000.0;
+    }
+}
+
+void frame_profiler::init(VkPhysicalDevice physical_device, VkDevice device, const VkAllocationCallbacks* callbacks,
+                          uint32_t queue_family, uint32_t frames_in_flight, bool print_stats,
+                          const std::string& csv_path, const std::string& trace_path) {
+    this->device = device;
+    this->callbacks = callbacks;
+    this->print_stats = print_stats;
+    active = print_stats || !csv_path.empty() || !trace_path.empty();
+    epoch = std::chrono::steady_clock::now();
+    frames.resize(frames_in_flight);
+    if (!active) {
+        return;
+    }
+
+    // timestamps are only meaningful if the queue writes them at all
+    uint32_t family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+    uint32_t valid_bits = families[queue_family].timestampValidBits;
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    timestamp_period_ns = properties.limits.timestampPeriod;
+    timestamp_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+    gpu_timing = valid_bits > 0;
+
+    if (gpu_timing) {
+        VkQueryPoolCreateInfo create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        create_info.queryCount = frames_in_flight * max_gpu_scopes * 2;
+        if (vkCreateQueryPool(device, &create_info, callbacks, &query_pool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create a timestamp query pool!");
+        }
+    } else {
+        std::cerr << "profiler: the graphics queue does not support timestamps, GPU timing is off" << std::endl;
+    }
+
+    if (!csv_path.empty()) {
+        csv.open(csv_path);
+        if (!csv.is_open()) {
+            throw std::runtime_error("failed to open " + csv_path + "!");
+        }
+    }
+    if (!trace_path.empty()) {
+        trace.open(trace_path);
+        if (!trace.is_open()) {
+            throw std::runtime_error("failed to open " + trace_path + "!");
+        }
+        trace << "[\n";
+    }
+}
+
+void frame_profiler::destroy() {
+    if (trace.is_open()) {
+        trace << "\n]\n";
+        trace.close();
+    }
+    csv.close();
+    if (query_pool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, query_pool, callbacks);
+        query_pool = VK_NULL_HANDLE;
+    }
+}
+
+double frame_profiler::now_us() const {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void frame_profiler::begin_frame(uint32_t frame_slot, uint64_t frame_number) {
+    if (!active) {
+        return;
+    }
+    finish_frame(frame_slot);
+
+    // frame time is measured from the start of one frame to the start of the next
+    double start_us = now_us();
+    if (last_frame_start_us >= 0.0) {
+        double frame_ms = (start_us - last_frame_start_us) / 1000.0;
+        frame_times_ms.push_back(frame_ms);
+        all_frame_times_ms.push_back(frame_ms);
+        if (frame_times_ms.size() > window_size) {
+            frame_times_ms.pop_front();
+        }
+    }
+    last_frame_start_us = start_us;
+
+    current_slot = frame_slot;
+    auto& frame = frames[frame_slot];
+    frame = frame_record{};
+    frame.frame_number = frame_number;
+    frame.start_us = start_us;
+
+    if (print_stats && start_us - last_print_us > 1000000.0) {
+        print_rolling_stats();
+        last_print_us = start_us;
+    }
+}
+
+void frame_profiler::end_frame() {
+    if (!active) {
+        return;
+    }
+    frames[current_slot].pending = true;
+}
+
+void frame_profiler::flush() {
+    for (uint32_t slot = 0; slot < frames.size(); slot++) {
+        finish_frame(slot);
+    }
+}
+
+void frame_profiler::reset_queries(VkCommandBuffer command_buffer) {
+    if (!active || !gpu_timing) {
+        return;
+    }
+    vkCmdResetQueryPool(command_buffer, query_pool, current_slot * max_gpu_scopes * 2, max_gpu_scopes * 2);
+}
+
+void frame_profiler::gpu_begin(VkCommandBuffer command_buffer, const char* name) {
+    auto& frame = frames[current_slot];
+    if (!active || !gpu_timing || frame.gpu_scope_names.size() >= max_gpu_scopes) {
+        return;
+    }
+    uint32_t query = current_slot * max_gpu_scopes * 2 + frame.gpu_queries;
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool, query);
+    frame.gpu_scope_names.push_back(name);
+    frame.gpu_queries++;
+}
+
+void frame_profiler::gpu_end(VkCommandBuffer command_buffer) {
+    auto& frame = frames[current_slot];
+    if (!active || !gpu_timing || frame.gpu_queries % 2 == 0) {
+        return;
+    }
+    uint32_t query = current_slot * max_gpu_scopes * 2 + frame.gpu_queries;
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool, query);
+    frame.gpu_queries++;
+}
+
+void frame_profiler::finish_frame(uint32_t frame_slot) {
+    auto& frame = frames[frame_slot];
+    if (!frame.pending) {
+        return;
+    }
+    frame.pending = false;
+
+    std::vector<timed_scope> gpu_scopes;
+    if (gpu_timing && frame.gpu_queries >= 2) {
+        // the frame's fence has signalled, so the results are available without waiting
+        std::vector<uint64_t> timestamps(frame.gpu_queries);
+        VkResult result = vkGetQueryPoolResults(device, query_pool, frame_slot * max_gpu_scopes * 2,
+                                                frame.gpu_queries, timestamps.size() * sizeof(uint64_t),
+                                                timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (result == VK_SUCCESS) {
+            uint64_t first = timestamps[0] & timestamp_mask;
+            double gpu_total_ms = 0.0;
+            for (uint32_t i = 0; i + 1 < frame.gpu_queries; i += 2) {
+                uint64_t begin = timestamps[i] & timestamp_mask;
+                uint64_t end = timestamps[i + 1] & timestamp_mask;
+                double duration_ms = static_cast<double>((end - begin) & timestamp_mask) * timestamp_period_ns / 1e6;
+                // GPU clocks are not calibrated against the CPU, so the
+                // GPU track is anchored at the end of the frame's submit
+                double start_us = frame.submit_us +
+                                  static_cast<double>((begin - first) & timestamp_mask) * timestamp_period_ns / 1e3;
+                gpu_scopes.push_back({frame.gpu_scope_names[i / 2], start_us, duration_ms});
+                gpu_total_ms += duration_ms;
+            }
+            gpu_times_ms.push_back(gpu_total_ms);
+            if (gpu_times_ms.size() > window_size) {
+                gpu_times_ms.pop_front();
+            }
+        }
+    }
+
+    double frame_ms = frame_times_ms.empty() ? 0.0 : frame_times_ms.back();
+    if (csv.is_open()) {
+        write_csv(frame, frame_ms, gpu_scopes);
+    }
+    if (trace.is_open()) {
+        write_trace(frame, gpu_scopes);
+    }
+}
+
+void frame_profiler::write_csv(const frame_record& frame, double frame_ms, const std::vector<timed_scope>& gpu_scopes) {
+    // the columns are whatever scopes the first finished frame had
+    if (csv_columns.empty()) {
+        csv << "frame,frame_ms";
+        for (const auto& scope : frame.cpu_scopes) {
+            csv_columns.push_back(scope.name);
+            csv << ',' << scope.name << "_ms";
+        }
+        for (const auto& scope : gpu_scopes) {
+            csv_columns.push_back(std::string("gpu:") + scope.name);
+            csv << ",gpu_" << scope.name << "_ms";
+        }
+        csv << '\n';
+    }
+    csv << frame.frame_number << ',' << frame_ms;
+    for (const auto& column : csv_columns) {
+        csv << ',';
+        bool gpu = column.compare(0, 4, "gpu:") == 0;
+        const auto& scopes = gpu ? gpu_scopes : frame.cpu_scopes;
+        std::string name = gpu ? column.substr(4) : column;
+        for (const auto& scope : scopes) {
+            if (name == scope.name) {
+                csv << scope.duration_ms;
+                break;
+            }
+        }
+    }
+    csv << '\n';
+}
+
+void frame_profiler::write_trace(const frame_record& frame, const std::vector<timed_scope>& gpu_scopes) {
+    // complete events ("ph": "X"), CPU scopes on thread 0 and GPU scopes on thread 1
+    auto write_event = [&](const timed_scope& scope, int tid) {
+        trace << (first_trace_event ? "" : ",\n");
+        first_trace_event = false;
+        trace << "{\"name\":\"" << scope.name << "\",\"cat\":\"frame " << frame.frame_number
+              << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid
+              << ",\"ts\":" << scope.start_us << ",\"dur\":" << scope.duration_ms * 1000.0 << '}';
+    };
+    for (const auto& scope : frame.cpu_scopes) {
+        write_event(scope, 0);
+    }
+    for (const auto& scope : gpu_scopes) {
+        write_event(scope, 1);
+    }
+}
+
+void frame_profiler::print_rolling_stats() {
+    if (frame_times_ms.empty()) {
+        return;
+    }
+    std::vector<double> cpu(frame_times_ms.begin(), frame_times_ms.end());
+    std::cerr << "frame time p50 " << percentile(cpu, 0.5) << " ms, p99 " << percentile(cpu, 0.99)
+              << " ms, max " << *std::max_element(cpu.begin(), cpu.end()) << " ms";
+    if (!gpu_times_ms.empty()) {
+        std::vector<double> gpu(gpu_times_ms.begin(), gpu_times_ms.end());
+        std::cerr << " | gpu p50 " << percentile(gpu, 0.5) << " ms, p99 " << percentile(gpu, 0.99)
+                  << " ms, max " << *std::max_element(gpu.begin(), gpu.end()) << " ms";
+    }
+    std::cerr << std::endl;
+}
+
+void frame_profiler::print_summary(std::ostream& out) {
+    if (!active || all_frame_times_ms.empty()) {
+        return;
+    }
+    out << "frame time over " << all_frame_times_ms.size() << " frames: p50 "
+        << percentile(all_frame_times_ms, 0.5) << " ms, p99 " << percentile(all_frame_times_ms, 0.99)
+        << " ms, max " << *std::max_element(all_frame_times_ms.begin(), all_frame_times_ms.end())
+        << " ms" << std::endl;
+}
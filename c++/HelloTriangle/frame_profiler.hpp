@@ -0,0 +1,110 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <fstream>
+#include <chrono>
+#include <ostream>
+
+/**
+ * Per-frame CPU and GPU timings. CPU scopes are plain RAII timers;
+ * GPU scopes are pairs of timestamp queries from a query pool slice
+ * per frame in flight, read back once the frame's fence has been
+ * waited on (so reading them never stalls). Finished frames feed
+ * rolling p50/p99/max statistics and, optionally, a CSV file and a
+ * Chrome trace (chrome://tracing, ui.perfetto.dev).
+ */
+class frame_profiler
+{
+public:
+    class scope {
+    public:
+        scope(frame_profiler* profiler, const char* name);
+        ~scope();
+        scope(const scope&) = delete;
+        scope& operator=(const scope&) = delete;
+    private:
+        frame_profiler* profiler;
+        const char* name;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    void init(VkPhysicalDevice physical_device, VkDevice device, const VkAllocationCallbacks* callbacks,
+              uint32_t queue_family, uint32_t frames_in_flight, bool print_stats,
+              const std::string& csv_path, const std::string& trace_path);
+    void destroy();
+    bool enabled() const { return active; }
+
+    // call after the frame's fence has been waited on: finishes the
+    // frame that used this slot before and starts a new one
+    void begin_frame(uint32_t frame_slot, uint64_t frame_number);
+    void end_frame();
+    // finish all frames still pending, the device has to be idle
+    void flush();
+
+    scope cpu_scope(const char* name) { return scope(this, name); }
+    // a scope the caller timed, for work that has to happen before begin_frame()
+    void add_cpu_scope(const char* name, std::chrono::steady_clock::time_point start,
+                       std::chrono::steady_clock::time_point end);
+
+    // must be recorded outside of a render pass, before any gpu_begin()
+    void reset_queries(VkCommandBuffer command_buffer);
+    void gpu_begin(VkCommandBuffer command_buffer, const char* name);
+    void gpu_end(VkCommandBuffer command_buffer);
+
+    void print_summary(std::ostream& out);
+
+private:
+    struct timed_scope {
+        const char* name;
+        double start_us;    // relative to the profiler's epoch
+        double duration_ms;
+    };
+
+    struct frame_record {
+        bool pending = false;
+        uint64_t frame_number = 0;
+        double start_us = 0.0;
+        double submit_us = 0.0;   // anchor for placing GPU scopes on the CPU timeline
+        std::vector<timed_scope> cpu_scopes;
+        std::vector<const char*> gpu_scope_names;
+        uint32_t gpu_queries = 0;
+    };
+
+    double now_us() const;
+    void finish_frame(uint32_t frame_slot);
+    void write_csv(const frame_record& frame, double frame_ms, const std::vector<timed_scope>& gpu_scopes);
+    void write_trace(const frame_record& frame, const std::vector<timed_scope>& gpu_scopes);
+    void print_rolling_stats();
+
+    bool active = false;
+    bool print_stats = false;
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks* callbacks = nullptr;
+    std::chrono::steady_clock::time_point epoch;
+
+    VkQueryPool query_pool = VK_NULL_HANDLE;
+    double timestamp_period_ns = 1.0;
+    uint64_t timestamp_mask = ~0ull;
+    bool gpu_timing = false;
+    static constexpr uint32_t max_gpu_scopes = 8;
+
+    std::vector<frame_record> frames; // per frame in flight
+    uint32_t current_slot = 0;
+    double last_frame_start_us = -1.0;
+
+    // rolling window of finished frames
+    static constexpr size_t window_size = 240;
+    std::deque<double> frame_times_ms;
+    std::deque<double> gpu_times_ms;
+    double last_print_us = 0.0;
+    std::vector<double> all_frame_times_ms;
+
+    std::ofstream csv;
+    std::vector<std::string> csv_columns;
+    std::ofstream trace;
+    bool first_trace_event = true;
+};
@@ -0,0 +1,429 @@
+#include <gpu_allocator.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+    // Vulkan alignments are always powers of two
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// whether the last byte of one resource and the first byte of the
+// next one fall into the same bufferImageGranularity "page"
+static bool on_same_page(VkDeviceSize end_of_a, VkDeviceSize start_of_b, VkDeviceSize page_size) {
+    return (end_of_a & ~(page_size - 1)) == (start_of_b & ~(page_size - 1));
+}
+
+void gpu_allocator::init(VkPhysicalDevice physical_device, VkDevice device, const VkAllocationCallbacks* callbacks,
+                         uint32_t frames_in_flight) {
+    this->physical_device = physical_device;
+    this->device = device;
+    this->callbacks = callbacks;
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_properties);
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    limits = properties.limits;
+
+    blocks.resize(mem_properties.memoryTypeCount);
+    dedicated_bytes.assign(mem_properties.memoryTypeCount, 0);
+
+    // the transient arena is a single persistently mapped buffer,
+    // split into one segment per frame in flight
+    VkDeviceSize segment_alignment = std::max({limits.minUniformBufferOffsetAlignment,
+                                               limits.minStorageBufferOffsetAlignment,
+                                               limits.nonCoherentAtomSize,
+                                               VkDeviceSize(256)});
+    transient_segment_size = align_up(transient_size_per_frame, segment_alignment);
+    transient_heads.assign(frames_in_flight, 0);
+    transient_buffer = create_buffer(transient_segment_size * frames_in_flight,
+                                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                                     VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                     transient_memory);
+}
+
+void gpu_allocator::destroy() {
+    destroy_buffer(transient_buffer, transient_memory);
+    transient_buffer = VK_NULL_HANDLE;
+    for (uint32_t type = 0; type < blocks.size(); type++) {
+        for (auto& block : blocks[type]) {
+            if (block.memory != VK_NULL_HANDLE) {
+                free_device_memory(block.memory, block.mapped != nullptr);
+            }
+        }
+        blocks[type].clear();
+    }
+}
+
+bool gpu_allocator::find_memory_type(uint32_t type_bits, VkMemoryPropertyFlags flags, uint32_t& type_index) {
+    for (uint32_t i = 0; i < mem_properties.memoryTypeCount; i++) {
+        if ((type_bits & (1 << i)) && (mem_properties.memoryTypes[i].propertyFlags & flags) == flags) {
+            type_index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool gpu_allocator::is_non_coherent(uint32_t memory_type) const {
+    auto flags = mem_properties.memoryTypes[memory_type].propertyFlags;
+    return (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+VkDeviceSize gpu_allocator::block_size_for(uint32_t memory_type) const {
+    // small heaps (e.g. the 256 MiB host-visible device-local heap
+    // without resizable BAR) should not be eaten up by a single block
+    VkDeviceSize heap_size = mem_properties.memoryHeaps[mem_properties.memoryTypes[memory_type].heapIndex].size;
+    if (heap_size <= 1024ull * 1024 * 1024) {
+        return std::min(default_block_size, align_up(heap_size / 8, 1024 * 1024));
+    }
+    return default_block_size;
+}
+
+VkDeviceMemory gpu_allocator::allocate_device_memory(uint32_t memory_type, VkDeviceSize size, void** mapped) {
+    if (live_device_allocations >= limits.maxMemoryAllocationCount) {
+        throw std::runtime_error("gpu allocator: maxMemoryAllocationCount reached!");
+    }
+    VkMemoryAllocateInfo allocate_info{};
+    allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocate_info.allocationSize = size;
+    allocate_info.memoryTypeIndex = memory_type;
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(device, &allocate_info, callbacks, &memory) != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+    live_device_allocations++;
+    total_device_allocations++;
+
+    *mapped = nullptr;
+    if (mem_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+            throw std::runtime_error("gpu allocator: failed to map host-visible memory!");
+        }
+    }
+    return memory;
+}
+
+void gpu_allocator::free_device_memory(VkDeviceMemory memory, bool mapped) {
+    if (mapped) {
+        vkUnmapMemory(device, memory);
+    }
+    vkFreeMemory(device, memory, callbacks);
+    live_device_allocations--;
+}
+
+/**
+ * First fit over the free ranges of a block. A range that would put
+ * a linear and an optimal resource on the same bufferImageGranularity
+ * page is either pushed to the next page (previous neighbour) or
+ * skipped (next neighbour), as the spec requires.
+ */
+bool gpu_allocator::allocate_from_block(memory_block& block, VkDeviceSize size, VkDeviceSize alignment,
+                                        resource_kind kind, VkDeviceSize& offset) {
+    VkDeviceSize granularity = limits.bufferImageGranularity;
+    for (auto it = block.free_ranges.begin(); it != block.free_ranges.end(); ++it) {
+        VkDeviceSize range_start = it->first;
+        VkDeviceSize range_end = it->first + it->second;
+
+        VkDeviceSize start = align_up(range_start, alignment);
+        if (granularity > 1) {
+            auto previous = block.used_ranges.lower_bound(range_start);
+            if (previous != block.used_ranges.begin()) {
+                --previous;
+                VkDeviceSize previous_end = previous->first + previous->second.size;
+                if (previous->second.kind != kind && on_same_page(previous_end - 1, start, granularity)) {
+                    start = align_up(start, granularity);
+                }
+            }
+        }
+        VkDeviceSize end = start + size;
+        if (end > range_end) {
+            continue;
+        }
+        if (granularity > 1) {
+            auto next = block.used_ranges.lower_bound(range_end);
+            if (next != block.used_ranges.end() && next->second.kind != kind &&
+                on_same_page(end - 1, next->first, granularity)) {
+                continue;
+            }
+        }
+
+        // carve [start, end) out of the free range, keeping the padding around it free
+        block.free_ranges.erase(it);
+        if (start > range_start) {
+            block.free_ranges[range_start] = start - range_start;
+        }
+        if (end < range_end) {
+            block.free_ranges[end] = range_end - end;
+        }
+        block.used_ranges[start] = {size, kind};
+        offset = start;
+        return true;
+    }
+    return false;
+}
+
+void gpu_allocator::free_in_block(memory_block& block, VkDeviceSize offset) {
+    auto used = block.used_ranges.find(offset);
+    if (used == block.used_ranges.end()) {
+        throw std::runtime_error("gpu allocator: freeing memory that was not allocated!");
+    }
+    VkDeviceSize start = offset;
+    VkDeviceSize end = offset + used->second.size;
+    block.used_ranges.erase(used);
+
+    // coalesce with the free neighbours on both sides
+    auto next = block.free_ranges.lower_bound(start);
+    if (next != block.free_ranges.end() && next->first == end) {
+        end += next->second;
+        next = block.free_ranges.erase(next);
+    }
+    if (next != block.free_ranges.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == start) {
+            start = previous->first;
+            block.free_ranges.erase(previous);
+        }
+    }
+    block.free_ranges[start] = end - start;
+}
+
+gpu_allocation gpu_allocator::allocate_from_type(uint32_t memory_type, VkDeviceSize size, VkDeviceSize alignment,
+                                                 resource_kind kind) {
+    gpu_allocation allocation;
+    allocation.memory_type = memory_type;
+    allocation.size = size;
+
+    if (is_non_coherent(memory_type)) {
+        // flushes and invalidations work on whole atoms, keep them from touching neighbours
+        alignment = std::max(alignment, limits.nonCoherentAtomSize);
+        size = align_up(size, limits.nonCoherentAtomSize);
+    }
+
+    // large resources get memory of their own rather than wasting most of a block
+    VkDeviceSize block_size = block_size_for(memory_type);
+    if (size > block_size / 2) {
+        allocation.memory = allocate_device_memory(memory_type, size, &allocation.mapped);
+        if (allocation.memory != VK_NULL_HANDLE) {
+            allocation.dedicated = true;
+            dedicated_count++;
+            dedicated_bytes[memory_type] += size;
+        }
+        return allocation;
+    }
+
+    auto& type_blocks = blocks[memory_type];
+    for (size_t i = 0; i < type_blocks.size(); i++) {
+        auto& block = type_blocks[i];
+        if (block.memory != VK_NULL_HANDLE && allocate_from_block(block, size, alignment, kind, allocation.offset)) {
+            allocation.memory = block.memory;
+            allocation.block = i;
+            allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + allocation.offset : nullptr;
+            return allocation;
+        }
+    }
+
+    // no room anywhere, reserve a new block (reusing the slot of a released one)
+    memory_block block;
+    block.size = block_size;
+    block.memory = allocate_device_memory(memory_type, block_size, &block.mapped);
+    if (block.memory == VK_NULL_HANDLE) {
+        return allocation;
+    }
+    block.free_ranges[0] = block_size;
+    auto slot = std::find_if(type_blocks.begin(), type_blocks.end(),
+                             [](const memory_block& b) { return b.memory == VK_NULL_HANDLE; });
+    if (slot == type_blocks.end()) {
+        slot = type_blocks.insert(type_blocks.end(), block);
+    } else {
+        *slot = block;
+    }
+    allocate_from_block(*slot, size, alignment, kind, allocation.offset);
+    allocation.memory = slot->memory;
+    allocation.block = static_cast<size_t>(slot - type_blocks.begin());
+    allocation.mapped = slot->mapped ? static_cast<char*>(slot->mapped) + allocation.offset : nullptr;
+    return allocation;
+}
+
+gpu_allocation gpu_allocator::allocate(const VkMemoryRequirements& requirements,
+                                       VkMemoryPropertyFlags required,
+                                       VkMemoryPropertyFlags preferred,
+                                       resource_kind kind) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // try the memory types with the preferred properties first, then
+    // fall back to anything that has the required ones (e.g. when the
+    // device-local heap is full)
+    uint32_t type_bits = requirements.memoryTypeBits;
+    while (type_bits != 0) {
+        uint32_t memory_type;
+        if (!find_memory_type(type_bits, required | preferred, memory_type) &&
+            !find_memory_type(type_bits, required, memory_type)) {
+            break;
+        }
+        auto allocation = allocate_from_type(memory_type, requirements.size, requirements.alignment, kind);
+        if (allocation.memory != VK_NULL_HANDLE) {
+            return allocation;
+        }
+        type_bits &= ~(1u << memory_type);
+    }
+    throw std::runtime_error("gpu allocator: out of device memory!");
+}
+
+void gpu_allocator::free(const gpu_allocation& allocation) {
+    if (allocation.memory == VK_NULL_HANDLE) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (allocation.dedicated) {
+        VkDeviceSize size = allocation.size;
+        if (is_non_coherent(allocation.memory_type)) {
+            size = align_up(size, limits.nonCoherentAtomSize);
+        }
+        free_device_memory(allocation.memory, allocation.mapped != nullptr);
+        dedicated_count--;
+        dedicated_bytes[allocation.memory_type] -= size;
+        return;
+    }
+
+    auto& type_blocks = blocks[allocation.memory_type];
+    auto& block = type_blocks[allocation.block];
+    free_in_block(block, allocation.offset);
+
+    // give empty blocks back to the driver, but keep one around per
+    // memory type so that alloc/free patterns do not thrash vkAllocateMemory
+    if (block.used_ranges.empty()) {
+        size_t live_blocks = std::count_if(type_blocks.begin(), type_blocks.end(),
+                                           [](const memory_block& b) { return b.memory != VK_NULL_HANDLE; });
+        if (live_blocks > 1) {
+            free_device_memory(block.memory, block.mapped != nullptr);
+            block = memory_block{};
+        }
+    }
+}
+
+VkBuffer gpu_allocator::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                                      VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred,
+                                      gpu_allocation& allocation) {
+    VkBufferCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    create_info.size = size;
+    create_info.usage = usage;
+    create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkBuffer buffer;
+    if (vkCreateBuffer(device, &create_info, callbacks, &buffer) != VK_SUCCESS) {
+        throw std::runtime_error("gpu allocator: failed to create a buffer!");
+    }
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(device, buffer, &requirements);
+    allocation = allocate(requirements, required, preferred, resource_kind::linear);
+    vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+    return buffer;
+}
+
+VkImage gpu_allocator::create_image(const VkImageCreateInfo& create_info, VkMemoryPropertyFlags required,
+                                    gpu_allocation& allocation) {
+    VkImage image;
+    if (vkCreateImage(device, &create_info, callbacks, &image) != VK_SUCCESS) {
+        throw std::runtime_error("gpu allocator: failed to create an image!");
+    }
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(device, image, &requirements);
+    auto kind = create_info.tiling == VK_IMAGE_TILING_OPTIMAL ? resource_kind::optimal : resource_kind::linear;
+    allocation = allocate(requirements, required, 0, kind);
+    vkBindImageMemory(device, image, allocation.memory, allocation.offset);
+    return image;
+}
+
+void gpu_allocator::destroy_buffer(VkBuffer buffer, const gpu_allocation& allocation) {
+    vkDestroyBuffer(device, buffer, callbacks);
+    free(allocation);
+}
+
+void gpu_allocator::destroy_image(VkImage image, const gpu_allocation& allocation) {
+    vkDestroyImage(device, image, callbacks);
+    free(allocation);
+}
+
+transient_allocation gpu_allocator::allocate_transient(uint32_t frame, VkDeviceSize size, VkDeviceSize alignment) {
+    // transient data is bound as uniform/storage/vertex data, any of these offsets must be valid
+    alignment = std::max({alignment, limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment});
+    VkDeviceSize offset = align_up(transient_heads[frame], alignment);
+    if (offset + size > transient_segment_size) {
+        throw std::runtime_error("gpu allocator: transient memory of a frame exhausted!");
+    }
+    transient_heads[frame] = offset + size;
+    transient_peak = std::max(transient_peak, transient_heads[frame]);
+
+    transient_allocation allocation;
+    allocation.buffer = transient_buffer;
+    allocation.offset = frame * transient_segment_size + offset;
+    allocation.size = size;
+    allocation.mapped = static_cast<char*>(transient_memory.mapped) + allocation.offset;
+    return allocation;
+}
+
+void gpu_allocator::reset_frame(uint32_t frame) {
+    transient_heads[frame] = 0;
+}
+
+gpu_allocator_stats gpu_allocator::get_stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    gpu_allocator_stats stats;
+    stats.device_allocations = live_device_allocations;
+    stats.max_device_allocations = limits.maxMemoryAllocationCount;
+    stats.total_device_allocations = total_device_allocations;
+    stats.transient_capacity = transient_segment_size;
+    stats.transient_peak = transient_peak;
+    stats.heaps.resize(mem_properties.memoryHeapCount);
+    for (uint32_t heap = 0; heap < mem_properties.memoryHeapCount; heap++) {
+        stats.heaps[heap].size = mem_properties.memoryHeaps[heap].size;
+    }
+
+    VkDeviceSize free_bytes = 0;
+    for (uint32_t type = 0; type < blocks.size(); type++) {
+        auto& heap = stats.heaps[mem_properties.memoryTypes[type].heapIndex];
+        heap.reserved += dedicated_bytes[type];
+        heap.used += dedicated_bytes[type];
+        for (const auto& block : blocks[type]) {
+            if (block.memory == VK_NULL_HANDLE) {
+                continue;
+            }
+            heap.reserved += block.size;
+            for (const auto& used : block.used_ranges) {
+                heap.used += used.second.size;
+                stats.sub_allocations++;
+            }
+            for (const auto& range : block.free_ranges) {
+                free_bytes += range.second;
+                stats.largest_free_range = std::max(stats.largest_free_range, range.second);
+            }
+        }
+    }
+    for (const auto& heap : stats.heaps) {
+        stats.reserved += heap.reserved;
+        stats.used += heap.used;
+    }
+    if (free_bytes > 0) {
+        stats.fragmentation = 1.0 - static_cast<double>(stats.largest_free_range) / free_bytes;
+    }
+    return stats;
+}
+
+void gpu_allocator::print_stats(std::ostream& out) {
+    auto stats = get_stats();
+    const double mib = 1024.0 * 1024.0;
+    out << "gpu memory: " << stats.used / mib << " MiB used of " << stats.reserved / mib << " MiB reserved in "
+        << stats.device_allocations << '/' << stats.max_device_allocations << " device allocations ("
+        << stats.total_device_allocations << " made in total), "
+        << stats.sub_allocations << " sub-allocations, fragmentation " << stats.fragmentation << '\n';
+    for (size_t heap = 0; heap < stats.heaps.size(); heap++) {
+        out << "\theap " << heap << ": " << stats.heaps[heap].used / mib << " MiB used, "
+            << stats.heaps[heap].reserved / mib << " MiB reserved, "
+            << stats.heaps[heap].size / mib << " MiB total\n";
+    }
+    out << "\ttransient: peak " << stats.transient_peak / 1024.0 << " KiB of "
+        << stats.transient_capacity / 1024.0 << " KiB per frame" << std::endl;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <map>
+#include <mutex>
+#include <ostream>
+
+/**
+ * Drivers only allow a limited number of live vkAllocateMemory objects
+ * (maxMemoryAllocationCount, often 4096), and every allocation is slow.
+ * gpu_allocator reserves large blocks per memory type and hands out
+ * sub-ranges of them instead:
+ *  - long-lived resources come from a free list with coalescing,
+ *  - per-frame transient data comes from a linear arena per frame in
+ *    flight, which is reset wholesale once the frame has retired.
+ */
+
+// buffers and linear images must not share a bufferImageGranularity
+// page with optimal images, so the allocator has to tell them apart
+enum class resource_kind {
+    linear,
+    optimal
+};
+
+struct gpu_allocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    // non-null for host-visible memory, blocks stay mapped for their whole life
+    void* mapped = nullptr;
+    uint32_t memory_type = 0;
+    size_t block = 0;
+    bool dedicated = false;
+};
+
+// a range of the shared per-frame buffer, valid until the frame retires
+struct transient_allocation {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr;
+};
+
+struct gpu_heap_stats {
+    VkDeviceSize size = 0;     // size of the heap as reported by the driver
+    VkDeviceSize reserved = 0; // bytes held in vkAllocateMemory objects
+    VkDeviceSize used = 0;     // bytes handed out to resources
+};
+
+struct gpu_allocator_stats {
+    uint32_t device_allocations = 0;       // live vkAllocateMemory objects
+    uint32_t max_device_allocations = 0;   // the driver's limit for the above
+    uint64_t total_device_allocations = 0; // vkAllocateMemory calls so far
+    uint32_t sub_allocations = 0;          // live resources in shared blocks
+    VkDeviceSize reserved = 0;
+    VkDeviceSize used = 0;
+    VkDeviceSize largest_free_range = 0;
+    // 1 - largest free range / free bytes; 0 means all free memory is contiguous
+    double fragmentation = 0.0;
+    VkDeviceSize transient_capacity = 0;   // per frame
+    VkDeviceSize transient_peak = 0;       // most bytes used by a single frame
+    std::vector<gpu_heap_stats> heaps;
+};
+
+
+class gpu_allocator
+{
+public:
+    void init(VkPhysicalDevice physical_device, VkDevice device, const VkAllocationCallbacks* callbacks,
+              uint32_t frames_in_flight);
+    void destroy();
+
+    gpu_allocation allocate(const VkMemoryRequirements& requirements,
+                            VkMemoryPropertyFlags required,
+                            VkMemoryPropertyFlags preferred,
+                            resource_kind kind);
+    void free(const gpu_allocation& allocation);
+
+    // create a resource and bind it to freshly sub-allocated memory
+    VkBuffer create_buffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                           VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred,
+                           gpu_allocation& allocation);
+    VkImage create_image(const VkImageCreateInfo& create_info, VkMemoryPropertyFlags required,
+                         gpu_allocation& allocation);
+    void destroy_buffer(VkBuffer buffer, const gpu_allocation& allocation);
+    void destroy_image(VkImage image, const gpu_allocation& allocation);
+
+    // per-frame linear arena; only valid until reset_frame() is called
+    // again for the same frame, i.e. after its fence has been waited on
+    transient_allocation allocate_transient(uint32_t frame, VkDeviceSize size, VkDeviceSize alignment = 1);
+    void reset_frame(uint32_t frame);
+
+    const VkPhysicalDeviceMemoryProperties& memory_properties() const { return mem_properties; }
+    gpu_allocator_stats get_stats();
+    void print_stats(std::ostream& out);
+
+private:
+    struct used_range {
+        VkDeviceSize size;
+        resource_kind kind;
+    };
+
+    struct memory_block {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        void* mapped = nullptr;
+        std::map<VkDeviceSize, VkDeviceSize> free_ranges; // offset -> size, coalesced
+        std::map<VkDeviceSize, used_range> used_ranges;   // offset -> range
+    };
+
+    bool find_memory_type(uint32_t type_bits, VkMemoryPropertyFlags flags, uint32_t& type_index);
+    VkDeviceMemory allocate_device_memory(uint32_t memory_type, VkDeviceSize size, void** mapped);
+    void free_device_memory(VkDeviceMemory memory, bool mapped);
+    bool allocate_from_block(memory_block& block, VkDeviceSize size, VkDeviceSize alignment,
+                             resource_kind kind, VkDeviceSize& offset);
+    void free_in_block(memory_block& block, VkDeviceSize offset);
+    gpu_allocation allocate_from_type(uint32_t memory_type, VkDeviceSize size, VkDeviceSize alignment,
+                                      resource_kind kind);
+    VkDeviceSize block_size_for(uint32_t memory_type) const;
+    bool is_non_coherent(uint32_t memory_type) const;
+
+    VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks* callbacks = nullptr;
+    VkPhysicalDeviceMemoryProperties mem_properties{};
+    VkPhysicalDeviceLimits limits{};
+
+    std::mutex mutex;
+    std::vector<std::vector<memory_block>> blocks; // per memory type
+    std::vector<VkDeviceSize> dedicated_bytes;     // per memory type
+    uint32_t dedicated_count = 0;
+    uint32_t live_device_allocations = 0;
+    uint64_t total_device_allocations = 0;
+
+    // one linear segment of transient_buffer per frame in flight
+    VkBuffer transient_buffer = VK_NULL_HANDLE;
+    gpu_allocation transient_memory;
+    VkDeviceSize transient_segment_size = 0;
+    std::vector<VkDeviceSize> transient_heads;
+    VkDeviceSize transient_peak = 0;
+
+    static constexpr VkDeviceSize default_block_size = 64ull * 1024 * 1024;
+    static constexpr VkDeviceSize transient_size_per_frame = 4ull * 1024 * 1024;
+};
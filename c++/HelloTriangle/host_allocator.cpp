@@ -0,0 +1,217 @@
+#include <host_allocator.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// in front of every allocation handed to the driver
+struct allocation_header {
+    void* base;       // what to pass to std::free, null for arena memory
+    void* arena;      // the thread_arena it came from, if any
+    size_t size;
+    uint32_t scope;
+};
+
+char* align_up(char* p, size_t alignment) {
+    auto address = reinterpret_cast<uintptr_t>(p);
+    return reinterpret_cast<char*>((address + alignment - 1) & ~(uintptr_t(alignment) - 1));
+}
+
+allocation_header* header_of(void* memory) {
+    return reinterpret_cast<allocation_header*>(static_cast<char*>(memory) - sizeof(allocation_header));
+}
+
+std::atomic<uint64_t> next_allocator_id{1};
+
+// the arena of the current thread, for the allocator with the given id
+thread_local uint64_t cached_owner = 0;
+thread_local void* cached_arena = nullptr;
+
+}
+
+void host_allocator::init(size_t arena_bytes) {
+    this->arena_bytes = arena_bytes;
+    id = next_allocator_id.fetch_add(1, std::memory_order_relaxed);
+    vk_callbacks.pUserData = this;
+    vk_callbacks.pfnAllocation = vk_allocate;
+    vk_callbacks.pfnReallocation = vk_reallocate;
+    vk_callbacks.pfnFree = vk_free;
+    vk_callbacks.pfnInternalAllocation = vk_internal_allocation;
+    vk_callbacks.pfnInternalFree = vk_internal_free;
+    enabled = true;
+}
+
+void host_allocator::destroy() {
+    std::lock_guard<std::mutex> lock(arenas_mutex);
+    for (auto& arena : arenas) {
+        std::free(arena->memory);
+    }
+    arenas.clear();
+    enabled = false;
+}
+
+host_allocator::thread_arena* host_allocator::arena_of_this_thread() {
+    if (cached_owner == id) {
+        return static_cast<thread_arena*>(cached_arena);
+    }
+    auto arena = std::make_unique<thread_arena>();
+    arena->memory = static_cast<char*>(std::malloc(arena_bytes));
+    arena->capacity = arena->memory ? arena_bytes : 0;
+    cached_owner = id;
+    cached_arena = arena.get();
+    std::lock_guard<std::mutex> lock(arenas_mutex);
+    arenas.push_back(std::move(arena));
+    return static_cast<thread_arena*>(cached_arena);
+}
+
+void* host_allocator::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    alignment = std::max(alignment, alignof(allocation_header));
+    char* memory = nullptr;
+    void* base = nullptr;
+    thread_arena* arena = nullptr;
+
+    if (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND && arena_bytes > 0) {
+        arena = arena_of_this_thread();
+        // everything handed out so far has come back, start over
+        if (arena->live.load(std::memory_order_acquire) == 0) {
+            arena->head = 0;
+        }
+        char* position = align_up(arena->memory + arena->head + sizeof(allocation_header), alignment);
+        if (arena->memory && position + size <= arena->memory + arena->capacity) {
+            memory = position;
+            arena->head = position + size - arena->memory;
+            arena->live.fetch_add(1, std::memory_order_relaxed);
+            arena_allocations.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            arena = nullptr;
+            arena_overflows.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (memory == nullptr) {
+        base = std::malloc(size + alignment + sizeof(allocation_header));
+        if (base == nullptr) {
+            // the driver turns this into VK_ERROR_OUT_OF_HOST_MEMORY
+            return nullptr;
+        }
+        memory = align_up(static_cast<char*>(base) + sizeof(allocation_header), alignment);
+    }
+    *header_of(memory) = {base, arena, size, static_cast<uint32_t>(scope)};
+
+    auto& counters = scopes[scope];
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    counters.bytes.fetch_add(size, std::memory_order_relaxed);
+    uint64_t live = counters.live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    uint64_t peak = counters.peak_bytes.load(std::memory_order_relaxed);
+    while (live > peak && !counters.peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+    return memory;
+}
+
+void host_allocator::release(void* memory) {
+    allocation_header header = *header_of(memory);
+    auto& counters = scopes[header.scope];
+    counters.frees.fetch_add(1, std::memory_order_relaxed);
+    counters.live_bytes.fetch_sub(header.size, std::memory_order_relaxed);
+    if (header.arena) {
+        static_cast<thread_arena*>(header.arena)->live.fetch_sub(1, std::memory_order_release);
+    } else {
+        std::free(header.base);
+    }
+}
+
+VKAPI_ATTR void* VKAPI_CALL host_allocator::vk_allocate(void* user_data, size_t size, size_t alignment,
+                                                        VkSystemAllocationScope scope) {
+    return static_cast<host_allocator*>(user_data)->allocate(size, alignment, scope);
+}
+
+VKAPI_ATTR void* VKAPI_CALL host_allocator::vk_reallocate(void* user_data, void* original, size_t size,
+                                                          size_t alignment, VkSystemAllocationScope scope) {
+    auto self = static_cast<host_allocator*>(user_data);
+    if (original == nullptr) {
+        return self->allocate(size, alignment, scope);
+    }
+    if (size == 0) {
+        self->release(original);
+        return nullptr;
+    }
+    void* memory = self->allocate(size, alignment, scope);
+    if (memory == nullptr) {
+        // the original allocation stays valid, as the spec requires
+        return nullptr;
+    }
+    std::memcpy(memory, original, std::min(size, header_of(original)->size));
+    self->release(original);
+    self->scopes[scope].reallocations.fetch_add(1, std::memory_order_relaxed);
+    return memory;
+}
+
+VKAPI_ATTR void VKAPI_CALL host_allocator::vk_free(void* user_data, void* memory) {
+    if (memory != nullptr) {
+        static_cast<host_allocator*>(user_data)->release(memory);
+    }
+}
+
+VKAPI_ATTR void VKAPI_CALL host_allocator::vk_internal_allocation(void* user_data, size_t size,
+                                                                  VkInternalAllocationType type,
+                                                                  VkSystemAllocationScope scope) {
+    static_cast<host_allocator*>(user_data)->scopes[scope].internal_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+VKAPI_ATTR void VKAPI_CALL host_allocator::vk_internal_free(void* user_data, size_t size,
+                                                            VkInternalAllocationType type,
+                                                            VkSystemAllocationScope scope) {
+    static_cast<host_allocator*>(user_data)->scopes[scope].internal_bytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+host_allocator_stats host_allocator::get_stats() const {
+    host_allocator_stats stats;
+    for (int scope = 0; scope <= VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE; scope++) {
+        const auto& counters = scopes[scope];
+        auto& out = stats.scopes[scope];
+        out.allocations = counters.allocations.load(std::memory_order_relaxed);
+        out.reallocations = counters.reallocations.load(std::memory_order_relaxed);
+        out.frees = counters.frees.load(std::memory_order_relaxed);
+        out.bytes = counters.bytes.load(std::memory_order_relaxed);
+        out.live_bytes = counters.live_bytes.load(std::memory_order_relaxed);
+        out.peak_bytes = counters.peak_bytes.load(std::memory_order_relaxed);
+        out.internal_bytes = counters.internal_bytes.load(std::memory_order_relaxed);
+    }
+    stats.arena_allocations = arena_allocations.load(std::memory_order_relaxed);
+    stats.arena_overflows = arena_overflows.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(arenas_mutex);
+    stats.arena_count = arenas.size();
+    return stats;
+}
+
+uint64_t host_allocator::allocation_count() const {
+    uint64_t count = 0;
+    for (const auto& counters : scopes) {
+        count += counters.allocations.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+void host_allocator::print_stats(std::ostream& out) const {
+    if (!enabled) {
+        return;
+    }
+    static const char* names[] = {"command", "object", "cache", "device", "instance"};
+    auto stats = get_stats();
+    out << "driver host memory:\n";
+    for (int scope = 0; scope <= VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE; scope++) {
+        const auto& s = stats.scopes[scope];
+        out << '\t' << names[scope] << ": " << s.allocations << " allocations ("
+            << s.reallocations << " reallocations, " << s.frees << " frees), "
+            << s.bytes / 1024.0 << " KiB in total, " << s.live_bytes / 1024.0 << " KiB live, peak "
+            << s.peak_bytes / 1024.0 << " KiB";
+        if (s.internal_bytes > 0) {
+            out << ", " << s.internal_bytes / 1024.0 << " KiB internal";
+        }
+        out << '\n';
+    }
+    out << "\tcommand arenas: " << stats.arena_allocations << " allocations served by "
+        << stats.arena_count << " arenas of " << arena_bytes / 1024.0 << " KiB, "
+        << stats.arena_overflows << " overflowed to the heap" << std::endl;
+}
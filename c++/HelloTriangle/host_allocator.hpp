@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+// what the driver allocated in one VkSystemAllocationScope
+struct host_scope_stats {
+    uint64_t allocations = 0;   // including the new block of a reallocation
+    uint64_t reallocations = 0;
+    uint64_t frees = 0;
+    uint64_t bytes = 0;         // requested in total
+    uint64_t live_bytes = 0;
+    uint64_t peak_bytes = 0;
+    uint64_t internal_bytes = 0; // reported through the internal allocation notifications
+};
+
+struct host_allocator_stats {
+    host_scope_stats scopes[VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1];
+    uint64_t arena_allocations = 0; // command scope allocations served by an arena
+    uint64_t arena_overflows = 0;   // command scope allocations that did not fit and went to the heap
+    size_t arena_count = 0;         // one per thread that made a command scope allocation
+};
+
+/**
+ * VkAllocationCallbacks for everything the driver allocates on the
+ * host on the app's behalf. Allocations that only live for the
+ * duration of a single Vulkan command (VK_SYSTEM_ALLOCATION_SCOPE_COMMAND)
+ * come from a bump arena of the calling thread, which is rewound once
+ * all of its allocations have been freed again; all other scopes go
+ * to the heap. Every allocation is counted per scope, so driver-side
+ * heap churn in the frame loop shows up in the stats (and in the
+ * benchmark reports).
+ *
+ * callbacks() is nullptr unless init() was called, in which case the
+ * driver's own allocator is used, as before. The allocator has to
+ * outlive every object created with its callbacks, i.e. destroy()
+ * comes after vkDestroyInstance().
+ */
+class host_allocator
+{
+public:
+    void init(size_t arena_bytes);
+    void destroy();
+
+    const VkAllocationCallbacks* callbacks() const { return enabled ? &vk_callbacks : nullptr; }
+    bool is_enabled() const { return enabled; }
+
+    host_allocator_stats get_stats() const;
+    // allocations in all scopes so far, cheap enough to sample every frame
+    uint64_t allocation_count() const;
+    void print_stats(std::ostream& out) const;
+
+private:
+    struct thread_arena {
+        char* memory = nullptr;
+        size_t capacity = 0;
+        size_t head = 0;
+        // only rewound by the owning thread, but the driver may free
+        // from another one
+        std::atomic<uint32_t> live{0};
+    };
+
+    struct scope_counters {
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> reallocations{0};
+        std::atomic<uint64_t> frees{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> live_bytes{0};
+        std::atomic<uint64_t> peak_bytes{0};
+        std::atomic<uint64_t> internal_bytes{0};
+    };
+
+    static VKAPI_ATTR void* VKAPI_CALL vk_allocate(void* user_data, size_t size, size_t alignment,
+                                                   VkSystemAllocationScope scope);
+    static VKAPI_ATTR void* VKAPI_CALL vk_reallocate(void* user_data, void* original, size_t size,
+                                                     size_t alignment, VkSystemAllocationScope scope);
+    static VKAPI_ATTR void VKAPI_CALL vk_free(void* user_data, void* memory);
+    static VKAPI_ATTR void VKAPI_CALL vk_internal_allocation(void* user_data, size_t size,
+                                                             VkInternalAllocationType type,
+                                                             VkSystemAllocationScope scope);
+    static VKAPI_ATTR void VKAPI_CALL vk_internal_free(void* user_data, size_t size,
+                                                       VkInternalAllocationType type,
+                                                       VkSystemAllocationScope scope);
+
+    void* allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+    void release(void* memory);
+    thread_arena* arena_of_this_thread();
+
+    bool enabled = false;
+    VkAllocationCallbacks vk_callbacks{};
+    size_t arena_bytes = 0;
+    // distinguishes this allocator from earlier ones in the thread-local arena cache
+    uint64_t id = 0;
+
+    scope_counters scopes[VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1];
+    std::atomic<uint64_t> arena_allocations{0};
+    std::atomic<uint64_t> arena_overflows{0};
+
+    mutable std::mutex arenas_mutex;
+    std::vector<std::unique_ptr<thread_arena>> arenas;
+};
@@ -0,0 +1,77 @@
+#include <job_system.hpp>
+
+job_system::job_system(uint32_t thread_count) {
+    for (uint32_t i = 0; i < thread_count; i++) {
+        threads.emplace_back(&job_system::worker_loop, this, i);
+    }
+}
+
+job_system::~job_system() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_available.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void job_system::parallel_for(uint32_t slices, size_t count,
+                              const std::function<void(uint32_t, size_t, size_t)>& job) {
+    if (slices > size()) {
+        slices = size();
+    }
+    if (slices == 0) {
+        // no workers, do it on the calling thread
+        job(0, 0, count);
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    this->job = &job;
+    job_count = count;
+    job_slices = slices;
+    pending = slices;
+    error = nullptr;
+    generation++;
+    work_available.notify_all();
+    work_done.wait(lock, [this] { return pending == 0; });
+    this->job = nullptr;
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void job_system::worker_loop(uint32_t index) {
+    uint64_t seen_generation = 0;
+    while (true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        work_available.wait(lock, [&] { return stopping || generation != seen_generation; });
+        if (stopping) {
+            return;
+        }
+        seen_generation = generation;
+        if (index >= job_slices) {
+            continue;
+        }
+        size_t begin = job_count * index / job_slices;
+        size_t end = job_count * (index + 1) / job_slices;
+        auto current_job = job;
+        lock.unlock();
+
+        std::exception_ptr job_error;
+        try {
+            (*current_job)(index, begin, end);
+        } catch (...) {
+            job_error = std::current_exception();
+        }
+
+        lock.lock();
+        if (job_error && !error) {
+            error = job_error;
+        }
+        if (--pending == 0) {
+            work_done.notify_one();
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <cstdint>
+
+/**
+ * A fixed pool of worker threads. parallel_for() hands slice i of the
+ * work to worker i, always, so that workers can own per-thread state
+ * that must not be shared (command pools in particular are externally
+ * synchronized and may only be used from one thread at a time).
+ */
+class job_system
+{
+public:
+    explicit job_system(uint32_t thread_count);
+    ~job_system();
+    job_system(const job_system&) = delete;
+    job_system& operator=(const job_system&) = delete;
+
+    uint32_t size() const { return static_cast<uint32_t>(threads.size()); }
+
+    // split [0, count) into `slices` contiguous ranges and run
+    // job(worker, begin, end) for each of them; blocks until all are done
+    void parallel_for(uint32_t slices, size_t count,
+                      const std::function<void(uint32_t, size_t, size_t)>& job);
+
+private:
+    void worker_loop(uint32_t index);
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable work_done;
+
+    const std::function<void(uint32_t, size_t, size_t)>* job = nullptr;
+    size_t job_count = 0;
+    uint32_t job_slices = 0;
+    uint32_t pending = 0;
+    uint64_t generation = 0;
+    bool stopping = false;
+    std::exception_ptr error;
+};
@@ -1,4 +1,5 @@
 #include <vulkan_app.hpp>
+#include <string>
 
 /**
  * A quick side note on code styling: I prefer to use
@@ -9,10 +10,137 @@
  */
 
 
-int main() {
-    vulkan_app app;
+app_config parse_arguments(int argc, char** argv) {
+    app_config config;
+    if (const char* device = std::getenv("HELLO_TRIANGLE_DEVICE")) {
+        config.device = device;
+    }
+    if (const char* validation = std::getenv("HELLO_TRIANGLE_VALIDATION")) {
+        config.validation = std::string(validation) != "0";
+    }
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--headless") {
+            config.headless = true;
+        } else if (argument == "--frames" && i + 1 < argc) {
+            config.frame_count = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (argument == "--frames-in-flight" && i + 1 < argc) {
+            config.frames_in_flight = static_cast<uint32_t>(std::stoul(argv[++i]));
+            if (config.frames_in_flight == 0) {
+                throw std::runtime_error("at least one frame has to be in flight!");
+            }
+        } else if (argument == "--compare-frames-in-flight") {
+            config.compare_frames_in_flight = true;
+        } else if (argument == "--pipeline-cache" && i + 1 < argc) {
+            config.pipeline_cache_path = argv[++i];
+        } else if (argument == "--no-pipeline-cache") {
+            config.pipeline_cache_path.clear();
+        } else if (argument == "--draws" && i + 1 < argc) {
+            config.draw_count = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (argument == "--record-threads" && i + 1 < argc) {
+            config.record_threads = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (argument == "--record-benchmark") {
+            config.record_benchmark = true;
+        } else if (argument == "--profile") {
+            config.profile = true;
+        } else if (argument == "--profile-csv" && i + 1 < argc) {
+            config.profile_csv_path = argv[++i];
+        } else if (argument == "--profile-trace" && i + 1 < argc) {
+            config.profile_trace_path = argv[++i];
+        } else if (argument == "--present-policy" && i + 1 < argc) {
+            if (!parse_present_policy(argv[++i], config.present)) {
+                throw std::runtime_error(std::string("unknown present policy: ") + argv[i]);
+            }
+        } else if (argument == "--compare-present-policies") {
+            config.compare_present_policies = true;
+        } else if (argument == "--no-bindless") {
+            config.bindless = false;
+        } else if (argument == "--scene" && i + 1 < argc) {
+            config.scene_objects = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (argument == "--gpu-culling") {
+            config.gpu_culling = true;
+        } else if (argument == "--culling-benchmark") {
+            config.culling_benchmark = true;
+        } else if (argument == "--bench" && i + 1 < argc) {
+            config.bench_scene = argv[++i];
+        } else if (argument == "--bench-json" && i + 1 < argc) {
+            config.bench_json_path = argv[++i];
+        } else if (argument == "--bench-baseline" && i + 1 < argc) {
+            config.bench_baseline_path = argv[++i];
+        } else if (argument == "--bench-threshold" && i + 1 < argc) {
+            config.bench_threshold = std::stod(argv[++i]);
+        } else if (argument == "--list-extensions") {
+            config.list_extensions = true;
+        } else if (argument == "--host-allocator") {
+            config.host_allocation_callbacks = true;
+        } else if (argument == "--host-arena-kb" && i + 1 < argc) {
+            config.host_arena_kb = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (argument == "--texture" && i + 1 < argc) {
+            config.texture_paths.push_back(argv[++i]);
+        } else if (argument == "--texture-budget-kb" && i + 1 < argc) {
+            config.texture_budget_kb = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (argument == "--sprites" && i + 1 < argc) {
+            config.sprite_count = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (argument == "--validation") {
+            config.validation = true;
+        } else if (argument == "--no-validation") {
+            config.validation = false;
+        } else if (argument == "--validation-severity" && i + 1 < argc) {
+            if (!parse_debug_severity(argv[++i], config.validation_severities)) {
+                throw std::runtime_error(std::string("unknown validation severity: ") + argv[i]);
+            }
+        } else if (argument == "--validation-types" && i + 1 < argc) {
+            if (!parse_debug_types(argv[++i], config.validation_types)) {
+                throw std::runtime_error(std::string("unknown validation message types: ") + argv[i]);
+            }
+        } else if (argument == "--validation-rate" && i + 1 < argc) {
+            config.validation_rate = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (argument == "--mesh" && i + 1 < argc) {
+            config.mesh_path = argv[++i];
+        } else if (argument == "--capture" && i + 1 < argc) {
+            config.capture_path = argv[++i];
+        } else if (argument == "--capture-buffers" && i + 1 < argc) {
+            config.capture_buffers = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (argument == "--vulkan10") {
+            config.vulkan13 = false;
+        } else if (argument == "--transforms" && i + 1 < argc) {
+            config.transform_count = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (argument == "--transform-benchmark") {
+            config.transform_benchmark = true;
+        } else if (argument == "--compute-benchmark") {
+            config.compute_benchmark = true;
+        } else if (argument == "--compute-jobs" && i + 1 < argc) {
+            config.compute_job_count = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (argument == "--device" && i + 1 < argc) {
+            config.device = argv[++i];
+        } else {
+            throw std::runtime_error("unknown argument: " + argument);
+        }
+    }
+    if (!config.bench_scene.empty() && !apply_bench_scene(config)) {
+        throw std::runtime_error("unknown benchmark scene: " + config.bench_scene);
+    }
+    if (config.culling_benchmark && config.scene_objects == 0) {
+        config.scene_objects = 100000;
+    }
+    if (config.transform_benchmark && config.transform_count == 0) {
+        config.transform_count = 100000;
+    }
+    if (config.compute_benchmark) {
+        config.headless = true;
+    }
+    return config;
+}
 
+int main(int argc, char** argv) {
     try {
+        app_config config = parse_arguments(argc, argv);
+        // CPU only, needs no device
+        if (config.transform_benchmark) {
+            benchmark_transforms(config.transform_count, config.frame_count);
+            return EXIT_SUCCESS;
+        }
+        vulkan_app app(config);
         app.run();
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
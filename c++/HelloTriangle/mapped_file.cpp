@@ -0,0 +1,56 @@
+#include <mapped_file.hpp>
+
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+mapped_file::mapped_file(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open " + path + "!");
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("failed to stat " + path + "!");
+    }
+    length = static_cast<size_t>(st.st_size);
+    if (length > 0) {
+        mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    // the mapping keeps its own reference to the file
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        length = 0;
+        throw std::runtime_error("failed to map " + path + "!");
+    }
+}
+
+mapped_file::~mapped_file() {
+    unmap();
+}
+
+mapped_file::mapped_file(mapped_file&& other) noexcept
+    : mapping(std::exchange(other.mapping, nullptr)), length(std::exchange(other.length, 0)) {}
+
+mapped_file& mapped_file::operator=(mapped_file&& other) noexcept {
+    if (this != &other) {
+        unmap();
+        mapping = std::exchange(other.mapping, nullptr);
+        length = std::exchange(other.length, 0);
+    }
+    return *this;
+}
+
+void mapped_file::unmap() {
+    if (mapping != nullptr) {
+        munmap(mapping, length);
+        mapping = nullptr;
+        length = 0;
+    }
+}
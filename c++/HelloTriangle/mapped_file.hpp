@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+/**
+ * A read-only memory mapping of a whole file. The pages are faulted
+ * in on first access straight from the page cache, nothing is copied
+ * into a heap buffer. The mapping is page-aligned, so the contents can
+ * be reinterpreted as any type up to that alignment.
+ */
+class mapped_file
+{
+public:
+    mapped_file() = default;
+    // throws if the file cannot be opened or mapped
+    explicit mapped_file(const std::string& path);
+    ~mapped_file();
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+    mapped_file(mapped_file&& other) noexcept;
+    mapped_file& operator=(mapped_file&& other) noexcept;
+
+    const void* data() const { return mapping; }
+    size_t size() const { return length; }
+
+private:
+    void unmap();
+
+    void* mapping = nullptr;
+    size_t length = 0;
+};
@@ -0,0 +1,44 @@
+#include <mesh_format.hpp>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// whether [offset, offset + size) lies within the file, without overflowing
+bool in_file(uint64_t offset, uint64_t size, uint64_t file_size) {
+    return offset <= file_size && size <= file_size - offset;
+}
+
+}
+
+mesh_file open_mesh_file(const std::string& path) {
+    mesh_file mesh;
+    mesh.path = path;
+    mesh.file = mapped_file(path);
+    if (mesh.file.size() < sizeof(mesh_file_header) ||
+        std::memcmp(mesh.file.data(), mesh_file_magic, sizeof(mesh_file_magic)) != 0) {
+        throw std::runtime_error(path + " is not a mesh file!");
+    }
+    mesh.header = static_cast<const mesh_file_header*>(mesh.file.data());
+    const mesh_file_header& header = *mesh.header;
+    if (header.version != mesh_file_version) {
+        throw std::runtime_error(path + " is of mesh format version " + std::to_string(header.version) +
+                                 ", expected " + std::to_string(mesh_file_version) + "!");
+    }
+    if (header.index_size != 2 && header.index_size != 4) {
+        throw std::runtime_error(path + " has malformed indices!");
+    }
+    // the sections are reinterpreted in place, the mapping itself is page-aligned
+    uint64_t size = mesh.file.size();
+    if (header.vertex_offset % 16 != 0 || header.index_offset % 16 != 0 || header.meshlet_offset % 16 != 0 ||
+        !in_file(header.vertex_offset, mesh.vertex_bytes(), size) ||
+        !in_file(header.index_offset, mesh.index_bytes(), size) ||
+        !in_file(header.meshlet_offset, uint64_t(header.meshlet_count) * sizeof(mesh_meshlet), size)) {
+        throw std::runtime_error("truncated mesh file " + path + "!");
+    }
+    if (header.vertex_count == 0 || header.index_count == 0 || header.index_count % 3 != 0) {
+        throw std::runtime_error(path + " has no triangles!");
+    }
+    return mesh;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <mapped_file.hpp>
+
+#include <string>
+#include <cstdint>
+
+/**
+ * The binary mesh format written by tools/mesh_converter and read by
+ * the app. Everything is stored the way the GPU consumes it, so that
+ * loading is a memory mapping and a copy into staging memory:
+ *
+ *   mesh_file_header
+ *   mesh_vertex[vertex_count]         at vertex_offset
+ *   uint16_t or uint32_t[index_count] at index_offset
+ *   mesh_meshlet[meshlet_count]       at meshlet_offset
+ *
+ * The sections are 16-byte aligned, the file is little-endian.
+ * Positions are normalized by the converter so that the largest side
+ * of the bounding box is 1 and the box is centered on the origin, the
+ * same size as the hard-coded triangle; header.scale and header.center
+ * take them back to the units of the source.
+ */
+constexpr char mesh_file_magic[4] = {'H', 'T', 'M', 'S'};
+constexpr uint32_t mesh_file_version = 1;
+
+/**
+ * 20 bytes instead of the 48 of the same attributes as floats:
+ *  - position: 16-bit snorm (R16G16B16A16_SNORM), w is 0,
+ *  - normal: 8-bit snorm (R8G8B8A8_SNORM), w is 0,
+ *  - color: 8-bit unorm (R8G8B8A8_UNORM),
+ *  - texcoord: half floats (R16G16_SFLOAT), texture coordinates may
+ *    repeat beyond [0, 1].
+ */
+struct mesh_vertex {
+    int16_t position[4];
+    int8_t normal[4];
+    uint8_t color[4];
+    uint16_t texcoord[2];
+};
+static_assert(sizeof(mesh_vertex) == 20, "mesh_vertex is read by the vertex input as it is");
+
+/**
+ * A run of at most meshlet_max_triangles triangles of the index buffer
+ * that reference at most meshlet_max_vertices distinct vertices, with
+ * the bounds a culling pass needs: a bounding sphere and a normal cone.
+ * The meshlet can be skipped when the camera sees all of its triangles
+ * from behind, i.e. when
+ *   dot(center - camera, cone_axis) >= cone_cutoff * length(center - camera) + radius;
+ * a cone_cutoff of 1 means the triangles face too many ways to cull.
+ */
+struct mesh_meshlet {
+    uint32_t first_index;
+    uint32_t triangle_count;
+    uint32_t vertex_count;
+    float center[3];
+    float radius;
+    float cone_axis[3];
+    float cone_cutoff;
+    uint32_t padding;
+};
+static_assert(sizeof(mesh_meshlet) == 48, "mesh_meshlet is part of the file format");
+
+constexpr uint32_t meshlet_max_vertices = 64;
+constexpr uint32_t meshlet_max_triangles = 124;
+
+struct mesh_file_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t index_size; // 2 while the vertices fit 16-bit indices, 4 otherwise
+    uint32_t meshlet_count;
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+    uint64_t meshlet_offset;
+    float center[3];     // source position = position * scale + center
+    float scale;
+    float bounds_center[3]; // bounding sphere of the normalized positions
+    float bounds_radius;
+};
+static_assert(sizeof(mesh_file_header) == 80, "mesh_file_header is part of the file format");
+
+/**
+ * A mesh file as it lies on disk, with the header checked against the
+ * size of the mapping; the sections point into the mapping.
+ */
+struct mesh_file {
+    std::string path;
+    mapped_file file;
+    const mesh_file_header* header = nullptr;
+
+    const mesh_vertex* vertices() const { return reinterpret_cast<const mesh_vertex*>(at(header->vertex_offset)); }
+    const void* indices() const { return at(header->index_offset); }
+    const mesh_meshlet* meshlets() const { return reinterpret_cast<const mesh_meshlet*>(at(header->meshlet_offset)); }
+    size_t vertex_bytes() const { return size_t(header->vertex_count) * sizeof(mesh_vertex); }
+    size_t index_bytes() const { return size_t(header->index_count) * header->index_size; }
+
+private:
+    const char* at(uint64_t offset) const { return static_cast<const char*>(file.data()) + offset; }
+};
+
+// throws on files that are not mesh files, of another version or truncated;
+// the indices themselves are not checked, that would touch every one of them
+mesh_file open_mesh_file(const std::string& path);
@@ -0,0 +1,537 @@
+#include <render_graph.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+struct access_info {
+    VkPipelineStageFlags stage;
+    VkAccessFlags access;
+    VkImageLayout layout; // ignored for buffers
+    bool write;
+};
+
+access_info describe(rg_access access) {
+    switch (access) {
+    case rg_access::color_attachment_write:
+        return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true};
+    case rg_access::sampled_read:
+        return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false};
+    case rg_access::storage_read:
+        return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                VK_IMAGE_LAYOUT_GENERAL, false};
+    case rg_access::storage_write:
+        return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                VK_IMAGE_LAYOUT_GENERAL, true};
+    case rg_access::storage_read_write:
+        return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                VK_IMAGE_LAYOUT_GENERAL, true};
+    case rg_access::transfer_read:
+        return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false};
+    case rg_access::transfer_write:
+        return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true};
+    case rg_access::indirect_read:
+        return {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+                VK_IMAGE_LAYOUT_UNDEFINED, false};
+    case rg_access::vertex_read:
+    default:
+        return {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT,
+                VK_IMAGE_LAYOUT_UNDEFINED, false};
+    }
+}
+
+bool is_depth_format(VkFormat format) {
+    return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_D32_SFLOAT ||
+           format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+VkImageAspectFlags aspect_of(VkFormat format) {
+    return is_depth_format(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+}
+
+} // namespace
+
+void render_graph::init(VkDevice device, const VkAllocationCallbacks* callbacks, gpu_allocator* allocator,
+                        uint32_t frames_in_flight, bool synchronization2) {
+    this->device = device;
+    this->callbacks = callbacks;
+    this->allocator = allocator;
+    this->frames_in_flight = frames_in_flight;
+    this->synchronization2 = synchronization2;
+}
+
+void render_graph::destroy() {
+    // the device is idle by now
+    destroy_transients(transients);
+    for (auto& set : retired) {
+        destroy_transients(set);
+    }
+    retired.clear();
+}
+
+void render_graph::destroy_transients(transient_set& set) {
+    for (auto view : set.views) {
+        vkDestroyImageView(device, view, callbacks);
+    }
+    for (auto image : set.images) {
+        vkDestroyImage(device, image, callbacks);
+    }
+    for (const auto& allocation : set.allocations) {
+        allocator->free(allocation);
+    }
+    set = transient_set{};
+}
+
+void render_graph::begin_frame(uint64_t frame_number) {
+    this->frame_number = frame_number;
+    // same arithmetic as for retired swap chains
+    auto done = [&](transient_set& set) {
+        if (set.retired_at + frames_in_flight <= frame_number + 1) {
+            destroy_transients(set);
+            return true;
+        }
+        return false;
+    };
+    retired.erase(std::remove_if(retired.begin(), retired.end(), done), retired.end());
+}
+
+void render_graph::reset() {
+    if (!transients.images.empty()) {
+        transients.retired_at = frame_number;
+        retired.push_back(std::move(transients));
+        transients = transient_set{};
+    }
+    passes.clear();
+    resources.clear();
+    batches.clear();
+    slots.clear();
+    compiled = false;
+    transient_bytes = 0;
+    allocated_bytes = 0;
+}
+
+rg_handle render_graph::import_image(const std::string& name, VkPipelineStageFlags initial_stage,
+                                     VkImageLayout final_layout, VkPipelineStageFlags final_stage,
+                                     VkAccessFlags final_access) {
+    resource r;
+    r.name = name;
+    r.image = true;
+    r.imported = true;
+    r.output = true;
+    r.initial_stage = initial_stage;
+    r.final_layout = final_layout;
+    r.final_stage = final_stage;
+    r.final_access = final_access;
+    resources.push_back(r);
+    return static_cast<rg_handle>(resources.size() - 1);
+}
+
+rg_handle render_graph::import_buffer(const std::string& name, bool output) {
+    resource r;
+    r.name = name;
+    r.imported = true;
+    r.output = output;
+    resources.push_back(r);
+    return static_cast<rg_handle>(resources.size() - 1);
+}
+
+rg_handle render_graph::create_image(const std::string& name, const rg_image_desc& desc) {
+    resource r;
+    r.name = name;
+    r.image = true;
+    r.desc = desc;
+    resources.push_back(r);
+    return static_cast<rg_handle>(resources.size() - 1);
+}
+
+void render_graph::set_image(rg_handle handle, VkImage image) {
+    resources[handle].vk_image = image;
+}
+
+void render_graph::set_buffer(rg_handle handle, VkBuffer buffer) {
+    resources[handle].vk_buffer = buffer;
+}
+
+VkImage render_graph::image(rg_handle handle) const {
+    return resources[handle].vk_image;
+}
+
+VkImageView render_graph::image_view(rg_handle handle) const {
+    return resources[handle].view;
+}
+
+uint32_t render_graph::add_pass(const std::string& name, std::function<void(VkCommandBuffer)> record) {
+    passes.push_back({name, std::move(record), {}, false});
+    return static_cast<uint32_t>(passes.size() - 1);
+}
+
+void render_graph::use(uint32_t pass, rg_handle resource, rg_access access) {
+    passes[pass].usages.push_back({resource, access});
+}
+
+void render_graph::compile() {
+    cull_passes();
+    allocate_transients();
+    schedule_barriers();
+    compiled = true;
+}
+
+/**
+ * Walk the passes backwards: a pass survives if it writes something
+ * that an output or a surviving later pass needs, and then whatever
+ * it reads is needed as well.
+ */
+void render_graph::cull_passes() {
+    std::vector<bool> needed(resources.size());
+    for (size_t i = 0; i < resources.size(); i++) {
+        needed[i] = resources[i].output;
+    }
+    for (size_t i = passes.size(); i-- > 0;) {
+        pass& p = passes[i];
+        p.culled = true;
+        for (const auto& u : p.usages) {
+            if (describe(u.access).write && needed[u.resource]) {
+                p.culled = false;
+            }
+        }
+        if (p.culled) {
+            continue;
+        }
+        for (const auto& u : p.usages) {
+            // read-modify-write counts as a read as well
+            if (!describe(u.access).write || u.access == rg_access::storage_read_write) {
+                needed[u.resource] = true;
+            }
+        }
+    }
+}
+
+/**
+ * Transient images are placed into memory slots first-fit in the order
+ * of their first use; an image may move into a slot once the previous
+ * occupant's last pass is over, as long as the memory types agree.
+ */
+void render_graph::allocate_transients() {
+    for (uint32_t i = 0; i < passes.size(); i++) {
+        if (passes[i].culled) {
+            continue;
+        }
+        for (const auto& u : passes[i].usages) {
+            resource& r = resources[u.resource];
+            r.first_use = std::min(r.first_use, i);
+            r.last_use = std::max(r.last_use, i);
+        }
+    }
+
+    std::vector<rg_handle> order;
+    std::vector<VkMemoryRequirements> requirements(resources.size());
+    for (rg_handle h = 0; h < resources.size(); h++) {
+        resource& r = resources[h];
+        if (r.imported || !r.image || r.first_use == UINT32_MAX) {
+            continue; // imported, or only used by culled passes
+        }
+        VkImageCreateInfo create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        create_info.imageType = VK_IMAGE_TYPE_2D;
+        create_info.format = r.desc.format;
+        create_info.extent = {r.desc.extent.width, r.desc.extent.height, 1};
+        create_info.mipLevels = 1;
+        create_info.arrayLayers = 1;
+        create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        create_info.usage = r.desc.usage;
+        create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        if (vkCreateImage(device, &create_info, callbacks, &r.vk_image) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create a transient image for " + r.name + "!");
+        }
+        transients.images.push_back(r.vk_image);
+        vkGetImageMemoryRequirements(device, r.vk_image, &requirements[h]);
+        transient_bytes += requirements[h].size;
+        order.push_back(h);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](rg_handle a, rg_handle b) {
+        return resources[a].first_use < resources[b].first_use;
+    });
+
+    for (rg_handle h : order) {
+        resource& r = resources[h];
+        const VkMemoryRequirements& reqs = requirements[h];
+        for (size_t s = 0; s < slots.size() && r.memory_slot < 0; s++) {
+            memory_slot& slot = slots[s];
+            if (slot.free_after < r.first_use && (slot.requirements.memoryTypeBits & reqs.memoryTypeBits)) {
+                slot.requirements.size = std::max(slot.requirements.size, reqs.size);
+                slot.requirements.alignment = std::max(slot.requirements.alignment, reqs.alignment);
+                slot.requirements.memoryTypeBits &= reqs.memoryTypeBits;
+                r.alias_predecessor = slot.occupant;
+                slot.free_after = r.last_use;
+                slot.occupant = h;
+                r.memory_slot = static_cast<int32_t>(s);
+            }
+        }
+        if (r.memory_slot < 0) {
+            slots.push_back({reqs, r.last_use, h});
+            r.memory_slot = static_cast<int32_t>(slots.size() - 1);
+        }
+    }
+
+    std::vector<gpu_allocation> slot_allocations;
+    for (const auto& slot : slots) {
+        slot_allocations.push_back(allocator->allocate(slot.requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                       0, resource_kind::optimal));
+        allocated_bytes += slot.requirements.size;
+    }
+    transients.allocations = slot_allocations;
+    for (rg_handle h : order) {
+        resource& r = resources[h];
+        const gpu_allocation& allocation = slot_allocations[r.memory_slot];
+        vkBindImageMemory(device, r.vk_image, allocation.memory, allocation.offset);
+
+        VkImageViewCreateInfo view_info{};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = r.vk_image;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = r.desc.format;
+        view_info.subresourceRange.aspectMask = aspect_of(r.desc.format);
+        view_info.subresourceRange.levelCount = 1;
+        view_info.subresourceRange.layerCount = 1;
+        if (vkCreateImageView(device, &view_info, callbacks, &r.view) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create a transient image view for " + r.name + "!");
+        }
+        transients.views.push_back(r.view);
+    }
+}
+
+/**
+ * Simulate the frame pass by pass, tracking for every resource its
+ * layout, the last write and the stages that have read it since. A
+ * barrier is needed for a write after anything (WAW, WAR), for a
+ * layout change, and for a read by a stage the last write has not
+ * been made visible to yet (RAW); reads after reads are free.
+ */
+void render_graph::schedule_barriers() {
+    struct state {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags write_stage = 0;
+        VkAccessFlags write_access = 0;
+        VkPipelineStageFlags read_stages = 0;
+        VkAccessFlags visible_access = 0;
+    };
+    auto add_barrier = [](barrier_batch& batch, const barrier& b) {
+        batch.src_stages |= b.src_stage;
+        batch.dst_stages |= b.dst_stage;
+        batch.barriers.push_back(b);
+    };
+
+    // the transient memory is shared by all frames in flight, so the
+    // first image in a slot waits for the last one of the previous frame;
+    // the graph does the same every frame, so a first round over the
+    // passes finds out what that last image was left in
+    std::vector<state> states;
+    std::vector<state> previous_frame;
+    for (int round = 0; round < 2; round++) {
+        previous_frame = std::move(states);
+        states.assign(resources.size(), state{});
+        for (size_t i = 0; i < resources.size(); i++) {
+            // the previous user of an imported image counts as its last writer
+            if (resources[i].imported && resources[i].image) {
+                states[i].write_stage = resources[i].initial_stage;
+            }
+        }
+        batches.assign(passes.size() + 1, barrier_batch{});
+
+        for (uint32_t i = 0; i < passes.size(); i++) {
+            if (passes[i].culled) {
+                continue;
+            }
+            for (const auto& u : passes[i].usages) {
+                const resource& r = resources[u.resource];
+                state& s = states[u.resource];
+                if (i == r.first_use && r.memory_slot >= 0) {
+                    // the memory was last used by another image (or this one, a
+                    // frame ago), whose contents are discarded
+                    const state* previous = nullptr;
+                    if (r.alias_predecessor != UINT32_MAX) {
+                        previous = &states[r.alias_predecessor];
+                    } else if (round == 1) {
+                        previous = &previous_frame[slots[r.memory_slot].occupant];
+                    }
+                    if (previous) {
+                        s.write_stage = previous->write_stage | previous->read_stages;
+                        s.write_access = previous->write_access;
+                    }
+                }
+                access_info info = describe(u.access);
+                VkImageLayout layout = r.image ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+                bool layout_change = r.image && s.layout != layout;
+
+                if (info.write || layout_change) {
+                    VkPipelineStageFlags src_stage = s.write_stage | s.read_stages;
+                    if (src_stage != 0 || layout_change) {
+                        add_barrier(batches[i], {u.resource, src_stage ? src_stage : VkPipelineStageFlags(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT),
+                                                 info.stage, s.write_access, info.access, s.layout, layout});
+                    }
+                    s.write_stage = info.stage;
+                    s.write_access = info.write ? info.access : 0;
+                    s.read_stages = info.write ? 0 : info.stage;
+                    s.visible_access = info.write ? 0 : info.access;
+                    s.layout = layout;
+                } else {
+                    bool unsynchronized = s.write_stage != 0 && (info.stage & ~s.read_stages);
+                    bool invisible = s.write_access != 0 && (info.access & ~s.visible_access);
+                    if (unsynchronized || invisible) {
+                        add_barrier(batches[i], {u.resource, s.write_stage, info.stage,
+                                                 s.write_access, info.access, s.layout, s.layout});
+                    }
+                    s.read_stages |= info.stage;
+                    s.visible_access |= info.access;
+                }
+            }
+        }
+    }
+
+    // hand the outputs over in the layout the next user expects
+    for (rg_handle h = 0; h < resources.size(); h++) {
+        const resource& r = resources[h];
+        if (!r.imported || !r.image) {
+            continue;
+        }
+        const state& s = states[h];
+        VkPipelineStageFlags src_stage = s.write_stage | s.read_stages;
+        add_barrier(batches.back(), {h, src_stage ? src_stage : VkPipelineStageFlags(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT),
+                                     r.final_stage ? r.final_stage : VkPipelineStageFlags(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT),
+                                     s.write_access, r.final_access, s.layout, r.final_layout});
+    }
+}
+
+void render_graph::record_batch(VkCommandBuffer command_buffer, const barrier_batch& batch) {
+    if (batch.barriers.empty()) {
+        return;
+    }
+    if (synchronization2) {
+        record_batch2(command_buffer, batch);
+        return;
+    }
+    std::vector<VkImageMemoryBarrier> image_barriers;
+    std::vector<VkBufferMemoryBarrier> buffer_barriers;
+    for (const auto& b : batch.barriers) {
+        const resource& r = resources[b.resource];
+        if (r.image) {
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = b.src_access;
+            barrier.dstAccessMask = b.dst_access;
+            barrier.oldLayout = b.old_layout;
+            barrier.newLayout = b.new_layout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = r.vk_image;
+            barrier.subresourceRange.aspectMask = r.imported ? VkImageAspectFlags(VK_IMAGE_ASPECT_COLOR_BIT) : aspect_of(r.desc.format);
+            barrier.subresourceRange.levelCount = 1;
+            barrier.subresourceRange.layerCount = 1;
+            image_barriers.push_back(barrier);
+        } else {
+            VkBufferMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = b.src_access;
+            barrier.dstAccessMask = b.dst_access;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.buffer = r.vk_buffer;
+            barrier.offset = 0;
+            barrier.size = VK_WHOLE_SIZE;
+            buffer_barriers.push_back(barrier);
+        }
+    }
+    vkCmdPipelineBarrier(command_buffer, batch.src_stages, batch.dst_stages, 0, 0, nullptr,
+                         static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
+                         static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+}
+
+// the same barriers, but each with its own stages instead of the union
+// of the batch, so e.g. a transfer waiting on the color attachment
+// output does not also wait on the compute shader; the legacy stage and
+// access bits have the same values in the *2 flags
+void render_graph::record_batch2(VkCommandBuffer command_buffer, const barrier_batch& batch) {
+    std::vector<VkImageMemoryBarrier2> image_barriers;
+    std::vector<VkBufferMemoryBarrier2> buffer_barriers;
+    for (const auto& b : batch.barriers) {
+        const resource& r = resources[b.resource];
+        if (r.image) {
+            VkImageMemoryBarrier2 barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+            barrier.srcStageMask = b.src_stage;
+            barrier.srcAccessMask = b.src_access;
+            barrier.dstStageMask = b.dst_stage;
+            barrier.dstAccessMask = b.dst_access;
+            barrier.oldLayout = b.old_layout;
+            barrier.newLayout = b.new_layout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = r.vk_image;
+            barrier.subresourceRange.aspectMask = r.imported ? VkImageAspectFlags(VK_IMAGE_ASPECT_COLOR_BIT) : aspect_of(r.desc.format);
+            barrier.subresourceRange.levelCount = 1;
+            barrier.subresourceRange.layerCount = 1;
+            image_barriers.push_back(barrier);
+        } else {
+            VkBufferMemoryBarrier2 barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+            barrier.srcStageMask = b.src_stage;
+            barrier.srcAccessMask = b.src_access;
+            barrier.dstStageMask = b.dst_stage;
+            barrier.dstAccessMask = b.dst_access;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.buffer = r.vk_buffer;
+            barrier.offset = 0;
+            barrier.size = VK_WHOLE_SIZE;
+            buffer_barriers.push_back(barrier);
+        }
+    }
+    VkDependencyInfo dependency_info{};
+    dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency_info.bufferMemoryBarrierCount = static_cast<uint32_t>(buffer_barriers.size());
+    dependency_info.pBufferMemoryBarriers = buffer_barriers.data();
+    dependency_info.imageMemoryBarrierCount = static_cast<uint32_t>(image_barriers.size());
+    dependency_info.pImageMemoryBarriers = image_barriers.data();
+    vkCmdPipelineBarrier2(command_buffer, &dependency_info);
+}
+
+void render_graph::execute(VkCommandBuffer command_buffer) {
+    if (!compiled) {
+        compile();
+    }
+    for (size_t i = 0; i < passes.size(); i++) {
+        if (passes[i].culled) {
+            continue;
+        }
+        record_batch(command_buffer, batches[i]);
+        passes[i].record(command_buffer);
+    }
+    record_batch(command_buffer, batches.back());
+}
+
+void render_graph::print_summary(std::ostream& out) const {
+    size_t barrier_count = 0, batch_count = 0;
+    for (const auto& batch : batches) {
+        barrier_count += batch.barriers.size();
+        batch_count += batch.barriers.empty() ? 0 : 1;
+    }
+    out << "render graph:";
+    for (const auto& p : passes) {
+        out << ' ' << p.name << (p.culled ? " (culled)" : "");
+    }
+    out << "; " << barrier_count << " barriers in " << batch_count << " batches";
+    if (transient_bytes > 0) {
+        out << "; transient images " << (transient_bytes >> 10) << " KiB in "
+            << (allocated_bytes >> 10) << " KiB after aliasing";
+    }
+    out << std::endl;
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <gpu_allocator.hpp>
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <ostream>
+#include <cstdint>
+
+/**
+ * A frame as a list of passes that declare which resources they read
+ * and write, instead of hand-written pipeline barriers. compile()
+ *  - culls passes whose results never reach an output,
+ *  - creates the transient images, letting images whose lifetimes do
+ *    not overlap share the same memory (one set for all frames in
+ *    flight, the first image in a slot waits for the previous frame),
+ *  - works out the barriers and layout transitions in front of each
+ *    pass, one vkCmdPipelineBarrier (or vkCmdPipelineBarrier2 with
+ *    synchronization2) per pass boundary.
+ * The result depends only on the structure of the graph, so it is
+ * compiled once and executed every frame; imported resources (e.g.
+ * the swap chain image) are rebound with set_image()/set_buffer().
+ */
+
+using rg_handle = uint32_t;
+
+// how a pass uses a resource
+enum class rg_access {
+    color_attachment_write,
+    sampled_read,          // fragment shader
+    storage_read,          // compute shader
+    storage_write,         // compute shader
+    storage_read_write,    // compute shader
+    transfer_read,
+    transfer_write,
+    indirect_read,
+    vertex_read,           // vertex or index buffer
+};
+
+struct rg_image_desc {
+    VkFormat format;
+    VkExtent2D extent;
+    VkImageUsageFlags usage;
+};
+
+class render_graph
+{
+public:
+    void init(VkDevice device, const VkAllocationCallbacks* callbacks, gpu_allocator* allocator,
+              uint32_t frames_in_flight, bool synchronization2 = false);
+    void destroy();
+    // call once the frame's fence has been waited on
+    void begin_frame(uint64_t frame_number);
+    // drop all passes and resources; transient images are destroyed
+    // once the frames that might still use them have retired
+    void reset();
+
+    // `initial_stage` is where the previous user of the image (e.g. the
+    // acquire semaphore wait) is synchronized with; the image ends the
+    // frame in `final_layout`, visible to `final_stage`/`final_access`
+    rg_handle import_image(const std::string& name, VkPipelineStageFlags initial_stage,
+                           VkImageLayout final_layout, VkPipelineStageFlags final_stage,
+                           VkAccessFlags final_access);
+    // buffers are not synchronized across frames, callers give each frame
+    // in flight its own buffer (see indirect_buffers[current_frame])
+    rg_handle import_buffer(const std::string& name, bool output = false);
+    rg_handle create_image(const std::string& name, const rg_image_desc& desc);
+    void set_image(rg_handle handle, VkImage image);
+    void set_buffer(rg_handle handle, VkBuffer buffer);
+    VkImage image(rg_handle handle) const;
+    VkImageView image_view(rg_handle handle) const; // transient images only
+
+    uint32_t add_pass(const std::string& name, std::function<void(VkCommandBuffer)> record);
+    void use(uint32_t pass, rg_handle resource, rg_access access);
+
+    void compile();
+    void execute(VkCommandBuffer command_buffer);
+    void print_summary(std::ostream& out) const;
+
+private:
+    struct usage {
+        rg_handle resource;
+        rg_access access;
+    };
+
+    struct pass {
+        std::string name;
+        std::function<void(VkCommandBuffer)> record;
+        std::vector<usage> usages;
+        bool culled = false;
+    };
+
+    struct resource {
+        std::string name;
+        bool image = false;
+        bool imported = false;
+        bool output = false;
+        rg_image_desc desc{};
+        VkImage vk_image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkBuffer vk_buffer = VK_NULL_HANDLE;
+        VkPipelineStageFlags initial_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        VkAccessFlags initial_access = 0;
+        VkImageLayout final_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags final_stage = 0;
+        VkAccessFlags final_access = 0;
+        // first and last pass that uses the resource, after culling
+        uint32_t first_use = UINT32_MAX;
+        uint32_t last_use = 0;
+        int32_t memory_slot = -1;
+        // the transient image that used the same memory before this one
+        uint32_t alias_predecessor = UINT32_MAX;
+    };
+
+    struct barrier {
+        rg_handle resource;
+        VkPipelineStageFlags src_stage;
+        VkPipelineStageFlags dst_stage;
+        VkAccessFlags src_access;
+        VkAccessFlags dst_access;
+        VkImageLayout old_layout;
+        VkImageLayout new_layout;
+    };
+
+    // all barriers in front of one pass (or after the last one)
+    struct barrier_batch {
+        VkPipelineStageFlags src_stages = 0;
+        VkPipelineStageFlags dst_stages = 0;
+        std::vector<barrier> barriers;
+    };
+
+    struct memory_slot {
+        VkMemoryRequirements requirements{};
+        uint32_t free_after = 0;   // last pass of the current occupant
+        rg_handle occupant = 0;
+    };
+
+    struct transient_set {
+        std::vector<VkImage> images;
+        std::vector<VkImageView> views;
+        std::vector<gpu_allocation> allocations;
+        uint64_t retired_at = 0;
+    };
+
+    void cull_passes();
+    void allocate_transients();
+    void schedule_barriers();
+    void record_batch(VkCommandBuffer command_buffer, const barrier_batch& batch);
+    void record_batch2(VkCommandBuffer command_buffer, const barrier_batch& batch);
+    void destroy_transients(transient_set& set);
+
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks* callbacks = nullptr;
+    gpu_allocator* allocator = nullptr;
+    uint32_t frames_in_flight = 0;
+    bool synchronization2 = false;
+    uint64_t frame_number = 0;
+
+    std::vector<pass> passes;
+    std::vector<resource> resources;
+    std::vector<barrier_batch> batches; // one per pass, plus the final transitions
+    std::vector<memory_slot> slots;
+    transient_set transients;
+    std::vector<transient_set> retired;
+    bool compiled = false;
+
+    VkDeviceSize transient_bytes = 0;  // sum of the requirements of all transient images
+    VkDeviceSize allocated_bytes = 0;  // what they actually occupy after aliasing
+};
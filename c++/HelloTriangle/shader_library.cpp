@@ -0,0 +1,479 @@
+#include <shader_library.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace spirv {
+// the few parts of the SPIR-V specification reflection needs
+constexpr uint32_t magic = 0x07230203;
+constexpr uint32_t header_words = 5;
+
+enum op : uint32_t {
+    op_entry_point = 15,
+    op_type_int = 21,
+    op_type_float = 22,
+    op_type_vector = 23,
+    op_type_matrix = 24,
+    op_type_image = 25,
+    op_type_sampler = 26,
+    op_type_sampled_image = 27,
+    op_type_array = 28,
+    op_type_runtime_array = 29,
+    op_type_struct = 30,
+    op_type_pointer = 32,
+    op_constant = 43,
+    op_variable = 59,
+    op_decorate = 71,
+    op_member_decorate = 72,
+};
+
+enum decoration : uint32_t {
+    decoration_block = 2,
+    decoration_buffer_block = 3,
+    decoration_array_stride = 6,
+    decoration_matrix_stride = 7,
+    decoration_non_writable = 24,
+    decoration_binding = 33,
+    decoration_descriptor_set = 34,
+    decoration_offset = 35,
+};
+
+enum storage_class : uint32_t {
+    storage_uniform_constant = 0,
+    storage_uniform = 2,
+    storage_push_constant = 9,
+    storage_storage_buffer = 12,
+};
+
+enum dim : uint32_t {
+    dim_buffer = 5,
+    dim_subpass_data = 6,
+};
+} // namespace spirv
+
+namespace {
+
+VkShaderStageFlagBits stage_of(uint32_t execution_model) {
+    switch (execution_model) {
+    case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+    case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+    case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+    case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+    case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+    default:
+        throw std::runtime_error("unsupported SPIR-V execution model!");
+    }
+}
+
+// everything reflection needs to know about one result id
+struct spirv_id {
+    uint32_t opcode = 0;
+    std::vector<uint32_t> operands; // without the result id
+    uint32_t set = UINT32_MAX;
+    uint32_t binding = UINT32_MAX;
+    uint32_t array_stride = 0;
+    bool block = false;
+    bool buffer_block = false;
+    bool non_writable = false;
+    uint32_t non_writable_members = 0;
+    std::vector<uint32_t> member_offsets;
+    std::vector<uint32_t> member_matrix_strides;
+};
+
+class spirv_reflector {
+public:
+    explicit spirv_reflector(std::vector<spirv_id>& ids) : ids(ids) {}
+
+    uint32_t size_of(uint32_t type, uint32_t matrix_stride = 0) const {
+        const spirv_id& t = ids[type];
+        switch (t.opcode) {
+        case spirv::op_type_int:
+        case spirv::op_type_float:
+            return t.operands[0] / 8;
+        case spirv::op_type_vector:
+            return size_of(t.operands[0]) * t.operands[1];
+        case spirv::op_type_matrix:
+            return (matrix_stride ? matrix_stride : size_of(t.operands[0])) * t.operands[1];
+        case spirv::op_type_array: {
+            uint32_t stride = t.array_stride ? t.array_stride : size_of(t.operands[0]);
+            return stride * constant(t.operands[1]);
+        }
+        case spirv::op_type_struct: {
+            uint32_t size = 0;
+            for (size_t m = 0; m < t.operands.size(); m++) {
+                uint32_t offset = m < t.member_offsets.size() ? t.member_offsets[m] : 0;
+                uint32_t stride = m < t.member_matrix_strides.size() ? t.member_matrix_strides[m] : 0;
+                size = std::max(size, offset + size_of(t.operands[m], stride));
+            }
+            return size;
+        }
+        default:
+            return 0; // runtime arrays and opaque types take no push constant space
+        }
+    }
+
+    uint32_t constant(uint32_t id) const {
+        const spirv_id& c = ids[id];
+        if (c.opcode != spirv::op_constant || c.operands.size() < 2) {
+            throw std::runtime_error("unsupported SPIR-V array length!");
+        }
+        return c.operands[1]; // [result type, value]
+    }
+
+    // strips arrays off `type`, multiplying their lengths into `count`
+    uint32_t element_type(uint32_t type, uint32_t& count) const {
+        count = 1;
+        while (ids[type].opcode == spirv::op_type_array || ids[type].opcode == spirv::op_type_runtime_array) {
+            if (ids[type].opcode == spirv::op_type_array) {
+                count *= constant(ids[type].operands[1]);
+            }
+            type = ids[type].operands[0];
+        }
+        return type;
+    }
+
+    VkDescriptorType descriptor_type(uint32_t type, uint32_t storage_class) const {
+        const spirv_id& t = ids[type];
+        switch (t.opcode) {
+        case spirv::op_type_sampler:
+            return VK_DESCRIPTOR_TYPE_SAMPLER;
+        case spirv::op_type_sampled_image:
+            return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        case spirv::op_type_image: {
+            // [sampled type, dim, depth, arrayed, ms, sampled, format]
+            uint32_t dim = t.operands[1];
+            bool storage = t.operands[5] == 2;
+            if (dim == spirv::dim_buffer) {
+                return storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+            }
+            if (dim == spirv::dim_subpass_data) {
+                return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+            }
+            return storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        }
+        case spirv::op_type_struct:
+            if (storage_class == spirv::storage_storage_buffer || t.buffer_block) {
+                return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            }
+            return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        default:
+            throw std::runtime_error("unsupported SPIR-V descriptor type!");
+        }
+    }
+
+    // GLSL `readonly` ends up on the variable for images and on every
+    // member of the block for buffers
+    bool is_read_only(const spirv_id& variable, uint32_t type, VkDescriptorType descriptor_type) const {
+        switch (descriptor_type) {
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+        case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+        case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+            return variable.non_writable ||
+                   (ids[type].opcode == spirv::op_type_struct &&
+                    ids[type].non_writable_members == ids[type].operands.size());
+        default:
+            return true;
+        }
+    }
+
+private:
+    std::vector<spirv_id>& ids;
+};
+
+} // namespace
+
+/**
+ * A single pass over the instructions collects the types, constants,
+ * decorations and variables by result id; SPIR-V declares them all
+ * before the function bodies, which are skipped.
+ */
+shader_reflection reflect_spirv(const uint32_t* code, size_t word_count) {
+    if (word_count < spirv::header_words || code[0] != spirv::magic) {
+        throw std::runtime_error("not a SPIR-V module!");
+    }
+    uint32_t bound = code[3];
+    std::vector<spirv_id> ids(bound);
+    std::vector<uint32_t> variables;
+    shader_reflection reflection;
+    bool has_entry_point = false;
+
+    auto id_at = [&](uint32_t id) -> spirv_id& {
+        if (id >= bound) {
+            throw std::runtime_error("malformed SPIR-V module!");
+        }
+        return ids[id];
+    };
+
+    for (size_t i = spirv::header_words; i < word_count;) {
+        uint32_t opcode = code[i] & 0xffff;
+        uint32_t length = code[i] >> 16;
+        if (length == 0 || i + length > word_count) {
+            throw std::runtime_error("malformed SPIR-V module!");
+        }
+        const uint32_t* operands = code + i + 1;
+        switch (opcode) {
+        case spirv::op_entry_point:
+            if (!has_entry_point) {
+                reflection.stage = stage_of(operands[0]);
+                has_entry_point = true;
+            }
+            break;
+        case spirv::op_decorate: {
+            spirv_id& target = id_at(operands[0]);
+            switch (operands[1]) {
+            case spirv::decoration_descriptor_set: target.set = operands[2]; break;
+            case spirv::decoration_binding: target.binding = operands[2]; break;
+            case spirv::decoration_array_stride: target.array_stride = operands[2]; break;
+            case spirv::decoration_block: target.block = true; break;
+            case spirv::decoration_buffer_block: target.buffer_block = true; break;
+            case spirv::decoration_non_writable: target.non_writable = true; break;
+            }
+            break;
+        }
+        case spirv::op_member_decorate: {
+            spirv_id& target = id_at(operands[0]);
+            uint32_t member = operands[1];
+            if (operands[2] == spirv::decoration_offset) {
+                target.member_offsets.resize(std::max<size_t>(target.member_offsets.size(), member + 1));
+                target.member_offsets[member] = operands[3];
+            } else if (operands[2] == spirv::decoration_matrix_stride) {
+                target.member_matrix_strides.resize(std::max<size_t>(target.member_matrix_strides.size(), member + 1));
+                target.member_matrix_strides[member] = operands[3];
+            } else if (operands[2] == spirv::decoration_non_writable) {
+                target.non_writable_members++;
+            }
+            break;
+        }
+        case spirv::op_type_int:
+        case spirv::op_type_float:
+        case spirv::op_type_vector:
+        case spirv::op_type_matrix:
+        case spirv::op_type_image:
+        case spirv::op_type_sampler:
+        case spirv::op_type_sampled_image:
+        case spirv::op_type_array:
+        case spirv::op_type_runtime_array:
+        case spirv::op_type_struct:
+        case spirv::op_type_pointer: {
+            spirv_id& result = id_at(operands[0]);
+            result.opcode = opcode;
+            result.operands.assign(operands + 1, operands + length - 1);
+            break;
+        }
+        case spirv::op_constant:
+        case spirv::op_variable: {
+            // these have the result type first
+            spirv_id& result = id_at(operands[1]);
+            result.opcode = opcode;
+            result.operands.assign({operands[0]});
+            result.operands.insert(result.operands.end(), operands + 2, operands + length - 1);
+            if (opcode == spirv::op_variable) {
+                variables.push_back(operands[1]);
+            }
+            break;
+        }
+        }
+        i += length;
+    }
+    if (!has_entry_point) {
+        throw std::runtime_error("SPIR-V module without an entry point!");
+    }
+
+    spirv_reflector reflector(ids);
+    for (uint32_t id : variables) {
+        const spirv_id& variable = ids[id];
+        uint32_t storage_class = variable.operands[1]; // [result type, storage class]
+        const spirv_id& pointer = id_at(variable.operands[0]);
+        uint32_t pointee = pointer.operands[1];        // [storage class, type]
+        if (storage_class == spirv::storage_push_constant) {
+            reflection.push_constant_size = std::max(reflection.push_constant_size, reflector.size_of(pointee));
+            continue;
+        }
+        if (storage_class != spirv::storage_uniform_constant && storage_class != spirv::storage_uniform &&
+            storage_class != spirv::storage_storage_buffer) {
+            continue; // inputs, outputs, workgroup memory
+        }
+        if (variable.set == UINT32_MAX || variable.binding == UINT32_MAX) {
+            continue;
+        }
+        uint32_t count;
+        uint32_t type = reflector.element_type(pointee, count);
+        VkDescriptorType descriptor_type = reflector.descriptor_type(type, storage_class);
+        reflection.bindings.push_back({variable.set, variable.binding, descriptor_type, count,
+                                       static_cast<VkShaderStageFlags>(reflection.stage),
+                                       reflector.is_read_only(variable, type, descriptor_type)});
+    }
+    std::sort(reflection.bindings.begin(), reflection.bindings.end(),
+              [](const reflected_binding& a, const reflected_binding& b) {
+                  return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+              });
+    return reflection;
+}
+
+void shader_library::init(VkDevice device, const VkAllocationCallbacks* callbacks) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->device = device;
+    this->callbacks = callbacks;
+}
+
+void shader_library::destroy() {
+    for (auto layout : pipeline_layouts) {
+        vkDestroyPipelineLayout(device, layout, callbacks);
+    }
+    for (const auto& entry : set_layouts) {
+        vkDestroyDescriptorSetLayout(device, entry.layout, callbacks);
+    }
+    for (const auto& [hash, module] : modules) {
+        vkDestroyShaderModule(device, module.module, callbacks);
+    }
+    pipeline_layouts.clear();
+    set_layouts.clear();
+    modules.clear();
+    prefetched.clear();
+}
+
+shader_library::loaded_file shader_library::read(const std::string& path) {
+    loaded_file loaded;
+    loaded.file = mapped_file(path);
+    if (loaded.file.size() % sizeof(uint32_t) != 0) {
+        throw std::runtime_error(path + " is not a SPIR-V module!");
+    }
+    // mmap is page-aligned, so the words can be read in place
+    const uint32_t* code = static_cast<const uint32_t*>(loaded.file.data());
+    size_t word_count = loaded.file.size() / sizeof(uint32_t);
+
+    // FNV-1a, one word at a time
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < word_count; i++) {
+        hash = (hash ^ code[i]) * 1099511628211ull;
+    }
+    loaded.hash = hash;
+    try {
+        loaded.reflection = reflect_spirv(code, word_count);
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error(path + ": " + e.what());
+    }
+    return loaded;
+}
+
+void shader_library::prefetch(const std::string& path) {
+    loaded_file loaded = read(path);
+    std::lock_guard<std::mutex> lock(mutex);
+    prefetched.emplace(path, std::move(loaded));
+}
+
+const shader& shader_library::load(const std::string& path) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto found_file = prefetched.find(path);
+    loaded_file loaded;
+    if (found_file != prefetched.end()) {
+        loaded = std::move(found_file->second);
+        prefetched.erase(found_file);
+    } else {
+        // reading does not touch the library, let other threads in meanwhile
+        lock.unlock();
+        loaded = read(path);
+        lock.lock();
+    }
+
+    auto found = modules.find(loaded.hash);
+    if (found != modules.end()) {
+        duplicates++;
+        return found->second;
+    }
+    shader result;
+    result.hash = loaded.hash;
+    result.reflection = std::move(loaded.reflection);
+    VkShaderModuleCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    create_info.codeSize = loaded.file.size();
+    create_info.pCode = static_cast<const uint32_t*>(loaded.file.data());
+    if (vkCreateShaderModule(device, &create_info, callbacks, &result.module) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create a shader module for " + path + "!");
+    }
+    return modules.emplace(loaded.hash, result).first->second;
+}
+
+VkDescriptorSetLayout shader_library::get_set_layout(const std::vector<VkDescriptorSetLayoutBinding>& bindings) {
+    auto same = [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+        return a.binding == b.binding && a.descriptorType == b.descriptorType &&
+               a.descriptorCount == b.descriptorCount && a.stageFlags == b.stageFlags;
+    };
+    for (const auto& entry : set_layouts) {
+        if (std::equal(entry.bindings.begin(), entry.bindings.end(), bindings.begin(), bindings.end(), same)) {
+            return entry.layout;
+        }
+    }
+    VkDescriptorSetLayoutCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    create_info.bindingCount = static_cast<uint32_t>(bindings.size());
+    create_info.pBindings = bindings.data();
+    VkDescriptorSetLayout layout;
+    if (vkCreateDescriptorSetLayout(device, &create_info, callbacks, &layout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create a reflected descriptor set layout!");
+    }
+    set_layouts.push_back({bindings, layout});
+    return layout;
+}
+
+reflected_layout shader_library::create_pipeline_layout(const std::vector<const shader*>& shaders,
+                                                        const std::map<uint32_t, VkDescriptorSetLayout>& external) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // merge the bindings of all stages, by set and binding number
+    std::map<uint32_t, std::map<uint32_t, VkDescriptorSetLayoutBinding>> sets;
+    VkPushConstantRange push_constants{};
+    for (const shader* s : shaders) {
+        for (const auto& b : s->reflection.bindings) {
+            auto& binding = sets[b.set][b.binding];
+            if (binding.stageFlags != 0 && (binding.descriptorType != b.type || binding.descriptorCount != b.count)) {
+                throw std::runtime_error("shader stages disagree on set " + std::to_string(b.set) +
+                                         " binding " + std::to_string(b.binding) + "!");
+            }
+            binding.binding = b.binding;
+            binding.descriptorType = b.type;
+            binding.descriptorCount = b.count;
+            binding.stageFlags |= b.stages;
+        }
+        if (s->reflection.push_constant_size > 0) {
+            push_constants.stageFlags |= s->reflection.stage;
+            push_constants.size = std::max(push_constants.size, s->reflection.push_constant_size);
+        }
+    }
+
+    uint32_t set_count = 0;
+    if (!sets.empty()) {
+        set_count = sets.rbegin()->first + 1;
+    }
+    if (!external.empty()) {
+        set_count = std::max(set_count, external.rbegin()->first + 1);
+    }
+    reflected_layout result;
+    for (uint32_t set = 0; set < set_count; set++) {
+        auto supplied = external.find(set);
+        if (supplied != external.end()) {
+            result.set_layouts.push_back(supplied->second);
+            continue;
+        }
+        // unused sets in between get an empty layout
+        std::vector<VkDescriptorSetLayoutBinding> bindings;
+        for (const auto& [number, binding] : sets[set]) {
+            bindings.push_back(binding);
+        }
+        result.set_layouts.push_back(get_set_layout(bindings));
+    }
+
+    VkPipelineLayoutCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    create_info.setLayoutCount = set_count;
+    create_info.pSetLayouts = result.set_layouts.data();
+    if (push_constants.size > 0) {
+        create_info.pushConstantRangeCount = 1;
+        create_info.pPushConstantRanges = &push_constants;
+    }
+    if (vkCreatePipelineLayout(device, &create_info, callbacks, &result.layout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create a reflected pipeline layout!");
+    }
+    pipeline_layouts.push_back(result.layout);
+    return result;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <mapped_file.hpp>
+
+#include <vector>
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+
+// one descriptor binding as declared by a shader
+struct reflected_binding {
+    uint32_t set;
+    uint32_t binding;
+    VkDescriptorType type;
+    uint32_t count;          // 1 for runtime-sized arrays
+    VkShaderStageFlags stages;
+    bool read_only;          // never written by the shader
+};
+
+struct shader_reflection {
+    VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+    std::vector<reflected_binding> bindings;
+    uint32_t push_constant_size = 0;
+};
+
+struct shader {
+    VkShaderModule module = VK_NULL_HANDLE;
+    uint64_t hash = 0;       // of the SPIR-V words
+    shader_reflection reflection;
+};
+
+struct reflected_layout {
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    // indexed by set number, including sets supplied by the caller
+    std::vector<VkDescriptorSetLayout> set_layouts;
+};
+
+/**
+ * Shader modules loaded from the .spv files produced by the build.
+ *  - the files are memory-mapped and handed to the driver in place,
+ *  - modules are keyed by the hash of their SPIR-V, so the same
+ *    code loaded twice (e.g. a fragment shader shared by several
+ *    pipelines) is created once,
+ *  - the descriptor bindings and push constants of every module are
+ *    reflected from the SPIR-V, and create_pipeline_layout() builds the
+ *    descriptor set and pipeline layouts from them; set layouts with
+ *    identical bindings are shared as well.
+ * Modules and layouts live until destroy(). All functions may be
+ * called from several threads at once, e.g. while pipelines are
+ * compiled in parallel during startup.
+ */
+class shader_library
+{
+public:
+    void init(VkDevice device, const VkAllocationCallbacks* callbacks);
+    void destroy();
+
+    // maps, hashes and reflects the file ahead of load(); needs no
+    // device, so it can overlap with instance and device creation
+    void prefetch(const std::string& path);
+    const shader& load(const std::string& path);
+    // `external` replaces the reflected layout of a set, e.g. for the
+    // bindless set, whose flags and sizes cannot be derived from SPIR-V
+    reflected_layout create_pipeline_layout(const std::vector<const shader*>& shaders,
+                                            const std::map<uint32_t, VkDescriptorSetLayout>& external = {});
+
+    size_t module_count() const { return modules.size(); }
+    size_t duplicate_loads() const { return duplicates; }
+
+private:
+    struct loaded_file {
+        mapped_file file;
+        uint64_t hash = 0;
+        shader_reflection reflection;
+    };
+
+    struct set_layout_entry {
+        std::vector<VkDescriptorSetLayoutBinding> bindings;
+        VkDescriptorSetLayout layout;
+    };
+
+    static loaded_file read(const std::string& path);
+    VkDescriptorSetLayout get_set_layout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks* callbacks = nullptr;
+    std::mutex mutex;
+    std::unordered_map<std::string, loaded_file> prefetched;
+    std::unordered_map<uint64_t, shader> modules;
+    std::vector<set_layout_entry> set_layouts;
+    std::vector<VkPipelineLayout> pipeline_layouts;
+    size_t duplicates = 0;
+};
+
+// parses the SPIR-V words, throws on malformed input
+shader_reflection reflect_spirv(const uint32_t* code, size_t word_count);
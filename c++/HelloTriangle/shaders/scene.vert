@@ -0,0 +1,21 @@
+#version 450
+
+// scene_camera, see vulkan_app.hpp
+layout(push_constant) uniform camera_constants {
+    vec2 center;
+    float zoom;
+    float padding; // the push constant range is reflected from this block
+} camera;
+
+layout(location = 0) in vec2 in_position;
+layout(location = 1) in vec3 in_color;
+// per instance: position.xy, scale, radius
+layout(location = 2) in vec4 in_object;
+
+layout(location = 0) out vec3 frag_color;
+
+void main() {
+    vec2 world = in_position * in_object.z + in_object.xy;
+    gl_Position = vec4((world - camera.center) * camera.zoom, 0.0, 1.0);
+    frag_color = in_color;
+}
@@ -0,0 +1,19 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// the bindless set of descriptor_manager
+layout(set = 0, binding = 0) uniform sampler2D textures[];
+
+layout(location = 0) in vec4 frag_color;
+layout(location = 1) in vec2 frag_uv;
+layout(location = 2) flat in uint frag_texture;
+
+layout(location = 0) out vec4 out_color;
+
+void main() {
+    out_color = frag_color;
+    // 0xffffffff: an untextured sprite
+    if (frag_texture != 0xffffffffu) {
+        out_color *= texture(textures[nonuniformEXT(frag_texture)], frag_uv);
+    }
+}
@@ -0,0 +1,25 @@
+#version 450
+
+// per instance, see sprite_instance in sprite_renderer.hpp
+layout(location = 0) in vec4 in_rect; // center.xy, half size.xy
+layout(location = 1) in vec4 in_uv;   // u0, v0, u1, v1
+layout(location = 2) in uint in_color;
+layout(location = 3) in uint in_texture;
+
+layout(location = 0) out vec4 frag_color;
+layout(location = 1) out vec2 frag_uv;
+layout(location = 2) flat out uint frag_texture;
+
+// two clockwise triangles, like the rest of the app's geometry
+const vec2 corners[6] = vec2[](
+    vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+    vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0)
+);
+
+void main() {
+    vec2 corner = corners[gl_VertexIndex];
+    gl_Position = vec4(in_rect.xy + corner * in_rect.zw, 0.0, 1.0);
+    frag_uv = mix(in_uv.xy, in_uv.zw, corner * 0.5 + 0.5);
+    frag_color = unpackUnorm4x8(in_color);
+    frag_texture = in_texture;
+}
@@ -0,0 +1,17 @@
+#version 450
+
+// one draw_item of the draw list, see vulkan_app.hpp
+layout(push_constant) uniform draw_constants {
+    vec2 offset;
+    float scale;
+} draw;
+
+layout(location = 0) in vec2 in_position;
+layout(location = 1) in vec3 in_color;
+
+layout(location = 0) out vec3 frag_color;
+
+void main() {
+    gl_Position = vec4(in_position * draw.scale + draw.offset, 0.0, 1.0);
+    frag_color = in_color;
+}
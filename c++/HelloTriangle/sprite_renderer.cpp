@@ -0,0 +1,256 @@
+#include <sprite_renderer.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+void radix_sort(const std::vector<uint32_t>& keys, std::vector<uint32_t>& order, std::vector<uint32_t>& scratch) {
+    const size_t count = keys.size();
+    order.resize(count);
+    scratch.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        order[i] = static_cast<uint32_t>(i);
+    }
+
+    // all four histograms in a single pass over the keys
+    uint32_t histograms[4][256] = {};
+    for (uint32_t key : keys) {
+        for (int pass = 0; pass < 4; pass++) {
+            histograms[pass][(key >> (pass * 8)) & 0xff]++;
+        }
+    }
+
+    for (int pass = 0; pass < 4; pass++) {
+        uint32_t* histogram = histograms[pass];
+        const int shift = pass * 8;
+        if (count == 0 || histogram[(keys[0] >> shift) & 0xff] == count) {
+            continue;
+        }
+        uint32_t offset = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            uint32_t n = histogram[digit];
+            histogram[digit] = offset;
+            offset += n;
+        }
+        for (uint32_t index : order) {
+            scratch[histogram[(keys[index] >> shift) & 0xff]++] = index;
+        }
+        order.swap(scratch);
+    }
+}
+
+// layer (8 bits), blend mode (1 bit), texture (23 bits, the bindless
+// set is far smaller than that; no texture sorts last)
+uint32_t sprite_batch::key_of(const sprite& s) {
+    return uint32_t(s.layer) << 24 | uint32_t(s.blend) << 23 | std::min<uint32_t>(s.texture, 0x7fffff);
+}
+
+uint32_t sprite_batch::add(const sprite& s) {
+    auto index = static_cast<uint32_t>(keys.size());
+    center_x.push_back(s.center[0]);
+    center_y.push_back(s.center[1]);
+    half_width.push_back(s.half_size[0]);
+    half_height.push_back(s.half_size[1]);
+    uvs.insert(uvs.end(), s.uv, s.uv + 4);
+    colors.push_back(s.color);
+    textures.push_back(s.texture);
+    keys.push_back(key_of(s));
+    dirty = true;
+    keys_dirty = true;
+    return index;
+}
+
+void sprite_batch::set_center(uint32_t index, float x, float y) {
+    center_x[index] = x;
+    center_y[index] = y;
+    dirty = true;
+}
+
+void sprite_batch::set_color(uint32_t index, uint32_t color) {
+    colors[index] = color;
+    dirty = true;
+}
+
+void sprite_batch::set_texture(uint32_t index, uint32_t texture) {
+    textures[index] = texture;
+    keys[index] = (keys[index] & ~0x7fffffu) | std::min<uint32_t>(texture, 0x7fffff);
+    dirty = true;
+    keys_dirty = true;
+}
+
+void sprite_batch::clear() {
+    center_x.clear();
+    center_y.clear();
+    half_width.clear();
+    half_height.clear();
+    uvs.clear();
+    colors.clear();
+    textures.clear();
+    keys.clear();
+    dirty = true;
+    keys_dirty = true;
+}
+
+void sprite_batch::build(sprite_instance* out, std::vector<sprite_draw>& draws) {
+    if (keys_dirty) {
+        radix_sort(keys, order, scratch);
+        keys_dirty = false;
+    }
+    draws.clear();
+    for (uint32_t i = 0; i < order.size(); i++) {
+        uint32_t index = order[i];
+        sprite_instance& instance = out[i];
+        instance.rect[0] = center_x[index];
+        instance.rect[1] = center_y[index];
+        instance.rect[2] = half_width[index];
+        instance.rect[3] = half_height[index];
+        std::copy(&uvs[index * 4], &uvs[index * 4] + 4, instance.uv);
+        instance.color = colors[index];
+        instance.texture = textures[index];
+
+        auto blend = static_cast<sprite_blend>((keys[index] >> 23) & 1);
+        if (draws.empty() || draws.back().blend != blend) {
+            draws.push_back({blend, i, 0});
+        }
+        draws.back().count++;
+    }
+    dirty = false;
+}
+
+void sprite_renderer::init(gpu_allocator* allocator, upload_manager* uploads, uint32_t frames_in_flight) {
+    this->allocator = allocator;
+    this->uploads = uploads;
+    this->frames_in_flight = frames_in_flight;
+    frame_buffers.resize(frames_in_flight);
+}
+
+void sprite_renderer::destroy() {
+    for (auto& buffer : frame_buffers) {
+        retire(buffer);
+    }
+    for (auto& batch : retained) {
+        retire(batch->current);
+        retire(batch->pending);
+    }
+    for (auto& retired_buffer : retired_buffers) {
+        allocator->destroy_buffer(retired_buffer.buffer.buffer, retired_buffer.buffer.allocation);
+    }
+    retired_buffers.clear();
+    frame_buffers.clear();
+    retained.clear();
+}
+
+sprite_batch& sprite_renderer::create_retained_batch() {
+    retained.push_back(std::make_unique<retained_batch>());
+    return retained.back()->sprites;
+}
+
+void sprite_renderer::retire(gpu_buffer& buffer) {
+    if (buffer.buffer != VK_NULL_HANDLE) {
+        retired_buffers.push_back({buffer, frame_number});
+    }
+    buffer = gpu_buffer{};
+}
+
+/**
+ * Retained batches have at most one upload in flight: a batch that
+ * changes again before its last upload has arrived stays dirty and
+ * is rebuilt once it has, so a batch that changes every frame costs
+ * one upload per transfer round trip rather than one per frame.
+ */
+void sprite_renderer::prepare(uint32_t frame, uint64_t frame_number) {
+    current_frame = frame;
+    this->frame_number = frame_number;
+    auto retired = std::remove_if(retired_buffers.begin(), retired_buffers.end(), [&](const retired_buffer& r) {
+        if (r.retired_at + frames_in_flight > frame_number) {
+            return false;
+        }
+        allocator->destroy_buffer(r.buffer.buffer, r.buffer.allocation);
+        return true;
+    });
+    retired_buffers.erase(retired, retired_buffers.end());
+
+    for (auto& batch : retained) {
+        if (batch->pending.buffer != VK_NULL_HANDLE && uploads->is_ready(batch->ticket)) {
+            retire(batch->current);
+            batch->current = batch->pending;
+            batch->draws.swap(batch->pending_draws);
+            batch->pending = gpu_buffer{};
+        }
+        if (!batch->sprites.is_dirty() || batch->pending.buffer != VK_NULL_HANDLE) {
+            continue;
+        }
+        if (batch->sprites.size() == 0) {
+            retire(batch->current);
+            batch->sprites.build(nullptr, batch->draws);
+            continue;
+        }
+        VkDeviceSize size = batch->sprites.size() * sizeof(sprite_instance);
+        if (size > uploads->staging_capacity()) {
+            throw std::runtime_error("failed to upload a sprite batch larger than the staging buffer!");
+        }
+        staging.resize(batch->sprites.size());
+        batch->sprites.build(staging.data(), batch->pending_draws);
+        batch->pending.buffer = allocator->create_buffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, batch->pending.allocation);
+        batch->pending.capacity = size;
+        batch->ticket = uploads->upload_buffer(batch->pending.buffer, 0, staging.data(), size,
+                                               VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+        stats.static_uploads++;
+        stats.static_bytes += size;
+    }
+
+    dynamic_draws.clear();
+    if (dynamic.size() > 0) {
+        VkDeviceSize size = dynamic.size() * sizeof(sprite_instance);
+        gpu_buffer& buffer = frame_buffers[frame];
+        if (buffer.capacity < size) {
+            VkDeviceSize capacity = std::max<VkDeviceSize>(buffer.capacity * 2, 64 * sizeof(sprite_instance));
+            while (capacity < size) {
+                capacity *= 2;
+            }
+            retire(buffer);
+            buffer.buffer = allocator->create_buffer(capacity, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer.allocation);
+            buffer.capacity = capacity;
+        }
+        // the previous user of this buffer was the frame that last ran in this slot, long retired
+        dynamic.build(static_cast<sprite_instance*>(buffer.allocation.mapped), dynamic_draws);
+        stats.dynamic_bytes += size;
+    }
+    stats.frames++;
+}
+
+void sprite_renderer::record_draws(VkCommandBuffer command_buffer, const VkPipeline pipelines[2], VkBuffer buffer,
+                                   const std::vector<sprite_draw>& draws) {
+    if (draws.empty()) {
+        return;
+    }
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(command_buffer, 0, 1, &buffer, &offset);
+    for (const auto& draw : draws) {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[static_cast<int>(draw.blend)]);
+        // six vertices of a quad, generated from gl_VertexIndex
+        vkCmdDraw(command_buffer, 6, draw.count, 0, draw.first);
+        stats.sprites += draw.count;
+    }
+    stats.draws += draws.size();
+}
+
+void sprite_renderer::record(VkCommandBuffer command_buffer, const VkPipeline pipelines[2]) {
+    for (const auto& batch : retained) {
+        record_draws(command_buffer, pipelines, batch->current.buffer, batch->draws);
+    }
+    record_draws(command_buffer, pipelines, frame_buffers[current_frame].buffer, dynamic_draws);
+}
+
+void sprite_renderer::print_stats(std::ostream& out) const {
+    if (stats.frames == 0) {
+        return;
+    }
+    double frames = static_cast<double>(stats.frames);
+    out << "sprites: " << stats.sprites / frames << " sprites in " << stats.draws / frames
+        << " draws per frame, " << stats.dynamic_bytes / frames / 1024.0 << " KiB dynamic per frame, "
+        << stats.static_uploads << " retained batch uploads (" << stats.static_bytes / 1024.0 << " KiB)"
+        << std::endl;
+}
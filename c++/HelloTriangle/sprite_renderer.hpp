@@ -0,0 +1,168 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <gpu_allocator.hpp>
+#include <upload_manager.hpp>
+
+#include <vector>
+#include <memory>
+#include <ostream>
+#include <cstdint>
+
+enum class sprite_blend : uint8_t {
+    opaque,
+    alpha
+};
+
+// one quad, in clip space like the rest of the app
+struct sprite {
+    float center[2];
+    float half_size[2];
+    float uv[4] = {0.0f, 0.0f, 1.0f, 1.0f}; // u0, v0, u1, v1
+    uint32_t color = 0xffffffff;            // RGBA8, multiplied with the texture
+    uint32_t texture = UINT32_MAX;          // bindless slot, UINT32_MAX for none
+    uint8_t layer = 0;                      // lower layers are drawn first
+    sprite_blend blend = sprite_blend::opaque;
+};
+
+// per-instance vertex data of shaders/sprite.vert
+struct sprite_instance {
+    float rect[4]; // center.xy, half size.xy
+    float uv[4];
+    uint32_t color;
+    uint32_t texture;
+};
+
+// instances [first, first + count) of a batch, drawn with one pipeline
+struct sprite_draw {
+    sprite_blend blend;
+    uint32_t first;
+    uint32_t count;
+};
+
+// LSD radix sort of 32 bit keys, 8 bits per pass; passes in which all
+// keys share the same byte are skipped. `order` receives the indices
+// of the keys in ascending (stable) order.
+void radix_sort(const std::vector<uint32_t>& keys, std::vector<uint32_t>& order, std::vector<uint32_t>& scratch);
+
+/**
+ * Sprites in SoA form: every attribute in an array of its own, so
+ * that moving sprites touches only their positions, and sorting only
+ * reads the keys. The sort key is layer, then pipeline (blend mode),
+ * then texture; as the texture is read per instance through the
+ * bindless set, a draw only ends where the pipeline changes.
+ */
+class sprite_batch
+{
+public:
+    uint32_t add(const sprite& s);
+    void set_center(uint32_t index, float x, float y);
+    void set_color(uint32_t index, uint32_t color);
+    // changes the sort key, the next build() sorts again
+    void set_texture(uint32_t index, uint32_t texture);
+    void clear();
+
+    size_t size() const { return keys.size(); }
+    bool is_dirty() const { return dirty; }
+
+    // sorts the sprites and writes them to `out` (room for size() instances)
+    void build(sprite_instance* out, std::vector<sprite_draw>& draws);
+
+private:
+    static uint32_t key_of(const sprite& s);
+
+    std::vector<float> center_x;
+    std::vector<float> center_y;
+    std::vector<float> half_width;
+    std::vector<float> half_height;
+    std::vector<float> uvs; // 4 per sprite
+    std::vector<uint32_t> colors;
+    std::vector<uint32_t> textures;
+    std::vector<uint32_t> keys;
+    bool dirty = false;
+    bool keys_dirty = false;
+
+    // kept between builds, a retained batch whose keys did not change is not sorted again
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> scratch;
+};
+
+struct sprite_stats {
+    uint64_t sprites = 0;
+    uint64_t draws = 0;
+    uint64_t static_uploads = 0;  // retained batches re-uploaded because they changed
+    uint64_t static_bytes = 0;
+    uint64_t dynamic_bytes = 0;   // written to the per-frame buffers
+    uint64_t frames = 0;
+};
+
+/**
+ * Draws batches of sprites as instanced quads, one draw per run of
+ * sprites that share a pipeline.
+ *  - the dynamic batch is refilled every frame; it is written straight
+ *    into a persistently mapped buffer of the current frame in flight,
+ *  - retained batches live in device-local buffers and are only
+ *    rebuilt and uploaded again when one of their sprites changed;
+ *    until the new upload has arrived the previous version is drawn.
+ * Retained batches are drawn in creation order, then the dynamic one.
+ */
+class sprite_renderer
+{
+public:
+    void init(gpu_allocator* allocator, upload_manager* uploads, uint32_t frames_in_flight);
+    void destroy();
+
+    sprite_batch& dynamic_batch() { return dynamic; }
+    sprite_batch& create_retained_batch();
+
+    // call once the frame's fence has been waited on, before the upload
+    // batch is submitted: writes the dynamic sprites and queues the uploads
+    // of changed retained batches
+    void prepare(uint32_t frame, uint64_t frame_number);
+    // inside a render pass; pipelines are indexed by sprite_blend
+    void record(VkCommandBuffer command_buffer, const VkPipeline pipelines[2]);
+
+    const sprite_stats& get_stats() const { return stats; }
+    void print_stats(std::ostream& out) const;
+
+private:
+    struct gpu_buffer {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        gpu_allocation allocation;
+        VkDeviceSize capacity = 0;
+    };
+
+    struct retained_batch {
+        sprite_batch sprites;
+        gpu_buffer current;
+        std::vector<sprite_draw> draws;
+        // the next version, drawn from once its upload has been acquired
+        gpu_buffer pending;
+        std::vector<sprite_draw> pending_draws;
+        upload_manager::ticket ticket = 0;
+    };
+
+    struct retired_buffer {
+        gpu_buffer buffer;
+        uint64_t retired_at;
+    };
+
+    void retire(gpu_buffer& buffer);
+    void record_draws(VkCommandBuffer command_buffer, const VkPipeline pipelines[2], VkBuffer buffer,
+                      const std::vector<sprite_draw>& draws);
+
+    gpu_allocator* allocator = nullptr;
+    upload_manager* uploads = nullptr;
+    uint32_t frames_in_flight = 0;
+    uint32_t current_frame = 0;
+    uint64_t frame_number = 0;
+
+    sprite_batch dynamic;
+    std::vector<gpu_buffer> frame_buffers; // per frame in flight, persistently mapped
+    std::vector<sprite_draw> dynamic_draws;
+    // unique_ptr, so that references handed out stay valid
+    std::vector<std::unique_ptr<retained_batch>> retained;
+    std::vector<sprite_instance> staging;
+    std::vector<retired_buffer> retired_buffers;
+    sprite_stats stats;
+};
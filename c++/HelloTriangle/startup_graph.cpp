@@ -0,0 +1,151 @@
+#include <startup_graph.hpp>
+
+#include <algorithm>
+#include <thread>
+
+startup_graph::step_id startup_graph::add(const char* name, std::vector<step_id> dependencies,
+                                          std::function<void()> work, bool main_thread) {
+    step s;
+    s.name = name;
+    s.dependencies = std::move(dependencies);
+    s.work = std::move(work);
+    s.main_thread = main_thread;
+    steps.push_back(std::move(s));
+    return static_cast<step_id>(steps.size() - 1);
+}
+
+void startup_graph::run(uint32_t helper_threads) {
+    epoch = std::chrono::steady_clock::now();
+    for (step_id i = 0; i < steps.size(); i++) {
+        steps[i].waiting = steps[i].dependencies.size();
+        for (step_id dependency : steps[i].dependencies) {
+            steps[dependency].dependents.push_back(i);
+        }
+        if (steps[i].waiting == 0) {
+            ready.push_back(i);
+        }
+    }
+    remaining = steps.size();
+
+    std::vector<std::thread> helpers;
+    for (uint32_t i = 0; i < helper_threads; i++) {
+        helpers.emplace_back(&startup_graph::execute, this, false);
+    }
+    execute(true);
+    for (auto& helper : helpers) {
+        helper.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void startup_graph::execute(bool on_main_thread) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        auto next = ready.end();
+        changed.wait(lock, [&] {
+            if (remaining == 0 || (error && running == 0)) {
+                return true;
+            }
+            if (error) {
+                return false;
+            }
+            // the main thread takes its own steps first, helpers never take them
+            next = std::find_if(ready.begin(), ready.end(), [&](step_id id) {
+                return steps[id].main_thread == on_main_thread;
+            });
+            if (next == ready.end() && on_main_thread) {
+                next = ready.begin();
+            }
+            return next != ready.end();
+        });
+        if (next == ready.end()) {
+            // everything is done, or a step failed and nothing is running anymore
+            changed.notify_all();
+            return;
+        }
+        step_id id = *next;
+        ready.erase(next);
+        running++;
+        lock.unlock();
+
+        step& s = steps[id];
+        std::exception_ptr step_error;
+        s.start_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - epoch).count();
+        try {
+            s.work();
+        } catch (...) {
+            step_error = std::current_exception();
+        }
+        s.end_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - epoch).count();
+
+        lock.lock();
+        running--;
+        remaining--;
+        if (step_error && !error) {
+            error = step_error;
+        }
+        if (!step_error) {
+            for (step_id dependent : s.dependents) {
+                if (--steps[dependent].waiting == 0) {
+                    ready.push_back(dependent);
+                }
+            }
+        }
+        changed.notify_all();
+    }
+}
+
+double startup_graph::duration_ms(step_id step) const {
+    return steps[step].end_ms - steps[step].start_ms;
+}
+
+/**
+ * Starting from the step that finished last, follow the dependency
+ * each step waited for the longest, i.e. the one that finished last.
+ */
+std::vector<startup_graph::step_id> startup_graph::critical_path() const {
+    std::vector<step_id> path;
+    if (steps.empty()) {
+        return path;
+    }
+    auto later = [&](step_id a, step_id b) { return steps[a].end_ms < steps[b].end_ms; };
+    std::vector<step_id> all(steps.size());
+    for (step_id i = 0; i < steps.size(); i++) {
+        all[i] = i;
+    }
+    step_id current = *std::max_element(all.begin(), all.end(), later);
+    while (true) {
+        path.push_back(current);
+        const auto& dependencies = steps[current].dependencies;
+        if (dependencies.empty()) {
+            break;
+        }
+        current = *std::max_element(dependencies.begin(), dependencies.end(), later);
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+double startup_graph::critical_path_ms() const {
+    double end = 0.0;
+    for (const auto& s : steps) {
+        end = std::max(end, s.end_ms);
+    }
+    return end;
+}
+
+void startup_graph::print_critical_path(std::ostream& out) const {
+    double serial = 0.0;
+    for (const auto& s : steps) {
+        serial += s.end_ms - s.start_ms;
+    }
+    out << "startup critical path " << critical_path_ms() << " ms (" << serial << " ms of work):";
+    auto path = critical_path();
+    for (size_t i = 0; i < path.size(); i++) {
+        out << (i > 0 ? " > " : " ") << steps[path[i]].name << ' '
+            << steps[path[i]].end_ms - steps[path[i]].start_ms << " ms";
+    }
+    out << std::endl;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+
+/**
+ * Initialization steps as a dependency graph. run() executes every
+ * step as soon as the steps it depends on have finished, on the
+ * calling thread and a few helper threads; steps that have to stay on
+ * the main thread (GLFW window creation, for one) are only ever picked
+ * up by the calling thread. Each step's start and end are recorded, so
+ * that the critical path, i.e. the chain of steps that decided when
+ * startup was over, can be reported afterwards.
+ */
+class startup_graph
+{
+public:
+    using step_id = uint32_t;
+
+    step_id add(const char* name, std::vector<step_id> dependencies,
+                std::function<void()> work, bool main_thread = false);
+    // blocks until all steps are done; if a step throws, no further
+    // steps are started and the exception is rethrown here
+    void run(uint32_t helper_threads);
+
+    double duration_ms(step_id step) const;
+    double critical_path_ms() const;
+    void print_critical_path(std::ostream& out) const;
+
+private:
+    struct step {
+        const char* name;
+        std::vector<step_id> dependencies;
+        std::function<void()> work;
+        bool main_thread;
+        std::vector<step_id> dependents;
+        size_t waiting = 0;   // unfinished dependencies
+        double start_ms = 0.0;
+        double end_ms = 0.0;
+    };
+
+    void execute(bool on_main_thread);
+    std::vector<step_id> critical_path() const;
+
+    std::vector<step> steps;
+    std::vector<step_id> ready;
+    size_t remaining = 0;
+    size_t running = 0;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::chrono::steady_clock::time_point epoch;
+};
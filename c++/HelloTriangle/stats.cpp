@@ -0,0 +1,13 @@
+#include <stats.hpp>
+
+#include <algorithm>
+#include <cstddef>
+
+double percentile(std::vector<double> values, double fraction) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    size_t index = std::min(values.size() - 1, static_cast<size_t>(fraction * (values.size() - 1) + 0.5));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <vector>
+
+// the value below which the given fraction of the samples lies, the
+// nearest rank rounded; 0 for no samples
+double percentile(std::vector<double> values, double fraction);
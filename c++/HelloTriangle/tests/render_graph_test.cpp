@@ -0,0 +1,186 @@
+#include <render_graph.hpp>
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * The render graph's compile step against a stand-in for the handful of
+ * Vulkan calls it makes: images are numbered, memory requirements depend
+ * only on the format, and the barriers are recorded instead of executed.
+ * Checks which transient images end up sharing memory and the barriers
+ * that hand the memory from one image to the next.
+ */
+
+namespace {
+
+uint64_t next_handle = 1;
+std::map<VkImage, VkFormat> image_formats;
+std::map<VkImage, VkDeviceMemory> image_memory;
+uint32_t allocations = 0;
+
+struct recorded_barrier {
+    size_t next_pass; // index into executed, of the pass it was recorded in front of
+    VkPipelineStageFlags src_stages;
+    VkPipelineStageFlags dst_stages;
+    VkImageMemoryBarrier barrier;
+};
+std::vector<recorded_barrier> barriers;
+std::vector<std::string> executed;
+
+int failures = 0;
+
+void check(bool condition, const char* what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+const recorded_barrier* find_barrier(const std::string& pass, VkImage image) {
+    for (const auto& b : barriers) {
+        if (b.next_pass < executed.size() && executed[b.next_pass] == pass && b.barrier.image == image) {
+            return &b;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace
+
+VkResult vkCreateImage(VkDevice, const VkImageCreateInfo* create_info, const VkAllocationCallbacks*, VkImage* image) {
+    *image = reinterpret_cast<VkImage>(next_handle++);
+    image_formats[*image] = create_info->format;
+    return VK_SUCCESS;
+}
+
+void vkDestroyImage(VkDevice, VkImage, const VkAllocationCallbacks*) {}
+
+// 8-bit images live in a memory type of their own, as formats may on real devices
+void vkGetImageMemoryRequirements(VkDevice, VkImage image, VkMemoryRequirements* requirements) {
+    bool narrow = image_formats[image] == VK_FORMAT_R8G8B8A8_UNORM;
+    requirements->size = narrow ? 4u << 20 : 8u << 20;
+    requirements->alignment = 4096;
+    requirements->memoryTypeBits = narrow ? 0x2 : 0x1;
+}
+
+VkResult vkBindImageMemory(VkDevice, VkImage image, VkDeviceMemory memory, VkDeviceSize) {
+    image_memory[image] = memory;
+    return VK_SUCCESS;
+}
+
+VkResult vkCreateImageView(VkDevice, const VkImageViewCreateInfo*, const VkAllocationCallbacks*, VkImageView* view) {
+    *view = reinterpret_cast<VkImageView>(next_handle++);
+    return VK_SUCCESS;
+}
+
+void vkDestroyImageView(VkDevice, VkImageView, const VkAllocationCallbacks*) {}
+
+void vkCmdPipelineBarrier(VkCommandBuffer, VkPipelineStageFlags src_stages, VkPipelineStageFlags dst_stages,
+                          VkDependencyFlags, uint32_t, const VkMemoryBarrier*, uint32_t, const VkBufferMemoryBarrier*,
+                          uint32_t image_barrier_count, const VkImageMemoryBarrier* image_barriers) {
+    for (uint32_t i = 0; i < image_barrier_count; i++) {
+        barriers.push_back({executed.size(), src_stages, dst_stages, image_barriers[i]});
+    }
+}
+
+void vkCmdPipelineBarrier2(VkCommandBuffer, const VkDependencyInfo*) {}
+
+gpu_allocation gpu_allocator::allocate(const VkMemoryRequirements&, VkMemoryPropertyFlags, VkMemoryPropertyFlags,
+                                       resource_kind) {
+    gpu_allocation allocation{};
+    allocation.memory = reinterpret_cast<VkDeviceMemory>(next_handle++);
+    allocations++;
+    return allocation;
+}
+
+void gpu_allocator::free(const gpu_allocation&) {}
+
+int main() {
+    gpu_allocator allocator;
+    render_graph graph;
+    graph.init(reinterpret_cast<VkDevice>(next_handle++), nullptr, &allocator, 2);
+
+    rg_image_desc color{VK_FORMAT_R16G16B16A16_SFLOAT, {1280, 720},
+                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT};
+    rg_image_desc narrow{VK_FORMAT_R8G8B8A8_UNORM, {1280, 720},
+                         VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT};
+
+    // scene -> bloom -> tonemap -> backbuffer: the scene color is done
+    // with before the tonemapped image is written, so those two may share
+    // memory, the bloom image overlaps both; the normals have the same
+    // lifetime as the scene color but another memory type, and the debug
+    // image is never read, so its pass is culled
+    rg_handle backbuffer = graph.import_image("backbuffer", VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                              VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                              VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+    rg_handle scene = graph.create_image("scene", color);
+    rg_handle normals = graph.create_image("normals", narrow);
+    rg_handle bloom = graph.create_image("bloom", color);
+    rg_handle tonemapped = graph.create_image("tonemapped", color);
+    rg_handle debug = graph.create_image("debug", color);
+    graph.set_image(backbuffer, reinterpret_cast<VkImage>(next_handle++));
+
+    auto mark = [](const std::string& pass) {
+        return [pass](VkCommandBuffer) { executed.push_back(pass); };
+    };
+    uint32_t scene_pass = graph.add_pass("scene", mark("scene"));
+    graph.use(scene_pass, scene, rg_access::color_attachment_write);
+    graph.use(scene_pass, normals, rg_access::color_attachment_write);
+    uint32_t bloom_pass = graph.add_pass("bloom", mark("bloom"));
+    graph.use(bloom_pass, scene, rg_access::sampled_read);
+    graph.use(bloom_pass, normals, rg_access::sampled_read);
+    graph.use(bloom_pass, bloom, rg_access::color_attachment_write);
+    uint32_t debug_pass = graph.add_pass("debug", mark("debug"));
+    graph.use(debug_pass, scene, rg_access::sampled_read);
+    graph.use(debug_pass, debug, rg_access::color_attachment_write);
+    uint32_t tonemap_pass = graph.add_pass("tonemap", mark("tonemap"));
+    graph.use(tonemap_pass, bloom, rg_access::sampled_read);
+    graph.use(tonemap_pass, tonemapped, rg_access::color_attachment_write);
+    uint32_t present_pass = graph.add_pass("present", mark("present"));
+    graph.use(present_pass, tonemapped, rg_access::sampled_read);
+    graph.use(present_pass, backbuffer, rg_access::color_attachment_write);
+
+    graph.compile();
+    graph.print_summary(std::cout);
+    graph.execute(reinterpret_cast<VkCommandBuffer>(next_handle++));
+
+    check(graph.image(debug) == VK_NULL_HANDLE, "the culled pass's image is not created");
+    check(image_formats.size() == 4, "four transient images are created");
+    check(allocations == 3, "three memory slots for four images");
+    VkDeviceMemory scene_memory = image_memory[graph.image(scene)];
+    check(scene_memory != VK_NULL_HANDLE, "the scene color is bound");
+    check(image_memory[graph.image(tonemapped)] == scene_memory, "the tonemapped image takes the scene color's memory");
+    check(image_memory[graph.image(bloom)] != scene_memory, "the bloom image overlaps the scene color");
+    check(image_memory[graph.image(normals)] != scene_memory, "the normals need another memory type");
+    check(image_memory[graph.image(normals)] != image_memory[graph.image(bloom)], "the normals overlap the bloom image");
+    check(executed == std::vector<std::string>{"scene", "bloom", "tonemap", "present"}, "the debug pass is culled");
+
+    // in front of the tonemap pass, the scene color's last readers are
+    // waited for before the tonemapped image overwrites the memory
+    const recorded_barrier* handover = find_barrier("tonemap", graph.image(tonemapped));
+    check(handover != nullptr, "an aliasing barrier in front of the tonemap pass");
+    if (handover) {
+        check(handover->barrier.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED, "the previous contents are discarded");
+        check(handover->barrier.newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, "into the attachment layout");
+        check(handover->src_stages & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, "after the scene color was sampled");
+        // its write was made visible by the transition to be sampled
+        check(handover->barrier.dstAccessMask & VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, "before the new image is written");
+    }
+    // the memory is shared by the frames in flight: the first image in a
+    // slot waits for the previous frame's tonemapped image to be sampled
+    const recorded_barrier* first = find_barrier("scene", graph.image(scene));
+    check(first != nullptr, "a barrier in front of the scene pass");
+    if (first) {
+        check(first->barrier.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED, "the previous frame's contents are discarded");
+        check(first->src_stages & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, "after the previous frame sampled the memory");
+    }
+
+    graph.destroy();
+    if (failures == 0) {
+        std::cout << "render graph: all checks passed" << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
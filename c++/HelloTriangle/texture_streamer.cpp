@@ -0,0 +1,512 @@
+#include <texture_streamer.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+enum class compression {
+    none,
+    bc,
+    astc
+};
+
+struct format_info {
+    VkFormat format;
+    const char* name;
+    uint32_t block_width;
+    uint32_t block_height;
+    uint32_t block_bytes;
+    compression kind;
+};
+
+const format_info formats[] = {
+    {VK_FORMAT_R8G8B8A8_UNORM, "RGBA8_UNORM", 1, 1, 4, compression::none},
+    {VK_FORMAT_R8G8B8A8_SRGB, "RGBA8_SRGB", 1, 1, 4, compression::none},
+    {VK_FORMAT_B8G8R8A8_UNORM, "BGRA8_UNORM", 1, 1, 4, compression::none},
+    {VK_FORMAT_B8G8R8A8_SRGB, "BGRA8_SRGB", 1, 1, 4, compression::none},
+    {VK_FORMAT_BC1_RGB_UNORM_BLOCK, "BC1_RGB_UNORM", 4, 4, 8, compression::bc},
+    {VK_FORMAT_BC1_RGB_SRGB_BLOCK, "BC1_RGB_SRGB", 4, 4, 8, compression::bc},
+    {VK_FORMAT_BC1_RGBA_UNORM_BLOCK, "BC1_RGBA_UNORM", 4, 4, 8, compression::bc},
+    {VK_FORMAT_BC1_RGBA_SRGB_BLOCK, "BC1_RGBA_SRGB", 4, 4, 8, compression::bc},
+    {VK_FORMAT_BC2_UNORM_BLOCK, "BC2_UNORM", 4, 4, 16, compression::bc},
+    {VK_FORMAT_BC2_SRGB_BLOCK, "BC2_SRGB", 4, 4, 16, compression::bc},
+    {VK_FORMAT_BC3_UNORM_BLOCK, "BC3_UNORM", 4, 4, 16, compression::bc},
+    {VK_FORMAT_BC3_SRGB_BLOCK, "BC3_SRGB", 4, 4, 16, compression::bc},
+    {VK_FORMAT_BC4_UNORM_BLOCK, "BC4_UNORM", 4, 4, 8, compression::bc},
+    {VK_FORMAT_BC4_SNORM_BLOCK, "BC4_SNORM", 4, 4, 8, compression::bc},
+    {VK_FORMAT_BC5_UNORM_BLOCK, "BC5_UNORM", 4, 4, 16, compression::bc},
+    {VK_FORMAT_BC5_SNORM_BLOCK, "BC5_SNORM", 4, 4, 16, compression::bc},
+    {VK_FORMAT_BC6H_UFLOAT_BLOCK, "BC6H_UFLOAT", 4, 4, 16, compression::bc},
+    {VK_FORMAT_BC6H_SFLOAT_BLOCK, "BC6H_SFLOAT", 4, 4, 16, compression::bc},
+    {VK_FORMAT_BC7_UNORM_BLOCK, "BC7_UNORM", 4, 4, 16, compression::bc},
+    {VK_FORMAT_BC7_SRGB_BLOCK, "BC7_SRGB", 4, 4, 16, compression::bc},
+    {VK_FORMAT_ASTC_4x4_UNORM_BLOCK, "ASTC_4x4_UNORM", 4, 4, 16, compression::astc},
+    {VK_FORMAT_ASTC_4x4_SRGB_BLOCK, "ASTC_4x4_SRGB", 4, 4, 16, compression::astc},
+    {VK_FORMAT_ASTC_5x4_UNORM_BLOCK, "ASTC_5x4_UNORM", 5, 4, 16, compression::astc},
+    {VK_FORMAT_ASTC_5x4_SRGB_BLOCK, "ASTC_5x4_SRGB", 5, 4, 16, compression::astc},
+    {VK_FORMAT_ASTC_5x5_UNORM_BLOCK, "ASTC_5x5_UNORM", 5, 5, 16, compression::astc},
+    {VK_FORMAT_ASTC_5x5_SRGB_BLOCK, "ASTC_5x5_SRGB", 5, 5, 16, compression::astc},
+    {VK_FORMAT_ASTC_6x5_UNORM_BLOCK, "ASTC_6x5_UNORM", 6, 5, 16, compression::astc},
+    {VK_FORMAT_ASTC_6x5_SRGB_BLOCK, "ASTC_6x5_SRGB", 6, 5, 16, compression::astc},
+    {VK_FORMAT_ASTC_6x6_UNORM_BLOCK, "ASTC_6x6_UNORM", 6, 6, 16, compression::astc},
+    {VK_FORMAT_ASTC_6x6_SRGB_BLOCK, "ASTC_6x6_SRGB", 6, 6, 16, compression::astc},
+    {VK_FORMAT_ASTC_8x5_UNORM_BLOCK, "ASTC_8x5_UNORM", 8, 5, 16, compression::astc},
+    {VK_FORMAT_ASTC_8x5_SRGB_BLOCK, "ASTC_8x5_SRGB", 8, 5, 16, compression::astc},
+    {VK_FORMAT_ASTC_8x6_UNORM_BLOCK, "ASTC_8x6_UNORM", 8, 6, 16, compression::astc},
+    {VK_FORMAT_ASTC_8x6_SRGB_BLOCK, "ASTC_8x6_SRGB", 8, 6, 16, compression::astc},
+    {VK_FORMAT_ASTC_8x8_UNORM_BLOCK, "ASTC_8x8_UNORM", 8, 8, 16, compression::astc},
+    {VK_FORMAT_ASTC_8x8_SRGB_BLOCK, "ASTC_8x8_SRGB", 8, 8, 16, compression::astc},
+    {VK_FORMAT_ASTC_10x5_UNORM_BLOCK, "ASTC_10x5_UNORM", 10, 5, 16, compression::astc},
+    {VK_FORMAT_ASTC_10x5_SRGB_BLOCK, "ASTC_10x5_SRGB", 10, 5, 16, compression::astc},
+    {VK_FORMAT_ASTC_10x6_UNORM_BLOCK, "ASTC_10x6_UNORM", 10, 6, 16, compression::astc},
+    {VK_FORMAT_ASTC_10x6_SRGB_BLOCK, "ASTC_10x6_SRGB", 10, 6, 16, compression::astc},
+    {VK_FORMAT_ASTC_10x8_UNORM_BLOCK, "ASTC_10x8_UNORM", 10, 8, 16, compression::astc},
+    {VK_FORMAT_ASTC_10x8_SRGB_BLOCK, "ASTC_10x8_SRGB", 10, 8, 16, compression::astc},
+    {VK_FORMAT_ASTC_10x10_UNORM_BLOCK, "ASTC_10x10_UNORM", 10, 10, 16, compression::astc},
+    {VK_FORMAT_ASTC_10x10_SRGB_BLOCK, "ASTC_10x10_SRGB", 10, 10, 16, compression::astc},
+    {VK_FORMAT_ASTC_12x10_UNORM_BLOCK, "ASTC_12x10_UNORM", 12, 10, 16, compression::astc},
+    {VK_FORMAT_ASTC_12x10_SRGB_BLOCK, "ASTC_12x10_SRGB", 12, 10, 16, compression::astc},
+    {VK_FORMAT_ASTC_12x12_UNORM_BLOCK, "ASTC_12x12_UNORM", 12, 12, 16, compression::astc},
+    {VK_FORMAT_ASTC_12x12_SRGB_BLOCK, "ASTC_12x12_SRGB", 12, 12, 16, compression::astc},
+};
+
+const format_info* find_format(VkFormat format) {
+    for (const auto& info : formats) {
+        if (info.format == format) {
+            return &info;
+        }
+    }
+    return nullptr;
+}
+
+size_t level_size(const format_info& info, uint32_t width, uint32_t height) {
+    size_t blocks_x = (width + info.block_width - 1) / info.block_width;
+    size_t blocks_y = (height + info.block_height - 1) / info.block_height;
+    return blocks_x * blocks_y * info.block_bytes;
+}
+
+// levels in a full mip chain down to 1x1, the most a file may declare
+uint32_t max_level_count(uint32_t width, uint32_t height) {
+    uint32_t count = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+        count++;
+    }
+    return count;
+}
+
+// the files are only byte-aligned where it matters to us
+template <typename T>
+T read(const mapped_file& file, size_t offset) {
+    T value;
+    if (offset + sizeof(T) > file.size()) {
+        throw std::runtime_error("truncated texture file!");
+    }
+    std::memcpy(&value, static_cast<const char*>(file.data()) + offset, sizeof(T));
+    return value;
+}
+
+// the DXGI_FORMATs with a Vulkan equivalent that can be uploaded as they are
+VkFormat from_dxgi(uint32_t dxgi_format) {
+    switch (dxgi_format) {
+    case 28: return VK_FORMAT_R8G8B8A8_UNORM;
+    case 29: return VK_FORMAT_R8G8B8A8_SRGB;
+    case 87: return VK_FORMAT_B8G8R8A8_UNORM;
+    case 91: return VK_FORMAT_B8G8R8A8_SRGB;
+    case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+    case 74: return VK_FORMAT_BC2_UNORM_BLOCK;
+    case 75: return VK_FORMAT_BC2_SRGB_BLOCK;
+    case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+    case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+    case 80: return VK_FORMAT_BC4_UNORM_BLOCK;
+    case 81: return VK_FORMAT_BC4_SNORM_BLOCK;
+    case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+    case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+    case 95: return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+    case 96: return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+    case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+    case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+    default: return VK_FORMAT_UNDEFINED;
+    }
+}
+
+constexpr uint32_t fourcc(char a, char b, char c, char d) {
+    return uint32_t(uint8_t(a)) | uint32_t(uint8_t(b)) << 8 | uint32_t(uint8_t(c)) << 16 | uint32_t(uint8_t(d)) << 24;
+}
+
+/**
+ * KTX2: a 12 byte identifier, a header with the VkFormat and the
+ * dimensions, section offsets, then one (offset, length) entry per
+ * mip level, largest first. Level data may come in any order in the
+ * file, the index is all that matters.
+ */
+void parse_ktx2(texture_file& texture) {
+    const mapped_file& file = texture.file;
+    texture.format = static_cast<VkFormat>(read<uint32_t>(file, 12));
+    uint32_t width = read<uint32_t>(file, 20);
+    uint32_t height = std::max(read<uint32_t>(file, 24), 1u);
+    uint32_t depth = read<uint32_t>(file, 28);
+    uint32_t layers = read<uint32_t>(file, 32);
+    uint32_t faces = read<uint32_t>(file, 36);
+    uint32_t level_count = std::max(read<uint32_t>(file, 40), 1u);
+    uint32_t supercompression = read<uint32_t>(file, 44);
+    if (texture.format == VK_FORMAT_UNDEFINED || supercompression != 0) {
+        throw std::runtime_error(texture.path + " is supercompressed, which needs transcoding!");
+    }
+    if (depth > 1 || layers > 1 || faces != 1) {
+        throw std::runtime_error(texture.path + " is not a plain 2D texture!");
+    }
+    const format_info* info = find_format(texture.format);
+    if (info == nullptr) {
+        throw std::runtime_error(texture.path + " has an unsupported format!");
+    }
+    if (width == 0 || level_count > max_level_count(width, height)) {
+        throw std::runtime_error("malformed header in " + texture.path + "!");
+    }
+    for (uint32_t level = 0; level < level_count; level++) {
+        size_t entry = 80 + 24 * size_t(level);
+        uint64_t offset = read<uint64_t>(file, entry);
+        uint64_t length = read<uint64_t>(file, entry + 8);
+        uint32_t level_width = std::max(width >> level, 1u);
+        uint32_t level_height = std::max(height >> level, 1u);
+        if (offset + length > file.size() || length != level_size(*info, level_width, level_height)) {
+            throw std::runtime_error("malformed mip level in " + texture.path + "!");
+        }
+        texture.levels.push_back({size_t(offset), size_t(length), {level_width, level_height, 1}});
+    }
+}
+
+/**
+ * DDS: "DDS ", a 124 byte header and, for DXGI formats, the DX10
+ * extension header; the levels follow back to back, largest first.
+ */
+void parse_dds(texture_file& texture) {
+    const mapped_file& file = texture.file;
+    const uint32_t mip_map_count_flag = 0x20000;
+    const uint32_t fourcc_flag = 0x4;
+    const uint32_t cube_map = 0x200;
+    const uint32_t volume = 0x200000;
+
+    uint32_t flags = read<uint32_t>(file, 8);
+    uint32_t height = read<uint32_t>(file, 12);
+    uint32_t width = read<uint32_t>(file, 16);
+    uint32_t level_count = flags & mip_map_count_flag ? std::max(read<uint32_t>(file, 28), 1u) : 1;
+    uint32_t pixel_flags = read<uint32_t>(file, 80);
+    uint32_t code = read<uint32_t>(file, 84);
+    uint32_t caps2 = read<uint32_t>(file, 112);
+    if (caps2 & (cube_map | volume)) {
+        throw std::runtime_error(texture.path + " is not a plain 2D texture!");
+    }
+
+    size_t data_offset = 128;
+    if (pixel_flags & fourcc_flag) {
+        switch (code) {
+        case fourcc('D', 'X', 'T', '1'): texture.format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK; break;
+        case fourcc('D', 'X', 'T', '3'): texture.format = VK_FORMAT_BC2_UNORM_BLOCK; break;
+        case fourcc('D', 'X', 'T', '5'): texture.format = VK_FORMAT_BC3_UNORM_BLOCK; break;
+        case fourcc('A', 'T', 'I', '1'):
+        case fourcc('B', 'C', '4', 'U'): texture.format = VK_FORMAT_BC4_UNORM_BLOCK; break;
+        case fourcc('A', 'T', 'I', '2'):
+        case fourcc('B', 'C', '5', 'U'): texture.format = VK_FORMAT_BC5_UNORM_BLOCK; break;
+        case fourcc('D', 'X', '1', '0'): {
+            const uint32_t texture_2d = 3;
+            const uint32_t texture_cube = 0x4;
+            texture.format = from_dxgi(read<uint32_t>(file, 128));
+            if (read<uint32_t>(file, 132) != texture_2d || read<uint32_t>(file, 136) & texture_cube ||
+                read<uint32_t>(file, 140) > 1) {
+                throw std::runtime_error(texture.path + " is not a plain 2D texture!");
+            }
+            data_offset = 148;
+            break;
+        }
+        default: break;
+        }
+    } else if (read<uint32_t>(file, 88) == 32 && read<uint32_t>(file, 104) == 0xff000000u) {
+        // uncompressed, only the two byte orders that Vulkan has formats for
+        uint32_t red_mask = read<uint32_t>(file, 92);
+        texture.format = red_mask == 0x000000ffu ? VK_FORMAT_R8G8B8A8_UNORM
+                         : red_mask == 0x00ff0000u ? VK_FORMAT_B8G8R8A8_UNORM : VK_FORMAT_UNDEFINED;
+    }
+    const format_info* info = find_format(texture.format);
+    if (info == nullptr) {
+        throw std::runtime_error(texture.path + " has an unsupported format!");
+    }
+    if (width == 0 || height == 0 || level_count > max_level_count(width, height)) {
+        throw std::runtime_error("malformed header in " + texture.path + "!");
+    }
+
+    size_t offset = data_offset;
+    for (uint32_t level = 0; level < level_count; level++) {
+        uint32_t level_width = std::max(width >> level, 1u);
+        uint32_t level_height = std::max(height >> level, 1u);
+        size_t size = level_size(*info, level_width, level_height);
+        if (offset + size > file.size()) {
+            throw std::runtime_error("truncated mip level in " + texture.path + "!");
+        }
+        texture.levels.push_back({offset, size, {level_width, level_height, 1}});
+        offset += size;
+    }
+}
+
+}
+
+texture_file open_texture_file(const std::string& path) {
+    static const uint8_t ktx2_identifier[12] = {0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n'};
+    texture_file texture;
+    texture.path = path;
+    texture.file = mapped_file(path);
+    if (texture.file.size() >= sizeof(ktx2_identifier) &&
+        std::memcmp(texture.file.data(), ktx2_identifier, sizeof(ktx2_identifier)) == 0) {
+        parse_ktx2(texture);
+    } else if (texture.file.size() >= 4 && read<uint32_t>(texture.file, 0) == fourcc('D', 'D', 'S', ' ')) {
+        parse_dds(texture);
+    } else {
+        throw std::runtime_error(path + " is neither a KTX2 nor a DDS file!");
+    }
+    return texture;
+}
+
+const char* texture_format_name(VkFormat format) {
+    const format_info* info = find_format(format);
+    return info ? info->name : "unknown";
+}
+
+void texture_streamer::init(VkPhysicalDevice physical_device, VkDevice device, const VkAllocationCallbacks* callbacks,
+                            const VkPhysicalDeviceFeatures& enabled_features, gpu_allocator* allocator,
+                            upload_manager* uploads, descriptor_manager* descriptors,
+                            uint32_t frames_in_flight, VkDeviceSize frame_budget) {
+    this->physical_device = physical_device;
+    this->device = device;
+    this->callbacks = callbacks;
+    this->enabled_features = enabled_features;
+    this->allocator = allocator;
+    this->uploads = uploads;
+    this->descriptors = descriptors;
+    this->frames_in_flight = frames_in_flight;
+    this->frame_budget = frame_budget;
+
+    VkSamplerCreateInfo sampler_info{};
+    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter = VK_FILTER_LINEAR;
+    sampler_info.minFilter = VK_FILTER_LINEAR;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    // the views only cover the resident levels, so the sampler can allow all of them
+    sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+    if (vkCreateSampler(device, &sampler_info, callbacks, &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create the texture sampler!");
+    }
+}
+
+void texture_streamer::destroy() {
+    for (const auto& retired : retired_views) {
+        vkDestroyImageView(device, retired.view, callbacks);
+    }
+    retired_views.clear();
+    for (auto& t : textures) {
+        if (t.view != VK_NULL_HANDLE) {
+            vkDestroyImageView(device, t.view, callbacks);
+        }
+        allocator->destroy_image(t.image, t.allocation);
+    }
+    textures.clear();
+    vkDestroySampler(device, sampler, callbacks);
+}
+
+/**
+ * Block-compressed formats additionally need their device feature,
+ * which create_logical_device() enables wherever it is available.
+ * Linear filtering is required as well, since all textures share
+ * one trilinear sampler.
+ */
+bool texture_streamer::is_format_supported(VkFormat format) {
+    auto cached = format_support.find(format);
+    if (cached != format_support.end()) {
+        return cached->second;
+    }
+    const format_info* info = find_format(format);
+    bool supported = info != nullptr;
+    if (supported && info->kind == compression::bc) {
+        supported = enabled_features.textureCompressionBC == VK_TRUE;
+    } else if (supported && info->kind == compression::astc) {
+        supported = enabled_features.textureCompressionASTC_LDR == VK_TRUE;
+    }
+    if (supported) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+        const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+                                              VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        supported = (properties.optimalTilingFeatures & required) == required;
+    }
+    format_support[format] = supported;
+    return supported;
+}
+
+texture_streamer::texture_id texture_streamer::load(const std::vector<std::string>& candidates) {
+    std::string rejected;
+    for (const auto& path : candidates) {
+        texture_file source = open_texture_file(path);
+        if (!is_format_supported(source.format)) {
+            rejected += std::string(rejected.empty() ? "" : ", ") + texture_format_name(source.format);
+            continue;
+        }
+
+        texture t;
+        t.source = std::move(source);
+        const auto& levels = t.source.levels;
+        VkImageCreateInfo create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        create_info.imageType = VK_IMAGE_TYPE_2D;
+        create_info.format = t.source.format;
+        create_info.extent = levels[0].extent;
+        create_info.mipLevels = static_cast<uint32_t>(levels.size());
+        create_info.arrayLayers = 1;
+        create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        create_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        t.image = allocator->create_image(create_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, t.allocation);
+
+        // a level is uploaded in one piece, so it has to fit into the staging ring
+        while (t.finest_level < levels.size() - 1 && levels[t.finest_level].size > uploads->staging_capacity()) {
+            t.finest_level++;
+        }
+        t.resident_level = static_cast<uint32_t>(levels.size());
+        t.next_level = t.resident_level;
+        t.loaded_frame = frame_number;
+        std::cout << "texture " << path << ": " << texture_format_name(t.source.format) << ' '
+                  << levels[0].extent.width << 'x' << levels[0].extent.height << ", " << levels.size()
+                  << " levels" << (t.finest_level > 0 ? " (the largest do not fit into the staging ring)" : "")
+                  << std::endl;
+        textures.push_back(std::move(t));
+        return static_cast<texture_id>(textures.size() - 1);
+    }
+    throw std::runtime_error("the device supports none of the formats of " + candidates.front() +
+                             " (" + rejected + ")!");
+}
+
+void texture_streamer::make_resident(texture& t, uint32_t level, uint64_t frame_number) {
+    VkImageViewCreateInfo view_info{};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image = t.image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = t.source.format;
+    view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    view_info.subresourceRange.baseMipLevel = level;
+    view_info.subresourceRange.levelCount = static_cast<uint32_t>(t.source.levels.size()) - level;
+    view_info.subresourceRange.baseArrayLayer = 0;
+    view_info.subresourceRange.layerCount = 1;
+    VkImageView view;
+    if (vkCreateImageView(device, &view_info, callbacks, &view) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create a texture view!");
+    }
+
+    // frames in flight may still sample through the old view; its slot
+    // is held back by the descriptor manager for the same reason
+    if (t.view != VK_NULL_HANDLE) {
+        retired_views.push_back({t.view, t.descriptor, frame_number});
+        if (t.descriptor != no_descriptor) {
+            descriptors->remove_texture(t.descriptor);
+        }
+    }
+    t.view = view;
+    t.descriptor = descriptors->is_bindless() ? descriptors->add_texture(view, sampler) : no_descriptor;
+    t.resident_level = level;
+    if (level == t.finest_level) {
+        t.completed_frame = frame_number;
+    }
+}
+
+/**
+ * Levels whose upload has been acquired by the graphics queue are
+ * made visible first, then new levels are queued: always the smallest
+ * level any texture is missing, so every texture gets a coarse
+ * version before any gets a fine one. At least one level is queued
+ * per frame, even if it alone exceeds the budget.
+ */
+void texture_streamer::update(uint64_t frame_number) {
+    this->frame_number = frame_number;
+    auto retired = std::remove_if(retired_views.begin(), retired_views.end(), [&](const retired_view& r) {
+        if (r.retired_at + frames_in_flight > frame_number) {
+            return false;
+        }
+        vkDestroyImageView(device, r.view, callbacks);
+        return true;
+    });
+    retired_views.erase(retired, retired_views.end());
+
+    for (auto& t : textures) {
+        // batches complete in order, and so do the levels of a texture
+        uint32_t arrived = t.resident_level;
+        size_t done = 0;
+        while (done < t.pending.size() && uploads->is_ready(t.pending[done].ticket)) {
+            arrived = t.pending[done++].level;
+        }
+        t.pending.erase(t.pending.begin(), t.pending.begin() + done);
+        if (arrived < t.resident_level) {
+            make_resident(t, arrived, frame_number);
+        }
+    }
+
+    VkDeviceSize spent = 0;
+    while (true) {
+        texture* next = nullptr;
+        for (auto& t : textures) {
+            if (t.next_level > t.finest_level &&
+                (next == nullptr || t.source.levels[t.next_level - 1].size < next->source.levels[next->next_level - 1].size)) {
+                next = &t;
+            }
+        }
+        if (next == nullptr) {
+            break;
+        }
+        const texture_level& level = next->source.levels[next->next_level - 1];
+        if (spent > 0 && spent + level.size > frame_budget) {
+            break;
+        }
+        next->next_level--;
+        auto ticket = uploads->upload_image(next->image, next->next_level, level.extent,
+                                            next->source.level_data(next->next_level), level.size);
+        next->pending.push_back({next->next_level, ticket});
+        spent += level.size;
+    }
+    if (spent > 0) {
+        bytes_streamed += spent;
+        busy_frames++;
+    }
+}
+
+uint32_t texture_streamer::resident_levels(texture_id texture) const {
+    const auto& t = textures[texture];
+    return static_cast<uint32_t>(t.source.levels.size()) - t.resident_level;
+}
+
+bool texture_streamer::is_complete() const {
+    return std::all_of(textures.begin(), textures.end(), [](const texture& t) {
+        return t.resident_level == t.finest_level;
+    });
+}
+
+void texture_streamer::print_stats(std::ostream& out) const {
+    if (textures.empty()) {
+        return;
+    }
+    out << "textures: " << bytes_streamed / (1024.0 * 1024.0) << " MiB streamed in " << busy_frames
+        << " frames (budget " << frame_budget / 1024 << " KiB per frame)\n";
+    for (texture_id id = 0; id < textures.size(); id++) {
+        const auto& t = textures[id];
+        out << '\t' << t.source.path << ": " << resident_levels(id) << '/' << t.source.levels.size()
+            << " levels resident";
+        if (t.resident_level == t.finest_level) {
+            out << ", complete after " << t.completed_frame - t.loaded_frame << " frames";
+        }
+        out << '\n';
+    }
+    out << std::flush;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <mapped_file.hpp>
+#include <gpu_allocator.hpp>
+#include <upload_manager.hpp>
+#include <descriptor_manager.hpp>
+
+#include <vector>
+#include <string>
+#include <map>
+#include <ostream>
+#include <cstdint>
+
+struct texture_level {
+    size_t offset;  // into the file
+    size_t size;
+    VkExtent3D extent;
+};
+
+/**
+ * A KTX2 or DDS file as it lies on disk. Only the header is parsed:
+ * the mip levels are ranges of the mapping, already in the layout
+ * vkCmdCopyBufferToImage expects (tightly packed rows of blocks), so
+ * they can be copied into staging memory as they are.
+ */
+struct texture_file {
+    std::string path;
+    mapped_file file;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    std::vector<texture_level> levels; // level 0 is the full resolution
+
+    const char* level_data(uint32_t level) const {
+        return static_cast<const char*>(file.data()) + levels[level].offset;
+    }
+};
+
+// throws on malformed files and on what cannot be uploaded without
+// decoding: supercompression, arrays, cube maps, 3D textures
+texture_file open_texture_file(const std::string& path);
+const char* texture_format_name(VkFormat format);
+
+/**
+ * Textures streamed from memory-mapped KTX2/DDS files with
+ * block-compressed (BC, ASTC) or plain RGBA8 data. load() only maps
+ * the file and creates the image; update() then uploads mip levels
+ * from the mapping into the staging ring, smallest first across all
+ * textures, until the per-frame budget is used up. A texture becomes
+ * visible as soon as its smallest level is resident and is refined
+ * over the following frames: each time more levels have arrived its
+ * view is recreated to include them and its bindless slot changes.
+ *
+ * A texture may come in several files with different formats (e.g.
+ * BC7 for desktop GPUs, ASTC for mobile ones); the first one whose
+ * format the device can sample from is used.
+ */
+class texture_streamer
+{
+public:
+    using texture_id = uint32_t;
+    static constexpr uint32_t no_descriptor = UINT32_MAX;
+
+    void init(VkPhysicalDevice physical_device, VkDevice device, const VkAllocationCallbacks* callbacks,
+              const VkPhysicalDeviceFeatures& enabled_features, gpu_allocator* allocator,
+              upload_manager* uploads, descriptor_manager* descriptors,
+              uint32_t frames_in_flight, VkDeviceSize frame_budget);
+    void destroy();
+
+    // `candidates` are the same texture in different formats; throws
+    // if the device supports none of them
+    texture_id load(const std::vector<std::string>& candidates);
+    bool is_format_supported(VkFormat format);
+
+    // call once per frame, before the upload batch is submitted and
+    // after the frame's fence has been waited on
+    void update(uint64_t frame_number);
+
+    // the bindless slot of the resident levels, no_descriptor until the
+    // first level has arrived (and always without bindless descriptors)
+    uint32_t descriptor_index(texture_id texture) const { return textures[texture].descriptor; }
+    uint32_t resident_levels(texture_id texture) const;
+    bool is_complete() const;
+    void print_stats(std::ostream& out) const;
+
+private:
+    struct pending_level {
+        uint32_t level;
+        upload_manager::ticket ticket;
+    };
+
+    struct texture {
+        texture_file source;
+        VkImage image = VK_NULL_HANDLE;
+        gpu_allocation allocation;
+        VkImageView view = VK_NULL_HANDLE;
+        uint32_t descriptor = no_descriptor;
+        // levels at and above this are resident, levels above next_level are queued
+        uint32_t resident_level;
+        uint32_t next_level;
+        // levels below this do not fit into the staging ring and are never streamed
+        uint32_t finest_level = 0;
+        std::vector<pending_level> pending;
+        uint64_t loaded_frame = 0;
+        uint64_t completed_frame = 0;
+    };
+
+    struct retired_view {
+        VkImageView view;
+        uint32_t descriptor;
+        uint64_t retired_at;
+    };
+
+    void make_resident(texture& t, uint32_t level, uint64_t frame_number);
+
+    VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks* callbacks = nullptr;
+    VkPhysicalDeviceFeatures enabled_features{};
+    gpu_allocator* allocator = nullptr;
+    upload_manager* uploads = nullptr;
+    descriptor_manager* descriptors = nullptr;
+    uint32_t frames_in_flight = 0;
+    VkDeviceSize frame_budget = 0;
+    uint64_t frame_number = 0;
+
+    VkSampler sampler = VK_NULL_HANDLE;
+    std::map<VkFormat, bool> format_support;
+    std::vector<texture> textures;
+    std::vector<retired_view> retired_views;
+    uint64_t bytes_streamed = 0;
+    uint64_t busy_frames = 0; // frames in which something was uploaded
+};
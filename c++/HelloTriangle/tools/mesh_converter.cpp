@@ -0,0 +1,396 @@
+#include <mesh_format.hpp>
+#include <mesh_optimizer.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Converts a Wavefront OBJ file into the binary mesh format of
+ * mesh_format.hpp, offline, so the app never parses text:
+ *
+ *   mesh_converter [--no-optimize] input.obj output.mesh
+ *
+ * Faces are triangulated as fans, each distinct position/texcoord/
+ * normal combination becomes one vertex. Missing normals are
+ * averaged from the faces; without vertex colors ("v x y z r g b")
+ * the normals double as colors, so the shape shows in the app's
+ * unlit shaders. --no-optimize keeps the order of the source, to see
+ * what the optimizations are worth.
+ */
+
+namespace {
+
+struct obj_mesh {
+    std::vector<float> positions; // xyz
+    std::vector<float> colors;    // rgb, empty when the file has none
+    std::vector<float> texcoords; // uv
+    std::vector<float> normals;   // xyz
+    // per face corner: position, texcoord and normal index, -1 when absent
+    std::vector<int32_t> corners;
+};
+
+struct corner_hash {
+    size_t operator()(const std::array<int32_t, 3>& corner) const {
+        return size_t(corner[0]) * 73856093u ^ size_t(corner[1]) * 19349663u ^ size_t(corner[2]) * 83492791u;
+    }
+};
+
+// OBJ indices start at 1, negative ones count back from the last element so far
+int32_t resolve_index(long index, size_t count, const std::string& path) {
+    long resolved = index > 0 ? index - 1 : static_cast<long>(count) + index;
+    if (index == 0 || resolved < 0 || resolved >= static_cast<long>(count)) {
+        throw std::runtime_error("face index out of range in " + path + "!");
+    }
+    return static_cast<int32_t>(resolved);
+}
+
+obj_mesh parse_obj(const std::string& path) {
+    mapped_file file(path);
+    const char* cursor = static_cast<const char*>(file.data());
+    const char* end = cursor + file.size();
+    obj_mesh mesh;
+    std::string line;
+    std::vector<std::array<int32_t, 3>> face;
+    while (cursor < end) {
+        const char* line_end = static_cast<const char*>(std::memchr(cursor, '\n', end - cursor));
+        line_end = line_end ? line_end : end;
+        // copied so that strtof/strtol stop at the end of the line
+        line.assign(cursor, line_end);
+        cursor = line_end + 1;
+        const char* c = line.c_str();
+        char* next;
+        if (line.compare(0, 2, "v ") == 0) {
+            float values[6];
+            int count = 0;
+            c += 2;
+            for (; count < 6; count++, c = next) {
+                values[count] = std::strtof(c, &next);
+                if (next == c) {
+                    break;
+                }
+            }
+            if (count < 3) {
+                throw std::runtime_error("malformed vertex in " + path + "!");
+            }
+            mesh.positions.insert(mesh.positions.end(), values, values + 3);
+            if (count == 6) {
+                mesh.colors.resize(mesh.positions.size() - 3, 1.0f);
+                mesh.colors.insert(mesh.colors.end(), values + 3, values + 6);
+            }
+        } else if (line.compare(0, 3, "vt ") == 0) {
+            float u = std::strtof(c + 3, &next);
+            float v = std::strtof(next, &next);
+            mesh.texcoords.push_back(u);
+            mesh.texcoords.push_back(v);
+        } else if (line.compare(0, 3, "vn ") == 0) {
+            c += 3;
+            for (int i = 0; i < 3; i++, c = next) {
+                mesh.normals.push_back(std::strtof(c, &next));
+            }
+        } else if (line.compare(0, 2, "f ") == 0) {
+            face.clear();
+            c += 2;
+            while (true) {
+                while (*c == ' ' || *c == '\t' || *c == '\r') {
+                    c++;
+                }
+                if (*c == '\0') {
+                    break;
+                }
+                std::array<int32_t, 3> corner = {-1, -1, -1};
+                corner[0] = resolve_index(std::strtol(c, &next, 10), mesh.positions.size() / 3, path);
+                c = next;
+                if (*c == '/') {
+                    c++;
+                    if (*c != '/') {
+                        corner[1] = resolve_index(std::strtol(c, &next, 10), mesh.texcoords.size() / 2, path);
+                        c = next;
+                    }
+                    if (*c == '/') {
+                        corner[2] = resolve_index(std::strtol(c + 1, &next, 10), mesh.normals.size() / 3, path);
+                        c = next;
+                    }
+                }
+                face.push_back(corner);
+            }
+            for (size_t i = 2; i < face.size(); i++) {
+                for (const auto& corner : {face[0], face[i - 1], face[i]}) {
+                    mesh.corners.insert(mesh.corners.end(), corner.begin(), corner.end());
+                }
+            }
+        }
+    }
+    if (!mesh.colors.empty()) {
+        mesh.colors.resize(mesh.positions.size(), 1.0f);
+    }
+    return mesh;
+}
+
+// round to nearest even, with subnormals, infinities and NaNs
+uint16_t float_to_half(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+    if (((bits >> 23) & 0xff) == 0xff) {
+        return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+    if (exponent >= 31) {
+        return static_cast<uint16_t>(sign | 0x7c00);
+    }
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return static_cast<uint16_t>(sign);
+        }
+        mantissa |= 0x800000;
+        uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) {
+            half++;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+    uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    // a carry out of the mantissa correctly rounds up to the next exponent, or infinity
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return static_cast<uint16_t>(sign | half);
+}
+
+template <typename T>
+T quantize_snorm(float value, float max) {
+    return static_cast<T>(std::lround(std::clamp(value, -1.0f, 1.0f) * max));
+}
+
+uint8_t quantize_unorm8(float value) {
+    return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+void normalize(float* v) {
+    float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (length > 0.0f) {
+        v[0] /= length;
+        v[1] /= length;
+        v[2] /= length;
+    }
+}
+
+uint64_t align16(uint64_t offset) {
+    return (offset + 15) & ~uint64_t(15);
+}
+
+}
+
+int main(int argc, char** argv) {
+    try {
+        bool optimize = true;
+        std::vector<std::string> paths;
+        for (int i = 1; i < argc; i++) {
+            std::string argument = argv[i];
+            if (argument == "--no-optimize") {
+                optimize = false;
+            } else {
+                paths.push_back(argument);
+            }
+        }
+        if (paths.size() != 2) {
+            std::cerr << "usage: " << argv[0] << " [--no-optimize] input.obj output.mesh" << std::endl;
+            return EXIT_FAILURE;
+        }
+        auto start = std::chrono::steady_clock::now();
+        obj_mesh obj = parse_obj(paths[0]);
+        if (obj.corners.empty()) {
+            throw std::runtime_error(paths[0] + " has no faces!");
+        }
+
+        // one vertex per distinct corner
+        std::unordered_map<std::array<int32_t, 3>, uint32_t, corner_hash> vertex_of;
+        std::vector<std::array<int32_t, 3>> corners;
+        std::vector<uint32_t> indices;
+        indices.reserve(obj.corners.size() / 3);
+        for (size_t i = 0; i < obj.corners.size(); i += 3) {
+            std::array<int32_t, 3> corner = {obj.corners[i], obj.corners[i + 1], obj.corners[i + 2]};
+            auto inserted = vertex_of.emplace(corner, static_cast<uint32_t>(corners.size()));
+            if (inserted.second) {
+                corners.push_back(corner);
+            }
+            indices.push_back(inserted.first->second);
+        }
+        size_t vertex_count = corners.size();
+
+        // normalized positions: centered, the largest side of the bounding box 1
+        float low[3] = {HUGE_VALF, HUGE_VALF, HUGE_VALF}, high[3] = {-HUGE_VALF, -HUGE_VALF, -HUGE_VALF};
+        for (const auto& corner : corners) {
+            for (int k = 0; k < 3; k++) {
+                low[k] = std::min(low[k], obj.positions[corner[0] * 3 + k]);
+                high[k] = std::max(high[k], obj.positions[corner[0] * 3 + k]);
+            }
+        }
+        float center[3];
+        float scale = 0.0f;
+        for (int k = 0; k < 3; k++) {
+            center[k] = (low[k] + high[k]) * 0.5f;
+            scale = std::max(scale, high[k] - low[k]);
+        }
+        scale = scale > 0.0f ? scale : 1.0f;
+        std::vector<float> positions(vertex_count * 3);
+        for (size_t v = 0; v < vertex_count; v++) {
+            for (int k = 0; k < 3; k++) {
+                positions[v * 3 + k] = (obj.positions[corners[v][0] * 3 + k] - center[k]) / scale;
+            }
+        }
+
+        std::vector<float> normals(vertex_count * 3, 0.0f);
+        bool has_normals = std::all_of(corners.begin(), corners.end(),
+                                       [](const std::array<int32_t, 3>& corner) { return corner[2] >= 0; });
+        if (has_normals) {
+            for (size_t v = 0; v < vertex_count; v++) {
+                std::copy_n(&obj.normals[corners[v][2] * 3], 3, &normals[v * 3]);
+            }
+        } else {
+            // area-weighted face normals
+            for (size_t i = 0; i < indices.size(); i += 3) {
+                const float* a = &positions[indices[i] * 3];
+                const float* b = &positions[indices[i + 1] * 3];
+                const float* c = &positions[indices[i + 2] * 3];
+                float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+                float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+                float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+                for (int k = 0; k < 3; k++) {
+                    for (int corner = 0; corner < 3; corner++) {
+                        normals[indices[i + corner] * 3 + k] += n[k];
+                    }
+                }
+            }
+        }
+        for (size_t v = 0; v < vertex_count; v++) {
+            normalize(&normals[v * 3]);
+        }
+        auto parsed = std::chrono::steady_clock::now();
+
+        vertex_cache_stats cache_before = analyze_vertex_cache(indices, vertex_count);
+        double overdraw_before = analyze_overdraw(indices, positions);
+        std::vector<uint32_t> remap;
+        if (optimize) {
+            optimize_vertex_cache(indices, vertex_count);
+            optimize_overdraw(indices, positions, 1.05f);
+            remap = optimize_vertex_fetch(indices, vertex_count);
+        } else {
+            remap.resize(vertex_count);
+            for (uint32_t v = 0; v < vertex_count; v++) {
+                remap[v] = v;
+            }
+        }
+        // the positions in the new vertex order, for the bounds
+        std::vector<float> final_positions(remap.size() * 3);
+        for (size_t v = 0; v < remap.size(); v++) {
+            std::copy_n(&positions[remap[v] * 3], 3, &final_positions[v * 3]);
+        }
+        vertex_cache_stats cache_after = analyze_vertex_cache(indices, remap.size());
+        double overdraw_after = analyze_overdraw(indices, final_positions);
+        std::vector<mesh_meshlet> meshlets = build_meshlets(indices, final_positions);
+        auto optimized = std::chrono::steady_clock::now();
+
+        std::vector<mesh_vertex> vertices(remap.size());
+        for (size_t v = 0; v < remap.size(); v++) {
+            uint32_t source = remap[v];
+            mesh_vertex& out = vertices[v];
+            // the normalized positions lie within [-0.5, 0.5]
+            for (int k = 0; k < 3; k++) {
+                out.position[k] = quantize_snorm<int16_t>(positions[source * 3 + k], 32767.0f);
+                out.normal[k] = quantize_snorm<int8_t>(normals[source * 3 + k], 127.0f);
+            }
+            out.position[3] = 0;
+            out.normal[3] = 0;
+            int32_t position_index = corners[source][0];
+            for (int k = 0; k < 3; k++) {
+                float color = obj.colors.empty() ? normals[source * 3 + k] * 0.5f + 0.5f
+                                                 : obj.colors[position_index * 3 + k];
+                out.color[k] = quantize_unorm8(color);
+            }
+            out.color[3] = 255;
+            int32_t texcoord_index = corners[source][1];
+            for (int k = 0; k < 2; k++) {
+                out.texcoord[k] = float_to_half(texcoord_index >= 0 ? obj.texcoords[texcoord_index * 2 + k] : 0.0f);
+            }
+        }
+
+        mesh_file_header header{};
+        std::memcpy(header.magic, mesh_file_magic, sizeof(header.magic));
+        header.version = mesh_file_version;
+        header.vertex_count = static_cast<uint32_t>(vertices.size());
+        header.index_count = static_cast<uint32_t>(indices.size());
+        header.index_size = vertices.size() <= 65536 ? 2 : 4;
+        header.meshlet_count = static_cast<uint32_t>(meshlets.size());
+        header.vertex_offset = align16(sizeof(header));
+        header.index_offset = align16(header.vertex_offset + vertices.size() * sizeof(mesh_vertex));
+        header.meshlet_offset = align16(header.index_offset + uint64_t(indices.size()) * header.index_size);
+        std::copy_n(center, 3, header.center);
+        header.scale = scale;
+        std::vector<uint32_t> all(vertices.size());
+        for (uint32_t v = 0; v < all.size(); v++) {
+            all[v] = v;
+        }
+        float sphere[4];
+        bounding_sphere(final_positions, all.data(), all.size(), sphere);
+        std::copy_n(sphere, 3, header.bounds_center);
+        header.bounds_radius = sphere[3];
+
+        std::ofstream out(paths[1], std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("failed to open " + paths[1] + "!");
+        }
+        auto pad_to = [&](uint64_t offset) {
+            static const char zeros[16] = {};
+            out.write(zeros, static_cast<std::streamsize>(offset - static_cast<uint64_t>(out.tellp())));
+        };
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        pad_to(header.vertex_offset);
+        out.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(mesh_vertex));
+        pad_to(header.index_offset);
+        if (header.index_size == 2) {
+            std::vector<uint16_t> short_indices(indices.begin(), indices.end());
+            out.write(reinterpret_cast<const char*>(short_indices.data()), short_indices.size() * sizeof(uint16_t));
+        } else {
+            out.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(uint32_t));
+        }
+        pad_to(header.meshlet_offset);
+        out.write(reinterpret_cast<const char*>(meshlets.data()), meshlets.size() * sizeof(mesh_meshlet));
+        out.close();
+        if (!out) {
+            throw std::runtime_error("failed to write " + paths[1] + "!");
+        }
+        auto written = std::chrono::steady_clock::now();
+
+        // read back the way the app does
+        mesh_file mesh = open_mesh_file(paths[1]);
+        auto ms = [](auto a, auto b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+        std::cout << paths[1] << ": " << mesh.header->vertex_count << " vertices, " << mesh.header->index_count / 3
+                  << " triangles, " << mesh.header->meshlet_count << " meshlets, " << mesh.header->index_size * 8
+                  << "-bit indices, " << mesh.file.size() << " bytes\n"
+                  << "\tvertex cache (16 entry FIFO): ACMR " << cache_before.acmr << " -> " << cache_after.acmr
+                  << ", ATVR " << cache_before.atvr << " -> " << cache_after.atvr << "\n"
+                  << "\toverdraw: " << overdraw_before << " -> " << overdraw_after << " shaded per covered pixel\n"
+                  << "\t" << ms(start, parsed) << " ms parsing, " << ms(parsed, optimized) << " ms optimizing, "
+                  << ms(optimized, written) << " ms writing" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
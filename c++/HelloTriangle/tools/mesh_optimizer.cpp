@@ -0,0 +1,494 @@
+#include <mesh_optimizer.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+const uint32_t no_vertex = std::numeric_limits<uint32_t>::max();
+
+struct vec3 {
+    float x, y, z;
+};
+
+vec3 position_of(const std::vector<float>& positions, uint32_t index) {
+    return {positions[index * 3 + 0], positions[index * 3 + 1], positions[index * 3 + 2]};
+}
+
+vec3 sub(vec3 a, vec3 b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+float dot(vec3 a, vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+vec3 cross(vec3 a, vec3 b) { return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x}; }
+float length(vec3 a) { return std::sqrt(dot(a, a)); }
+
+// the area-weighted normal (twice the area long) of a triangle
+vec3 triangle_normal(const std::vector<float>& positions, const uint32_t* triangle) {
+    vec3 a = position_of(positions, triangle[0]);
+    return cross(sub(position_of(positions, triangle[1]), a), sub(position_of(positions, triangle[2]), a));
+}
+
+/**
+ * A FIFO cache simulated with timestamps: a vertex is in the cache
+ * while fewer than `size` misses have happened since it was loaded.
+ */
+class fifo_cache
+{
+public:
+    fifo_cache(size_t vertex_count, uint32_t size) : loaded(vertex_count, 0), size(size), time(size + 1) {}
+
+    void clear() { time += size + 1; }
+
+    // returns the number of misses
+    uint32_t add_triangle(const uint32_t* triangle) {
+        uint32_t misses = 0;
+        for (int i = 0; i < 3; i++) {
+            if (time - loaded[triangle[i]] > size) {
+                loaded[triangle[i]] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+
+private:
+    std::vector<uint64_t> loaded;
+    uint64_t size;
+    uint64_t time;
+};
+
+// Forsyth's scoring: the three most recent vertices get a fixed score
+// (so the next triangle does not simply reuse the last one's edge),
+// older ones fall off with their cache position, and vertices with
+// few triangles left get a boost, so that no islands are left behind
+const uint32_t forsyth_cache_size = 32;
+
+float vertex_score(int32_t cache_position, uint32_t remaining) {
+    if (remaining == 0) {
+        return -1.0f;
+    }
+    float score = 0.0f;
+    if (cache_position >= 0) {
+        if (cache_position < 3) {
+            score = 0.75f;
+        } else {
+            float fraction = 1.0f - float(cache_position - 3) / (forsyth_cache_size - 3);
+            score = std::pow(fraction, 1.5f);
+        }
+    }
+    return score + 2.0f / std::sqrt(float(remaining));
+}
+
+}
+
+void optimize_vertex_cache(std::vector<uint32_t>& indices, size_t vertex_count) {
+    size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0) {
+        return;
+    }
+
+    // the triangles of every vertex, the live ones in front
+    std::vector<uint32_t> remaining(vertex_count, 0);
+    for (uint32_t index : indices) {
+        remaining[index]++;
+    }
+    std::vector<uint32_t> first_triangle(vertex_count + 1, 0);
+    for (size_t v = 0; v < vertex_count; v++) {
+        first_triangle[v + 1] = first_triangle[v] + remaining[v];
+    }
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<uint32_t> filled(first_triangle.begin(), first_triangle.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++) {
+            adjacency[filled[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    std::vector<int32_t> cache_position(vertex_count, -1);
+    std::vector<float> score(vertex_count);
+    for (size_t v = 0; v < vertex_count; v++) {
+        score[v] = vertex_score(-1, remaining[v]);
+    }
+    std::vector<float> triangle_score(triangle_count);
+    std::vector<bool> emitted(triangle_count, false);
+    uint32_t best = 0;
+    for (size_t t = 0; t < triangle_count; t++) {
+        triangle_score[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+        if (triangle_score[t] > triangle_score[best]) {
+            best = static_cast<uint32_t>(t);
+        }
+    }
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    std::vector<uint32_t> cache, next_cache;
+    size_t cursor = 0; // no triangle before it is still waiting
+    while (output.size() < indices.size()) {
+        if (best == no_vertex) {
+            // the cache holds no live triangle, restart at the next one in the input
+            while (emitted[cursor]) {
+                cursor++;
+            }
+            best = static_cast<uint32_t>(cursor);
+        }
+        const uint32_t* triangle = &indices[best * 3];
+        emitted[best] = true;
+        for (int i = 0; i < 3; i++) {
+            uint32_t v = triangle[i];
+            output.push_back(v);
+            // drop the triangle from the live ones of the vertex
+            uint32_t* begin = &adjacency[first_triangle[v]];
+            uint32_t* end = begin + remaining[v];
+            *std::find(begin, end, best) = *(end - 1);
+            remaining[v]--;
+        }
+
+        // the triangle's vertices move to the front, the rest keep their order
+        next_cache.assign(triangle, triangle + 3);
+        for (uint32_t v : cache) {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                next_cache.push_back(v);
+            }
+        }
+        for (size_t i = 0; i < next_cache.size(); i++) {
+            uint32_t v = next_cache[i];
+            cache_position[v] = i < forsyth_cache_size ? static_cast<int32_t>(i) : -1;
+            score[v] = vertex_score(cache_position[v], remaining[v]);
+        }
+        next_cache.resize(std::min<size_t>(next_cache.size(), forsyth_cache_size));
+        std::swap(cache, next_cache);
+
+        // only the triangles of cached vertices changed their score
+        best = no_vertex;
+        float best_score = -1.0f;
+        for (uint32_t v : cache) {
+            for (uint32_t i = first_triangle[v]; i < first_triangle[v] + remaining[v]; i++) {
+                uint32_t t = adjacency[i];
+                const uint32_t* other = &indices[t * 3];
+                triangle_score[t] = score[other[0]] + score[other[1]] + score[other[2]];
+                if (triangle_score[t] > best_score) {
+                    best_score = triangle_score[t];
+                    best = t;
+                }
+            }
+        }
+    }
+    indices = std::move(output);
+}
+
+void optimize_overdraw(std::vector<uint32_t>& indices, const std::vector<float>& positions, float threshold) {
+    size_t triangle_count = indices.size() / 3;
+    size_t vertex_count = positions.size() / 3;
+    if (triangle_count == 0) {
+        return;
+    }
+
+    // hard boundaries: triangles with all three vertices missing the
+    // cache, the order before and after them shares nothing
+    std::vector<size_t> hard = {0};
+    {
+        fifo_cache cache(vertex_count, 16);
+        for (size_t t = 0; t < triangle_count; t++) {
+            if (cache.add_triangle(&indices[t * 3]) == 3 && t > 0) {
+                hard.push_back(t);
+            }
+        }
+        hard.push_back(triangle_count);
+    }
+
+    // soft boundaries: within a hard cluster, cut wherever the cache
+    // has done about as well as it does over the whole cluster
+    std::vector<size_t> clusters;
+    fifo_cache cache(vertex_count, 16);
+    for (size_t c = 0; c + 1 < hard.size(); c++) {
+        size_t start = hard[c], end = hard[c + 1];
+        cache.clear();
+        uint32_t cluster_misses = 0;
+        for (size_t t = start; t < end; t++) {
+            cluster_misses += cache.add_triangle(&indices[t * 3]);
+        }
+        double acceptable = double(cluster_misses) / (end - start) * threshold;
+
+        cache.clear();
+        clusters.push_back(start);
+        size_t soft_start = start;
+        uint32_t misses = 0;
+        for (size_t t = start; t < end; t++) {
+            misses += cache.add_triangle(&indices[t * 3]);
+            if (t + 1 < end && double(misses) / (t + 1 - soft_start) <= acceptable) {
+                clusters.push_back(t + 1);
+                soft_start = t + 1;
+                misses = 0;
+                cache.clear();
+            }
+        }
+    }
+    clusters.push_back(triangle_count);
+
+    // clusters facing away from the center of the mesh are the ones most
+    // likely to be in front, draw them first
+    vec3 mesh_center{0.0f, 0.0f, 0.0f};
+    for (size_t v = 0; v < vertex_count; v++) {
+        vec3 p = position_of(positions, static_cast<uint32_t>(v));
+        mesh_center = {mesh_center.x + p.x, mesh_center.y + p.y, mesh_center.z + p.z};
+    }
+    float inverse_count = 1.0f / std::max<size_t>(vertex_count, 1);
+    mesh_center = {mesh_center.x * inverse_count, mesh_center.y * inverse_count, mesh_center.z * inverse_count};
+
+    size_t cluster_count = clusters.size() - 1;
+    std::vector<float> sort_key(cluster_count);
+    for (size_t c = 0; c < cluster_count; c++) {
+        vec3 center{0.0f, 0.0f, 0.0f};
+        vec3 normal{0.0f, 0.0f, 0.0f};
+        float area = 0.0f;
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+            const uint32_t* triangle = &indices[t * 3];
+            vec3 n = triangle_normal(positions, triangle);
+            float weight = length(n);
+            vec3 a = position_of(positions, triangle[0]);
+            vec3 b = position_of(positions, triangle[1]);
+            vec3 d = position_of(positions, triangle[2]);
+            center.x += (a.x + b.x + d.x) / 3.0f * weight;
+            center.y += (a.y + b.y + d.y) / 3.0f * weight;
+            center.z += (a.z + b.z + d.z) / 3.0f * weight;
+            normal = {normal.x + n.x, normal.y + n.y, normal.z + n.z};
+            area += weight;
+        }
+        if (area > 0.0f) {
+            center = {center.x / area, center.y / area, center.z / area};
+        }
+        float normal_length = length(normal);
+        if (normal_length > 0.0f) {
+            normal = {normal.x / normal_length, normal.y / normal_length, normal.z / normal_length};
+        }
+        sort_key[c] = dot(sub(center, mesh_center), normal);
+    }
+
+    std::vector<uint32_t> order(cluster_count);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sort_key[a] > sort_key[b]; });
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    for (uint32_t c : order) {
+        output.insert(output.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+    }
+    indices = std::move(output);
+}
+
+std::vector<uint32_t> optimize_vertex_fetch(std::vector<uint32_t>& indices, size_t vertex_count) {
+    std::vector<uint32_t> new_index(vertex_count, no_vertex);
+    std::vector<uint32_t> remap;
+    remap.reserve(vertex_count);
+    for (uint32_t& index : indices) {
+        if (new_index[index] == no_vertex) {
+            new_index[index] = static_cast<uint32_t>(remap.size());
+            remap.push_back(index);
+        }
+        index = new_index[index];
+    }
+    // vertices no triangle uses are dropped
+    return remap;
+}
+
+void bounding_sphere(const std::vector<float>& positions, const uint32_t* vertices, size_t count, float sphere[4]) {
+    // start from the pair of extreme points along the axis they are furthest apart on
+    uint32_t extremes[3][2];
+    for (int axis = 0; axis < 3; axis++) {
+        extremes[axis][0] = extremes[axis][1] = vertices[0];
+        for (size_t i = 1; i < count; i++) {
+            float value = positions[vertices[i] * 3 + axis];
+            if (value < positions[extremes[axis][0] * 3 + axis]) {
+                extremes[axis][0] = vertices[i];
+            }
+            if (value > positions[extremes[axis][1] * 3 + axis]) {
+                extremes[axis][1] = vertices[i];
+            }
+        }
+    }
+    int widest = 0;
+    float widest_distance = -1.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        vec3 d = sub(position_of(positions, extremes[axis][1]), position_of(positions, extremes[axis][0]));
+        if (dot(d, d) > widest_distance) {
+            widest_distance = dot(d, d);
+            widest = axis;
+        }
+    }
+    vec3 a = position_of(positions, extremes[widest][0]);
+    vec3 b = position_of(positions, extremes[widest][1]);
+    vec3 center{(a.x + b.x) * 0.5f, (a.y + b.y) * 0.5f, (a.z + b.z) * 0.5f};
+    float radius = std::sqrt(widest_distance) * 0.5f;
+
+    // grow it just enough to take in every point outside
+    for (size_t i = 0; i < count; i++) {
+        vec3 p = position_of(positions, vertices[i]);
+        vec3 d = sub(p, center);
+        float distance = length(d);
+        if (distance > radius) {
+            float grow = (distance - radius) * 0.5f;
+            center = {center.x + d.x / distance * grow, center.y + d.y / distance * grow,
+                      center.z + d.z / distance * grow};
+            radius += grow;
+        }
+    }
+    sphere[0] = center.x;
+    sphere[1] = center.y;
+    sphere[2] = center.z;
+    sphere[3] = radius;
+}
+
+std::vector<mesh_meshlet> build_meshlets(const std::vector<uint32_t>& indices, const std::vector<float>& positions) {
+    size_t vertex_count = positions.size() / 3;
+    std::vector<mesh_meshlet> meshlets;
+    // which meshlet last used a vertex, to count the distinct ones
+    std::vector<uint32_t> used_by(vertex_count, no_vertex);
+    std::vector<uint32_t> vertices;
+
+    auto finish = [&](mesh_meshlet& meshlet) {
+        float sphere[4];
+        bounding_sphere(positions, vertices.data(), vertices.size(), sphere);
+        std::copy(sphere, sphere + 3, meshlet.center);
+        meshlet.radius = sphere[3];
+
+        // the cone around the average normal that holds all the triangle normals
+        vec3 axis{0.0f, 0.0f, 0.0f};
+        std::vector<vec3> normals;
+        for (uint32_t t = 0; t < meshlet.triangle_count; t++) {
+            vec3 n = triangle_normal(positions, &indices[meshlet.first_index + t * 3]);
+            float n_length = length(n);
+            if (n_length > 0.0f) {
+                n = {n.x / n_length, n.y / n_length, n.z / n_length};
+                normals.push_back(n);
+                axis = {axis.x + n.x, axis.y + n.y, axis.z + n.z};
+            }
+        }
+        float axis_length = length(axis);
+        float min_dot = 1.0f;
+        if (axis_length > 0.0f) {
+            axis = {axis.x / axis_length, axis.y / axis_length, axis.z / axis_length};
+            for (vec3 n : normals) {
+                min_dot = std::min(min_dot, dot(n, axis));
+            }
+        } else {
+            min_dot = -1.0f;
+        }
+        meshlet.cone_axis[0] = axis.x;
+        meshlet.cone_axis[1] = axis.y;
+        meshlet.cone_axis[2] = axis.z;
+        // wider than about 84 degrees the cone culls too little to be worth a test
+        meshlet.cone_cutoff = min_dot <= 0.1f ? 1.0f : std::sqrt(1.0f - min_dot * min_dot);
+        meshlets.push_back(meshlet);
+    };
+
+    mesh_meshlet meshlet{};
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        uint32_t id = static_cast<uint32_t>(meshlets.size());
+        uint32_t new_vertices = 0;
+        for (int k = 0; k < 3; k++) {
+            // a vertex repeated within the triangle counts once
+            bool repeated = (k > 0 && indices[i + k] == indices[i]) || (k > 1 && indices[i + k] == indices[i + 1]);
+            new_vertices += used_by[indices[i + k]] != id && !repeated;
+        }
+        if (meshlet.triangle_count > 0 && (meshlet.vertex_count + new_vertices > meshlet_max_vertices ||
+                                           meshlet.triangle_count == meshlet_max_triangles)) {
+            finish(meshlet);
+            meshlet = mesh_meshlet{};
+            vertices.clear();
+            id++;
+        }
+        if (meshlet.triangle_count == 0) {
+            meshlet.first_index = static_cast<uint32_t>(i);
+        }
+        for (int k = 0; k < 3; k++) {
+            if (used_by[indices[i + k]] != id) {
+                used_by[indices[i + k]] = id;
+                vertices.push_back(indices[i + k]);
+                meshlet.vertex_count++;
+            }
+        }
+        meshlet.triangle_count++;
+    }
+    if (meshlet.triangle_count > 0) {
+        finish(meshlet);
+    }
+    return meshlets;
+}
+
+vertex_cache_stats analyze_vertex_cache(const std::vector<uint32_t>& indices, size_t vertex_count,
+                                        uint32_t cache_size) {
+    vertex_cache_stats stats;
+    if (indices.empty() || vertex_count == 0) {
+        return stats;
+    }
+    fifo_cache cache(vertex_count, cache_size);
+    uint64_t misses = 0;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        misses += cache.add_triangle(&indices[i]);
+    }
+    stats.acmr = double(misses) / (indices.size() / 3);
+    stats.atvr = double(misses) / vertex_count;
+    return stats;
+}
+
+double analyze_overdraw(const std::vector<uint32_t>& indices, const std::vector<float>& positions) {
+    const int grid = 256;
+    vec3 low{std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+    vec3 high{-low.x, -low.y, -low.z};
+    for (size_t i = 0; i + 2 < positions.size(); i += 3) {
+        low = {std::min(low.x, positions[i]), std::min(low.y, positions[i + 1]), std::min(low.z, positions[i + 2])};
+        high = {std::max(high.x, positions[i]), std::max(high.y, positions[i + 1]), std::max(high.z, positions[i + 2])};
+    }
+    float extent = std::max({high.x - low.x, high.y - low.y, high.z - low.z, 1e-20f});
+
+    uint64_t covered = 0, shaded = 0;
+    std::vector<float> depth(grid * grid);
+    for (int axis = 0; axis < 3; axis++) {
+        for (int side = 0; side < 2; side++) {
+            std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::max());
+            for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+                // project onto the other two axes; the projection is mirrored
+                // when looking down the axis, so that counter-clockwise
+                // triangles facing the viewer have a positive area either way
+                float x[3], y[3], z[3];
+                for (int k = 0; k < 3; k++) {
+                    const float* p = &positions[indices[i + k] * 3];
+                    float u = (p[(axis + 1) % 3] - (&low.x)[(axis + 1) % 3]) / extent;
+                    float v = (p[(axis + 2) % 3] - (&low.x)[(axis + 2) % 3]) / extent;
+                    x[k] = (side ? u : 1.0f - u) * grid;
+                    y[k] = v * grid;
+                    z[k] = side ? -p[axis] : p[axis];
+                }
+                float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+                if (area <= 0.0f) {
+                    continue; // back-facing or degenerate
+                }
+                int min_x = std::max(0, int(std::floor(std::min({x[0], x[1], x[2]}))));
+                int max_x = std::min(grid - 1, int(std::ceil(std::max({x[0], x[1], x[2]}))));
+                int min_y = std::max(0, int(std::floor(std::min({y[0], y[1], y[2]}))));
+                int max_y = std::min(grid - 1, int(std::ceil(std::max({y[0], y[1], y[2]}))));
+                for (int py = min_y; py <= max_y; py++) {
+                    for (int px = min_x; px <= max_x; px++) {
+                        float cx = px + 0.5f, cy = py + 0.5f;
+                        float w0 = (x[2] - x[1]) * (cy - y[1]) - (y[2] - y[1]) * (cx - x[1]);
+                        float w1 = (x[0] - x[2]) * (cy - y[2]) - (y[0] - y[2]) * (cx - x[2]);
+                        float w2 = area - w0 - w1;
+                        if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) {
+                            continue;
+                        }
+                        float pixel_depth = (w0 * z[0] + w1 * z[1] + w2 * z[2]) / area;
+                        float& stored = depth[py * grid + px];
+                        if (stored == std::numeric_limits<float>::max()) {
+                            covered++;
+                        }
+                        if (pixel_depth < stored) {
+                            stored = pixel_depth;
+                            shaded++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return covered > 0 ? double(shaded) / covered : 0.0;
+}
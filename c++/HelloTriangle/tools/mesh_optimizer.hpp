@@ -0,0 +1,46 @@
+#pragma once
+
+#include <mesh_format.hpp>
+
+#include <vector>
+#include <cstdint>
+
+/**
+ * The index and vertex reordering of tools/mesh_converter. The passes
+ * run in this order, each one keeping what the previous one achieved
+ * as far as it can:
+ *  1. optimize_vertex_cache() orders triangles for the post-transform
+ *     vertex cache (Forsyth's linear-speed algorithm),
+ *  2. optimize_overdraw() splits that order into clusters where the
+ *     cache starts over anyway and sorts the clusters so that the ones
+ *     facing outwards are drawn first (after Sander et al., "Fast
+ *     Triangle Reordering for Vertex Locality and Reduced Overdraw"),
+ *  3. optimize_vertex_fetch() renumbers the vertices in the order the
+ *     indices first use them, so that fetches walk the vertex buffer,
+ *  4. build_meshlets() cuts the final order into meshlets and computes
+ *     their bounds.
+ * Positions are passed as xyz triples, indices as triangle lists.
+ */
+
+void optimize_vertex_cache(std::vector<uint32_t>& indices, size_t vertex_count);
+// `threshold` is how much worse than the cache order a cluster may get
+// in vertex transforms per triangle to be split further, e.g. 1.05
+void optimize_overdraw(std::vector<uint32_t>& indices, const std::vector<float>& positions, float threshold);
+// returns the new order of the vertices: remap[new index] = old index
+std::vector<uint32_t> optimize_vertex_fetch(std::vector<uint32_t>& indices, size_t vertex_count);
+std::vector<mesh_meshlet> build_meshlets(const std::vector<uint32_t>& indices, const std::vector<float>& positions);
+
+// the smallest sphere found by Ritter's algorithm: center xyz and radius
+void bounding_sphere(const std::vector<float>& positions, const uint32_t* vertices, size_t count, float sphere[4]);
+
+struct vertex_cache_stats {
+    double acmr = 0.0; // vertex transforms per triangle, 0.5 is ideal for large grids, 3 the worst
+    double atvr = 0.0; // vertex transforms per vertex, 1 is ideal
+};
+
+// a FIFO post-transform cache, the kind most hardware approximates
+vertex_cache_stats analyze_vertex_cache(const std::vector<uint32_t>& indices, size_t vertex_count,
+                                        uint32_t cache_size = 16);
+// the shaded pixels per covered pixel, rasterized with a depth test
+// from the six axis directions
+double analyze_overdraw(const std::vector<uint32_t>& indices, const std::vector<float>& positions);
@@ -0,0 +1,138 @@
+#include <transform_system.hpp>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <thread>
+
+/**
+ * transform_system against the way this is usually written: an array
+ * of nodes, each composing a glm::mat4 from its translation, rotation
+ * and scale and multiplying it with its parent's. Both get the same
+ * hierarchy (a forest of 4-ary trees, 64 nodes per tree) and move the
+ * same roots every iteration, so every world matrix is recomputed.
+ */
+
+namespace {
+
+struct glm_node {
+    glm::vec3 position;
+    glm::quat rotation;
+    glm::vec3 scale;
+    uint32_t parent;
+    glm::mat4 world;
+};
+
+// node `roots + 4 * p + k` is child k of node p
+uint32_t benchmark_parent(uint32_t n, uint32_t roots) {
+    return n < roots ? transform_system::no_parent : (n - roots) / 4;
+}
+
+float root_offset(uint32_t iteration) {
+    return std::sin(static_cast<float>(iteration) * 0.01f);
+}
+
+template <typename function>
+double time_ms(uint32_t iterations, function&& body) {
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        body(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+// the largest difference of any component between the two sets of world matrices
+float max_difference(const std::vector<glm_node>& nodes, const transform_system& transforms) {
+    float difference = 0.0f;
+    float matrix[12];
+    for (uint32_t n = 0; n < nodes.size(); n++) {
+        transforms.get_world(n, matrix);
+        for (int row = 0; row < 3; row++) {
+            for (int column = 0; column < 4; column++) {
+                difference = std::max(difference, std::abs(matrix[row * 4 + column] - nodes[n].world[column][row]));
+            }
+        }
+    }
+    return difference;
+}
+
+}
+
+void benchmark_transforms(uint32_t node_count, uint32_t iterations) {
+    uint32_t roots = std::max(1u, node_count / 64);
+    std::cout << "composing " << node_count << " transforms (" << roots << " roots), " << iterations
+              << " iterations per run\n";
+
+    // a fixed seed, so that runs see the same hierarchy
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> size(0.5f, 1.5f);
+    std::vector<glm_node> nodes(node_count);
+    transform_system transforms;
+    for (uint32_t n = 0; n < node_count; n++) {
+        auto& node = nodes[n];
+        node.position = glm::vec3(unit(random), unit(random), unit(random)) * 4.0f;
+        node.rotation = glm::normalize(glm::quat(unit(random), unit(random), unit(random), unit(random)));
+        node.scale = glm::vec3(size(random), size(random), size(random));
+        node.parent = benchmark_parent(n, roots);
+        transforms.create(node.parent);
+        transforms.set_position(n, node.position.x, node.position.y, node.position.z);
+        transforms.set_rotation(n, node.rotation.x, node.rotation.y, node.rotation.z, node.rotation.w);
+        transforms.set_scale(n, node.scale.x, node.scale.y, node.scale.z);
+    }
+
+    double glm_ms = time_ms(iterations, [&](uint32_t iteration) {
+        for (uint32_t n = 0; n < roots; n++) {
+            nodes[n].position.y = root_offset(iteration);
+        }
+        for (auto& node : nodes) {
+            glm::mat4 local = glm::translate(glm::mat4(1.0f), node.position) * glm::mat4_cast(node.rotation) *
+                              glm::scale(glm::mat4(1.0f), node.scale);
+            node.world = node.parent == transform_system::no_parent ? local : nodes[node.parent].world * local;
+        }
+    });
+    std::cout << "\tglm::mat4: " << glm_ms << " ms/update\n";
+
+    // `moving` of the roots get a new position every iteration
+    auto run = [&](const char* name, job_system* jobs, uint32_t slices, uint32_t moving) {
+        double ms = time_ms(iterations, [&](uint32_t iteration) {
+            for (uint32_t n = 0; n < moving; n++) {
+                transforms.set_position(n, nodes[n].position.x, root_offset(iteration), nodes[n].position.z);
+            }
+            transforms.update(jobs, slices);
+        });
+        std::cout << "\t" << name << ": " << ms << " ms/update, " << glm_ms / ms << "x glm, "
+                  << transforms.worlds_composed() << " world matrices";
+        if (moving == roots) {
+            std::cout << ", max difference " << max_difference(nodes, transforms);
+        }
+        std::cout << "\n";
+    };
+
+    auto best = transforms.get_simd_level();
+    for (auto level : {transform_system::simd_level::scalar, transform_system::simd_level::sse,
+                       transform_system::simd_level::avx2}) {
+        transforms.set_simd_level(level);
+        if (transforms.get_simd_level() != level) {
+            std::cout << "\t" << transform_system::simd_level_name(level) << ": not supported by this CPU\n";
+            continue;
+        }
+        run(transform_system::simd_level_name(level), nullptr, 1, roots);
+    }
+    transforms.set_simd_level(best);
+
+    uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+    job_system jobs(threads);
+    std::string name = std::string(transform_system::simd_level_name(best)) + ", " + std::to_string(threads) + " threads";
+    run(name.c_str(), &jobs, threads, roots);
+    name += ", 10% moving";
+    run(name.c_str(), &jobs, threads, std::max(1u, roots / 10));
+    std::cout << std::flush;
+}
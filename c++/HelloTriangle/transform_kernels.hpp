@@ -0,0 +1,93 @@
+#pragma once
+
+// included by translation units compiled for different instruction
+// sets (see transform_kernels_avx2.cpp), so nothing here may pull in
+// inline library code the linker could pick from the wrong one
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * The structure-of-arrays storage of transform_system as the kernels
+ * see it. Matrices are affine 3x4, row-major: components 0-3 are the
+ * first row, the translation is in components 3, 7 and 11.
+ */
+struct transform_arrays {
+    const float* position[3];
+    const float* rotation[4]; // unit quaternion x, y, z, w
+    const float* scale[3];
+    float* local[12];
+    float* world[12];
+};
+
+/**
+ * The kernels, written once against a "pack" of `width` floats:
+ * a plain float for the scalar path, __m128 for SSE and __m256 for
+ * AVX2. A pack provides load/store, set1, add/sub/mul, fma (a * b + c)
+ * and gather/scatter through a list of node indices.
+ */
+
+// local = translation * rotation * scale for nodes [begin, end), whole packs only
+template <typename pack>
+void compose_local_packs(const transform_arrays& arrays, size_t begin, size_t end) {
+    using v = typename pack::type;
+    const v one = pack::set1(1.0f);
+    for (size_t i = begin; i + pack::width <= end; i += pack::width) {
+        v x = pack::load(arrays.rotation[0] + i);
+        v y = pack::load(arrays.rotation[1] + i);
+        v z = pack::load(arrays.rotation[2] + i);
+        v w = pack::load(arrays.rotation[3] + i);
+        v x2 = pack::add(x, x), y2 = pack::add(y, y), z2 = pack::add(z, z);
+        v xx = pack::mul(x, x2), yy = pack::mul(y, y2), zz = pack::mul(z, z2);
+        v xy = pack::mul(x, y2), xz = pack::mul(x, z2), yz = pack::mul(y, z2);
+        v wx = pack::mul(w, x2), wy = pack::mul(w, y2), wz = pack::mul(w, z2);
+        v sx = pack::load(arrays.scale[0] + i);
+        v sy = pack::load(arrays.scale[1] + i);
+        v sz = pack::load(arrays.scale[2] + i);
+
+        pack::store(arrays.local[0] + i, pack::mul(pack::sub(one, pack::add(yy, zz)), sx));
+        pack::store(arrays.local[1] + i, pack::mul(pack::sub(xy, wz), sy));
+        pack::store(arrays.local[2] + i, pack::mul(pack::add(xz, wy), sz));
+        pack::store(arrays.local[3] + i, pack::load(arrays.position[0] + i));
+        pack::store(arrays.local[4] + i, pack::mul(pack::add(xy, wz), sx));
+        pack::store(arrays.local[5] + i, pack::mul(pack::sub(one, pack::add(xx, zz)), sy));
+        pack::store(arrays.local[6] + i, pack::mul(pack::sub(yz, wx), sz));
+        pack::store(arrays.local[7] + i, pack::load(arrays.position[1] + i));
+        pack::store(arrays.local[8] + i, pack::mul(pack::sub(xz, wy), sx));
+        pack::store(arrays.local[9] + i, pack::mul(pack::add(yz, wx), sy));
+        pack::store(arrays.local[10] + i, pack::mul(pack::sub(one, pack::add(xx, yy)), sz));
+        pack::store(arrays.local[11] + i, pack::load(arrays.position[2] + i));
+    }
+}
+
+// world[nodes[i]] = world[parents[i]] * local[nodes[i]] for i in [0, count), whole packs only
+template <typename pack>
+void compose_world_packs(const transform_arrays& arrays, const uint32_t* nodes, const uint32_t* parents,
+                         size_t count) {
+    using v = typename pack::type;
+    for (size_t i = 0; i + pack::width <= count; i += pack::width) {
+        v local[12];
+        for (int c = 0; c < 12; c++) {
+            local[c] = pack::gather(arrays.local[c], nodes + i);
+        }
+        for (int row = 0; row < 3; row++) {
+            v p0 = pack::gather(arrays.world[row * 4 + 0], parents + i);
+            v p1 = pack::gather(arrays.world[row * 4 + 1], parents + i);
+            v p2 = pack::gather(arrays.world[row * 4 + 2], parents + i);
+            v p3 = pack::gather(arrays.world[row * 4 + 3], parents + i);
+            for (int column = 0; column < 4; column++) {
+                v sum = pack::fma(p0, local[column], pack::fma(p1, local[4 + column], pack::mul(p2, local[8 + column])));
+                if (column == 3) {
+                    sum = pack::add(sum, p3);
+                }
+                pack::scatter(arrays.world[row * 4 + column], nodes + i, sum);
+            }
+        }
+    }
+}
+
+// the entry points of the instruction sets, x86-64 only; they
+// process whole packs and leave the rest to the scalar path
+void compose_local_sse(const transform_arrays& arrays, size_t begin, size_t end);
+void compose_world_sse(const transform_arrays& arrays, const uint32_t* nodes, const uint32_t* parents, size_t count);
+void compose_local_avx2(const transform_arrays& arrays, size_t begin, size_t end);
+void compose_world_avx2(const transform_arrays& arrays, const uint32_t* nodes, const uint32_t* parents, size_t count);
@@ -0,0 +1,51 @@
+// the whole translation unit is compiled for AVX2 and FMA, which
+// transform_system only calls into after checking the CPU has them;
+// the Makefile builds every file with the same flags
+#if defined(__x86_64__) && defined(__GNUC__)
+#pragma GCC target("avx2,fma")
+#endif
+
+#include <transform_kernels.hpp>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+
+#include <immintrin.h>
+
+namespace {
+
+struct avx2_pack {
+    using type = __m256;
+    static constexpr size_t width = 8;
+
+    static type load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, type value) { _mm256_storeu_ps(p, value); }
+    static type set1(float value) { return _mm256_set1_ps(value); }
+    static type add(type a, type b) { return _mm256_add_ps(a, b); }
+    static type sub(type a, type b) { return _mm256_sub_ps(a, b); }
+    static type mul(type a, type b) { return _mm256_mul_ps(a, b); }
+    static type fma(type a, type b, type c) { return _mm256_fmadd_ps(a, b, c); }
+    static type gather(const float* base, const uint32_t* indices) {
+        __m256i offsets = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices));
+        return _mm256_i32gather_ps(base, offsets, 4);
+    }
+    // AVX2 has no scatter
+    static void scatter(float* base, const uint32_t* indices, type value) {
+        alignas(32) float lanes[8];
+        _mm256_store_ps(lanes, value);
+        for (size_t i = 0; i < 8; i++) {
+            base[indices[i]] = lanes[i];
+        }
+    }
+};
+
+}
+
+void compose_local_avx2(const transform_arrays& arrays, size_t begin, size_t end) {
+    compose_local_packs<avx2_pack>(arrays, begin, end);
+}
+
+void compose_world_avx2(const transform_arrays& arrays, const uint32_t* nodes, const uint32_t* parents, size_t count) {
+    compose_world_packs<avx2_pack>(arrays, nodes, parents, count);
+}
+
+#endif
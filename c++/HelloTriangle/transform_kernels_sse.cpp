@@ -0,0 +1,43 @@
+#include <transform_kernels.hpp>
+
+// SSE2 is part of x86-64, this needs no run-time check
+#if defined(__x86_64__)
+
+#include <immintrin.h>
+
+namespace {
+
+struct sse_pack {
+    using type = __m128;
+    static constexpr size_t width = 4;
+
+    static type load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, type value) { _mm_storeu_ps(p, value); }
+    static type set1(float value) { return _mm_set1_ps(value); }
+    static type add(type a, type b) { return _mm_add_ps(a, b); }
+    static type sub(type a, type b) { return _mm_sub_ps(a, b); }
+    static type mul(type a, type b) { return _mm_mul_ps(a, b); }
+    static type fma(type a, type b, type c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static type gather(const float* base, const uint32_t* indices) {
+        return _mm_setr_ps(base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]]);
+    }
+    static void scatter(float* base, const uint32_t* indices, type value) {
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, value);
+        for (size_t i = 0; i < 4; i++) {
+            base[indices[i]] = lanes[i];
+        }
+    }
+};
+
+}
+
+void compose_local_sse(const transform_arrays& arrays, size_t begin, size_t end) {
+    compose_local_packs<sse_pack>(arrays, begin, end);
+}
+
+void compose_world_sse(const transform_arrays& arrays, const uint32_t* nodes, const uint32_t* parents, size_t count) {
+    compose_world_packs<sse_pack>(arrays, nodes, parents, count);
+}
+
+#endif
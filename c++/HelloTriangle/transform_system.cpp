@@ -0,0 +1,290 @@
+#include <transform_system.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+namespace {
+
+struct scalar_pack {
+    using type = float;
+    static constexpr size_t width = 1;
+
+    static type load(const float* p) { return *p; }
+    static void store(float* p, type value) { *p = value; }
+    static type set1(float value) { return value; }
+    static type add(type a, type b) { return a + b; }
+    static type sub(type a, type b) { return a - b; }
+    static type mul(type a, type b) { return a * b; }
+    static type fma(type a, type b, type c) { return a * b + c; }
+    static type gather(const float* base, const uint32_t* indices) { return base[indices[0]]; }
+    static void scatter(float* base, const uint32_t* indices, type value) { base[indices[0]] = value; }
+};
+
+// waking the workers costs more than composing this many nodes
+const size_t min_parallel_nodes = 4096;
+
+// `count` items of `item_size` nodes each
+void run(job_system* jobs, uint32_t slices, size_t count, size_t item_size,
+         const std::function<void(uint32_t, size_t, size_t)>& job) {
+    if (jobs == nullptr || slices <= 1 || count * item_size < min_parallel_nodes) {
+        job(0, 0, count);
+    } else {
+        jobs->parallel_for(slices, count, job);
+    }
+}
+
+bool cpu_has_avx2() {
+#if defined(__x86_64__) && defined(__GNUC__)
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return false;
+#endif
+}
+
+}
+
+transform_system::transform_system() {
+    set_simd_level(simd_level::avx2);
+}
+
+void transform_system::set_simd_level(simd_level level) {
+#if defined(__x86_64__)
+    if (level == simd_level::avx2 && !cpu_has_avx2()) {
+        level = simd_level::sse;
+    }
+#else
+    level = simd_level::scalar;
+#endif
+    simd = level;
+}
+
+const char* transform_system::simd_level_name(simd_level level) {
+    switch (level) {
+    case simd_level::scalar:
+        return "scalar";
+    case simd_level::sse:
+        return "SSE";
+    case simd_level::avx2:
+        return "AVX2";
+    }
+    return "unknown";
+}
+
+transform_system::node transform_system::create(node parent) {
+    if (parent != no_parent && parent >= size()) {
+        throw std::runtime_error("failed to create a transform, its parent does not exist yet!");
+    }
+    auto n = static_cast<node>(size());
+    for (int c = 0; c < 3; c++) {
+        position[c].push_back(0.0f);
+        scale[c].push_back(1.0f);
+    }
+    for (int c = 0; c < 4; c++) {
+        rotation[c].push_back(c == 3 ? 1.0f : 0.0f);
+    }
+    for (int c = 0; c < 12; c++) {
+        // identity: components 0, 5 and 10 are the diagonal
+        local[c].push_back(c % 5 == 0 ? 1.0f : 0.0f);
+        world[c].push_back(c % 5 == 0 ? 1.0f : 0.0f);
+    }
+    parents.push_back(parent);
+    dirty.push_back(dirty_local);
+    changed_at.push_back(0);
+    changed.push_back(0);
+    levels_valid = false;
+    return n;
+}
+
+void transform_system::clear() {
+    for (int c = 0; c < 3; c++) {
+        position[c].clear();
+        scale[c].clear();
+    }
+    for (int c = 0; c < 4; c++) {
+        rotation[c].clear();
+    }
+    for (int c = 0; c < 12; c++) {
+        local[c].clear();
+        world[c].clear();
+    }
+    parents.clear();
+    dirty.clear();
+    changed_at.clear();
+    changed.clear();
+    levels_valid = false;
+}
+
+void transform_system::set_position(node n, float x, float y, float z) {
+    position[0][n] = x;
+    position[1][n] = y;
+    position[2][n] = z;
+    dirty[n] = dirty_local;
+}
+
+void transform_system::set_rotation(node n, float x, float y, float z, float w) {
+    rotation[0][n] = x;
+    rotation[1][n] = y;
+    rotation[2][n] = z;
+    rotation[3][n] = w;
+    dirty[n] = dirty_local;
+}
+
+void transform_system::set_scale(node n, float x, float y, float z) {
+    scale[0][n] = x;
+    scale[1][n] = y;
+    scale[2][n] = z;
+    dirty[n] = dirty_local;
+}
+
+void transform_system::get_world(node n, float matrix[12]) const {
+    for (int c = 0; c < 12; c++) {
+        matrix[c] = world[c][n];
+    }
+}
+
+transform_arrays transform_system::arrays() {
+    transform_arrays a;
+    for (int c = 0; c < 3; c++) {
+        a.position[c] = position[c].data();
+        a.scale[c] = scale[c].data();
+    }
+    for (int c = 0; c < 4; c++) {
+        a.rotation[c] = rotation[c].data();
+    }
+    for (int c = 0; c < 12; c++) {
+        a.local[c] = local[c].data();
+        a.world[c] = world[c].data();
+    }
+    return a;
+}
+
+// whole packs with the widest instruction set, the rest one by one
+void transform_system::compose_locals(const transform_arrays& a, size_t begin, size_t end) const {
+    size_t done = begin;
+#if defined(__x86_64__)
+    if (simd == simd_level::avx2) {
+        compose_local_avx2(a, begin, end);
+        done = begin + (end - begin) / 8 * 8;
+    } else if (simd == simd_level::sse) {
+        compose_local_sse(a, begin, end);
+        done = begin + (end - begin) / 4 * 4;
+    }
+#endif
+    compose_local_packs<scalar_pack>(a, done, end);
+}
+
+void transform_system::compose_worlds(const transform_arrays& a, const uint32_t* nodes, const uint32_t* parent_nodes,
+                                      size_t count) const {
+    size_t done = 0;
+#if defined(__x86_64__)
+    if (simd == simd_level::avx2) {
+        compose_world_avx2(a, nodes, parent_nodes, count);
+        done = count / 8 * 8;
+    } else if (simd == simd_level::sse) {
+        compose_world_sse(a, nodes, parent_nodes, count);
+        done = count / 4 * 4;
+    }
+#endif
+    compose_world_packs<scalar_pack>(a, nodes + done, parent_nodes + done, count - done);
+}
+
+// parents come before their children, so one pass in index order
+// finds every depth; the counting sort keeps index order within a level
+void transform_system::sort_levels() {
+    depth.resize(size());
+    uint32_t max_depth = 0;
+    for (size_t n = 0; n < size(); n++) {
+        depth[n] = parents[n] == no_parent ? 0 : depth[parents[n]] + 1;
+        max_depth = std::max(max_depth, depth[n]);
+    }
+    level_offsets.assign(max_depth + 2, 0);
+    for (uint32_t d : depth) {
+        level_offsets[d + 1]++;
+    }
+    for (size_t d = 1; d < level_offsets.size(); d++) {
+        level_offsets[d] += level_offsets[d - 1];
+    }
+    level_order.resize(size());
+    std::vector<size_t> filled(level_offsets.begin(), level_offsets.end() - 1);
+    for (size_t n = 0; n < size(); n++) {
+        level_order[filled[depth[n]]++] = static_cast<uint32_t>(n);
+    }
+    levels_valid = true;
+}
+
+void transform_system::update(job_system* jobs, uint32_t slices) {
+    last_locals = 0;
+    last_worlds = 0;
+    if (size() == 0) {
+        return;
+    }
+    updates++;
+    transform_arrays a = arrays();
+
+    // local matrices, in packs of 8 nodes that have at least one dirty node;
+    // the clean ones in such a pack get the same matrix again
+    const size_t group_size = 8;
+    size_t group_count = (size() + group_size - 1) / group_size;
+    run(jobs, slices, group_count, group_size, [&](uint32_t, size_t begin, size_t end) {
+        for (size_t group = begin; group < end; group++) {
+            size_t first = group * group_size;
+            size_t last = std::min(first + group_size, size());
+            if (std::any_of(dirty.begin() + first, dirty.begin() + last, [](uint8_t d) { return d != 0; })) {
+                compose_locals(a, first, last);
+            }
+        }
+    });
+
+    // world matrices level by level: a node is composed when it or an
+    // ancestor is dirty, the parents' levels are complete by then
+    if (!levels_valid) {
+        sort_levels();
+    }
+    for (size_t d = 0; d + 1 < level_offsets.size(); d++) {
+        pending_nodes.clear();
+        pending_parents.clear();
+        for (size_t i = level_offsets[d]; i < level_offsets[d + 1]; i++) {
+            uint32_t n = level_order[i];
+            uint32_t parent = parents[n];
+            bool node_changed = dirty[n] != 0 || (parent != no_parent && changed[parent] != 0);
+            last_locals += dirty[n] != 0;
+            dirty[n] = 0;
+            changed[n] = node_changed;
+            if (node_changed) {
+                changed_at[n] = updates;
+                pending_nodes.push_back(n);
+                pending_parents.push_back(parent);
+            }
+        }
+        last_worlds += pending_nodes.size();
+        if (d == 0) {
+            // roots: the world matrix is the local one
+            run(jobs, slices, pending_nodes.size(), 1, [&](uint32_t, size_t begin, size_t end) {
+                for (int c = 0; c < 12; c++) {
+                    for (size_t i = begin; i < end; i++) {
+                        world[c][pending_nodes[i]] = local[c][pending_nodes[i]];
+                    }
+                }
+            });
+        } else {
+            run(jobs, slices, pending_nodes.size(), 1, [&](uint32_t, size_t begin, size_t end) {
+                compose_worlds(a, pending_nodes.data() + begin, pending_parents.data() + begin, end - begin);
+            });
+        }
+    }
+}
+
+void transform_system::write(job_system* jobs, uint32_t slices, float* output, uint64_t written_at) const {
+    run(jobs, slices, size(), 1, [&](uint32_t, size_t begin, size_t end) {
+        for (size_t n = begin; n < end; n++) {
+            if (changed_at[n] > written_at) {
+                // one node's 48 bytes in order, write-combined memory takes them as one burst
+                float* matrix = output + n * 12;
+                for (int c = 0; c < 12; c++) {
+                    matrix[c] = world[c][n];
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <transform_kernels.hpp>
+#include <job_system.hpp>
+
+#include <vector>
+#include <cstdint>
+
+/**
+ * Position, rotation and scale of a hierarchy of nodes, composed into
+ * world matrices once per frame. Every attribute is stored as its own
+ * array (structure of arrays), so that the matrices of 4 (SSE) or 8
+ * (AVX2) nodes are composed at once, one node per SIMD lane:
+ *  1. the local matrices of dirty nodes, in index order, split across
+ *     the job system's workers,
+ *  2. the world matrices level by level, roots first, of the nodes
+ *     that are dirty or have a dirty ancestor; nodes whose subtree did
+ *     not change are not touched at all.
+ * write() then copies the world matrices that changed recently into a
+ * persistently mapped buffer, straight from the arrays.
+ *
+ * A parent has to be created before its children, so node indices
+ * are a valid evaluation order. Matrices are affine 3x4, row-major:
+ * the layout of a std430 `mat3x4` array read with `row_major`, or of
+ * three vec4 rows.
+ */
+class transform_system
+{
+public:
+    using node = uint32_t;
+    static constexpr node no_parent = UINT32_MAX;
+
+    enum class simd_level {
+        scalar,
+        sse,
+        avx2
+    };
+
+    // picks the widest instruction set the CPU has
+    transform_system();
+
+    node create(node parent = no_parent);
+    void clear();
+    size_t size() const { return parents.size(); }
+
+    void set_position(node n, float x, float y, float z);
+    // a unit quaternion
+    void set_rotation(node n, float x, float y, float z, float w);
+    void set_scale(node n, float x, float y, float z);
+    // as of the last update()
+    void get_world(node n, float matrix[12]) const;
+
+    // jobs may be null to run on the calling thread
+    void update(job_system* jobs, uint32_t slices);
+    // copies the world matrices that changed after update `written_at`
+    // to output + 12 * node, i.e. everything a buffer that was last
+    // written then is missing; 0 writes all of them
+    void write(job_system* jobs, uint32_t slices, float* output, uint64_t written_at) const;
+    // the number of update() calls so far, what the buffer just written is up to date with
+    uint64_t update_count() const { return updates; }
+
+    simd_level get_simd_level() const { return simd; }
+    // for the benchmark; levels the CPU lacks fall back to scalar
+    void set_simd_level(simd_level level);
+    static const char* simd_level_name(simd_level level);
+
+    // of the last update()
+    size_t locals_composed() const { return last_locals; }
+    size_t worlds_composed() const { return last_worlds; }
+
+private:
+    static constexpr uint8_t dirty_local = 1;
+
+    transform_arrays arrays();
+    void compose_locals(const transform_arrays& a, size_t begin, size_t end) const;
+    void compose_worlds(const transform_arrays& a, const uint32_t* nodes, const uint32_t* parent_nodes,
+                        size_t count) const;
+    void sort_levels();
+
+    simd_level simd = simd_level::scalar;
+
+    std::vector<float> position[3];
+    std::vector<float> rotation[4];
+    std::vector<float> scale[3];
+    std::vector<float> local[12];
+    std::vector<float> world[12];
+    std::vector<uint32_t> parents;
+    std::vector<uint8_t> dirty;
+    // the update() that last changed the world matrix
+    std::vector<uint64_t> changed_at;
+    uint64_t updates = 0;
+
+    // the nodes by depth; level_offsets[d] is where depth d starts
+    bool levels_valid = false;
+    std::vector<uint32_t> depth;
+    std::vector<uint32_t> level_order;
+    std::vector<size_t> level_offsets;
+    // per level, the nodes to compose and their parents
+    std::vector<uint32_t> pending_nodes;
+    std::vector<uint32_t> pending_parents;
+    std::vector<uint8_t> changed;
+
+    size_t last_locals = 0;
+    size_t last_worlds = 0;
+};
+
+// composes `node_count` nodes with transform_system at every SIMD level
+// and thread count against glm::mat4 one node at a time, see transform_benchmark.cpp
+void benchmark_transforms(uint32_t node_count, uint32_t iterations);
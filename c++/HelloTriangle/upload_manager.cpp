@@ -0,0 +1,396 @@
+#include <upload_manager.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+void upload_manager::init(VkDevice device, const VkAllocationCallbacks* callbacks, gpu_allocator* allocator,
+                          uint32_t transfer_family, VkQueue transfer_queue,
+                          uint32_t graphics_family, bool timeline_semaphores,
+                          VkDeviceSize staging_size) {
+    this->device = device;
+    this->callbacks = callbacks;
+    this->allocator = allocator;
+    this->transfer_family = transfer_family;
+    this->transfer_queue = transfer_queue;
+    this->graphics_family = graphics_family;
+    timeline = timeline_semaphores;
+    ring_size = staging_size;
+
+    VkCommandPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    // batch command buffers are recycled one by one
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex = transfer_family;
+    if (vkCreateCommandPool(device, &pool_info, callbacks, &command_pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create the upload command pool!");
+    }
+
+    if (timeline) {
+        VkSemaphoreTypeCreateInfo type_info{};
+        type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        type_info.initialValue = 0;
+        VkSemaphoreCreateInfo semaphore_info{};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphore_info.pNext = &type_info;
+        if (vkCreateSemaphore(device, &semaphore_info, callbacks, &timeline_semaphore) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create the upload timeline semaphore!");
+        }
+    }
+
+    // written by the CPU once and read by the copy engine once,
+    // so there is no point in asking for device-local memory
+    staging_buffer = allocator->create_buffer(ring_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                              0, staging_memory);
+}
+
+void upload_manager::destroy() {
+    if (device == VK_NULL_HANDLE) {
+        return;
+    }
+    // the device is idle by now, so every batch has completed
+    auto destroy_batch = [this](batch& b) {
+        if (b.fence != VK_NULL_HANDLE) {
+            vkDestroyFence(device, b.fence, callbacks);
+        }
+    };
+    destroy_batch(recording_batch);
+    for (auto& b : in_flight) destroy_batch(b);
+    for (auto& b : completed) destroy_batch(b);
+    for (auto& b : free_batches) destroy_batch(b);
+    in_flight.clear();
+    completed.clear();
+    free_batches.clear();
+
+    // destroying the pool frees all of its command buffers
+    vkDestroyCommandPool(device, command_pool, callbacks);
+    if (timeline_semaphore != VK_NULL_HANDLE) {
+        vkDestroySemaphore(device, timeline_semaphore, callbacks);
+    }
+    allocator->destroy_buffer(staging_buffer, staging_memory);
+    device = VK_NULL_HANDLE;
+}
+
+upload_manager::batch& upload_manager::current_batch() {
+    if (recording_batch.recording) {
+        return recording_batch;
+    }
+    if (!free_batches.empty()) {
+        recording_batch = std::move(free_batches.back());
+        free_batches.pop_back();
+        vkResetCommandBuffer(recording_batch.command_buffer, 0);
+        if (!timeline) {
+            vkResetFences(device, 1, &recording_batch.fence);
+        }
+    } else {
+        recording_batch = batch{};
+        VkCommandBufferAllocateInfo allocate_info{};
+        allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocate_info.commandPool = command_pool;
+        allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocate_info.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(device, &allocate_info, &recording_batch.command_buffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate an upload command buffer!");
+        }
+        if (!timeline) {
+            VkFenceCreateInfo fence_info{};
+            fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            if (vkCreateFence(device, &fence_info, callbacks, &recording_batch.fence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create an upload fence!");
+            }
+        }
+    }
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(recording_batch.command_buffer, &begin_info) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording an upload command buffer!");
+    }
+    recording_batch.value = next_value;
+    recording_batch.ring_bytes = 0;
+    recording_batch.acquires.clear();
+    recording_batch.recording = true;
+    return recording_batch;
+}
+
+/**
+ * The ring is handed out strictly in submission order, so it is
+ * enough to count the bytes in use: a batch gives its bytes back
+ * when it completes, and batches complete in order. When there is
+ * no room left the oldest batch is waited for, submitting the
+ * current one first if nothing else is in flight.
+ */
+VkDeviceSize upload_manager::allocate_staging(VkDeviceSize size, VkDeviceSize alignment) {
+    if (size > ring_size) {
+        throw std::runtime_error("upload does not fit into the staging ring!");
+    }
+    for (;;) {
+        if (ring_used == 0) {
+            ring_head = 0;
+        }
+        VkDeviceSize offset = (ring_head + alignment - 1) / alignment * alignment;
+        if (offset + size > ring_size) {
+            // no room before the end of the ring, skip the tail
+            offset = 0;
+        }
+        VkDeviceSize consumed = (offset >= ring_head ? offset - ring_head : ring_size - ring_head) + size;
+        if (ring_used + consumed <= ring_size) {
+            batch& b = current_batch();
+            b.ring_bytes += consumed;
+            ring_used += consumed;
+            ring_head = offset + size;
+            return offset;
+        }
+        if (in_flight.empty()) {
+            submit();
+        }
+        wait(in_flight.front().value);
+    }
+}
+
+upload_manager::ticket upload_manager::upload_buffer(VkBuffer buffer, VkDeviceSize offset, const void* data,
+                                                     VkDeviceSize size, VkPipelineStageFlags dst_stage,
+                                                     VkAccessFlags dst_access) {
+    // large uploads are split up, so that the ring keeps streaming
+    // instead of having to drain completely for a single copy
+    const VkDeviceSize max_chunk = std::max<VkDeviceSize>(ring_size / 4, 4);
+    auto bytes = static_cast<const char*>(data);
+    VkDeviceSize done = 0;
+    while (done < size) {
+        VkDeviceSize chunk = std::min(size - done, max_chunk);
+        VkDeviceSize staging_offset = allocate_staging(chunk, 4);
+        std::memcpy(static_cast<char*>(staging_memory.mapped) + staging_offset, bytes + done, chunk);
+
+        batch& b = current_batch();
+        VkBufferCopy region{};
+        region.srcOffset = staging_offset;
+        region.dstOffset = offset + done;
+        region.size = chunk;
+        vkCmdCopyBuffer(b.command_buffer, staging_buffer, buffer, 1, &region);
+
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.buffer = buffer;
+        barrier.offset = offset + done;
+        barrier.size = chunk;
+        if (ownership_transfers()) {
+            // release half of the ownership transfer, the destination
+            // access is meaningless on this queue and has to be 0
+            barrier.dstAccessMask = 0;
+            barrier.srcQueueFamilyIndex = transfer_family;
+            barrier.dstQueueFamilyIndex = graphics_family;
+            vkCmdPipelineBarrier(b.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                 0, 0, nullptr, 1, &barrier, 0, nullptr);
+            b.acquires.push_back({buffer, VK_NULL_HANDLE, offset + done, chunk, 0, dst_stage, dst_access});
+        } else {
+            // same queue as the frames, which come later in submission order
+            barrier.dstAccessMask = dst_access;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            vkCmdPipelineBarrier(b.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage,
+                                 0, 0, nullptr, 1, &barrier, 0, nullptr);
+        }
+        done += chunk;
+        total_bytes += chunk;
+    }
+    return next_value;
+}
+
+upload_manager::ticket upload_manager::upload_image(VkImage image, uint32_t mip_level, VkExtent3D extent,
+                                                    const void* data, VkDeviceSize size) {
+    // 16 covers the texel size of every uncompressed color format and the block size of BCn
+    VkDeviceSize staging_offset = allocate_staging(size, 16);
+    std::memcpy(static_cast<char*>(staging_memory.mapped) + staging_offset, data, size);
+    batch& b = current_batch();
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = mip_level;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(b.command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = staging_offset;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = mip_level;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = extent;
+    vkCmdCopyBufferToImage(b.command_buffer, staging_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    // the layout transition happens as part of the release, the
+    // acquire on the graphics queue has to repeat the same layouts
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    if (ownership_transfers()) {
+        barrier.dstAccessMask = 0;
+        barrier.srcQueueFamilyIndex = transfer_family;
+        barrier.dstQueueFamilyIndex = graphics_family;
+        vkCmdPipelineBarrier(b.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+        b.acquires.push_back({VK_NULL_HANDLE, image, 0, 0, mip_level,
+                              VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT});
+    } else {
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(b.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+    total_bytes += size;
+    return next_value;
+}
+
+upload_manager::ticket upload_manager::submit() {
+    if (!recording_batch.recording) {
+        return next_value - 1;
+    }
+    batch b = std::move(recording_batch);
+    recording_batch = batch{};
+    b.recording = false;
+    if (vkEndCommandBuffer(b.command_buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record an upload command buffer!");
+    }
+
+    VkSubmitInfo submit_info{};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &b.command_buffer;
+    VkTimelineSemaphoreSubmitInfo timeline_info{};
+    if (timeline) {
+        timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timeline_info.signalSemaphoreValueCount = 1;
+        timeline_info.pSignalSemaphoreValues = &b.value;
+        submit_info.pNext = &timeline_info;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &timeline_semaphore;
+    }
+    if (vkQueueSubmit(transfer_queue, 1, &submit_info, b.fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit an upload batch!");
+    }
+    next_value++;
+    in_flight.push_back(std::move(b));
+    return in_flight.back().value;
+}
+
+void upload_manager::retire_completed() {
+    uint64_t done = 0;
+    if (timeline) {
+        vkGetSemaphoreCounterValue(device, timeline_semaphore, &done);
+    }
+    while (!in_flight.empty()) {
+        batch& oldest = in_flight.front();
+        bool finished = timeline ? oldest.value <= done
+                                 : vkGetFenceStatus(device, oldest.fence) == VK_SUCCESS;
+        if (!finished) {
+            break;
+        }
+        ring_used -= oldest.ring_bytes;
+        oldest.ring_bytes = 0;
+        completed.push_back(std::move(oldest));
+        in_flight.pop_front();
+    }
+}
+
+bool upload_manager::is_complete(ticket value) {
+    if (value >= next_value) {
+        return false; // still being recorded
+    }
+    retire_completed();
+    return in_flight.empty() || in_flight.front().value > value;
+}
+
+void upload_manager::wait(ticket value) {
+    if (value >= next_value) {
+        submit();
+    }
+    if (timeline) {
+        VkSemaphoreWaitInfo wait_info{};
+        wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        wait_info.semaphoreCount = 1;
+        wait_info.pSemaphores = &timeline_semaphore;
+        wait_info.pValues = &value;
+        vkWaitSemaphores(device, &wait_info, UINT64_MAX);
+    } else {
+        for (const auto& b : in_flight) {
+            if (b.value > value) {
+                break;
+            }
+            vkWaitForFences(device, 1, &b.fence, VK_TRUE, UINT64_MAX);
+        }
+    }
+    retire_completed();
+}
+
+/**
+ * Completion is observed on the host, so the graphics queue never
+ * waits on the transfer queue: a frame only picks up batches that
+ * have already finished, everything else waits for a later frame.
+ */
+void upload_manager::record_acquires(VkCommandBuffer graphics_command_buffer) {
+    retire_completed();
+    if (completed.empty()) {
+        return;
+    }
+    std::vector<VkBufferMemoryBarrier> buffer_barriers;
+    std::vector<VkImageMemoryBarrier> image_barriers;
+    VkPipelineStageFlags dst_stages = 0;
+    for (auto& b : completed) {
+        for (const auto& acquire : b.acquires) {
+            dst_stages |= acquire.dst_stage;
+            if (acquire.buffer != VK_NULL_HANDLE) {
+                VkBufferMemoryBarrier barrier{};
+                barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = acquire.dst_access;
+                barrier.srcQueueFamilyIndex = transfer_family;
+                barrier.dstQueueFamilyIndex = graphics_family;
+                barrier.buffer = acquire.buffer;
+                barrier.offset = acquire.offset;
+                barrier.size = acquire.size;
+                buffer_barriers.push_back(barrier);
+            } else {
+                VkImageMemoryBarrier barrier{};
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = acquire.dst_access;
+                barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                barrier.srcQueueFamilyIndex = transfer_family;
+                barrier.dstQueueFamilyIndex = graphics_family;
+                barrier.image = acquire.image;
+                barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                barrier.subresourceRange.baseMipLevel = acquire.mip_level;
+                barrier.subresourceRange.levelCount = 1;
+                barrier.subresourceRange.baseArrayLayer = 0;
+                barrier.subresourceRange.layerCount = 1;
+                image_barriers.push_back(barrier);
+            }
+        }
+        acquired_value = b.value;
+        b.acquires.clear();
+        free_batches.push_back(std::move(b));
+    }
+    completed.clear();
+
+    if (!buffer_barriers.empty() || !image_barriers.empty()) {
+        vkCmdPipelineBarrier(graphics_command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dst_stages, 0,
+                             0, nullptr,
+                             static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
+                             static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <gpu_allocator.hpp>
+
+#include <vector>
+#include <deque>
+#include <cstdint>
+
+/**
+ * Streams data to device-local resources through a staging ring
+ * buffer on the transfer queue, so that uploads never occupy the
+ * graphics queue. Work is batched: every upload_*() call appends
+ * to the current batch and submit() sends it off. Completion is
+ * tracked with a timeline semaphore (one value per batch), or with
+ * a fence per batch where timeline semaphores are unavailable.
+ *
+ * With a dedicated transfer family the resources change queue
+ * family ownership: the batch records the release half of the
+ * transfer, and record_acquires() records the matching acquire
+ * half into a graphics command buffer once the batch has completed.
+ * A resource may only be used in a frame whose command buffer came
+ * after that, i.e. once is_ready() returns true for its ticket.
+ */
+class upload_manager
+{
+public:
+    using ticket = uint64_t;
+
+    void init(VkDevice device, const VkAllocationCallbacks* callbacks, gpu_allocator* allocator,
+              uint32_t transfer_family, VkQueue transfer_queue,
+              uint32_t graphics_family, bool timeline_semaphores,
+              VkDeviceSize staging_size = 32ull * 1024 * 1024);
+    void destroy();
+
+    // copy into a buffer; dst_stage/dst_access describe the first use on the graphics queue
+    ticket upload_buffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size,
+                         VkPipelineStageFlags dst_stage, VkAccessFlags dst_access);
+    // copy one mip level of a color image, which must still be in UNDEFINED
+    // layout; the level ends up in SHADER_READ_ONLY_OPTIMAL for fragment shaders
+    ticket upload_image(VkImage image, uint32_t mip_level, VkExtent3D extent,
+                        const void* data, VkDeviceSize size);
+
+    // send the current batch to the transfer queue, returns its ticket
+    ticket submit();
+    bool is_complete(ticket value);
+    void wait(ticket value);
+    // acquire the resources of all completed batches on the graphics queue
+    void record_acquires(VkCommandBuffer graphics_command_buffer);
+    bool is_ready(ticket value) const { return value <= acquired_value; }
+
+    uint64_t bytes_uploaded() const { return total_bytes; }
+    // the largest single upload
+    VkDeviceSize staging_capacity() const { return ring_size; }
+    bool ownership_transfers() const { return transfer_family != graphics_family; }
+
+private:
+    struct pending_acquire {
+        VkBuffer buffer;
+        VkImage image;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        uint32_t mip_level;
+        VkPipelineStageFlags dst_stage;
+        VkAccessFlags dst_access;
+    };
+
+    struct batch {
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;  // only without timeline semaphores
+        ticket value = 0;
+        VkDeviceSize ring_bytes = 0;     // staging bytes to give back on completion
+        std::vector<pending_acquire> acquires;
+        bool recording = false;
+    };
+
+    VkDeviceSize allocate_staging(VkDeviceSize size, VkDeviceSize alignment);
+    batch& current_batch();
+    void retire_completed();
+
+    VkDevice device = VK_NULL_HANDLE;
+    const VkAllocationCallbacks* callbacks = nullptr;
+    gpu_allocator* allocator = nullptr;
+    uint32_t transfer_family = 0;
+    uint32_t graphics_family = 0;
+    VkQueue transfer_queue = VK_NULL_HANDLE;
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+
+    bool timeline = false;
+    VkSemaphore timeline_semaphore = VK_NULL_HANDLE;
+    ticket next_value = 1;
+    ticket acquired_value = 0;
+
+    VkBuffer staging_buffer = VK_NULL_HANDLE;
+    gpu_allocation staging_memory;
+    VkDeviceSize ring_size = 0;
+    VkDeviceSize ring_head = 0;
+    VkDeviceSize ring_used = 0;
+
+    batch recording_batch;
+    std::deque<batch> in_flight;       // submitted, oldest first
+    std::deque<batch> completed;       // waiting for record_acquires()
+    std::vector<batch> free_batches;
+    uint64_t total_bytes = 0;
+};
@@ -1,50 +1,322 @@
 #include <vulkan_app.hpp>
+#include <algorithm>
+#include <chrono>
+#include <thread>
 
 void vulkan_app::run() {
-    init_window();
+    if (config.compute_benchmark) {
+        run_compute_benchmark();
+        return;
+    }
+    using clock = std::chrono::steady_clock;
+    run_start = clock::now();
+    active_present_policy = requested_present_policy =
+        config.compare_present_policies ? present_policy::low_latency : config.present;
     init_vulkan();
+    startup.total_ms = std::chrono::duration<double, std::milli>(clock::now() - run_start).count();
+    std::cout << "startup took " << startup.total_ms << " ms (instance " << startup.instance_ms
+              << ", device " << startup.device_ms << ", swap chain " << startup.swap_chain_ms
+              << ", pipelines " << startup.pipelines_ms << "; "
+              << (pipeline_cache_warm ? "warm" : "cold") << " pipeline cache)" << std::endl;
     main_loop();
     cleanup();
+    // only now, so that a failing benchmark still shuts down cleanly
+    if (bench_regressed) {
+        throw std::runtime_error("benchmark regressed beyond the baseline!");
+    }
 }
 
-void vulkan_app::init_window() {
+void vulkan_app::init_glfw() {
     glfwInit();
     // tell GLFW not to create an OpenGL context
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    // disable window resizing for now
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+}
+
+void vulkan_app::init_window() {
     // create the window
     window = glfwCreateWindow(width, hight, "Vulkan", nullptr, nullptr);
+    // the swap chain is recreated on resize, see recreate_swap_chain()
+    glfwSetWindowUserPointer(window, this);
+    glfwSetFramebufferSizeCallback(window, framebuffer_resize_callback);
+    // 1/2/3 select the low_latency/power_saving/throughput present policy
+    glfwSetKeyCallback(window, key_callback);
 }
 
+void vulkan_app::framebuffer_resize_callback(GLFWwindow* window, int width, int height) {
+    // drivers are not guaranteed to report VK_ERROR_OUT_OF_DATE_KHR on resize
+    auto app = reinterpret_cast<vulkan_app*>(glfwGetWindowUserPointer(window));
+    app->swap_chain_out_of_date = true;
+}
 
+bool vulkan_app::is_window_minimized() {
+    int width = 0, height = 0;
+    glfwGetFramebufferSize(window, &width, &height);
+    return width == 0 || height == 0;
+}
+
+
+/**
+ * Startup as a dependency graph rather than a sequence: the window is
+ * created on the main thread while the instance is being created, the
+ * shaders are read and reflected while the device is, and the graphics
+ * and culling pipelines are compiled side by side (the pipeline cache
+ * is internally synchronized) while the geometry is uploaded. The
+ * allocator is internally synchronized as well, so the steps that
+ * create resources with it run side by side; steps that share state
+ * which is not thread-safe, e.g. the upload manager, are chained.
+ */
 void vulkan_app::init_vulkan() {
-    create_instance();
-    setup_debug_messenger();
-    create_surface();
-    pick_physical_device();
-    create_logical_device();
-    create_swap_chain();
-    create_image_views();
+    bool windowed = !config.headless;
+    // before anything is created with the callbacks, they must not change afterwards
+    if (config.host_allocation_callbacks) {
+        host_memory.init(size_t(config.host_arena_kb) * 1024);
+    }
+    // the instance reports through the messenger from vkCreateInstance on
+    if (enable_validation_layers) {
+        validation_log.start(config.validation_rate);
+    }
+    startup_graph graph;
+    using step = startup_graph::step_id;
+
+    // GLFW has to be initialized and create its windows on the main thread
+    step glfw = graph.add("glfw", {}, [&] { if (windowed) init_glfw(); }, true);
+    step window = graph.add("window", {glfw}, [&] { if (windowed) init_window(); }, true);
+    step layers = graph.add("layer query", {}, [&] {
+        validation_layers_available = !enable_validation_layers || check_validation_layer_support();
+    });
+    if (config.list_extensions) {
+        graph.add("extension query", {}, [&] { print_instance_extensions(); });
+    }
+    step shader_files = graph.add("shader files", {}, [&] {
+        for (const char* path : {"shaders/triangle.vert.spv", "shaders/triangle.frag.spv",
+                                 "shaders/scene.vert.spv", "shaders/cull.comp.spv",
+                                 "shaders/sprite.vert.spv", "shaders/sprite.frag.spv"}) {
+            shaders.prefetch(path);
+        }
+    });
+    step instance_step = graph.add("instance", {glfw, layers}, [&] {
+        create_instance();
+        setup_debug_messenger();
+    });
+    step surface_step = graph.add("surface", {instance_step, window}, [&] { if (windowed) create_surface(); });
+    step device = graph.add("device", {instance_step, surface_step}, [&] {
+        pick_physical_device();
+        create_logical_device();
+        const VkAllocationCallbacks* callbacks = host_memory.callbacks();
+        allocator.init(physical_device, logical_device, callbacks, config.frames_in_flight);
+        profiler.init(physical_device, logical_device, callbacks, queue_families.graphics_family.value(),
+                      config.frames_in_flight, config.profile, config.profile_csv_path, config.profile_trace_path);
+        shaders.init(logical_device, callbacks);
+        descriptors.init(logical_device, callbacks, config.frames_in_flight, bindless_supported);
+        frame_graph.init(logical_device, callbacks, &allocator, config.frames_in_flight, vulkan13_path);
+    });
+    step swap_chain_step = graph.add("swap chain", {device}, [&] {
+        if (config.headless) {
+            create_offscreen_targets();
+        } else {
+            create_swap_chain();
+        }
+        create_image_views();
+    });
+    step render_pass_step = graph.add("render pass", {swap_chain_step}, [&] { create_render_pass(); });
+    step cache = graph.add("pipeline cache", {device}, [&] { create_pipeline_cache(); });
+    step graphics = graph.add("graphics pipeline", {render_pass_step, cache, shader_files}, [&] {
+        create_graphics_pipeline();
+    });
+    step culling = graph.add("culling pipelines", {render_pass_step, cache, shader_files}, [&] {
+        if (config.scene_objects > 0 && (config.gpu_culling || config.culling_benchmark) && gpu_culling_supported) {
+            create_culling_pipelines();
+        }
+    });
+    step sprite_pipelines_step = graph.add("sprite pipelines", {render_pass_step, cache, shader_files}, [&] {
+        create_sprite_pipelines();
+    });
+    step framebuffers = graph.add("framebuffers", {render_pass_step}, [&] { create_framebuffers(); });
+    step commands = graph.add("command buffers", {device}, [&] {
+        create_command_pool();
+        create_command_buffers();
+        create_worker_command_buffers();
+    });
+    step geometry = graph.add("geometry", {device}, [&] {
+        create_geometry_buffers();
+        build_draw_list();
+        create_scene();
+    });
+    // after the geometry, which sets up the upload manager; only the headers
+    // are read here, the levels are streamed in by the frames
+    step textures_step = graph.add("textures", {geometry}, [&] {
+        textures.init(physical_device, logical_device, host_memory.callbacks(), enabled_features, &allocator,
+                      &uploads, &descriptors, config.frames_in_flight, VkDeviceSize(config.texture_budget_kb) * 1024);
+        for (const auto& paths : config.texture_paths) {
+            std::vector<std::string> candidates;
+            size_t start = 0;
+            for (size_t comma; (comma = paths.find(',', start)) != std::string::npos; start = comma + 1) {
+                candidates.push_back(paths.substr(start, comma - start));
+            }
+            candidates.push_back(paths.substr(start));
+            textures.load(candidates);
+        }
+    });
+    step capture_step = graph.add("capture", {device}, [&] {
+        if (!config.capture_path.empty()) {
+            capture.init(logical_device, host_memory.callbacks(), &allocator, config.capture_path,
+                         config.capture_buffers, config.headless);
+        }
+    });
+    // only fills the batches, their buffers are created by the frames
+    step sprites_step = graph.add("sprites", {device}, [&] { create_sprites(); });
+    // creates its buffers alongside the swap chain and geometry steps, see above
+    step transforms_step = graph.add("transforms", {device}, [&] { create_transforms(); });
+    step sync = graph.add("sync objects", {swap_chain_step}, [&] { create_sync_objects(); });
+    graph.add("ready", {graphics, culling, sprite_pipelines_step, framebuffers, commands, textures_step, sprites_step,
+                        capture_step, transforms_step, sync}, [] {});
+
+    graph.run(std::clamp(std::thread::hardware_concurrency(), 2u, 4u) - 1);
+
+    startup.instance_ms = graph.duration_ms(glfw) + graph.duration_ms(instance_step) +
+                          graph.duration_ms(surface_step);
+    startup.device_ms = graph.duration_ms(device);
+    startup.swap_chain_ms = graph.duration_ms(swap_chain_step);
+    startup.pipelines_ms = graph.duration_ms(render_pass_step) + graph.duration_ms(cache) +
+                           graph.duration_ms(graphics) + graph.duration_ms(culling) +
+                           graph.duration_ms(sprite_pipelines_step);
+    startup.critical_path_ms = graph.critical_path_ms();
+    graph.print_critical_path(std::cout);
+    std::cout << shaders.module_count() << " shader modules, "
+              << shaders.duplicate_loads() << " duplicate loads shared" << std::endl;
 }
 
 void vulkan_app::main_loop() {
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+    if (config.record_benchmark) {
+        benchmark_recording();
+        return;
+    }
+    if (config.culling_benchmark) {
+        benchmark_culling();
+        return;
+    }
+    active_frames_in_flight = config.compare_frames_in_flight ? 1 : config.frames_in_flight;
+    stall_stats.push_back({active_frames_in_flight});
+
+    if (config.headless) {
+        uint32_t total_frames = config.compare_frames_in_flight ? 2 * config.frame_count : config.frame_count;
+        if (!config.bench_scene.empty()) {
+            frame_times_ms.reserve(total_frames);
+        }
+        uint64_t host_allocations = host_allocation_count();
+        uint64_t driver_allocations = host_memory.allocation_count();
+        double validation_ms = validation_log.get_stats().callback_ms;
+        auto loop_start = std::chrono::steady_clock::now();
+        for (uint32_t frame = 0; frame < total_frames; frame++) {
+            draw_frame();
+        }
+        loop_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loop_start).count();
+        loop_validation_ms = validation_log.get_stats().callback_ms - validation_ms;
+        loop_host_allocations = host_allocation_count() - host_allocations;
+        loop_driver_allocations = host_memory.allocation_count() - driver_allocations;
+    } else {
+        uint32_t policy_frames = 0;
+        while (!glfwWindowShouldClose(window)) {
+            glfwPollEvents();
+            input_sample_time = std::chrono::steady_clock::now();
+            // a minimized window has a zero extent, which no swap chain
+            // can have; sleep until something happens instead of spinning
+            if (is_window_minimized()) {
+                glfwWaitEvents();
+                continue;
+            }
+            draw_frame();
+
+            if (config.compare_present_policies && ++policy_frames == config.frame_count) {
+                policy_frames = 0;
+                auto next = static_cast<int>(requested_present_policy) + 1;
+                if (next > static_cast<int>(present_policy::throughput)) {
+                    glfwSetWindowShouldClose(window, GLFW_TRUE);
+                } else {
+                    set_present_policy(static_cast<present_policy>(next));
+                }
+            }
+        }
+    }
+    vkDeviceWaitIdle(logical_device);
+    profiler.flush();
+    profiler.print_summary(std::cerr);
+    report_frame_stall_stats();
+    report_present_stats();
+    allocator.print_stats(std::cout);
+    host_memory.print_stats(std::cout);
+    textures.print_stats(std::cout);
+    sprites.print_stats(std::cout);
+    validation_log.print_stats(std::cout);
+    capture.print_stats(std::cout);
+    print_transform_stats();
+    if (enable_validation_layers && config.headless && frame_number > 0) {
+        // the layers' own checks are not included, compare with a --no-validation run for those
+        std::cout << "\tframe loop: " << loop_validation_ms / frame_number << " ms per frame in the callback, "
+                  << 100.0 * loop_validation_ms / std::max(loop_ms, 1e-9) << "% of the frame time" << std::endl;
+    }
+    if (host_memory.is_enabled() && config.headless) {
+        std::cout << "\tframe loop: " << loop_driver_allocations << " driver allocations in "
+                  << frame_number << " frames" << std::endl;
+    }
+    if (!config.bench_scene.empty()) {
+        write_bench_report();
     }
 }
 
 void vulkan_app::cleanup() {
-    vkDestroySwapchainKHR(logical_device, swap_chain, nullptr); // SEGFAULT!
+    for (auto semaphore : image_available_semaphores) {
+        vkDestroySemaphore(logical_device, semaphore, host_memory.callbacks());
+    }
+    for (auto fence : in_flight_fences) {
+        vkDestroyFence(logical_device, fence, host_memory.callbacks());
+    }
+    vkDestroySemaphore(logical_device, frame_timeline, host_memory.callbacks());
+    vkDestroyCommandPool(logical_device, command_pool, host_memory.callbacks());
+    for (const auto& frame_pools : worker_command_pools) {
+        for (auto pool : frame_pools) {
+            vkDestroyCommandPool(logical_device, pool, host_memory.callbacks());
+        }
+    }
+    record_workers.reset();
+    destroy_retired_swap_chains(true);
+    vkDestroyPipeline(logical_device, graphics_pipeline, host_memory.callbacks());
+    save_pipeline_cache();
+    vkDestroyPipelineCache(logical_device, pipeline_cache, host_memory.callbacks());
+    vkDestroyRenderPass(logical_device, render_pass, host_memory.callbacks());
+    // the current swap chain goes the same way as the retired ones
+    destroy_swap_chain_resources({swap_chain, swap_chain_image_views, swap_chain_framebuffers,
+                                  render_finished_semaphores, frame_number});
+    if (config.headless) {
+        for (size_t i = 0; i < swap_chain_images.size(); i++) {
+            allocator.destroy_image(swap_chain_images[i], offscreen_image_allocations[i]);
+        }
+    }
+    destroy_scene();
+    destroy_sprites();
+    capture.destroy();
+    destroy_transforms();
+    textures.destroy();
+    shaders.destroy();
+    uploads.destroy();
+    descriptors.destroy();
+    frame_graph.destroy();
+    allocator.destroy_buffer(index_buffer, index_buffer_allocation);
+    allocator.destroy_buffer(vertex_buffer, vertex_buffer_allocation);
+    profiler.destroy();
+    allocator.destroy();
+    vkDestroyDevice(logical_device, host_memory.callbacks());
     if (enable_validation_layers) {
-        destroy_debug_utils_messenger(instance, debug_messenger, nullptr);
+        destroy_debug_utils_messenger(instance, debug_messenger, host_memory.callbacks());
+    }
+    if (!config.headless) {
+        vkDestroySurfaceKHR(instance, surface, host_memory.callbacks());
     }
-    for (auto image_view : swap_chain_image_views) {
-        vkDestroyImageView(logical_device, image_view, nullptr);
+    vkDestroyInstance(instance, host_memory.callbacks());
+    validation_log.stop();
+    host_memory.destroy();
+    if (!config.headless) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
     }
-    vkDestroyDevice(logical_device, nullptr);
-    vkDestroySurfaceKHR(instance, surface, nullptr);
-    vkDestroyInstance(instance, nullptr);
-    glfwDestroyWindow(window);
-    glfwTerminate();
 }
\ No newline at end of file
@@ -3,11 +3,35 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <gpu_allocator.hpp>
+#include <job_system.hpp>
+#include <frame_profiler.hpp>
+#include <upload_manager.hpp>
+#include <descriptor_manager.hpp>
+#include <render_graph.hpp>
+#include <shader_library.hpp>
+#include <allocation_counter.hpp>
+#include <startup_graph.hpp>
+#include <host_allocator.hpp>
+#include <texture_streamer.hpp>
+#include <sprite_renderer.hpp>
+#include <debug_logger.hpp>
+#include <frame_capture.hpp>
+#include <transform_system.hpp>
+#include <mesh_format.hpp>
+#include <compute_jobs.hpp>
+
 #include <iostream>
 #include <stdexcept>
 #include <cstdlib>
 #include <vector>
 #include <optional>
+#include <limits>
+#include <string>
+#include <memory>
+#include <array>
+#include <cstddef>
+#include <chrono>
 
 //#define NDEBUG
 
@@ -27,35 +51,298 @@ void destroy_debug_utils_messenger(
 struct queue_family_indices {
     std::optional<uint32_t> graphics_family;
     std::optional<uint32_t> present_family;
-    bool is_complete() {
-        return graphics_family.has_value() && present_family.has_value();
+    // families without graphics support, if the hardware exposes them;
+    // their queues run independently of (and concurrently with) graphics
+    std::optional<uint32_t> transfer_family;
+    std::optional<uint32_t> compute_family;
+    // headless rendering never presents, so only the graphics family is required
+    bool is_complete(bool require_present = true) {
+        return graphics_family.has_value() && (present_family.has_value() || !require_present);
     }
 };
 
+/**
+ * A physical device as seen by pick_physical_device(). Candidates
+ * are ranked by score; devices that cannot run the app at all are
+ * still listed, but never picked.
+ */
+struct device_candidate {
+    VkPhysicalDevice device;
+    uint32_t index;
+    VkPhysicalDeviceProperties properties;
+    std::string uuid; // empty on Vulkan 1.0 instances
+    VkDeviceSize device_local_bytes;
+    bool suitable;
+    uint64_t score;
+};
+
 struct swap_chain_support_details {
     VkSurfaceCapabilitiesKHR capabilities;
     std::vector<VkSurfaceFormatKHR> formats;
     std::vector<VkPresentModeKHR> present_modes;
 };
 
+/**
+ * A swap chain replaced by recreate_swap_chain(), together with
+ * everything that refers to its images. Frames submitted before
+ * retired_at may still use them, so they are only destroyed once
+ * those frames have retired.
+ */
+struct retired_swap_chain {
+    VkSwapchainKHR swap_chain;
+    std::vector<VkImageView> image_views;
+    std::vector<VkFramebuffer> framebuffers;
+    std::vector<VkSemaphore> render_finished_semaphores;
+    uint64_t retired_at;
+};
+
+
+/**
+ * How the swap chain trades latency against power and smoothness:
+ *  - low_latency: IMMEDIATE (else MAILBOX) with as few images as allowed,
+ *  - power_saving: FIFO, the CPU sleeps in acquire once it is ahead,
+ *  - throughput: MAILBOX (else FIFO) with extra images to absorb spikes.
+ */
+enum class present_policy {
+    low_latency,
+    power_saving,
+    throughput
+};
+
+const char* present_policy_name(present_policy policy);
+bool parse_present_policy(const std::string& name, present_policy& policy);
+
+/**
+ * Run-time options of the application. In headless mode no window
+ * or surface is created: frames are rendered into device-local
+ * images instead of the swap chain, so the app runs on machines
+ * without a display (e.g. on lavapipe/llvmpipe).
+ */
+struct app_config {
+    bool headless = false;
+    uint32_t frame_count = 1000; // number of frames to render in headless mode
+    uint32_t frames_in_flight = 2;
+    // render frame_count frames with a single frame in flight first,
+    // then switch to frames_in_flight and report the difference
+    bool compare_frames_in_flight = false;
+    // empty to disable persisting the pipeline cache
+    std::string pipeline_cache_path = "pipeline_cache.bin";
+    uint32_t draw_count = 1;      // triangles in the draw list, laid out on a grid
+    uint32_t record_threads = 0;  // 0 records everything inline on the main thread
+    // record frame_count frames with 1, 2, 4, ... threads and report the scaling
+    bool record_benchmark = false;
+    // print rolling frame time percentiles to stderr once a second
+    bool profile = false;
+    std::string profile_csv_path;   // per-frame timings, one row per frame
+    std::string profile_trace_path; // Chrome trace event JSON
+    // force a physical device: its index, its UUID or part of its name;
+    // defaults to the HELLO_TRIANGLE_DEVICE environment variable
+    std::string device;
+    // can be changed at run time with the 1/2/3 keys
+    present_policy present = present_policy::throughput;
+    // run frame_count frames with each policy in turn, then report and exit
+    bool compare_present_policies = false;
+    // use descriptor indexing where the device supports it
+    bool bindless = true;
+    // replace the grid with a scene of this many objects under a panning camera
+    uint32_t scene_objects = 0;
+    // cull the scene in a compute shader and draw it with indirect draws,
+    // instead of culling on the CPU and recording one draw per object
+    bool gpu_culling = false;
+    // render frame_count frames with CPU and then with GPU culling and report both
+    bool culling_benchmark = false;
+    // a fixed benchmark scene (see apply_bench_scene()), rendered headless
+    std::string bench_scene;
+    std::string bench_json_path;      // the report, stdout if empty
+    std::string bench_baseline_path;  // fail if the report is worse than this one
+    double bench_threshold = 0.10;    // tolerated regression, relative
+    // print the instance extensions at startup
+    bool list_extensions = false;
+    // route the driver's host allocations through host_allocator
+    bool host_allocation_callbacks = false;
+    uint32_t host_arena_kb = 64; // per thread, for command scope allocations
+    // KTX2/DDS textures to stream in, each a comma-separated list of
+    // the same texture in alternative formats
+    std::vector<std::string> texture_paths;
+    uint32_t texture_budget_kb = 4096; // uploaded per frame
+    // sprites drawn on top of everything else, half retained, half dynamic
+    uint32_t sprite_count = 0;
+    // the validation layers and the debug messenger; on by default in
+    // debug builds, HELLO_TRIANGLE_VALIDATION=0/1 overrides that
+#ifdef NDEBUG
+    bool validation = false;
+#else
+    bool validation = true;
+#endif
+    // what the messenger subscribes to, the layers do not even format the rest
+    VkDebugUtilsMessageSeverityFlagsEXT validation_severities =
+        VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    VkDebugUtilsMessageTypeFlagsEXT validation_types = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
+                                                       VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
+                                                       VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+    uint32_t validation_rate = 10; // messages per ID and second, 0 for unlimited
+    // read every frame back and write it to a .raw, .ppm or .y4m file
+    std::string capture_path;
+    uint32_t capture_buffers = 3; // the readback ring
+    // drawn instead of the triangle, written by tools/mesh_converter
+    std::string mesh_path;
+    // dynamic rendering, synchronization2 and timeline semaphores where
+    // the device has Vulkan 1.3, else render passes, framebuffers and fences
+    bool vulkan13 = true;
+    // a hierarchy of this many animated transforms, composed every frame
+    // into a mapped storage buffer
+    uint32_t transform_count = 0;
+    // compose transform_count (default 100000) transforms for frame_count
+    // iterations with transform_system and with glm::mat4, then exit
+    bool transform_benchmark = false;
+    // create only the instance and the device, then run compute_job_count
+    // jobs of each kernel of benchmark_compute_jobs() and exit; always headless
+    bool compute_benchmark = false;
+    uint32_t compute_job_count = 32;
+};
+
+// sets up `config` for one of the benchmark scenes: grid, scene or gpu-scene
+bool apply_bench_scene(app_config& config);
+
+struct vertex {
+    float position[2];
+    float color[3];
+
+    static VkVertexInputBindingDescription get_binding_description() {
+        VkVertexInputBindingDescription binding_description{};
+        binding_description.binding = 0;
+        binding_description.stride = sizeof(vertex);
+        binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return binding_description;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 2> get_attribute_descriptions() {
+        std::array<VkVertexInputAttributeDescription, 2> attribute_descriptions{};
+        attribute_descriptions[0].binding = 0;
+        attribute_descriptions[0].location = 0;
+        attribute_descriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+        attribute_descriptions[0].offset = offsetof(vertex, position);
+        attribute_descriptions[1].binding = 0;
+        attribute_descriptions[1].location = 1;
+        attribute_descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+        attribute_descriptions[1].offset = offsetof(vertex, color);
+        return attribute_descriptions;
+    }
+};
+
+// the attributes of mesh_vertex the shaders take: the 16-bit position is
+// read as a vec2 (x and y, the shaders are 2D) and the color as a vec3
+struct mesh_vertex_input {
+    static VkVertexInputBindingDescription get_binding_description() {
+        VkVertexInputBindingDescription binding_description{};
+        binding_description.binding = 0;
+        binding_description.stride = sizeof(mesh_vertex);
+        binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return binding_description;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 2> get_attribute_descriptions() {
+        std::array<VkVertexInputAttributeDescription, 2> attribute_descriptions{};
+        attribute_descriptions[0].binding = 0;
+        attribute_descriptions[0].location = 0;
+        attribute_descriptions[0].format = VK_FORMAT_R16G16B16A16_SNORM;
+        attribute_descriptions[0].offset = offsetof(mesh_vertex, position);
+        attribute_descriptions[1].binding = 0;
+        attribute_descriptions[1].location = 1;
+        attribute_descriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+        attribute_descriptions[1].offset = offsetof(mesh_vertex, color);
+        return attribute_descriptions;
+    }
+};
+
+// per-draw data, passed to the vertex shader as push constants
+struct draw_item {
+    float offset[2];
+    float scale;
+};
+
+/**
+ * An object of the scene. The same layout is used by the object
+ * buffer that shaders/cull.comp reads and that shaders/scene.vert
+ * takes as a per-instance vertex attribute.
+ */
+struct scene_object {
+    float position[2];
+    float scale;
+    float radius; // of the bounding circle, in world units
+};
+
+// push constants of shaders/scene.vert
+struct scene_camera {
+    float center[2];
+    float zoom;
+    float padding;
+};
+
+// push constants of shaders/cull.comp
+struct cull_constants {
+    float planes[4][4]; // xy: inward normal, w: distance
+    uint32_t object_count;
+    uint32_t index_count;
+    uint32_t compact;   // append visible draws and a count, or one draw per object
+};
+
+/**
+ * Accumulated per-frame timings of one phase of the render loop.
+ * Stall is the time the CPU spent blocked on the in-flight fence
+ * before it could start recording the next frame.
+ */
+struct frame_stall_stats {
+    uint32_t frames_in_flight = 0;
+    uint64_t frames = 0;
+    double stall_ms = 0.0;
+    double record_ms = 0.0;
+    double total_ms = 0.0;
+};
+
+// wall-clock time of the startup phases of init_vulkan()
+struct startup_timings {
+    double instance_ms = 0.0;  // instance, debug messenger and surface
+    double device_ms = 0.0;    // physical device selection and logical device
+    double swap_chain_ms = 0.0; // swap chain or offscreen targets, image views
+    double pipelines_ms = 0.0; // render pass, pipeline cache, pipelines
+    double total_ms = 0.0;     // including everything else, e.g. the geometry upload
+    // the steps above overlap, see init_vulkan(); this is how long they took together
+    double critical_path_ms = 0.0;
+    double first_frame_ms = 0.0; // from run() to the first submitted frame
+};
+
+/**
+ * Latency and pacing of the frames presented under one policy.
+ * Latency runs from the input sampled by glfwPollEvents() to the
+ * moment the CPU sees the frame's fence signalled; the time the
+ * image then waits in the presentation engine is not included.
+ */
+struct present_policy_stats {
+    present_policy policy;
+    VkPresentModeKHR present_mode;
+    uint32_t image_count;
+    std::vector<double> latency_ms;
+    std::vector<double> interval_ms; // between consecutive vkQueuePresentKHR calls
+};
+
 
 class vulkan_app
 {
 public:
+    explicit vulkan_app(const app_config& config = app_config{})
+        : config(config), enable_validation_layers(config.validation) {}
     void run();
 
 private:
+    void init_glfw();
     void init_window();
-
-    static VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(
-        VkDebugUtilsMessageSeverityFlagBitsEXT message_severity,
-        VkDebugUtilsMessageTypeFlagsEXT message_type,
-        const VkDebugUtilsMessengerCallbackDataEXT* callback_data,
-        void* user_data) {
-        
-        std::cerr << "validatoin layer: " << callback_data->pMessage << std::endl;
-        return VK_FALSE;
-    }
+    static void framebuffer_resize_callback(GLFWwindow* window, int width, int height);
+    static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+    void set_present_policy(present_policy policy);
+    void record_present_timing();
+    void report_present_stats();
+    bool is_window_minimized();
 
     bool check_validation_layer_support();
     void populate_debug_messenger_create_info(VkDebugUtilsMessengerCreateInfoEXT& create_info);
@@ -66,24 +353,80 @@ private:
     void pick_physical_device();
     bool check_device_extension_support(VkPhysicalDevice device);
     bool is_device_suitable (VkPhysicalDevice device);
+    device_candidate rate_physical_device(VkPhysicalDevice device, uint32_t index);
     
     void create_logical_device();
     void create_swap_chain();
+    void recreate_swap_chain();
+    void destroy_retired_swap_chains(bool wait_all);
+    void destroy_swap_chain_resources(const retired_swap_chain& retired);
+    void create_offscreen_targets();
     void create_image_views();
+    void create_render_pass();
+    void create_pipeline_cache();
+    void save_pipeline_cache();
+    bool is_pipeline_cache_compatible(const std::vector<char>& data);
+    VkPipeline create_pipeline(const shader& vert, const shader& frag,
+                               const VkPipelineVertexInputStateCreateInfo& vertex_input_info,
+                               VkPipelineLayout layout, const char* name, bool alpha_blend = false);
+    void create_graphics_pipeline();
+    void create_framebuffers();
+    void create_command_pool();
+    void create_command_buffers();
+    void create_sync_objects();
+    void create_render_finished_semaphores();
+    void wait_for_frame_slot();
+    void submit_frame(uint32_t image_index);
+    void create_geometry_buffers();
+    void build_draw_list();
+    void create_scene();
+    void create_culling_pipelines();
+    void destroy_scene();
+    void update_scene_camera();
+    void cull_scene_on_cpu();
+    void record_gpu_culling(VkCommandBuffer command_buffer);
+    void record_indirect_draws(VkCommandBuffer command_buffer);
+    void benchmark_culling();
+    void create_sprites();
+    void create_sprite_pipelines();
+    void destroy_sprites();
+    void update_sprites();
+    void record_sprites(VkCommandBuffer command_buffer);
+    void create_transforms();
+    void destroy_transforms();
+    void update_transforms();
+    void print_transform_stats() const;
+    void run_compute_benchmark();
+    void create_worker_command_buffers();
+    void record_command_buffer(VkCommandBuffer command_buffer, uint32_t image_index);
+    void record_draws(VkCommandBuffer command_buffer, size_t begin, size_t end);
+    void record_viewport(VkCommandBuffer command_buffer);
+    void build_frame_graph();
+    void record_main_pass(VkCommandBuffer command_buffer);
+    void begin_main_pass(VkCommandBuffer command_buffer, bool secondary);
+    void record_secondary_command_buffers(uint32_t image_index);
+    void benchmark_recording();
+    void draw_frame();
+    void report_frame_stall_stats();
+    void write_bench_report();
     void create_instance();
+    void print_instance_extensions();
     void init_vulkan();
     void main_loop();
     void cleanup();
 
     std::vector<const char*> get_required_extensions();
+    std::vector<const char*> get_required_device_extensions();
 
     queue_family_indices find_queue_families(VkPhysicalDevice device);
     swap_chain_support_details query_swap_chain_support(VkPhysicalDevice device);
     VkSurfaceFormatKHR choose_swap_surface_format(const std::vector<VkSurfaceFormatKHR>& available_formats);
     VkPresentModeKHR choose_swap_present_mode(const std::vector<VkPresentModeKHR>& available_present_modes);
     VkExtent2D choose_swap_extent(const VkSurfaceCapabilitiesKHR& capabilities);
+    VkFormat choose_offscreen_format();
 
     /* Private members */
+    const app_config config;
     VkInstance instance;
 
     GLFWwindow* window;
@@ -97,20 +440,170 @@ private:
         VK_KHR_SWAPCHAIN_EXTENSION_NAME
     };
     VkDebugUtilsMessengerEXT debug_messenger;
-    VkSurfaceKHR surface;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
     VkQueue present_queue;
-#ifdef NDEBUG
-    const bool enable_validation_layers = false;
-#else
-    const bool enable_validation_layers = true;
-#endif
+    const bool enable_validation_layers;
+    // the debug messenger's callback, only started with validation
+    debug_logger validation_log;
+    // queried concurrently with the rest of startup, see init_vulkan()
+    bool validation_layers_available = false;
 
+    // the highest version both the loader and this app know about
+    uint32_t api_version = VK_API_VERSION_1_0;
     VkPhysicalDevice physical_device = VK_NULL_HANDLE;
     VkDevice logical_device;
+    queue_family_indices queue_families;
     VkQueue graphics_queue;
-    VkSwapchainKHR swap_chain;
+    // fall back to graphics_queue when there is no dedicated family
+    VkQueue transfer_queue;
+    VkQueue compute_queue;
+    // features enabled on the logical device, the 1.2 (1.3) ones only
+    // when both the instance and the device support Vulkan 1.2 (1.3)
+    VkPhysicalDeviceFeatures enabled_features{};
+    VkPhysicalDeviceVulkan12Features enabled_features12{};
+    VkPhysicalDeviceVulkan13Features enabled_features13{};
+    // dynamic rendering instead of render_pass and swap_chain_framebuffers,
+    // synchronization2 barriers and submits, and frame_timeline instead
+    // of in_flight_fences; chosen in create_logical_device()
+    bool vulkan13_path = false;
+    bool bindless_supported = false;
+    // multiDrawIndirect and drawIndirectFirstInstance, plus drawIndirectCount
+    bool gpu_culling_supported = false;
+    bool draw_indirect_count_supported = false;
+    VkSwapchainKHR swap_chain = VK_NULL_HANDLE;
     std::vector<VkImage> swap_chain_images;
     VkFormat swap_chain_image_format;
     VkExtent2D swap_chain_extent;
     std::vector<VkImageView> swap_chain_image_views;
+    // set by the resize callback or by acquire/present reporting
+    // VK_ERROR_OUT_OF_DATE_KHR / VK_SUBOPTIMAL_KHR
+    bool swap_chain_out_of_date = false;
+    std::vector<retired_swap_chain> retired_swap_chains;
+    // in headless mode swap_chain_images are owned by the app and
+    // backed by these allocations instead of a swap chain
+    const uint32_t offscreen_image_count = 3;
+    std::vector<gpu_allocation> offscreen_image_allocations;
+
+    // passed to every vkCreate*/vkDestroy* call, see host_allocator
+    host_allocator host_memory;
+    gpu_allocator allocator;
+    upload_manager uploads;
+    descriptor_manager descriptors;
+    texture_streamer textures;
+
+    VkBuffer vertex_buffer;
+    gpu_allocation vertex_buffer_allocation;
+    VkBuffer index_buffer;
+    gpu_allocation index_buffer_allocation;
+    uint32_t index_count = 0;
+    VkIndexType index_type = VK_INDEX_TYPE_UINT16;
+    upload_manager::ticket geometry_ticket = 0;
+    // whether this frame can draw, the geometry may still be uploading
+    bool geometry_ready = false;
+    bool scene_ready = false;
+
+    VkRenderPass render_pass = VK_NULL_HANDLE; // 1.0 path only
+    VkPipelineCache pipeline_cache;
+    bool pipeline_cache_warm = false;
+    shader_library shaders;
+    // owned by shaders, like the other reflected layouts
+    VkPipelineLayout pipeline_layout;
+    VkPipeline graphics_pipeline;
+    std::vector<VkFramebuffer> swap_chain_framebuffers; // 1.0 path only
+    // rebuilt whenever the set of passes changes
+    render_graph frame_graph;
+    bool frame_graph_dirty = true;
+    rg_handle backbuffer = 0;
+    rg_handle draw_commands = 0;
+    rg_handle readback = 0;
+    uint32_t current_image_index = 0;
+    VkCommandPool command_pool;
+
+    // one set of these per frame in flight
+    std::vector<VkCommandBuffer> command_buffers;
+    std::vector<VkSemaphore> image_available_semaphores;
+    std::vector<VkFence> in_flight_fences; // 1.0 path
+    // 1.3 path: frame F signals F + 1, and each frame slot remembers
+    // the value its last submission signals
+    VkSemaphore frame_timeline = VK_NULL_HANDLE;
+    std::vector<uint64_t> frame_timeline_values;
+    // signalled for presentation, hence one per swap chain image
+    std::vector<VkSemaphore> render_finished_semaphores;
+    uint32_t current_frame = 0;
+    uint32_t active_frames_in_flight = 1;
+    uint64_t frame_number = 0;
+    std::vector<frame_stall_stats> stall_stats;
+
+    // the policy of the current swap chain and the one the next
+    // recreate_swap_chain() switches to
+    present_policy active_present_policy = present_policy::throughput;
+    present_policy requested_present_policy = present_policy::throughput;
+    std::vector<present_policy_stats> present_stats;
+    std::chrono::steady_clock::time_point input_sample_time;
+    std::chrono::steady_clock::time_point last_present_time;
+    bool presented_since_switch = false;
+    // input sample of the frame last submitted from each frame slot
+    std::vector<std::optional<std::chrono::steady_clock::time_point>> frame_input_samples;
+    frame_profiler profiler;
+    startup_timings startup;
+    std::chrono::steady_clock::time_point run_start;
+    // every frame of the main loop, only kept for the benchmark report
+    std::vector<double> frame_times_ms;
+    uint64_t loop_host_allocations = 0;
+    uint64_t loop_driver_allocations = 0; // only counted with host allocation callbacks
+    double loop_ms = 0.0;
+    double loop_validation_ms = 0.0; // in the debug callback, during the frame loop
+    bool bench_regressed = false;
+
+    // the readback slot of the frame being recorded, if it is captured
+    frame_capture capture;
+    uint32_t capture_slot = frame_capture::no_slot;
+
+    std::vector<draw_item> draw_list;
+
+    // the scene replaces the static grid in draw_list when enabled
+    std::vector<scene_object> scene;
+    scene_camera camera{};
+    uint64_t scene_frame = 0; // drives the camera
+    bool use_gpu_culling = false;
+    VkBuffer object_buffer = VK_NULL_HANDLE;
+    gpu_allocation object_buffer_allocation;
+    upload_manager::ticket scene_ticket = 0;
+    // per frame in flight: the draw count followed by the draw commands
+    std::vector<VkBuffer> indirect_buffers;
+    std::vector<gpu_allocation> indirect_buffer_allocations;
+    static constexpr VkDeviceSize indirect_commands_offset = 16;
+    uint32_t max_draw_indirect_count = 0;
+    VkDescriptorSetLayout cull_set_layout = VK_NULL_HANDLE;
+    VkPipelineLayout cull_pipeline_layout = VK_NULL_HANDLE;
+    VkPipeline cull_pipeline = VK_NULL_HANDLE;
+    VkPipelineLayout scene_pipeline_layout = VK_NULL_HANDLE;
+    VkPipeline scene_pipeline = VK_NULL_HANDLE;
+    // needs bindless descriptors, the sprite shaders index the texture array
+    sprite_renderer sprites;
+    bool sprites_enabled = false;
+    sprite_batch* sprite_tiles = nullptr;
+    std::vector<float> particle_phases;
+    uint32_t particle_texture = texture_streamer::no_descriptor;
+    VkPipelineLayout sprite_pipeline_layout = VK_NULL_HANDLE;
+    // indexed by sprite_blend
+    VkPipeline sprite_pipelines[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+    transform_system transforms;
+    // per frame in flight, and the update each was last written with
+    std::vector<VkBuffer> transform_buffers;
+    std::vector<gpu_allocation> transform_buffer_allocations;
+    std::vector<uint64_t> transform_buffers_written;
+    struct {
+        uint64_t frames = 0;
+        uint64_t worlds = 0;
+        double ms = 0.0;
+    } transform_stats;
+    // only in compute benchmark mode, on compute_queue
+    compute_jobs compute;
+    // secondary command buffers are recorded by the workers, each
+    // from its own pool: [frame in flight][worker]
+    std::unique_ptr<job_system> record_workers;
+    uint32_t active_record_threads = 0;
+    std::vector<std::vector<VkCommandPool>> worker_command_pools;
+    std::vector<std::vector<VkCommandBuffer>> worker_command_buffers;
 };
\ No newline at end of file
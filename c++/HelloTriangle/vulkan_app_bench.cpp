@@ -0,0 +1,201 @@
+#include <vulkan_app.hpp>
+#include <stats.hpp>
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+/**
+ * The benchmark scenes. Everything that varies between runs is fixed:
+ * the scene seed, the camera path (driven by the frame counter), the
+ * number of frames and the lack of a window.
+ */
+bool apply_bench_scene(app_config& config) {
+    if (config.bench_scene == "grid") {
+        config.draw_count = 1000;
+    } else if (config.bench_scene == "scene") {
+        config.scene_objects = 20000;
+    } else if (config.bench_scene == "gpu-scene") {
+        config.scene_objects = 100000;
+        config.gpu_culling = true;
+    } else {
+        return false;
+    }
+    config.headless = true;
+    // counts the driver's host allocations for the report
+    config.host_allocation_callbacks = true;
+    return true;
+}
+
+// the reports are written by write_bench_report(), so this only has to
+// understand nested objects of numbers and strings; the numbers come
+// back under their dotted path, e.g. "frame_ms.p99"
+static std::map<std::string, double> read_bench_report(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open " + path + "!");
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string text = buffer.str();
+
+    std::map<std::string, double> values;
+    std::vector<std::string> scopes;
+    std::string key;
+    int depth = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        char c = text[i];
+        if (c == '"') {
+            size_t end = text.find('"', i + 1);
+            if (end == std::string::npos) {
+                throw std::runtime_error("malformed benchmark report " + path + "!");
+            }
+            std::string token = text.substr(i + 1, end - i - 1);
+            i = end;
+            size_t next = text.find_first_not_of(" \t\r\n", i + 1);
+            if (next != std::string::npos && text[next] == ':') {
+                key = token;
+            }
+        } else if (c == '{') {
+            if (depth++ > 0) {
+                scopes.push_back(key);
+            }
+        } else if (c == '}') {
+            if (--depth > 0) {
+                scopes.pop_back();
+            }
+        } else if (c == '-' || std::isdigit(static_cast<unsigned char>(c))) {
+            size_t used = 0;
+            double value = std::stod(text.substr(i, 32), &used);
+            std::string name;
+            for (const auto& scope : scopes) {
+                name += scope + ".";
+            }
+            values[name + key] = value;
+            i += used - 1;
+        }
+    }
+    return values;
+}
+
+void vulkan_app::write_bench_report() {
+    // the first frames pay for lazy driver work, e.g. shader compilation on first use
+    size_t warmup = frame_times_ms.size() > 20 ? 10 : 0;
+    std::vector<double> frames(frame_times_ms.begin() + warmup, frame_times_ms.end());
+    double mean = 0.0;
+    for (double frame : frames) {
+        mean += frame;
+    }
+    mean /= std::max<size_t>(frames.size(), 1);
+    double max = frames.empty() ? 0.0 : *std::max_element(frames.begin(), frames.end());
+    // what the CPU spends on a frame apart from waiting for its slot to retire
+    double cpu_ms = 0.0, stall_frames = 0.0;
+    for (const auto& stats : stall_stats) {
+        cpu_ms += stats.total_ms - stats.stall_ms;
+        stall_frames += stats.frames;
+    }
+    cpu_ms /= std::max(stall_frames, 1.0);
+    auto gpu_stats = allocator.get_stats();
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+    std::map<std::string, double> current = {
+        {"startup_ms.total", startup.total_ms},
+        {"startup_ms.first_frame", startup.first_frame_ms},
+        {"startup_ms.pipelines", startup.pipelines_ms},
+        {"frame_ms.mean", mean},
+        {"frame_ms.p99", percentile(frames, 0.99)},
+        {"frame_ms.cpu", cpu_ms},
+        {"allocations.host_per_frame",
+         static_cast<double>(loop_host_allocations) / std::max<size_t>(frame_times_ms.size(), 1)},
+        {"allocations.driver_per_frame",
+         static_cast<double>(loop_driver_allocations) / std::max<size_t>(frame_times_ms.size(), 1)},
+        {"allocations.device_memory", static_cast<double>(gpu_stats.total_device_allocations)},
+    };
+
+    std::ostringstream report;
+    report << "{\n"
+           << "  \"scene\": \"" << config.bench_scene << "\",\n"
+           << "  \"device\": \"" << properties.deviceName << "\",\n"
+           << "  \"path\": \"" << (vulkan13_path ? "vulkan13" : "vulkan10") << "\",\n"
+           << "  \"frames\": " << frame_times_ms.size() << ",\n"
+           << "  \"warmup_frames\": " << warmup << ",\n"
+           << "  \"startup_ms\": {\n"
+           << "    \"instance\": " << startup.instance_ms << ",\n"
+           << "    \"device\": " << startup.device_ms << ",\n"
+           << "    \"swap_chain\": " << startup.swap_chain_ms << ",\n"
+           << "    \"pipelines\": " << startup.pipelines_ms << ",\n"
+           << "    \"critical_path\": " << startup.critical_path_ms << ",\n"
+           << "    \"total\": " << startup.total_ms << ",\n"
+           << "    \"first_frame\": " << startup.first_frame_ms << "\n"
+           << "  },\n"
+           << "  \"frame_ms\": {\n"
+           << "    \"mean\": " << mean << ",\n"
+           << "    \"p50\": " << percentile(frames, 0.5) << ",\n"
+           << "    \"p90\": " << percentile(frames, 0.9) << ",\n"
+           << "    \"p99\": " << current["frame_ms.p99"] << ",\n"
+           << "    \"max\": " << max << ",\n"
+           << "    \"cpu\": " << cpu_ms << "\n"
+           << "  },\n"
+           << "  \"allocations\": {\n"
+           << "    \"host_per_frame\": " << current["allocations.host_per_frame"] << ",\n"
+           << "    \"host_total\": " << host_allocation_count() << ",\n"
+           << "    \"driver_per_frame\": " << current["allocations.driver_per_frame"] << ",\n"
+           << "    \"driver_total\": " << host_memory.allocation_count() << ",\n"
+           << "    \"device_memory\": " << gpu_stats.total_device_allocations << ",\n"
+           << "    \"sub_allocations\": " << gpu_stats.sub_allocations << "\n"
+           << "  },\n"
+           << "  \"validation\": {\n"
+           << "    \"layers\": \"" << (enable_validation_layers ? "on" : "off") << "\",\n"
+           << "    \"messages\": " << validation_log.get_stats().messages << ",\n"
+           << "    \"callback_ms_per_frame\": "
+           << loop_validation_ms / std::max<size_t>(frame_times_ms.size(), 1) << "\n"
+           << "  }\n"
+           << "}\n";
+    if (config.bench_json_path.empty()) {
+        std::cout << report.str();
+    } else {
+        std::ofstream file(config.bench_json_path, std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to write " + config.bench_json_path + "!");
+        }
+        file << report.str();
+    }
+
+    if (config.bench_baseline_path.empty()) {
+        return;
+    }
+    // lower is better for all of these; the slack keeps tiny absolute
+    // differences (timer noise, a single extra allocation) from failing
+    const std::pair<const char*, double> metrics[] = {
+        {"startup_ms.total", 1.0},
+        {"startup_ms.first_frame", 1.0},
+        {"startup_ms.pipelines", 1.0},
+        {"frame_ms.mean", 0.05},
+        {"frame_ms.p99", 0.1},
+        {"frame_ms.cpu", 0.05},
+        {"allocations.host_per_frame", 1.0},
+        {"allocations.driver_per_frame", 1.0},
+        {"allocations.device_memory", 1.0},
+    };
+    auto baseline = read_bench_report(config.bench_baseline_path);
+    std::cout << config.bench_scene << " against " << config.bench_baseline_path
+              << " (threshold " << 100.0 * config.bench_threshold << "%):\n";
+    for (const auto& [name, slack] : metrics) {
+        auto found = baseline.find(name);
+        if (found == baseline.end()) {
+            continue;
+        }
+        double before = found->second;
+        double after = current[name];
+        bool regressed = after > before * (1.0 + config.bench_threshold) + slack;
+        std::cout << "\t" << name << ": " << before << " -> " << after;
+        if (before > 0.0) {
+            std::cout << " (" << (after >= before ? "+" : "") << 100.0 * (after - before) / before << "%)";
+        }
+        std::cout << (regressed ? " REGRESSED" : "") << '\n';
+        bench_regressed = bench_regressed || regressed;
+    }
+    std::cout << std::flush;
+}
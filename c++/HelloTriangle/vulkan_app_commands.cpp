@@ -0,0 +1,101 @@
+#include <vulkan_app.hpp>
+
+void vulkan_app::create_command_pool() {
+    queue_family_indices indices = find_queue_families(physical_device);
+
+    VkCommandPoolCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    // command buffers are re-recorded every frame
+    create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    create_info.queueFamilyIndex = indices.graphics_family.value();
+    if (vkCreateCommandPool(logical_device, &create_info, host_memory.callbacks(), &command_pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create a command pool!");
+    }
+}
+
+void vulkan_app::create_command_buffers() {
+    command_buffers.resize(config.frames_in_flight);
+
+    VkCommandBufferAllocateInfo allocate_info{};
+    allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocate_info.commandPool = command_pool;
+    allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocate_info.commandBufferCount = static_cast<uint32_t>(command_buffers.size());
+    if (vkAllocateCommandBuffers(logical_device, &allocate_info, command_buffers.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate command buffers!");
+    }
+}
+
+void vulkan_app::record_command_buffer(VkCommandBuffer command_buffer, uint32_t image_index) {
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (!scene.empty()) {
+        update_scene_camera();
+        if (!use_gpu_culling) {
+            cull_scene_on_cpu();
+        }
+    }
+
+    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording a command buffer!");
+    }
+
+    profiler.reset_queries(command_buffer);
+    // take ownership of finished uploads before anything reads them
+    uploads.record_acquires(command_buffer);
+    geometry_ready = uploads.is_ready(geometry_ticket);
+    scene_ready = geometry_ready && uploads.is_ready(scene_ticket);
+
+    if (frame_graph_dirty) {
+        build_frame_graph();
+    }
+    current_image_index = image_index;
+    frame_graph.set_image(backbuffer, swap_chain_images[image_index]);
+    if (use_gpu_culling) {
+        frame_graph.set_buffer(draw_commands, indirect_buffers[current_frame]);
+    }
+    frame_graph.execute(command_buffer);
+
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record a command buffer!");
+    }
+}
+
+void vulkan_app::record_draws(VkCommandBuffer command_buffer, size_t begin, size_t end) {
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline);
+    // once per command buffer, never per draw
+    if (descriptors.is_bindless()) {
+        descriptors.bind_bindless(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout);
+    }
+    record_viewport(command_buffer);
+
+    if (!geometry_ready) {
+        return;
+    }
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(command_buffer, 0, 1, &vertex_buffer, &offset);
+    vkCmdBindIndexBuffer(command_buffer, index_buffer, 0, index_type);
+    for (size_t i = begin; i < end; i++) {
+        vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT,
+                           0, sizeof(draw_item), &draw_list[i]);
+        vkCmdDrawIndexed(command_buffer, index_count, 1, 0, 0, 0);
+    }
+}
+
+void vulkan_app::record_viewport(VkCommandBuffer command_buffer) {
+    // viewport and scissor are dynamic state of the pipeline, and
+    // secondary command buffers do not inherit it from the primary
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(swap_chain_extent.width);
+    viewport.height = static_cast<float>(swap_chain_extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = swap_chain_extent;
+    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+}
@@ -0,0 +1,47 @@
+#include <vulkan_app.hpp>
+
+/**
+ * Compute without rendering: the same instance, device selection and
+ * logical device as the app (always headless, so no window, surface
+ * or swap chain extension), the allocator, the shader library and the
+ * pipeline cache, and nothing else. The jobs go to compute_queue,
+ * which is a dedicated compute family where there is one.
+ */
+void vulkan_app::run_compute_benchmark() {
+    if (config.host_allocation_callbacks) {
+        host_memory.init(size_t(config.host_arena_kb) * 1024);
+    }
+    if (enable_validation_layers) {
+        validation_log.start(config.validation_rate);
+    }
+    validation_layers_available = !enable_validation_layers || check_validation_layer_support();
+    create_instance();
+    setup_debug_messenger();
+    pick_physical_device();
+    create_logical_device();
+    const VkAllocationCallbacks* callbacks = host_memory.callbacks();
+    allocator.init(physical_device, logical_device, callbacks, 1);
+    shaders.init(logical_device, callbacks);
+    create_pipeline_cache();
+    uint32_t compute_family = queue_families.compute_family.value_or(queue_families.graphics_family.value());
+    compute.init(logical_device, callbacks, &allocator, &shaders, pipeline_cache, compute_family, compute_queue,
+                 enabled_features12.timelineSemaphore == VK_TRUE);
+
+    benchmark_compute_jobs(compute, config.compute_job_count);
+    compute.print_stats(std::cout);
+    allocator.print_stats(std::cout);
+    validation_log.print_stats(std::cout);
+
+    compute.destroy();
+    shaders.destroy();
+    save_pipeline_cache();
+    vkDestroyPipelineCache(logical_device, pipeline_cache, callbacks);
+    allocator.destroy();
+    vkDestroyDevice(logical_device, callbacks);
+    if (enable_validation_layers) {
+        destroy_debug_utils_messenger(instance, debug_messenger, callbacks);
+    }
+    vkDestroyInstance(instance, callbacks);
+    validation_log.stop();
+    host_memory.destroy();
+}
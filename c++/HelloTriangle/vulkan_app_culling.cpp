@@ -0,0 +1,261 @@
+#include <vulkan_app.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+// the objects are scattered over [-extent, extent]^2, of which the
+// camera sees a 2x2 window, i.e. roughly 1/16 of the scene
+static constexpr float scene_extent = 4.0f;
+
+void vulkan_app::create_scene() {
+    if (config.scene_objects == 0) {
+        return;
+    }
+    // a fixed seed, so that runs (and benchmarks) see the same scene
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> position(-scene_extent, scene_extent);
+    std::uniform_real_distribution<float> scale(0.01f, 0.04f);
+    scene.resize(config.scene_objects);
+    for (auto& object : scene) {
+        object.position[0] = position(rng);
+        object.position[1] = position(rng);
+        object.scale = scale(rng);
+        // the triangle's vertices are at most sqrt(0.5) from its origin
+        object.radius = object.scale * 0.7072f;
+    }
+
+    VkDeviceSize size = sizeof(scene_object) * scene.size();
+    object_buffer = allocator.create_buffer(size,
+                                            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, object_buffer_allocation);
+    // read by the cull shader and, per instance, by the vertex shader
+    uploads.upload_buffer(object_buffer, 0, scene.data(), size,
+                          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                          VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+    scene_ticket = uploads.submit();
+
+    if (!config.gpu_culling && !config.culling_benchmark) {
+        return;
+    }
+    if (!gpu_culling_supported) {
+        std::cout << "GPU culling needs multiDrawIndirect and drawIndirectFirstInstance, culling on the CPU" << std::endl;
+        return;
+    }
+    use_gpu_culling = config.gpu_culling;
+
+    indirect_buffers.resize(config.frames_in_flight);
+    indirect_buffer_allocations.resize(config.frames_in_flight);
+    for (uint32_t i = 0; i < config.frames_in_flight; i++) {
+        indirect_buffers[i] = allocator.create_buffer(
+            indirect_commands_offset + sizeof(VkDrawIndexedIndirectCommand) * scene.size(),
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, indirect_buffer_allocations[i]);
+    }
+    // the cull and scene pipelines are compiled concurrently, see init_vulkan()
+}
+
+void vulkan_app::create_culling_pipelines() {
+    // the layouts come from the shaders: two storage buffers and
+    // cull_constants for the cull shader, scene_camera for the scene
+    const shader& cull_shader = shaders.load("shaders/cull.comp.spv");
+    reflected_layout cull_layout = shaders.create_pipeline_layout({&cull_shader});
+    cull_pipeline_layout = cull_layout.layout;
+    cull_set_layout = cull_layout.set_layouts[0];
+
+    VkComputePipelineCreateInfo cull_pipeline_info{};
+    cull_pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    cull_pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    cull_pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    cull_pipeline_info.stage.module = cull_shader.module;
+    cull_pipeline_info.stage.pName = "main";
+    cull_pipeline_info.layout = cull_pipeline_layout;
+    if (vkCreateComputePipelines(logical_device, pipeline_cache, 1, &cull_pipeline_info, host_memory.callbacks(), &cull_pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create the cull pipeline!");
+    }
+
+    const shader& scene_vert = shaders.load("shaders/scene.vert.spv");
+    const shader& scene_frag = shaders.load("shaders/triangle.frag.spv");
+    scene_pipeline_layout = shaders.create_pipeline_layout({&scene_vert, &scene_frag}).layout;
+
+    // binding 0 is the triangle (or mesh), binding 1 steps once per instance through the object buffer
+    bool mesh = !config.mesh_path.empty();
+    VkVertexInputBindingDescription binding_descriptions[2] = {
+        mesh ? mesh_vertex_input::get_binding_description() : vertex::get_binding_description(), {}};
+    binding_descriptions[1].binding = 1;
+    binding_descriptions[1].stride = sizeof(scene_object);
+    binding_descriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    auto vertex_attributes = mesh ? mesh_vertex_input::get_attribute_descriptions()
+                                  : vertex::get_attribute_descriptions();
+    VkVertexInputAttributeDescription attribute_descriptions[3] = {vertex_attributes[0], vertex_attributes[1], {}};
+    attribute_descriptions[2].binding = 1;
+    attribute_descriptions[2].location = 2;
+    attribute_descriptions[2].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    attribute_descriptions[2].offset = 0;
+    VkPipelineVertexInputStateCreateInfo vertex_input_info{};
+    vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertex_input_info.vertexBindingDescriptionCount = 2;
+    vertex_input_info.pVertexBindingDescriptions = binding_descriptions;
+    vertex_input_info.vertexAttributeDescriptionCount = 3;
+    vertex_input_info.pVertexAttributeDescriptions = attribute_descriptions;
+    scene_pipeline = create_pipeline(scene_vert, scene_frag, vertex_input_info, scene_pipeline_layout, "scene");
+}
+
+void vulkan_app::destroy_scene() {
+    vkDestroyPipeline(logical_device, scene_pipeline, host_memory.callbacks());
+    vkDestroyPipeline(logical_device, cull_pipeline, host_memory.callbacks());
+    for (size_t i = 0; i < indirect_buffers.size(); i++) {
+        allocator.destroy_buffer(indirect_buffers[i], indirect_buffer_allocations[i]);
+    }
+    if (object_buffer != VK_NULL_HANDLE) {
+        allocator.destroy_buffer(object_buffer, object_buffer_allocation);
+    }
+}
+
+void vulkan_app::update_scene_camera() {
+    // circle around the scene, deterministic per frame
+    float angle = 0.005f * static_cast<float>(scene_frame++);
+    camera.center[0] = 0.6f * scene_extent * std::cos(angle);
+    camera.center[1] = 0.6f * scene_extent * std::sin(angle);
+    camera.zoom = 1.0f;
+}
+
+void vulkan_app::cull_scene_on_cpu() {
+    float half_extent = 1.0f / camera.zoom;
+    draw_list.clear();
+    for (const auto& object : scene) {
+        float x = object.position[0] - camera.center[0];
+        float y = object.position[1] - camera.center[1];
+        // the same four planes as in record_gpu_culling()
+        if (std::abs(x) - object.radius > half_extent || std::abs(y) - object.radius > half_extent) {
+            continue;
+        }
+        draw_list.push_back({{x * camera.zoom, y * camera.zoom}, object.scale * camera.zoom});
+    }
+}
+
+/**
+ * The cull shader reads the object buffer and writes the draws into
+ * this frame's indirect buffer, whose previous contents were consumed
+ * by the frame that last used this slot and has retired since.
+ */
+void vulkan_app::record_gpu_culling(VkCommandBuffer command_buffer) {
+    VkBuffer draw_buffer = indirect_buffers[current_frame];
+    uint32_t object_count = static_cast<uint32_t>(scene.size());
+    profiler.gpu_begin(command_buffer, "cull");
+
+    // a fresh set every frame, the per-frame pool is reset wholesale
+    VkDescriptorSet set = descriptors.allocate(current_frame, cull_set_layout);
+    VkDescriptorBufferInfo buffer_infos[2] = {
+        {object_buffer, 0, VK_WHOLE_SIZE},
+        {draw_buffer, 0, VK_WHOLE_SIZE}
+    };
+    VkWriteDescriptorSet writes[2]{};
+    for (uint32_t i = 0; i < 2; i++) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &buffer_infos[i];
+    }
+    vkUpdateDescriptorSets(logical_device, 2, writes, 0, nullptr);
+
+    float half_extent = 1.0f / camera.zoom;
+    cull_constants constants{};
+    float planes[4][4] = {
+        { 1.0f,  0.0f, 0.0f, half_extent - camera.center[0]},
+        {-1.0f,  0.0f, 0.0f, half_extent + camera.center[0]},
+        { 0.0f,  1.0f, 0.0f, half_extent - camera.center[1]},
+        { 0.0f, -1.0f, 0.0f, half_extent + camera.center[1]}
+    };
+    std::copy(&planes[0][0], &planes[0][0] + 16, &constants.planes[0][0]);
+    constants.object_count = object_count;
+    constants.index_count = index_count;
+    constants.compact = draw_indirect_count_supported && object_count <= max_draw_indirect_count;
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline_layout,
+                            0, 1, &set, 0, nullptr);
+    vkCmdPushConstants(command_buffer, cull_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT,
+                       0, sizeof(constants), &constants);
+    vkCmdDispatch(command_buffer, (object_count + 63) / 64, 1, 1);
+
+    profiler.gpu_end(command_buffer);
+}
+
+void vulkan_app::record_indirect_draws(VkCommandBuffer command_buffer) {
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, scene_pipeline);
+    record_viewport(command_buffer);
+    vkCmdPushConstants(command_buffer, scene_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT,
+                       0, sizeof(scene_camera), &camera);
+    VkBuffer vertex_buffers[] = {vertex_buffer, object_buffer};
+    VkDeviceSize offsets[] = {0, 0};
+    vkCmdBindVertexBuffers(command_buffer, 0, 2, vertex_buffers, offsets);
+    vkCmdBindIndexBuffer(command_buffer, index_buffer, 0, index_type);
+
+    VkBuffer draw_buffer = indirect_buffers[current_frame];
+    uint32_t object_count = static_cast<uint32_t>(scene.size());
+    uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    if (draw_indirect_count_supported && object_count <= max_draw_indirect_count) {
+        // only the visible objects, the count never leaves the GPU
+        vkCmdDrawIndexedIndirectCount(command_buffer, draw_buffer, indirect_commands_offset,
+                                      draw_buffer, 0, object_count, stride);
+    } else {
+        // every object, culled ones with zero instances, in chunks the device accepts
+        for (uint32_t first = 0; first < object_count; first += max_draw_indirect_count) {
+            uint32_t count = std::min(max_draw_indirect_count, object_count - first);
+            vkCmdDrawIndexedIndirect(command_buffer, draw_buffer,
+                                     indirect_commands_offset + VkDeviceSize(first) * stride, count, stride);
+        }
+    }
+}
+
+/**
+ * Both runs render the same frames of the same scene, the difference
+ * is where culling happens and how many draws the CPU records.
+ */
+void vulkan_app::benchmark_culling() {
+    uploads.wait(geometry_ticket);
+    uploads.wait(scene_ticket);
+    active_frames_in_flight = config.frames_in_flight;
+    std::cout << "culling " << scene.size() << " objects, " << config.frame_count << " frames per run\n";
+
+    double cpu_record_ms = 0.0;
+    for (bool gpu : {false, true}) {
+        if (gpu && !gpu_culling_supported) {
+            std::cout << "\tgpu: not supported by this device\n";
+            break;
+        }
+        use_gpu_culling = gpu;
+        frame_graph_dirty = true;
+        scene_frame = 0;
+        stall_stats.clear();
+        stall_stats.push_back({active_frames_in_flight});
+        uint64_t cpu_draws = 0;
+        for (uint32_t frame = 0; frame < config.frame_count; frame++) {
+            if (!config.headless) {
+                glfwPollEvents();
+            }
+            draw_frame();
+            cpu_draws += draw_list.size();
+        }
+        vkDeviceWaitIdle(logical_device);
+
+        const auto& stats = stall_stats.back();
+        double record_ms = stats.record_ms / stats.frames;
+        if (!gpu) {
+            cpu_record_ms = record_ms;
+            std::cout << "\tcpu: cull + record " << record_ms << " ms/frame, "
+                      << cpu_draws / stats.frames << " draws/frame";
+        } else {
+            std::cout << "\tgpu: record " << record_ms << " ms/frame, "
+                      << (draw_indirect_count_supported ? "indirect count" : "indirect") << " draws, "
+                      << cpu_record_ms / record_ms << "x less CPU time";
+        }
+        std::cout << ", frame time " << stats.total_ms / stats.frames << " ms\n";
+    }
+    std::cout << std::flush;
+    profiler.flush();
+}
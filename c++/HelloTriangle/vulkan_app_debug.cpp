@@ -29,14 +29,13 @@ void vulkan_app::populate_debug_messenger_create_info(
 
     create_info = {};
     create_info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-    create_info.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT |
-                                  VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
-                                  VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
-    create_info.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
-                              VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
-                              VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
-    create_info.pfnUserCallback = debug_callback;
-    // create_info.pUserData = nullptr; // optional
+    // filtered here rather than in the callback, so that the layers
+    // do not format messages nobody is going to read
+    create_info.messageSeverity = config.validation_severities;
+    create_info.messageType = config.validation_types;
+    // queues the message and returns, see debug_logger
+    create_info.pfnUserCallback = debug_logger::callback;
+    create_info.pUserData = &validation_log;
 }
 
 void vulkan_app::setup_debug_messenger() {
@@ -44,7 +43,7 @@ void vulkan_app::setup_debug_messenger() {
 
     VkDebugUtilsMessengerCreateInfoEXT create_info;
     populate_debug_messenger_create_info(create_info);
-    if (create_debug_utils_messenger(instance, &create_info, nullptr, &debug_messenger) != VK_SUCCESS) {
+    if (create_debug_utils_messenger(instance, &create_info, host_memory.callbacks(), &debug_messenger) != VK_SUCCESS) {
         throw std::runtime_error("failed to set up debug messenger!");
     }
 }
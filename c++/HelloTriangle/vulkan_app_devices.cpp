@@ -1,11 +1,23 @@
 #include <vulkan_app.hpp>
 #include <set>
+#include <algorithm>
+#include <cctype>
+
+std::vector<const char*> vulkan_app::get_required_device_extensions() {
+    // offscreen targets are plain images, so headless mode
+    // does not need the swap chain extension
+    if (config.headless) {
+        return {};
+    }
+    return device_extensions;
+}
 
 bool vulkan_app::check_device_extension_support(VkPhysicalDevice device) {
     uint32_t extension_count;
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
     std::vector<VkExtensionProperties> available_extensions(extension_count);
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, available_extensions.data());
+    auto device_extensions = get_required_device_extensions();
     std::set<std::string> required_extensions(device_extensions.begin(), device_extensions.end());
 
     for (const auto& extension : available_extensions) {
@@ -18,6 +30,10 @@ bool vulkan_app::check_device_extension_support(VkPhysicalDevice device) {
 bool vulkan_app::is_device_suitable (VkPhysicalDevice device) {
     auto indeces = find_queue_families(device);
     bool extensions_supported = check_device_extension_support(device);
+    if (config.headless) {
+        // no surface to present to, any device that can draw will do
+        return indeces.is_complete(false) && extensions_supported;
+    }
     bool swap_chain_adequate = false;
     if (extensions_supported) {
         swap_chain_support_details swap_chain_support = query_swap_chain_support(device);
@@ -27,6 +43,122 @@ bool vulkan_app::is_device_suitable (VkPhysicalDevice device) {
     return indeces.is_complete() && extensions_supported && swap_chain_adequate;
 }
 
+/**
+ * The device type dominates the score, so that a discrete GPU always
+ * wins over an integrated one or a software rasterizer. Among devices
+ * of the same type the amount of device-local memory decides, then
+ * asynchronous queues, optional features and limits break the tie.
+ */
+device_candidate vulkan_app::rate_physical_device(VkPhysicalDevice device, uint32_t index) {
+    device_candidate candidate{};
+    candidate.device = device;
+    candidate.index = index;
+    vkGetPhysicalDeviceProperties(device, &candidate.properties);
+    candidate.suitable = is_device_suitable(device);
+
+    // the UUID is stable across reboots and driver updates, unlike the index
+    if (api_version >= VK_API_VERSION_1_1) {
+        VkPhysicalDeviceIDProperties id_properties{};
+        id_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+        VkPhysicalDeviceProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &id_properties;
+        vkGetPhysicalDeviceProperties2(device, &properties2);
+        static const char* hex = "0123456789abcdef";
+        for (uint32_t i = 0; i < VK_UUID_SIZE; i++) {
+            if (i == 4 || i == 6 || i == 8 || i == 10) {
+                candidate.uuid += '-';
+            }
+            candidate.uuid += hex[id_properties.deviceUUID[i] >> 4];
+            candidate.uuid += hex[id_properties.deviceUUID[i] & 0xf];
+        }
+    }
+
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    vkGetPhysicalDeviceMemoryProperties(device, &memory_properties);
+    for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++) {
+        if (memory_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            candidate.device_local_bytes += memory_properties.memoryHeaps[i].size;
+        }
+    }
+
+    uint64_t type_score = 0;
+    switch (candidate.properties.deviceType) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:   type_score = 4; break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: type_score = 3; break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:    type_score = 2; break;
+    case VK_PHYSICAL_DEVICE_TYPE_OTHER:          type_score = 1; break;
+    default:                                     type_score = 0; break; // CPU
+    }
+    uint64_t score = type_score * 1000000000ull;
+    // 10 points per MiB, capped at 64 GiB so that it never outweighs the type
+    score += std::min<uint64_t>(candidate.device_local_bytes >> 20, 65536) * 10;
+
+    auto indices = find_queue_families(device);
+    if (indices.transfer_family.has_value()) {
+        score += 5000;
+    }
+    if (indices.compute_family.has_value()) {
+        score += 5000;
+    }
+
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(device, &features);
+    if (features.multiDrawIndirect) {
+        score += 1000;
+    }
+    if (features.samplerAnisotropy) {
+        score += 500;
+    }
+    if (api_version >= VK_API_VERSION_1_2 && candidate.properties.apiVersion >= VK_API_VERSION_1_2) {
+        VkPhysicalDeviceVulkan12Features features12{};
+        features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &features12;
+        vkGetPhysicalDeviceFeatures2(device, &features2);
+        if (features12.timelineSemaphore) {
+            score += 1000;
+        }
+    }
+
+    const VkPhysicalDeviceLimits& limits = candidate.properties.limits;
+    score += limits.maxImageDimension2D / 1024;
+    score += limits.maxComputeSharedMemorySize / 1024;
+    candidate.score = score;
+    return candidate;
+}
+
+static bool matches_device_selector(const device_candidate& candidate, const std::string& selector) {
+    if (std::all_of(selector.begin(), selector.end(), [](unsigned char c) { return std::isdigit(c); })) {
+        return candidate.index == std::stoul(selector);
+    }
+    // UUIDs are accepted with or without dashes and in either case
+    auto normalize = [](const std::string& text) {
+        std::string result;
+        for (unsigned char c : text) {
+            if (c != '-') {
+                result += static_cast<char>(std::tolower(c));
+            }
+        }
+        return result;
+    };
+    if (!candidate.uuid.empty() && normalize(candidate.uuid) == normalize(selector)) {
+        return true;
+    }
+    return std::string(candidate.properties.deviceName).find(selector) != std::string::npos;
+}
+
+static const char* device_type_name(VkPhysicalDeviceType type) {
+    switch (type) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:   return "discrete";
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:    return "virtual";
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:            return "cpu";
+    default:                                     return "other";
+    }
+}
+
 void vulkan_app::pick_physical_device() {
     uint32_t device_count = 0;
     vkEnumeratePhysicalDevices(instance, &device_count, nullptr);
@@ -36,17 +168,54 @@ void vulkan_app::pick_physical_device() {
     std::vector<VkPhysicalDevice> devices(device_count);
     vkEnumeratePhysicalDevices(instance, &device_count, devices.data());
 
-    
+    std::vector<device_candidate> candidates;
+    for (uint32_t i = 0; i < device_count; i++) {
+        candidates.push_back(rate_physical_device(devices[i], i));
+    }
+    // stable, so that equal scores keep the driver's order
+    std::stable_sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) {
+        return a.suitable != b.suitable ? a.suitable : a.score > b.score;
+    });
 
-    for (const auto& device : devices) {
-        if (is_device_suitable(device)) {
-            physical_device = device;
-            break;
+    std::cout << "physical devices, best first:\n";
+    for (const auto& candidate : candidates) {
+        std::cout << "\t[" << candidate.index << "] " << candidate.properties.deviceName
+                  << " (" << device_type_name(candidate.properties.deviceType)
+                  << ", " << (candidate.device_local_bytes >> 20) << " MiB device-local";
+        if (!candidate.uuid.empty()) {
+            std::cout << ", uuid " << candidate.uuid;
+        }
+        std::cout << "): ";
+        if (candidate.suitable) {
+            std::cout << "score " << candidate.score << '\n';
+        } else {
+            std::cout << "unsuitable\n";
         }
     }
-    if (physical_device == VK_NULL_HANDLE) {
+
+    const device_candidate* chosen = nullptr;
+    if (!config.device.empty()) {
+        for (const auto& candidate : candidates) {
+            if (matches_device_selector(candidate, config.device)) {
+                chosen = &candidate;
+                break;
+            }
+        }
+        if (chosen == nullptr) {
+            throw std::runtime_error("no physical device matches \"" + config.device + "\"!");
+        }
+        if (!chosen->suitable) {
+            throw std::runtime_error(std::string("the requested device is not suitable: ") + chosen->properties.deviceName);
+        }
+    } else if (candidates.front().suitable) {
+        chosen = &candidates.front();
+    }
+    if (chosen == nullptr) {
         throw std::runtime_error("failed to find a suitable GPU!");
     }
+    physical_device = chosen->device;
+    std::cout << "using [" << chosen->index << "] " << chosen->properties.deviceName
+              << (config.device.empty() ? "" : " (forced)") << std::endl;
 }
 
 queue_family_indices vulkan_app::find_queue_families(VkPhysicalDevice device) {
@@ -57,32 +226,53 @@ queue_family_indices vulkan_app::find_queue_families(VkPhysicalDevice device) {
     std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, queue_families.data());
 
-    int i = 0;
-    for (const auto& queue_family : queue_families) {
-        if (queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+    // scan every family: a dedicated transfer or compute family is
+    // usually listed after the graphics one
+    for (uint32_t i = 0; i < queue_family_count; i++) {
+        VkQueueFlags flags = queue_families[i].queueFlags;
+        if ((flags & VK_QUEUE_GRAPHICS_BIT) && !indices.graphics_family.has_value()) {
             indices.graphics_family = i;
         }
-        
-        VkBool32 present_support = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support);
-        if (present_support) {
-            indices.present_family = i;
+        if (!config.headless) {
+            VkBool32 present_support = false;
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support);
+            // presenting from the graphics family saves an ownership transfer
+            if (present_support && (!indices.present_family.has_value() || indices.graphics_family == i)) {
+                indices.present_family = i;
+            }
+        }
+        // a transfer-only family is typically the DMA copy engine, failing
+        // that any non-graphics family that can copy is still asynchronous
+        if (!(flags & VK_QUEUE_GRAPHICS_BIT) && (flags & VK_QUEUE_TRANSFER_BIT || flags & VK_QUEUE_COMPUTE_BIT)) {
+            bool transfer_only = !(flags & VK_QUEUE_COMPUTE_BIT);
+            if (!indices.transfer_family.has_value() ||
+                (transfer_only && queue_families[indices.transfer_family.value()].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+                indices.transfer_family = i;
+            }
         }
-        if (indices.is_complete()) {
-            break;
+        if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && !indices.compute_family.has_value()) {
+            indices.compute_family = i;
         }
-        i++;
     }
 
     return indices;
 }
 
 void vulkan_app::create_logical_device() {
-    queue_family_indices indices = find_queue_families(physical_device);
+    queue_families = find_queue_families(physical_device);
+    const queue_family_indices& indices = queue_families;
 
     std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
-    std::set<uint32_t> unique_queue_families = {indices.graphics_family.value(),
-                                                indices.present_family.value()  };
+    std::set<uint32_t> unique_queue_families = {indices.graphics_family.value()};
+    if (!config.headless) {
+        unique_queue_families.insert(indices.present_family.value());
+    }
+    if (indices.transfer_family.has_value()) {
+        unique_queue_families.insert(indices.transfer_family.value());
+    }
+    if (indices.compute_family.has_value()) {
+        unique_queue_families.insert(indices.compute_family.value());
+    }
 
     float queue_priority = 1.0f;
     for (uint32_t queue_family : unique_queue_families) {
@@ -93,19 +283,91 @@ void vulkan_app::create_logical_device() {
         queue_create_info.pQueuePriorities = &queue_priority;
         queue_create_infos.push_back(queue_create_info);
     }
-    
 
-    VkPhysicalDeviceFeatures device_features{}; // empty for now
+    // Vulkan 1.2 features are queried and enabled through a pNext chain,
+    // which needs both a 1.2 instance and a 1.2 device
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    bool vulkan12 = api_version >= VK_API_VERSION_1_2 && properties.apiVersion >= VK_API_VERSION_1_2;
+    enabled_features = VkPhysicalDeviceFeatures{};
+    VkPhysicalDeviceFeatures supported_features;
+    vkGetPhysicalDeviceFeatures(physical_device, &supported_features);
+    // GPU culling emits one indirect draw per object, each selecting
+    // its object through firstInstance
+    gpu_culling_supported = supported_features.multiDrawIndirect && supported_features.drawIndirectFirstInstance;
+    enabled_features.multiDrawIndirect = supported_features.multiDrawIndirect;
+    enabled_features.drawIndirectFirstInstance = supported_features.drawIndirectFirstInstance;
+    max_draw_indirect_count = properties.limits.maxDrawIndirectCount;
+    // texture_streamer checks these before it picks a compressed format
+    enabled_features.textureCompressionBC = supported_features.textureCompressionBC;
+    enabled_features.textureCompressionASTC_LDR = supported_features.textureCompressionASTC_LDR;
+    enabled_features12 = VkPhysicalDeviceVulkan12Features{};
+    enabled_features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    if (vulkan12) {
+        VkPhysicalDeviceVulkan12Features supported12{};
+        supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 supported{};
+        supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supported.pNext = &supported12;
+        vkGetPhysicalDeviceFeatures2(physical_device, &supported);
+        enabled_features12.timelineSemaphore = supported12.timelineSemaphore;
+        enabled_features12.drawIndirectCount = supported12.drawIndirectCount;
+        draw_indirect_count_supported = supported12.drawIndirectCount == VK_TRUE;
+        // everything descriptor_manager needs for its bindless set
+        bindless_supported = config.bindless &&
+                             supported12.descriptorIndexing &&
+                             supported12.runtimeDescriptorArray &&
+                             supported12.descriptorBindingPartiallyBound &&
+                             supported12.descriptorBindingUpdateUnusedWhilePending &&
+                             supported12.descriptorBindingSampledImageUpdateAfterBind &&
+                             supported12.descriptorBindingStorageBufferUpdateAfterBind &&
+                             supported12.shaderSampledImageArrayNonUniformIndexing &&
+                             supported12.shaderStorageBufferArrayNonUniformIndexing;
+        if (bindless_supported) {
+            enabled_features12.descriptorIndexing = VK_TRUE;
+            enabled_features12.runtimeDescriptorArray = VK_TRUE;
+            enabled_features12.descriptorBindingPartiallyBound = VK_TRUE;
+            enabled_features12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+            enabled_features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+            enabled_features12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+            enabled_features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+            enabled_features12.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+        }
+    }
+    // the 1.3 path needs all three, anything less keeps the render pass,
+    // framebuffers and fences of the 1.0 path
+    enabled_features13 = VkPhysicalDeviceVulkan13Features{};
+    enabled_features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    vulkan13_path = false;
+    if (config.vulkan13 && vulkan12 && api_version >= VK_API_VERSION_1_3 &&
+        properties.apiVersion >= VK_API_VERSION_1_3 && enabled_features12.timelineSemaphore) {
+        VkPhysicalDeviceVulkan13Features supported13{};
+        supported13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+        VkPhysicalDeviceFeatures2 supported{};
+        supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supported.pNext = &supported13;
+        vkGetPhysicalDeviceFeatures2(physical_device, &supported);
+        vulkan13_path = supported13.dynamicRendering && supported13.synchronization2;
+        if (vulkan13_path) {
+            enabled_features13.dynamicRendering = VK_TRUE;
+            enabled_features13.synchronization2 = VK_TRUE;
+            enabled_features12.pNext = &enabled_features13;
+        }
+    }
 
     VkDeviceCreateInfo create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    if (vulkan12) {
+        create_info.pNext = &enabled_features12;
+    }
 
     create_info.pQueueCreateInfos = queue_create_infos.data();
     create_info.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
 
-    create_info.pEnabledFeatures = &device_features;
+    create_info.pEnabledFeatures = &enabled_features;
 
-    create_info.enabledExtensionCount = device_extensions.size();
+    auto device_extensions = get_required_device_extensions();
+    create_info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
     create_info.ppEnabledExtensionNames = device_extensions.data();
 
     if (enable_validation_layers) {
@@ -115,10 +377,26 @@ void vulkan_app::create_logical_device() {
         create_info.enabledLayerCount = 0;
     }
 
-    if (vkCreateDevice(physical_device, &create_info, nullptr, &logical_device) != VK_SUCCESS) {
+    if (vkCreateDevice(physical_device, &create_info, host_memory.callbacks(), &logical_device) != VK_SUCCESS) {
         throw std::runtime_error("failed to create logical device");
     }
 
     vkGetDeviceQueue(logical_device, indices.graphics_family.value(), 0, &graphics_queue);
-    vkGetDeviceQueue(logical_device, indices.present_family.value(), 0, &present_queue);
-}
\ No newline at end of file
+    if (!config.headless) {
+        vkGetDeviceQueue(logical_device, indices.present_family.value(), 0, &present_queue);
+    }
+    transfer_queue = graphics_queue;
+    if (indices.transfer_family.has_value()) {
+        vkGetDeviceQueue(logical_device, indices.transfer_family.value(), 0, &transfer_queue);
+    }
+    compute_queue = graphics_queue;
+    if (indices.compute_family.has_value()) {
+        vkGetDeviceQueue(logical_device, indices.compute_family.value(), 0, &compute_queue);
+    }
+    std::cout << "queue families: graphics " << indices.graphics_family.value()
+              << ", transfer " << (indices.transfer_family.has_value() ? std::to_string(indices.transfer_family.value()) : "shared")
+              << ", compute " << (indices.compute_family.has_value() ? std::to_string(indices.compute_family.value()) : "shared")
+              << (enabled_features12.timelineSemaphore ? ", timeline semaphores" : "")
+              << (bindless_supported ? ", bindless descriptors" : "")
+              << (vulkan13_path ? ", Vulkan 1.3 path" : ", Vulkan 1.0 path") << std::endl;
+}
@@ -0,0 +1,137 @@
+#include <vulkan_app.hpp>
+
+/**
+ * The frame as a render graph: the passes only say what they touch,
+ * the barriers between them (and the layout transitions of the swap
+ * chain image) are left to the graph. The structure changes only when
+ * GPU culling is switched on or off, everything else that varies from
+ * frame to frame is rebound in record_command_buffer().
+ */
+void vulkan_app::build_frame_graph() {
+    frame_graph.reset();
+    // the image is handed over by the acquire semaphore, whose wait is
+    // at the color attachment output stage (see draw_frame())
+    if (config.headless) {
+        // offscreen targets are never presented, leave them ready to be copied out
+        backbuffer = frame_graph.import_image("backbuffer", VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                              VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    } else {
+        // presentation is ordered by the render finished semaphore
+        backbuffer = frame_graph.import_image("backbuffer", VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                              VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                              VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+    }
+
+    // passes run in the order they are added, and culling walks them
+    // backwards, so the producers of the draw commands go first
+    rg_handle objects = 0;
+    if (use_gpu_culling) {
+        objects = frame_graph.import_buffer("objects");
+        draw_commands = frame_graph.import_buffer("draw commands");
+        frame_graph.set_buffer(objects, object_buffer);
+
+        uint32_t clear_pass = frame_graph.add_pass("clear draw count", [this](VkCommandBuffer command_buffer) {
+            vkCmdFillBuffer(command_buffer, indirect_buffers[current_frame], 0, sizeof(uint32_t), 0);
+        });
+        frame_graph.use(clear_pass, draw_commands, rg_access::transfer_write);
+
+        uint32_t cull_pass = frame_graph.add_pass("cull", [this](VkCommandBuffer command_buffer) {
+            if (scene_ready) {
+                record_gpu_culling(command_buffer);
+            }
+        });
+        frame_graph.use(cull_pass, objects, rg_access::storage_read);
+        frame_graph.use(cull_pass, draw_commands, rg_access::storage_read_write);
+    }
+
+    uint32_t main_pass = frame_graph.add_pass("main", [this](VkCommandBuffer command_buffer) {
+        record_main_pass(command_buffer);
+    });
+    frame_graph.use(main_pass, backbuffer, rg_access::color_attachment_write);
+    if (use_gpu_culling) {
+        frame_graph.use(main_pass, objects, rg_access::vertex_read);
+        frame_graph.use(main_pass, draw_commands, rg_access::indirect_read);
+    }
+
+    if (capture.is_enabled()) {
+        // the readback buffer changes every frame and is read by the host
+        // after the frame's fence, so it only has to keep the pass alive
+        readback = frame_graph.import_buffer("readback", true);
+        uint32_t capture_pass = frame_graph.add_pass("capture", [this](VkCommandBuffer command_buffer) {
+            if (capture_slot != frame_capture::no_slot) {
+                capture.record_copy(command_buffer, capture_slot, frame_graph.image(backbuffer));
+            }
+        });
+        frame_graph.use(capture_pass, backbuffer, rg_access::transfer_read);
+        frame_graph.use(capture_pass, readback, rg_access::transfer_write);
+    }
+
+    frame_graph.compile();
+    frame_graph.print_summary(std::cout);
+    frame_graph_dirty = false;
+}
+
+void vulkan_app::record_main_pass(VkCommandBuffer command_buffer) {
+    profiler.gpu_begin(command_buffer, "render pass");
+    if (use_gpu_culling) {
+        // a handful of indirect draws, nothing worth spreading over the workers
+        begin_main_pass(command_buffer, false);
+        if (scene_ready) {
+            record_indirect_draws(command_buffer);
+        }
+        record_sprites(command_buffer);
+    } else if (active_record_threads > 0) {
+        // the workers record the draws, all that is left here is to stitch them together
+        record_secondary_command_buffers(current_image_index);
+        begin_main_pass(command_buffer, true);
+        vkCmdExecuteCommands(command_buffer, active_record_threads, worker_command_buffers[current_frame].data());
+    } else {
+        begin_main_pass(command_buffer, false);
+        record_draws(command_buffer, 0, draw_list.size());
+        record_sprites(command_buffer);
+    }
+    if (vulkan13_path) {
+        vkCmdEndRendering(command_buffer);
+    } else {
+        vkCmdEndRenderPass(command_buffer);
+    }
+    profiler.gpu_end(command_buffer);
+}
+
+// clears the backbuffer; the frame graph has already put it into COLOR_ATTACHMENT_OPTIMAL
+void vulkan_app::begin_main_pass(VkCommandBuffer command_buffer, bool secondary) {
+    VkClearValue clear_color = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+    VkRect2D render_area{};
+    render_area.offset = {0, 0};
+    render_area.extent = swap_chain_extent;
+
+    if (vulkan13_path) {
+        VkRenderingAttachmentInfo color_attachment{};
+        color_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        color_attachment.imageView = swap_chain_image_views[current_image_index];
+        color_attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        color_attachment.clearValue = clear_color;
+        VkRenderingInfo rendering_info{};
+        rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        rendering_info.flags = secondary ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0;
+        rendering_info.renderArea = render_area;
+        rendering_info.layerCount = 1;
+        rendering_info.colorAttachmentCount = 1;
+        rendering_info.pColorAttachments = &color_attachment;
+        vkCmdBeginRendering(command_buffer, &rendering_info);
+        return;
+    }
+
+    VkRenderPassBeginInfo render_pass_info{};
+    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    render_pass_info.renderPass = render_pass;
+    render_pass_info.framebuffer = swap_chain_framebuffers[current_image_index];
+    render_pass_info.renderArea = render_area;
+    render_pass_info.clearValueCount = 1;
+    render_pass_info.pClearValues = &clear_color;
+    vkCmdBeginRenderPass(command_buffer, &render_pass_info,
+                         secondary ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+}
@@ -0,0 +1,279 @@
+#include <vulkan_app.hpp>
+#include <chrono>
+
+void vulkan_app::create_sync_objects() {
+    image_available_semaphores.resize(config.frames_in_flight);
+    VkSemaphoreCreateInfo semaphore_info{};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    frame_input_samples.assign(config.frames_in_flight, std::nullopt);
+
+    for (size_t i = 0; i < config.frames_in_flight; i++) {
+        if (vkCreateSemaphore(logical_device, &semaphore_info, host_memory.callbacks(), &image_available_semaphores[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create synchronization objects for a frame!");
+        }
+    }
+    if (vulkan13_path) {
+        // one semaphore for all frame slots; a slot that was never
+        // submitted waits for 0, which the initial value already is
+        VkSemaphoreTypeCreateInfo type_info{};
+        type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        type_info.initialValue = 0;
+        VkSemaphoreCreateInfo timeline_info{};
+        timeline_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        timeline_info.pNext = &type_info;
+        if (vkCreateSemaphore(logical_device, &timeline_info, host_memory.callbacks(), &frame_timeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create the frame timeline semaphore!");
+        }
+        frame_timeline_values.assign(config.frames_in_flight, 0);
+    } else {
+        in_flight_fences.resize(config.frames_in_flight);
+        VkFenceCreateInfo fence_info{};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        // start signalled, so that the very first wait in draw_frame() does not block forever
+        fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        for (auto& fence : in_flight_fences) {
+            if (vkCreateFence(logical_device, &fence_info, host_memory.callbacks(), &fence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create synchronization objects for a frame!");
+            }
+        }
+    }
+    create_render_finished_semaphores();
+}
+
+void vulkan_app::create_render_finished_semaphores() {
+    render_finished_semaphores.resize(config.headless ? 0 : swap_chain_images.size());
+    VkSemaphoreCreateInfo semaphore_info{};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    for (auto& semaphore : render_finished_semaphores) {
+        if (vkCreateSemaphore(logical_device, &semaphore_info, host_memory.callbacks(), &semaphore) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create synchronization objects for a frame!");
+        }
+    }
+}
+
+// blocks until the GPU is done with the frame that last used this slot
+void vulkan_app::wait_for_frame_slot() {
+    if (vulkan13_path) {
+        VkSemaphoreWaitInfo wait_info{};
+        wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        wait_info.semaphoreCount = 1;
+        wait_info.pSemaphores = &frame_timeline;
+        wait_info.pValues = &frame_timeline_values[current_frame];
+        vkWaitSemaphores(logical_device, &wait_info, UINT64_MAX);
+    } else {
+        vkWaitForFences(logical_device, 1, &in_flight_fences[current_frame], VK_TRUE, UINT64_MAX);
+    }
+}
+
+void vulkan_app::submit_frame(uint32_t image_index) {
+    if (vulkan13_path) {
+        // nothing to reset: the slot is free again once the timeline passes frame_number + 1
+        uint64_t signal_value = frame_number + 1;
+        VkSemaphoreSubmitInfo wait_info{};
+        wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+        wait_info.semaphore = image_available_semaphores[current_frame];
+        wait_info.stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+        VkSemaphoreSubmitInfo signal_infos[2]{};
+        signal_infos[0].sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+        signal_infos[0].semaphore = frame_timeline;
+        signal_infos[0].value = signal_value;
+        signal_infos[0].stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        VkCommandBufferSubmitInfo command_buffer_info{};
+        command_buffer_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+        command_buffer_info.commandBuffer = command_buffers[current_frame];
+
+        VkSubmitInfo2 submit_info{};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+        submit_info.commandBufferInfoCount = 1;
+        submit_info.pCommandBufferInfos = &command_buffer_info;
+        submit_info.signalSemaphoreInfoCount = 1;
+        submit_info.pSignalSemaphoreInfos = signal_infos;
+        if (!config.headless) {
+            submit_info.waitSemaphoreInfoCount = 1;
+            submit_info.pWaitSemaphoreInfos = &wait_info;
+            signal_infos[1].sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+            signal_infos[1].semaphore = render_finished_semaphores[image_index];
+            signal_infos[1].stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+            submit_info.signalSemaphoreInfoCount = 2;
+        }
+        if (vkQueueSubmit2(graphics_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit a draw command buffer!");
+        }
+        frame_timeline_values[current_frame] = signal_value;
+        return;
+    }
+
+    VkSubmitInfo submit_info{};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    if (!config.headless) {
+        submit_info.waitSemaphoreCount = 1;
+        submit_info.pWaitSemaphores = &image_available_semaphores[current_frame];
+        submit_info.pWaitDstStageMask = wait_stages;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &render_finished_semaphores[image_index];
+    }
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &command_buffers[current_frame];
+    if (vkQueueSubmit(graphics_queue, 1, &submit_info, in_flight_fences[current_frame]) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit a draw command buffer!");
+    }
+}
+
+/**
+ * Waiting on the fence (or the timeline semaphore) only blocks until
+ * the GPU is done with the frame that used this slot
+ * active_frames_in_flight frames ago, so the CPU records the next
+ * frame while the GPU is still busy with the previous ones.
+ */
+void vulkan_app::draw_frame() {
+    using clock = std::chrono::steady_clock;
+    auto frame_start = clock::now();
+
+    wait_for_frame_slot();
+    auto stall_end = clock::now();
+    if (frame_input_samples[current_frame]) {
+        present_stats.back().latency_ms.push_back(
+            std::chrono::duration<double, std::milli>(stall_end - *frame_input_samples[current_frame]).count());
+        frame_input_samples[current_frame].reset();
+    }
+    destroy_retired_swap_chains(false);
+
+    // acquire before any of the frame's bookkeeping, so that a swap
+    // chain that is out of date leaves nothing behind for a frame that
+    // never happens
+    uint32_t image_index;
+    clock::time_point acquire_start, acquire_end;
+    if (config.headless) {
+        // there are at least as many offscreen targets as frames in flight
+        image_index = static_cast<uint32_t>(frame_number % swap_chain_images.size());
+    } else {
+        if (swap_chain_out_of_date) {
+            recreate_swap_chain();
+        }
+        acquire_start = clock::now();
+        VkResult result = vkAcquireNextImageKHR(logical_device, swap_chain, UINT64_MAX,
+                                                image_available_semaphores[current_frame],
+                                                VK_NULL_HANDLE, &image_index);
+        acquire_end = clock::now();
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            // nothing was acquired and the slot is still free, try again next frame
+            swap_chain_out_of_date = true;
+            return;
+        } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+            throw std::runtime_error("failed to acquire a swap chain image!");
+        }
+    }
+
+    // the GPU is done with this frame's transient data and timestamps
+    allocator.reset_frame(current_frame);
+    descriptors.begin_frame(current_frame, frame_number);
+    frame_graph.begin_frame(frame_number);
+    profiler.begin_frame(current_frame, frame_number);
+    if (!config.headless) {
+        profiler.add_cpu_scope("acquire", acquire_start, acquire_end);
+    }
+    // queue this frame's share of texture levels and the sprite batches
+    // that changed, then send off whatever was queued for upload since
+    // the last frame
+    textures.update(frame_number);
+    update_sprites();
+    uploads.submit();
+    // and this frame slot's world matrices
+    update_transforms();
+
+    if (capture.is_enabled()) {
+        // waits for a readback buffer in headless mode, skips the frame otherwise
+        capture_slot = capture.acquire(swap_chain_image_format, swap_chain_extent, frame_number);
+    }
+    if (!vulkan13_path) {
+        vkResetFences(logical_device, 1, &in_flight_fences[current_frame]);
+    }
+
+    auto record_start = clock::now();
+    {
+        auto scope = profiler.cpu_scope("record");
+        vkResetCommandBuffer(command_buffers[current_frame], 0);
+        record_command_buffer(command_buffers[current_frame], image_index);
+    }
+    auto record_end = clock::now();
+
+    {
+        auto scope = profiler.cpu_scope("submit");
+        submit_frame(image_index);
+        if (capture_slot != frame_capture::no_slot) {
+            capture.submit(graphics_queue, capture_slot);
+            capture_slot = frame_capture::no_slot;
+        }
+    }
+
+    if (!config.headless) {
+        auto scope = profiler.cpu_scope("present");
+        VkPresentInfoKHR present_info{};
+        present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        present_info.waitSemaphoreCount = 1;
+        present_info.pWaitSemaphores = &render_finished_semaphores[image_index];
+        present_info.swapchainCount = 1;
+        present_info.pSwapchains = &swap_chain;
+        present_info.pImageIndices = &image_index;
+        VkResult result = vkQueuePresentKHR(present_queue, &present_info);
+        record_present_timing();
+        frame_input_samples[current_frame] = input_sample_time;
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+            swap_chain_out_of_date = true;
+        } else if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to present a swap chain image!");
+        }
+    }
+
+    profiler.end_frame();
+    auto frame_end = clock::now();
+    auto& stats = stall_stats.back();
+    stats.frames++;
+    stats.stall_ms += std::chrono::duration<double, std::milli>(stall_end - frame_start).count();
+    stats.record_ms += std::chrono::duration<double, std::milli>(record_end - record_start).count();
+    stats.total_ms += std::chrono::duration<double, std::milli>(frame_end - frame_start).count();
+    if (!config.bench_scene.empty()) {
+        frame_times_ms.push_back(std::chrono::duration<double, std::milli>(frame_end - frame_start).count());
+    }
+
+    if (frame_number == 0) {
+        startup.first_frame_ms = std::chrono::duration<double, std::milli>(frame_end - run_start).count();
+        std::cout << "first frame submitted " << startup.first_frame_ms << " ms after start" << std::endl;
+    }
+    frame_number++;
+    current_frame = (current_frame + 1) % active_frames_in_flight;
+
+    // the single-frame baseline is over, switch to the pipelined loop
+    if (config.compare_frames_in_flight && stall_stats.size() == 1 && stats.frames == config.frame_count) {
+        active_frames_in_flight = config.frames_in_flight;
+        current_frame = 0;
+        stall_stats.push_back({active_frames_in_flight});
+    }
+}
+
+void vulkan_app::report_frame_stall_stats() {
+    for (const auto& stats : stall_stats) {
+        if (stats.frames == 0) {
+            continue;
+        }
+        std::cout << "frames in flight: " << stats.frames_in_flight
+                  << ", frames: " << stats.frames
+                  << ", frame time: " << stats.total_ms / stats.frames << " ms"
+                  << ", cpu stall: " << stats.stall_ms / stats.frames << " ms/frame"
+                  << ", record: " << stats.record_ms / stats.frames << " ms/frame"
+                  << ", cpu: " << (stats.total_ms - stats.stall_ms) / stats.frames << " ms/frame"
+                  << ", throughput: " << 1000.0 * stats.frames / stats.total_ms << " fps\n";
+    }
+    if (stall_stats.size() == 2 && stall_stats[0].frames > 0 && stall_stats[1].frames > 0) {
+        double single = stall_stats[0].stall_ms / stall_stats[0].frames;
+        double pipelined = stall_stats[1].stall_ms / stall_stats[1].frames;
+        std::cout << "pipelining removed " << single - pipelined << " ms of cpu stall per frame";
+        if (single > 0.0) {
+            std::cout << " (" << 100.0 * (single - pipelined) / single << "%)";
+        }
+        std::cout << '\n';
+    }
+    std::cout << std::flush;
+}
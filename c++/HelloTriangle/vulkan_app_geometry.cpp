@@ -0,0 +1,61 @@
+#include <vulkan_app.hpp>
+
+/**
+ * The triangle (or the mesh of --mesh) lives in device-local vertex
+ * and index buffers. They are filled through the upload manager on
+ * the transfer queue, so startup does not wait for the copy: frames
+ * clear the screen until the upload has completed and been acquired
+ * by the graphics queue.
+ */
+void vulkan_app::create_geometry_buffers() {
+    const std::vector<vertex> vertices = {
+        {{0.0f, -0.5f}, {1.0f, 0.0f, 0.0f}},
+        {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}},
+        {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}}
+    };
+    const std::vector<uint16_t> indices = {0, 1, 2};
+
+    // a mesh file replaces the triangle; its sections are copied from
+    // the mapping into staging memory as they are
+    mesh_file mesh;
+    const void* vertex_data = vertices.data();
+    VkDeviceSize vertex_size = sizeof(vertices[0]) * vertices.size();
+    const void* index_data = indices.data();
+    VkDeviceSize index_size = sizeof(indices[0]) * indices.size();
+    index_count = static_cast<uint32_t>(indices.size());
+    if (!config.mesh_path.empty()) {
+        auto load_start = std::chrono::steady_clock::now();
+        mesh = open_mesh_file(config.mesh_path);
+        vertex_data = mesh.vertices();
+        vertex_size = mesh.vertex_bytes();
+        index_data = mesh.indices();
+        index_size = mesh.index_bytes();
+        index_count = mesh.header->index_count;
+        index_type = mesh.header->index_size == 4 ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+        std::cout << config.mesh_path << ": " << mesh.header->vertex_count << " vertices, " << index_count / 3
+                  << " triangles, " << mesh.header->meshlet_count << " meshlets, mapped in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - load_start).count()
+                  << " ms" << std::endl;
+    }
+
+    bool timeline = enabled_features12.timelineSemaphore == VK_TRUE;
+    uint32_t transfer_family = queue_families.transfer_family.value_or(queue_families.graphics_family.value());
+    uploads.init(logical_device, host_memory.callbacks(), &allocator, transfer_family, transfer_queue,
+                 queue_families.graphics_family.value(), timeline);
+
+    vertex_buffer = allocator.create_buffer(vertex_size,
+                                            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, vertex_buffer_allocation);
+    index_buffer = allocator.create_buffer(index_size,
+                                           VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, index_buffer_allocation);
+
+    uploads.upload_buffer(vertex_buffer, 0, vertex_data, vertex_size,
+                          VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+    uploads.upload_buffer(index_buffer, 0, index_data, index_size,
+                          VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+    geometry_ticket = uploads.submit();
+    std::cout << "geometry upload submitted to the "
+              << (uploads.ownership_transfers() ? "dedicated transfer" : "graphics") << " queue ("
+              << (timeline ? "timeline semaphore" : "fence") << " completion)" << std::endl;
+}
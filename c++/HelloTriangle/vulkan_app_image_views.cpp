@@ -17,7 +17,7 @@ void vulkan_app::create_image_views() {
         create_info.subresourceRange.baseMipLevel = 0;
         create_info.subresourceRange.layerCount = 1;
         create_info.subresourceRange.levelCount = 1;
-        if (vkCreateImageView(logical_device, &create_info, nullptr, &swap_chain_image_views[i]) != VK_SUCCESS) {
+        if (vkCreateImageView(logical_device, &create_info, host_memory.callbacks(), &swap_chain_image_views[i]) != VK_SUCCESS) {
             throw std::runtime_error("failed to create image views!");
         }
     }
@@ -1,11 +1,15 @@
 #include <vulkan_app.hpp>
 
 std::vector<const char*> vulkan_app::get_required_extensions() {
-    uint32_t glfw_extension_count = 0;
-    const char** glfw_extensions;
-    glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
-
-    std::vector<const char*> extensions(glfw_extensions, glfw_extensions + glfw_extension_count);
+    std::vector<const char*> extensions;
+    // GLFW is never initialized in headless mode, and without
+    // a surface no window system extensions are needed
+    if (!config.headless) {
+        uint32_t glfw_extension_count = 0;
+        const char** glfw_extensions;
+        glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+        extensions.assign(glfw_extensions, glfw_extensions + glfw_extension_count);
+    }
     if (enable_validation_layers) {
         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
     }
@@ -13,8 +17,21 @@ std::vector<const char*> vulkan_app::get_required_extensions() {
     return extensions;
 }
 
+void vulkan_app::print_instance_extensions() {
+    uint32_t extension_count = 0;
+    vkEnumerateInstanceExtensionProperties(nullptr, &extension_count, nullptr);
+    std::vector<VkExtensionProperties> extensions(extension_count);
+    vkEnumerateInstanceExtensionProperties(nullptr, &extension_count, extensions.data());
+    // one write, other startup steps print concurrently
+    std::string message = "available extensions:\n";
+    for (const auto& extension : extensions) {
+        message += '\t' + std::string(extension.extensionName) + '\n';
+    }
+    std::cout << message << std::flush;
+}
+
 void vulkan_app::create_instance() {
-    if (enable_validation_layers && !check_validation_layer_support()) {
+    if (enable_validation_layers && !validation_layers_available) {
         throw std::runtime_error("some of the requested validation layers are unavailable!");
     }
     /* Fill out application information for the Vulkan instance */
@@ -24,23 +41,26 @@ void vulkan_app::create_instance() {
     app_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     app_info.pEngineName = "No Engine";
     app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    app_info.apiVersion = VK_API_VERSION_1_0;
+    // vkEnumerateInstanceVersion only exists on 1.1+ loaders
+    auto enumerate_instance_version = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+        vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+    uint32_t loader_version = VK_API_VERSION_1_0;
+    if (enumerate_instance_version != nullptr) {
+        enumerate_instance_version(&loader_version);
+    }
+    // 1.3 for the dynamic rendering path, 1.2 for timeline semaphores,
+    // older loaders get a 1.0 instance
+    if (loader_version >= VK_API_VERSION_1_3) {
+        api_version = VK_API_VERSION_1_3;
+    } else {
+        api_version = loader_version >= VK_API_VERSION_1_2 ? VK_API_VERSION_1_2 : VK_API_VERSION_1_0;
+    }
+    app_info.apiVersion = api_version;
     
     /* Fill out Vulkan instance information */
     VkInstanceCreateInfo create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
     create_info.pApplicationInfo = &app_info;
-    // query all availible extentions
-    uint32_t extention_count = 0;
-    vkEnumerateInstanceExtensionProperties(nullptr, &extention_count, nullptr);
-    std::vector<VkExtensionProperties> extensions(extention_count);
-    vkEnumerateInstanceExtensionProperties(nullptr, &extention_count, extensions.data());
-    // display extension data
-    std::cout << "availible extensions:\n";
-    for (const auto& extension : extensions) {
-        std::cout << '\t' << extension.extensionName << '\n';
-    }
-    std::cout << std::flush;
     // add extension info for the Vulkan instance 
     auto glfw_extensions = get_required_extensions();
     create_info.enabledExtensionCount = static_cast<uint32_t>(glfw_extensions.size());
@@ -66,10 +86,10 @@ void vulkan_app::create_instance() {
     }
     
     /* Create the Vulkan instance */
-    // NOTE: custom allocator callbacks will not be used throughout
-    //       this tutorial, and for this reason the second argument
-    //       will always be nullptr.
-    if (vkCreateInstance(&create_info, nullptr, &instance) != VK_SUCCESS) {
+    // NOTE: the allocation callbacks are nullptr (the driver's own
+    //       allocator) unless --host-allocator is given; every other
+    //       create/destroy call passes the same ones, see host_allocator.
+    if (vkCreateInstance(&create_info, host_memory.callbacks(), &instance) != VK_SUCCESS) {
         throw std::runtime_error("failed to create a Vulkan instance!");
     }
 
@@ -0,0 +1,97 @@
+#include <vulkan_app.hpp>
+#include <stats.hpp>
+#include <cmath>
+
+static const present_policy all_present_policies[] = {
+    present_policy::low_latency, present_policy::power_saving, present_policy::throughput
+};
+
+const char* present_policy_name(present_policy policy) {
+    switch (policy) {
+    case present_policy::low_latency:  return "low_latency";
+    case present_policy::power_saving: return "power_saving";
+    default:                           return "throughput";
+    }
+}
+
+bool parse_present_policy(const std::string& name, present_policy& policy) {
+    for (auto candidate : all_present_policies) {
+        if (name == present_policy_name(candidate)) {
+            policy = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+static const char* present_mode_name(VkPresentModeKHR mode) {
+    switch (mode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:    return "IMMEDIATE";
+    case VK_PRESENT_MODE_MAILBOX_KHR:      return "MAILBOX";
+    case VK_PRESENT_MODE_FIFO_KHR:         return "FIFO";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO_RELAXED";
+    default:                               return "other";
+    }
+}
+
+void vulkan_app::key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    if (action != GLFW_PRESS) {
+        return;
+    }
+    auto app = reinterpret_cast<vulkan_app*>(glfwGetWindowUserPointer(window));
+    if (key >= GLFW_KEY_1 && key <= GLFW_KEY_3) {
+        app->set_present_policy(all_present_policies[key - GLFW_KEY_1]);
+    }
+}
+
+/**
+ * The present mode and the image count are baked into the swap chain,
+ * so switching policies goes through the regular recreation path and
+ * never stalls the frames that are still in flight.
+ */
+void vulkan_app::set_present_policy(present_policy policy) {
+    if (policy == requested_present_policy) {
+        return;
+    }
+    requested_present_policy = policy;
+    swap_chain_out_of_date = true;
+    std::cout << "switching to the " << present_policy_name(policy) << " present policy" << std::endl;
+}
+
+void vulkan_app::record_present_timing() {
+    auto now = std::chrono::steady_clock::now();
+    if (presented_since_switch) {
+        present_stats.back().interval_ms.push_back(
+            std::chrono::duration<double, std::milli>(now - last_present_time).count());
+    }
+    last_present_time = now;
+    presented_since_switch = true;
+}
+
+void vulkan_app::report_present_stats() {
+    for (const auto& stats : present_stats) {
+        if (stats.interval_ms.empty()) {
+            continue;
+        }
+        double mean = 0.0;
+        for (double interval : stats.interval_ms) {
+            mean += interval;
+        }
+        mean /= stats.interval_ms.size();
+        double variance = 0.0;
+        for (double interval : stats.interval_ms) {
+            variance += (interval - mean) * (interval - mean);
+        }
+        double deviation = std::sqrt(variance / stats.interval_ms.size());
+
+        std::cout << present_policy_name(stats.policy) << " (" << present_mode_name(stats.present_mode)
+                  << ", " << stats.image_count << " images): "
+                  << stats.interval_ms.size() + 1 << " presents"
+                  << ", latency p50 " << percentile(stats.latency_ms, 0.5)
+                  << " ms p99 " << percentile(stats.latency_ms, 0.99) << " ms"
+                  // pacing: a steady frame rate has a small deviation and p99 close to the mean
+                  << ", interval mean " << mean << " ms stddev " << deviation
+                  << " ms p99 " << percentile(stats.interval_ms, 0.99) << " ms\n";
+    }
+    std::cout << std::flush;
+}
@@ -0,0 +1,54 @@
+#include <vulkan_app.hpp>
+#include <algorithm>
+
+VkFormat vulkan_app::choose_offscreen_format() {
+    // same preference as choose_swap_surface_format(), but checked
+    // against what the device can render to instead of the surface
+    const VkFormat candidates[] = {
+        VK_FORMAT_B8G8R8A8_SRGB,
+        VK_FORMAT_R8G8B8A8_SRGB,
+        VK_FORMAT_B8G8R8A8_UNORM,
+        VK_FORMAT_R8G8B8A8_UNORM
+    };
+    for (auto format : candidates) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT) {
+            return format;
+        }
+    }
+    throw std::runtime_error("failed to find a color attachment format for offscreen rendering!");
+}
+
+/**
+ * Headless replacement for create_swap_chain(): the render targets
+ * are ordinary device-local images owned by the app. They are stored
+ * in swap_chain_images so that everything downstream (image views,
+ * framebuffers, ...) does not have to care where they came from.
+ */
+void vulkan_app::create_offscreen_targets() {
+    swap_chain_image_format = choose_offscreen_format();
+    swap_chain_extent = { width, hight };
+
+    // every frame in flight needs a target of its own
+    uint32_t image_count = std::max(offscreen_image_count, config.frames_in_flight);
+    swap_chain_images.resize(image_count);
+    offscreen_image_allocations.resize(image_count);
+    for (uint32_t i = 0; i < image_count; i++) {
+        VkImageCreateInfo create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        create_info.imageType = VK_IMAGE_TYPE_2D;
+        create_info.format = swap_chain_image_format;
+        create_info.extent = { swap_chain_extent.width, swap_chain_extent.height, 1 };
+        create_info.mipLevels = 1;
+        create_info.arrayLayers = 1;
+        create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        // transfer source, so that rendered frames can be copied out
+        create_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        swap_chain_images[i] = allocator.create_image(create_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                      offscreen_image_allocations[i]);
+    }
+}
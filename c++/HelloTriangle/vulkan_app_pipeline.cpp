@@ -0,0 +1,132 @@
+#include <vulkan_app.hpp>
+#include <chrono>
+#include <map>
+#include <sstream>
+
+VkPipeline vulkan_app::create_pipeline(const shader& vert, const shader& frag,
+                                       const VkPipelineVertexInputStateCreateInfo& vertex_input_info,
+                                       VkPipelineLayout layout, const char* name, bool alpha_blend) {
+    VkPipelineShaderStageCreateInfo shader_stages[2]{};
+    shader_stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shader_stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shader_stages[0].module = vert.module;
+    shader_stages[0].pName = "main";
+    shader_stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shader_stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shader_stages[1].module = frag.module;
+    shader_stages[1].pName = "main";
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly{};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    input_assembly.primitiveRestartEnable = VK_FALSE;
+
+    // viewport and scissor are set while recording, so that the
+    // pipeline does not depend on the size of the swap chain
+    VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic_state{};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = 2;
+    dynamic_state.pDynamicStates = dynamic_states;
+
+    VkPipelineViewportStateCreateInfo viewport_state{};
+    viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterizer.depthBiasEnable = VK_FALSE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState color_blend_attachment{};
+    color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                            VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    // straight (not premultiplied) alpha, the alpha channel is left as is
+    color_blend_attachment.blendEnable = alpha_blend ? VK_TRUE : VK_FALSE;
+    color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
+    color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    color_blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    VkPipelineColorBlendStateCreateInfo color_blending{};
+    color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blending.logicOpEnable = VK_FALSE;
+    color_blending.attachmentCount = 1;
+    color_blending.pAttachments = &color_blend_attachment;
+
+    VkGraphicsPipelineCreateInfo pipeline_info{};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipeline_info.stageCount = 2;
+    pipeline_info.pStages = shader_stages;
+    pipeline_info.pVertexInputState = &vertex_input_info;
+    pipeline_info.pInputAssemblyState = &input_assembly;
+    pipeline_info.pViewportState = &viewport_state;
+    pipeline_info.pRasterizationState = &rasterizer;
+    pipeline_info.pMultisampleState = &multisampling;
+    pipeline_info.pColorBlendState = &color_blending;
+    pipeline_info.pDynamicState = &dynamic_state;
+    pipeline_info.layout = layout;
+    pipeline_info.renderPass = render_pass;
+    pipeline_info.subpass = 0;
+    // without a render pass the pipeline only needs to know the formats it renders to
+    VkPipelineRenderingCreateInfo rendering_info{};
+    rendering_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    rendering_info.colorAttachmentCount = 1;
+    rendering_info.pColorAttachmentFormats = &swap_chain_image_format;
+    if (vulkan13_path) {
+        pipeline_info.pNext = &rendering_info;
+    }
+
+    // this is where the driver compiles the shaders, unless the
+    // pipeline cache already has the result from an earlier run
+    auto start = std::chrono::steady_clock::now();
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(logical_device, pipeline_cache, 1, &pipeline_info, host_memory.callbacks(), &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create a graphics pipeline!");
+    }
+    auto end = std::chrono::steady_clock::now();
+    // pipelines are compiled concurrently at startup, print whole lines only
+    std::ostringstream message;
+    message << name << " pipeline created in "
+            << std::chrono::duration<double, std::milli>(end - start).count() << " ms ("
+            << (pipeline_cache_warm ? "warm" : "cold") << " start)\n";
+    std::cout << message.str() << std::flush;
+    return pipeline;
+}
+
+void vulkan_app::create_graphics_pipeline() {
+    const shader& vert = shaders.load("shaders/triangle.vert.spv");
+    const shader& frag = shaders.load("shaders/triangle.frag.spv");
+    // set 0 is the bindless set, resources are indexed through the push constants
+    std::map<uint32_t, VkDescriptorSetLayout> external_sets;
+    if (descriptors.is_bindless()) {
+        external_sets[0] = descriptors.bindless_layout();
+    }
+    pipeline_layout = shaders.create_pipeline_layout({&vert, &frag}, external_sets).layout;
+
+    bool mesh = !config.mesh_path.empty();
+    auto binding_description = mesh ? mesh_vertex_input::get_binding_description() : vertex::get_binding_description();
+    auto attribute_descriptions = mesh ? mesh_vertex_input::get_attribute_descriptions()
+                                       : vertex::get_attribute_descriptions();
+    VkPipelineVertexInputStateCreateInfo vertex_input_info{};
+    vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertex_input_info.vertexBindingDescriptionCount = 1;
+    vertex_input_info.pVertexBindingDescriptions = &binding_description;
+    vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attribute_descriptions.size());
+    vertex_input_info.pVertexAttributeDescriptions = attribute_descriptions.data();
+
+    graphics_pipeline = create_pipeline(vert, frag, vertex_input_info, pipeline_layout, "graphics");
+}
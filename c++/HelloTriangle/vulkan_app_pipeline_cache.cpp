@@ -0,0 +1,84 @@
+#include <vulkan_app.hpp>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+
+/**
+ * The driver is free to ignore initial data it does not like, but
+ * a cache written by a different driver or GPU is worse than useless,
+ * so the header is checked against the chosen device before use.
+ */
+bool vulkan_app::is_pipeline_cache_compatible(const std::vector<char>& data) {
+    VkPipelineCacheHeaderVersionOne header;
+    if (data.size() < sizeof(header)) {
+        std::cerr << "pipeline cache: file is too small for a header" << std::endl;
+        return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    if (header.headerSize < sizeof(header) || header.headerSize > data.size() ||
+        header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) {
+        std::cerr << "pipeline cache: unknown header version" << std::endl;
+        return false;
+    }
+    if (header.vendorID != properties.vendorID || header.deviceID != properties.deviceID) {
+        std::cerr << "pipeline cache: written for a different device" << std::endl;
+        return false;
+    }
+    if (std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        std::cerr << "pipeline cache: written by a different driver version" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void vulkan_app::create_pipeline_cache() {
+    std::vector<char> data;
+    if (!config.pipeline_cache_path.empty()) {
+        std::ifstream file(config.pipeline_cache_path, std::ios::ate | std::ios::binary);
+        if (file.is_open()) {
+            data.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(data.data(), data.size());
+        }
+    }
+    // a stale cache is simply discarded, it will be rewritten on exit
+    if (!data.empty() && !is_pipeline_cache_compatible(data)) {
+        data.clear();
+    }
+
+    VkPipelineCacheCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    create_info.initialDataSize = data.size();
+    create_info.pInitialData = data.empty() ? nullptr : data.data();
+    if (vkCreatePipelineCache(logical_device, &create_info, host_memory.callbacks(), &pipeline_cache) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create a pipeline cache!");
+    }
+    pipeline_cache_warm = !data.empty();
+}
+
+void vulkan_app::save_pipeline_cache() {
+    if (config.pipeline_cache_path.empty()) {
+        return;
+    }
+    size_t data_size = 0;
+    vkGetPipelineCacheData(logical_device, pipeline_cache, &data_size, nullptr);
+    std::vector<char> data(data_size);
+    if (vkGetPipelineCacheData(logical_device, pipeline_cache, &data_size, data.data()) != VK_SUCCESS) {
+        std::cerr << "pipeline cache: failed to retrieve the cache data" << std::endl;
+        return;
+    }
+    // write next to the old file first, so that a crash halfway
+    // through never leaves a truncated cache behind
+    std::string temp_path = config.pipeline_cache_path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file.write(data.data(), data_size)) {
+            std::cerr << "pipeline cache: failed to write " << temp_path << std::endl;
+            return;
+        }
+    }
+    std::rename(temp_path.c_str(), config.pipeline_cache_path.c_str());
+}
@@ -23,7 +23,7 @@ swap_chain_support_details vulkan_app::query_swap_chain_support(VkPhysicalDevice
 
 
 void vulkan_app::create_surface() {
-    if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) {
+    if (glfwCreateWindowSurface(instance, window, host_memory.callbacks(), &surface) != VK_SUCCESS) {
         throw std::runtime_error("failed to create window surface!");
     }
 }
@@ -38,11 +38,24 @@ VkSurfaceFormatKHR vulkan_app::choose_swap_surface_format(const std::vector<VkSu
 }
 
 VkPresentModeKHR vulkan_app::choose_swap_present_mode(const std::vector<VkPresentModeKHR>& available_present_modes) {
-    for (const auto& available_present_mode : available_present_modes) {
-        if (available_present_mode == VK_PRESENT_MODE_MAILBOX_KHR) {
-            return available_present_mode;
+    std::vector<VkPresentModeKHR> preferred;
+    switch (active_present_policy) {
+    case present_policy::low_latency:
+        // IMMEDIATE tears, but shows a finished frame right away
+        preferred = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR};
+        break;
+    case present_policy::throughput:
+        preferred = {VK_PRESENT_MODE_MAILBOX_KHR};
+        break;
+    case present_policy::power_saving:
+        break;
+    }
+    for (auto mode : preferred) {
+        if (std::find(available_present_modes.begin(), available_present_modes.end(), mode) != available_present_modes.end()) {
+            return mode;
         }
     }
+    // the only mode every implementation has to support
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -66,7 +79,14 @@ void vulkan_app::create_swap_chain() {
     VkPresentModeKHR present_mode = choose_swap_present_mode(swap_chain_support.present_modes);
     VkExtent2D extent = choose_swap_extent(swap_chain_support.capabilities);
 
-    uint32_t image_count = swap_chain_support.capabilities.minImageCount + 1;
+    // fewer images mean a shorter queue in front of the display,
+    // more images keep the GPU busy when a frame takes longer
+    uint32_t image_count = swap_chain_support.capabilities.minImageCount;
+    if (active_present_policy == present_policy::power_saving) {
+        image_count += 1;
+    } else if (active_present_policy == present_policy::throughput) {
+        image_count += 2;
+    }
     if (swap_chain_support.capabilities.maxImageCount > 0 && image_count > swap_chain_support.capabilities.maxImageCount) {
         image_count = swap_chain_support.capabilities.maxImageCount;
     }
@@ -80,6 +100,13 @@ void vulkan_app::create_swap_chain() {
     create_info.imageExtent = extent;
     create_info.imageArrayLayers = 1;
     create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    // captured frames are copied out of the swap chain images
+    if (!config.capture_path.empty()) {
+        if (!(swap_chain_support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+            throw std::runtime_error("failed to capture frames, the surface does not support copying from its images!");
+        }
+        create_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
     
     queue_family_indices indices = find_queue_families(physical_device);
     uint32_t queue_family_indices[] = {indices.graphics_family.value(), indices.present_family.value()};
@@ -97,15 +124,80 @@ void vulkan_app::create_swap_chain() {
     create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     create_info.presentMode = present_mode;
     create_info.clipped = VK_TRUE;
-    create_info.oldSwapchain = VK_NULL_HANDLE;
+    // lets the driver hand the old images over instead of starting from scratch;
+    // the old swap chain is retired but still has to be destroyed by us
+    create_info.oldSwapchain = swap_chain;
 
-    if (vkCreateSwapchainKHR(logical_device, &create_info, nullptr, &swap_chain) != VK_SUCCESS) {
+    VkSwapchainKHR new_swap_chain;
+    if (vkCreateSwapchainKHR(logical_device, &create_info, host_memory.callbacks(), &new_swap_chain) != VK_SUCCESS) {
         throw std::runtime_error("failed to create a swap chain!");
     }
+    swap_chain = new_swap_chain;
 
     vkGetSwapchainImagesKHR(logical_device, swap_chain, &image_count, nullptr);
     swap_chain_images.resize(image_count);
     vkGetSwapchainImagesKHR(logical_device, swap_chain, &image_count, swap_chain_images.data());
     swap_chain_image_format = surface_format.format;
     swap_chain_extent = extent;
-}
\ No newline at end of file
+
+    // a resize keeps collecting into the current entry
+    if (present_stats.empty() || present_stats.back().policy != active_present_policy) {
+        present_stats.push_back({active_present_policy, present_mode, image_count, {}, {}});
+        presented_since_switch = false;
+        std::fill(frame_input_samples.begin(), frame_input_samples.end(), std::nullopt);
+    }
+}
+
+/**
+ * Replace the swap chain without waiting for the device to go idle.
+ * Frames that are still in flight keep rendering to and presenting
+ * the old images, so the old swap chain and everything built on top
+ * of it is parked in retired_swap_chains until those frames retire.
+ */
+void vulkan_app::recreate_swap_chain() {
+    if (is_window_minimized()) {
+        // keep the flag set, the swap chain is rebuilt once the window is restored
+        return;
+    }
+    swap_chain_out_of_date = false;
+    active_present_policy = requested_present_policy;
+
+    retired_swap_chains.push_back({swap_chain, swap_chain_image_views, swap_chain_framebuffers,
+                                   render_finished_semaphores, frame_number});
+    // NOTE: the render pass and the pipeline are kept, the surface
+    //       format is not expected to change along with the size
+    create_swap_chain();
+    create_image_views();
+    create_framebuffers();
+    create_render_finished_semaphores();
+}
+
+void vulkan_app::destroy_swap_chain_resources(const retired_swap_chain& retired) {
+    for (auto framebuffer : retired.framebuffers) {
+        vkDestroyFramebuffer(logical_device, framebuffer, host_memory.callbacks());
+    }
+    for (auto image_view : retired.image_views) {
+        vkDestroyImageView(logical_device, image_view, host_memory.callbacks());
+    }
+    for (auto semaphore : retired.render_finished_semaphores) {
+        vkDestroySemaphore(logical_device, semaphore, host_memory.callbacks());
+    }
+    if (retired.swap_chain != VK_NULL_HANDLE) {
+        vkDestroySwapchainKHR(logical_device, retired.swap_chain, host_memory.callbacks());
+    }
+}
+
+void vulkan_app::destroy_retired_swap_chains(bool wait_all) {
+    // at the start of frame F the fences of all frames up to
+    // F - frames_in_flight have been waited on, so everything
+    // retired at or before F - frames_in_flight + 1 is unused
+    auto it = retired_swap_chains.begin();
+    while (it != retired_swap_chains.end()) {
+        if (wait_all || it->retired_at + config.frames_in_flight <= frame_number + 1) {
+            destroy_swap_chain_resources(*it);
+            it = retired_swap_chains.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
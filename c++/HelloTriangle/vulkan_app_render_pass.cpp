@@ -0,0 +1,60 @@
+#include <vulkan_app.hpp>
+
+void vulkan_app::create_render_pass() {
+    // dynamic rendering takes the attachment formats at pipeline creation instead
+    if (vulkan13_path) {
+        return;
+    }
+    VkAttachmentDescription color_attachment{};
+    color_attachment.format = swap_chain_image_format;
+    color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    // the frame graph transitions the image in and out of the render
+    // pass (see build_frame_graph()), together with the other barriers
+    color_attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference color_attachment_ref{};
+    color_attachment_ref.attachment = 0;
+    color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &color_attachment_ref;
+
+    VkRenderPassCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    create_info.attachmentCount = 1;
+    create_info.pAttachments = &color_attachment;
+    create_info.subpassCount = 1;
+    create_info.pSubpasses = &subpass;
+
+    if (vkCreateRenderPass(logical_device, &create_info, host_memory.callbacks(), &render_pass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create a render pass!");
+    }
+}
+
+void vulkan_app::create_framebuffers() {
+    // vkCmdBeginRendering takes the image views directly, nothing to rebuild with the swap chain
+    if (vulkan13_path) {
+        return;
+    }
+    swap_chain_framebuffers.resize(swap_chain_image_views.size());
+    for (size_t i = 0; i < swap_chain_image_views.size(); i++) {
+        VkFramebufferCreateInfo create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        create_info.renderPass = render_pass;
+        create_info.attachmentCount = 1;
+        create_info.pAttachments = &swap_chain_image_views[i];
+        create_info.width = swap_chain_extent.width;
+        create_info.height = swap_chain_extent.height;
+        create_info.layers = 1;
+        if (vkCreateFramebuffer(logical_device, &create_info, host_memory.callbacks(), &swap_chain_framebuffers[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create a framebuffer!");
+        }
+    }
+}
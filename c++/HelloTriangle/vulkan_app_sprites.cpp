@@ -0,0 +1,133 @@
+#include <vulkan_app.hpp>
+#include <cmath>
+#include <random>
+
+/**
+ * The sprite demo: half of the sprites are opaque tiles on a grid in
+ * a retained batch, of which one changes color every few frames; the
+ * other half are translucent particles in the dynamic batch, which
+ * move every frame. The particles use the first streamed texture, if
+ * there is one.
+ */
+void vulkan_app::create_sprites() {
+    if (config.sprite_count == 0) {
+        return;
+    }
+    if (!descriptors.is_bindless()) {
+        std::cout << "sprites need bindless descriptors, not drawing any" << std::endl;
+        return;
+    }
+    sprites.init(&allocator, &uploads, config.frames_in_flight);
+
+    uint32_t tile_count = config.sprite_count / 2;
+    auto columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(tile_count))));
+    float tile_size = columns > 0 ? 2.0f / columns : 0.0f;
+    sprite_tiles = &sprites.create_retained_batch();
+    for (uint32_t i = 0; i < tile_count; i++) {
+        sprite tile;
+        tile.center[0] = -1.0f + tile_size * (i % columns + 0.5f);
+        tile.center[1] = -1.0f + tile_size * (i / columns + 0.5f);
+        // a small gap between the tiles
+        tile.half_size[0] = tile.half_size[1] = tile_size * 0.45f;
+        tile.color = 0xff000000 | (i * 2654435761u & 0x003f3f3f);
+        sprite_tiles->add(tile);
+    }
+
+    // a fixed seed, like the scene
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    uint32_t particle_count = config.sprite_count - tile_count;
+    sprite_batch& particles = sprites.dynamic_batch();
+    particle_phases.resize(particle_count);
+    for (uint32_t i = 0; i < particle_count; i++) {
+        particle_phases[i] = 6.2831853f * unit(rng);
+        sprite particle;
+        particle.center[0] = particle.center[1] = 0.0f;
+        particle.half_size[0] = particle.half_size[1] = 0.01f + 0.03f * unit(rng);
+        particle.color = 0x80ffffff & (0xff000000 | static_cast<uint32_t>(rng()));
+        particle.layer = 1;
+        particle.blend = sprite_blend::alpha;
+        particles.add(particle);
+    }
+    sprites_enabled = true;
+}
+
+void vulkan_app::create_sprite_pipelines() {
+    if (config.sprite_count == 0 || !descriptors.is_bindless()) {
+        return;
+    }
+    const shader& vert = shaders.load("shaders/sprite.vert.spv");
+    const shader& frag = shaders.load("shaders/sprite.frag.spv");
+    sprite_pipeline_layout = shaders.create_pipeline_layout({&vert, &frag},
+                                                            {{0, descriptors.bindless_layout()}}).layout;
+
+    // everything comes per instance, the corners are generated from gl_VertexIndex
+    VkVertexInputBindingDescription binding_description{};
+    binding_description.binding = 0;
+    binding_description.stride = sizeof(sprite_instance);
+    binding_description.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    VkVertexInputAttributeDescription attribute_descriptions[4]{};
+    const VkFormat formats[4] = {VK_FORMAT_R32G32B32A32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT,
+                                 VK_FORMAT_R32_UINT, VK_FORMAT_R32_UINT};
+    const uint32_t offsets[4] = {offsetof(sprite_instance, rect), offsetof(sprite_instance, uv),
+                                 offsetof(sprite_instance, color), offsetof(sprite_instance, texture)};
+    for (uint32_t i = 0; i < 4; i++) {
+        attribute_descriptions[i].binding = 0;
+        attribute_descriptions[i].location = i;
+        attribute_descriptions[i].format = formats[i];
+        attribute_descriptions[i].offset = offsets[i];
+    }
+    VkPipelineVertexInputStateCreateInfo vertex_input_info{};
+    vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertex_input_info.vertexBindingDescriptionCount = 1;
+    vertex_input_info.pVertexBindingDescriptions = &binding_description;
+    vertex_input_info.vertexAttributeDescriptionCount = 4;
+    vertex_input_info.pVertexAttributeDescriptions = attribute_descriptions;
+
+    sprite_pipelines[0] = create_pipeline(vert, frag, vertex_input_info, sprite_pipeline_layout, "sprite", false);
+    sprite_pipelines[1] = create_pipeline(vert, frag, vertex_input_info, sprite_pipeline_layout, "sprite (alpha)", true);
+}
+
+void vulkan_app::destroy_sprites() {
+    sprites.destroy();
+    for (VkPipeline pipeline : sprite_pipelines) {
+        vkDestroyPipeline(logical_device, pipeline, host_memory.callbacks());
+    }
+}
+
+// after the frame's fence, before the upload batch is submitted
+void vulkan_app::update_sprites() {
+    if (!sprites_enabled) {
+        return;
+    }
+    // recolor one tile now and then, the batch is uploaded again as a whole
+    if (frame_number % 8 == 0 && sprite_tiles->size() > 0) {
+        auto tile = static_cast<uint32_t>((frame_number / 8) * 2654435761u % sprite_tiles->size());
+        sprite_tiles->set_color(tile, 0xff000000 | static_cast<uint32_t>(frame_number * 40503u));
+    }
+
+    sprite_batch& particles = sprites.dynamic_batch();
+    uint32_t texture = config.texture_paths.empty() ? texture_streamer::no_descriptor : textures.descriptor_index(0);
+    bool retexture = texture != particle_texture;
+    particle_texture = texture;
+    float time = 0.01f * static_cast<float>(frame_number);
+    for (uint32_t i = 0; i < particle_phases.size(); i++) {
+        float phase = particle_phases[i];
+        float radius = 0.2f + 0.7f * (0.5f + 0.5f * std::sin(3.0f * phase + time));
+        particles.set_center(i, radius * std::cos(phase + time), radius * std::sin(phase + time));
+        // only moves the sprite between textures, the sort key changes
+        if (retexture) {
+            particles.set_texture(i, texture);
+        }
+    }
+    sprites.prepare(current_frame, frame_number);
+}
+
+void vulkan_app::record_sprites(VkCommandBuffer command_buffer) {
+    if (!sprites_enabled) {
+        return;
+    }
+    descriptors.bind_bindless(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, sprite_pipeline_layout);
+    record_viewport(command_buffer);
+    sprites.record(command_buffer, sprite_pipelines);
+}
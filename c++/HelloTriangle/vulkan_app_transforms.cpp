@@ -0,0 +1,80 @@
+#include <vulkan_app.hpp>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+/**
+ * The transform demo: a forest of 4-ary trees, 64 nodes per tree, of
+ * which an eighth of the roots turn every frame, so that the subtrees
+ * below the other roots stay clean. Each frame in flight has its own
+ * persistently mapped storage buffer of world matrices (see
+ * transform_system for the layout), which only gets the matrices that
+ * changed since that frame slot last ran.
+ */
+void vulkan_app::create_transforms() {
+    if (config.transform_count == 0) {
+        return;
+    }
+    uint32_t roots = std::max(1u, config.transform_count / 64);
+    // a fixed seed, like the scene
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    for (uint32_t n = 0; n < config.transform_count; n++) {
+        // node `roots + 4 * p + k` is child k of node p
+        transforms.create(n < roots ? transform_system::no_parent : (n - roots) / 4);
+        transforms.set_position(n, unit(rng), unit(rng), unit(rng));
+        transforms.set_scale(n, 0.9f, 0.9f, 0.9f);
+    }
+
+    VkDeviceSize size = sizeof(float) * 12 * transforms.size();
+    transform_buffers.resize(config.frames_in_flight);
+    transform_buffer_allocations.resize(config.frames_in_flight);
+    transform_buffers_written.assign(config.frames_in_flight, 0);
+    for (uint32_t i = 0; i < config.frames_in_flight; i++) {
+        transform_buffers[i] = allocator.create_buffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, transform_buffer_allocations[i]);
+    }
+}
+
+void vulkan_app::destroy_transforms() {
+    for (size_t i = 0; i < transform_buffers.size(); i++) {
+        allocator.destroy_buffer(transform_buffers[i], transform_buffer_allocations[i]);
+    }
+    transform_buffers.clear();
+    transform_buffer_allocations.clear();
+}
+
+void vulkan_app::update_transforms() {
+    if (transform_buffers.empty()) {
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    uint32_t roots = std::max(1u, config.transform_count / 64);
+    float angle = 0.01f * static_cast<float>(frame_number);
+    for (uint32_t n = static_cast<uint32_t>(frame_number % 8); n < roots; n += 8) {
+        transforms.set_rotation(n, 0.0f, std::sin(angle), 0.0f, std::cos(angle));
+    }
+    // the recording workers are idle until the frame is recorded
+    transforms.update(record_workers.get(), active_record_threads);
+    // the previous user of this buffer was the frame that last ran in this slot, long retired
+    transforms.write(record_workers.get(), active_record_threads,
+                     static_cast<float*>(transform_buffer_allocations[current_frame].mapped),
+                     transform_buffers_written[current_frame]);
+    transform_buffers_written[current_frame] = transforms.update_count();
+
+    transform_stats.frames++;
+    transform_stats.worlds += transforms.worlds_composed();
+    transform_stats.ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void vulkan_app::print_transform_stats() const {
+    if (transform_stats.frames == 0) {
+        return;
+    }
+    double frames = static_cast<double>(transform_stats.frames);
+    std::cout << "transforms: " << transforms.size() << " nodes, "
+              << transform_stats.worlds / frames << " world matrices and "
+              << transform_stats.ms / frames << " ms per frame ("
+              << transform_system::simd_level_name(transforms.get_simd_level()) << ")" << std::endl;
+}
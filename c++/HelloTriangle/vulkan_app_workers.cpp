@@ -0,0 +1,141 @@
+#include <vulkan_app.hpp>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+void vulkan_app::build_draw_list() {
+    // lay the triangles out on a square grid covering the whole viewport
+    uint32_t grid_size = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(config.draw_count))));
+    float cell_size = 2.0f / grid_size;
+    draw_list.resize(config.draw_count);
+    for (uint32_t i = 0; i < config.draw_count; i++) {
+        draw_list[i].offset[0] = -1.0f + cell_size * (i % grid_size + 0.5f);
+        draw_list[i].offset[1] = -1.0f + cell_size * (i / grid_size + 0.5f);
+        draw_list[i].scale = 1.0f / grid_size;
+    }
+}
+
+void vulkan_app::create_worker_command_buffers() {
+    uint32_t worker_count = config.record_threads;
+    if (config.record_benchmark) {
+        worker_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    active_record_threads = config.record_threads;
+    if (worker_count == 0) {
+        return;
+    }
+    record_workers = std::make_unique<job_system>(worker_count);
+
+    queue_family_indices indices = find_queue_families(physical_device);
+    worker_command_pools.resize(config.frames_in_flight);
+    worker_command_buffers.resize(config.frames_in_flight);
+    for (uint32_t frame = 0; frame < config.frames_in_flight; frame++) {
+        worker_command_pools[frame].resize(worker_count);
+        worker_command_buffers[frame].resize(worker_count);
+        for (uint32_t worker = 0; worker < worker_count; worker++) {
+            // transient pools are reset as a whole every time the frame comes around
+            VkCommandPoolCreateInfo pool_info{};
+            pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            pool_info.queueFamilyIndex = indices.graphics_family.value();
+            if (vkCreateCommandPool(logical_device, &pool_info, host_memory.callbacks(), &worker_command_pools[frame][worker]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create a worker command pool!");
+            }
+
+            VkCommandBufferAllocateInfo allocate_info{};
+            allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocate_info.commandPool = worker_command_pools[frame][worker];
+            allocate_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocate_info.commandBufferCount = 1;
+            if (vkAllocateCommandBuffers(logical_device, &allocate_info, &worker_command_buffers[frame][worker]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate a worker command buffer!");
+            }
+        }
+    }
+}
+
+/**
+ * Every active worker records one contiguous slice of the draw list
+ * into its own secondary command buffer. Only the pools of the
+ * current frame are touched, whose previous submission has already
+ * retired (draw_frame() waited on its fence).
+ */
+void vulkan_app::record_secondary_command_buffers(uint32_t image_index) {
+    record_workers->parallel_for(active_record_threads, draw_list.size(),
+        [&](uint32_t worker, size_t begin, size_t end) {
+            vkResetCommandPool(logical_device, worker_command_pools[current_frame][worker], 0);
+            VkCommandBuffer command_buffer = worker_command_buffers[current_frame][worker];
+
+            VkCommandBufferInheritanceInfo inheritance_info{};
+            inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+            // with dynamic rendering the secondaries only need the attachment formats
+            VkCommandBufferInheritanceRenderingInfo rendering_info{};
+            rendering_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+            rendering_info.colorAttachmentCount = 1;
+            rendering_info.pColorAttachmentFormats = &swap_chain_image_format;
+            rendering_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+            if (vulkan13_path) {
+                inheritance_info.pNext = &rendering_info;
+            } else {
+                inheritance_info.renderPass = render_pass;
+                inheritance_info.subpass = 0;
+                inheritance_info.framebuffer = swap_chain_framebuffers[image_index];
+            }
+
+            VkCommandBufferBeginInfo begin_info{};
+            begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                               VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+            begin_info.pInheritanceInfo = &inheritance_info;
+            if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+                throw std::runtime_error("failed to begin recording a secondary command buffer!");
+            }
+            record_draws(command_buffer, begin, end);
+            // the sprites go on top, i.e. after the last slice of the draw list
+            if (worker + 1 == active_record_threads) {
+                record_sprites(command_buffer);
+            }
+            if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to record a secondary command buffer!");
+            }
+        });
+}
+
+void vulkan_app::benchmark_recording() {
+    // inline recording on the main thread first, then 1, 2, 4, ... workers
+    std::vector<uint32_t> thread_counts = {0};
+    for (uint32_t threads = 1; threads < record_workers->size(); threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(record_workers->size());
+
+    active_frames_in_flight = config.frames_in_flight;
+    // every measured frame should record the full draw list
+    uploads.wait(geometry_ticket);
+    std::cout << "recording " << draw_list.size() << " draws, " << config.frame_count << " frames per run\n";
+    double inline_ms = 0.0;
+    for (uint32_t threads : thread_counts) {
+        active_record_threads = threads;
+        stall_stats.clear();
+        stall_stats.push_back({active_frames_in_flight});
+        for (uint32_t frame = 0; frame < config.frame_count; frame++) {
+            if (!config.headless) {
+                glfwPollEvents();
+            }
+            draw_frame();
+        }
+        vkDeviceWaitIdle(logical_device);
+
+        double record_ms = stall_stats.back().record_ms / stall_stats.back().frames;
+        if (threads == 0) {
+            inline_ms = record_ms;
+            std::cout << "\tinline:    " << record_ms << " ms/frame\n";
+        } else {
+            std::cout << "\tthreads " << threads << ": " << record_ms << " ms/frame, "
+                      << inline_ms / record_ms << "x the inline speed\n";
+        }
+    }
+    std::cout << std::flush;
+    stall_stats.clear();
+    profiler.flush();
+}